@@ -73,6 +73,3 @@ void missingToken(TokenType tokenType, int lineNo, int colNo) {
   exit(0);
 }
 
-void assert(char *msg) {
-  printf("%s\n", msg);
-}
@@ -51,6 +51,5 @@ typedef enum {
 
 void error(ErrorCode err, int lineNo, int colNo);
 void missingToken(TokenType tokenType, int lineNo, int colNo);
-void assert(char *msg);
 
 #endif
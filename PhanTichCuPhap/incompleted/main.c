@@ -6,19 +6,45 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "reader.h"
 #include "parser.h"
+#include "trace.h"
 
 /******************************************************************/
 
 int main(int argc, char *argv[]) {
-  if (argc <= 1) {
+  char *fileName = NULL;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+#ifdef KPL_TRACE
+    if (strncmp(argv[i], "--trace=", 8) == 0) {
+      traceMask = parseTraceCategories(argv[i] + 8);
+      if (traceMask < 0) {
+        printf("parser: unknown trace category in %s\n", argv[i]);
+        return -1;
+      }
+      continue;
+    }
+    if (strncmp(argv[i], "--trace-buffer=", 15) == 0) {
+      if (!openTraceBuffer(argv[i] + 15)) {
+        printf("parser: can\'t allocate trace buffer\n");
+        return -1;
+      }
+      continue;
+    }
+#endif
+    fileName = argv[i];
+  }
+
+  if (fileName == NULL) {
     printf("parser: no input file.\n");
     return -1;
   }
 
-  if (compile(argv[1]) == IO_ERROR) {
+  if (compile(fileName) == IO_ERROR) {
     printf("Can\'t read input file!\n");
     return -1;
   }
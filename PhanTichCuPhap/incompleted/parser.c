@@ -10,6 +10,7 @@
 #include "scanner.h"
 #include "parser.h"
 #include "error.h"
+#include "trace.h"
 
 Token *currentToken;
 Token *lookAhead;
@@ -29,17 +30,17 @@ void eat(TokenType tokenType) {
 }
 
 void compileProgram(void) {
-  assert("Parsing a Program ....");
+  TRACE(TRACE_PROGRAM, "Parsing a Program ....");
   eat(KW_PROGRAM);
   eat(TK_IDENT);
   eat(SB_SEMICOLON);
   compileBlock();
   eat(SB_PERIOD);
-  assert("Program parsed!");
+  TRACE(TRACE_PROGRAM, "Program parsed!");
 }
 
 void compileBlock(void) {
-  assert("Parsing a Block ....");
+  TRACE(TRACE_PROGRAM, "Parsing a Block ....");
   if (lookAhead->tokenType == KW_CONST) {
     eat(KW_CONST);
     compileConstDecl();
@@ -47,7 +48,7 @@ void compileBlock(void) {
     compileBlock2();
   } 
   else compileBlock2();
-  assert("Block parsed!");
+  TRACE(TRACE_PROGRAM, "Block parsed!");
 }
 
 void compileBlock2(void) {
@@ -134,7 +135,7 @@ void compileVarDecl(void) {
 }
 
 void compileSubDecls(void) {
-  assert("Parsing subtoutines ....");
+  TRACE(TRACE_SUBDECL, "Parsing subtoutines ....");
   // TODO
   if(lookAhead->tokenType==KW_FUNCTION){
     compileFuncDecl();
@@ -145,11 +146,11 @@ void compileSubDecls(void) {
     compileProcDecl();
     compileSubDecls();
   }
-  assert("Subtoutines parsed ....");
+  TRACE(TRACE_SUBDECL, "Subtoutines parsed ....");
 }
 
 void compileFuncDecl(void) {
-  assert("Parsing a function ....");
+  TRACE(TRACE_SUBDECL, "Parsing a function ....");
   // TODO
   eat(KW_FUNCTION);
   eat(TK_IDENT);
@@ -159,11 +160,11 @@ void compileFuncDecl(void) {
   eat(SB_SEMICOLON);
   compileBlock();
   eat(SB_SEMICOLON);
-  assert("Function parsed ....");
+  TRACE(TRACE_SUBDECL, "Function parsed ....");
 }
 
 void compileProcDecl(void) {
-  assert("Parsing a procedure ....");
+  TRACE(TRACE_SUBDECL, "Parsing a procedure ....");
   // TODO
   eat(KW_PROCEDURE);
   eat(TK_IDENT);
@@ -171,7 +172,7 @@ void compileProcDecl(void) {
   eat(SB_SEMICOLON);
   compileBlock();
   eat(SB_SEMICOLON);
-  assert("Procedure parsed ....");
+  TRACE(TRACE_SUBDECL, "Procedure parsed ....");
 }
 
 void compileUnsignedConstant(void) {
@@ -374,7 +375,7 @@ void compileStatement(void) {
 }
 
 void compileAssignSt(void) {
-  assert("Parsing an assign statement ....");
+  TRACE(TRACE_STATEMENT, "Parsing an assign statement ....");
   // TODO
   eat(TK_IDENT);
   int countVariables = 1;
@@ -403,36 +404,36 @@ void compileAssignSt(void) {
     error(ERR_INVALIDSTATEMENT, lookAhead->lineNo, lookAhead->colNo);
     return;
   }
-  assert("Assign statement parsed ....");
+  TRACE(TRACE_STATEMENT, "Assign statement parsed ....");
 }
 
 void compileCallSt(void) {
-  assert("Parsing a call statement ....");
+  TRACE(TRACE_STATEMENT, "Parsing a call statement ....");
   // TODO
   eat(KW_CALL);
   eat(TK_IDENT);
   compileArguments();
-  assert("Call statement parsed ....");
+  TRACE(TRACE_STATEMENT, "Call statement parsed ....");
 }
 
 void compileGroupSt(void) {
-  assert("Parsing a group statement ....");
+  TRACE(TRACE_STATEMENT, "Parsing a group statement ....");
   // TODO
   eat(KW_BEGIN);
   compileStatements();
   eat(KW_END);
-  assert("Group statement parsed ....");
+  TRACE(TRACE_STATEMENT, "Group statement parsed ....");
 }
 
 void compileIfSt(void) {
-  assert("Parsing an if statement ....");
+  TRACE(TRACE_STATEMENT, "Parsing an if statement ....");
   eat(KW_IF);
   compileCondition();
   eat(KW_THEN);
   compileStatement();
   if (lookAhead->tokenType == KW_ELSE) 
     compileElseSt();
-  assert("If statement parsed ....");
+  TRACE(TRACE_STATEMENT, "If statement parsed ....");
 }
 
 void compileElseSt(void) {
@@ -443,17 +444,17 @@ void compileElseSt(void) {
 }
 
 void compileWhileSt(void) {
-  assert("Parsing a while statement ....");
+  TRACE(TRACE_STATEMENT, "Parsing a while statement ....");
   // TODO
   eat(KW_WHILE);
   compileCondition();
   eat(KW_DO);
   compileStatement();
-  assert("While statement pased ....");
+  TRACE(TRACE_STATEMENT, "While statement pased ....");
 }
 
 void compileForSt(void) {
-  assert("Parsing a for statement ....");
+  TRACE(TRACE_STATEMENT, "Parsing a for statement ....");
   // TODO
   eat(KW_FOR);
   eat(TK_IDENT);
@@ -463,7 +464,7 @@ void compileForSt(void) {
   compileExpression();
   eat(KW_DO);
   compileStatement();
-  assert("For statement parsed ....");
+  TRACE(TRACE_STATEMENT, "For statement parsed ....");
 }
 
 void compileArguments(void) {
@@ -525,7 +526,7 @@ void compileCondition2(void) {
 }
 
 void compileExpression(void) {
-  assert("Parsing an expression");
+  TRACE(TRACE_EXPRESSION, "Parsing an expression");
   // TODO
   switch (lookAhead->tokenType){
   case SB_PLUS:
@@ -541,7 +542,7 @@ void compileExpression(void) {
     break;
   }
   }
-  assert("Expression parsed");
+  TRACE(TRACE_EXPRESSION, "Expression parsed");
 }
 
 void compileExpression2(void) {
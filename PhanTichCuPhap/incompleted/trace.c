@@ -0,0 +1,135 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include "trace.h"
+
+#ifdef KPL_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_TRACE_SITES 64
+
+struct TraceSite_ {
+  int category;
+  char *msg;
+};
+
+typedef struct TraceSite_ TraceSite;
+
+struct {
+  char *name;
+  int mask;
+} traceCategories[] = {
+  {"program", TRACE_PROGRAM},
+  {"subdecl", TRACE_SUBDECL},
+  {"statement", TRACE_STATEMENT},
+  {"expression", TRACE_EXPRESSION},
+  {"all", TRACE_ALL},
+};
+
+int traceMask = 0;
+
+TraceSite traceSites[MAX_TRACE_SITES];
+int traceSiteCount = 0;
+
+TraceRecord *traceBuffer = NULL;
+long long traceCount = 0;
+char *traceFileName = NULL;
+
+int parseTraceCategories(char *spec) {
+  int mask = 0;
+  int len, i, n = sizeof(traceCategories) / sizeof(traceCategories[0]);
+
+  while (*spec != '\0') {
+    len = strcspn(spec, ",");
+    for (i = 0; i < n; i++)
+      if ((strlen(traceCategories[i].name) == (size_t) len) &&
+          (strncmp(traceCategories[i].name, spec, len) == 0))
+        break;
+    if (i == n)
+      return -1;
+    mask |= traceCategories[i].mask;
+    spec += len;
+    if (*spec == ',')
+      spec++;
+  }
+  return mask;
+}
+
+int openTraceBuffer(char *fileName) {
+  traceBuffer = (TraceRecord*) malloc(TRACE_BUFFER_SIZE * sizeof(TraceRecord));
+  if (traceBuffer == NULL)
+    return 0;
+  traceFileName = fileName;
+  traceCount = 0;
+  atexit(closeTrace);   // error() leaves through exit()
+  return 1;
+}
+
+void trace(int category, char *msg, int *site) {
+  struct timespec now;
+  TraceRecord *record;
+
+  if (traceBuffer == NULL) {
+    printf("%s\n", msg);
+    return;
+  }
+
+  if (*site < 0) {
+    if (traceSiteCount == MAX_TRACE_SITES)
+      return;
+    traceSites[traceSiteCount].category = category;
+    traceSites[traceSiteCount].msg = msg;
+    *site = traceSiteCount++;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  record = &traceBuffer[traceCount & (TRACE_BUFFER_SIZE - 1)];
+  record->timestamp = (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+  record->site = *site;
+  record->category = category;
+  traceCount++;
+}
+
+void closeTrace(void) {
+  TraceFileHeader header;
+  FILE *f;
+  long long first, i;
+  int len, s;
+
+  if (traceBuffer == NULL)
+    return;
+
+  f = fopen(traceFileName, "wb");
+  if (f != NULL) {
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.capacity = TRACE_BUFFER_SIZE;
+    header.siteCount = traceSiteCount;
+    header.count = traceCount;
+    fwrite(&header, sizeof(header), 1, f);
+
+    first = (traceCount > TRACE_BUFFER_SIZE) ? traceCount - TRACE_BUFFER_SIZE : 0;
+    for (i = first; i < traceCount; i++)
+      fwrite(&traceBuffer[i & (TRACE_BUFFER_SIZE - 1)], sizeof(TraceRecord), 1, f);
+
+    for (s = 0; s < traceSiteCount; s++) {
+      len = strlen(traceSites[s].msg);
+      fwrite(&traceSites[s].category, sizeof(int), 1, f);
+      fwrite(&len, sizeof(int), 1, f);
+      fwrite(traceSites[s].msg, 1, len, f);
+    }
+    fclose(f);
+  } else printf("Can\'t write trace file %s!\n", traceFileName);
+
+  free(traceBuffer);
+  traceBuffer = NULL;
+}
+
+#endif
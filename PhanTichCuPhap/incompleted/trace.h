@@ -0,0 +1,72 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+/* Parser trace points.
+ *
+ * TRACE expands to nothing unless the parser is built with -DKPL_TRACE
+ * (make parser-trace). In a tracing build every category starts disabled
+ * and is switched on at run time with --trace=<categories>. Messages go
+ * to stdout, or into a ring buffer of timestamped binary records written
+ * out by closeTrace when --trace-buffer=<file> is given.
+ */
+
+#define TRACE_PROGRAM    0x01
+#define TRACE_SUBDECL    0x02
+#define TRACE_STATEMENT  0x04
+#define TRACE_EXPRESSION 0x08
+#define TRACE_ALL        0x0F
+
+#define TRACE_MAGIC 0x54504C4B   /* "KPLT" */
+#define TRACE_VERSION 1
+#define TRACE_BUFFER_SIZE 65536  /* records, a power of two */
+
+/* Buffer file layout: a TraceFileHeader, then min(count, capacity) records
+ * oldest first, then siteCount sites, each an int category, an int length
+ * and the message bytes. A record's site is its index in that list. */
+
+struct TraceFileHeader_ {
+  int magic;
+  int version;
+  int capacity;
+  int siteCount;
+  long long count;
+};
+
+struct TraceRecord_ {
+  long long timestamp;   /* nanoseconds, CLOCK_MONOTONIC */
+  int site;
+  int category;
+};
+
+typedef struct TraceFileHeader_ TraceFileHeader;
+typedef struct TraceRecord_ TraceRecord;
+
+#ifdef KPL_TRACE
+
+extern int traceMask;
+
+#define TRACE(category, msg)                    \
+  do {                                          \
+    static int traceSite = -1;                  \
+    if (traceMask & (category))                 \
+      trace((category), (msg), &traceSite);     \
+  } while (0)
+
+int parseTraceCategories(char *spec);
+int openTraceBuffer(char *fileName);
+void trace(int category, char *msg, int *site);
+void closeTrace(void);
+
+#else
+
+#define TRACE(category, msg) ((void) 0)
+
+#endif
+
+#endif
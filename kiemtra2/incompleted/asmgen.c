@@ -0,0 +1,480 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "reader.h"
+#include "asmgen.h"
+#include "vm.h"
+
+#define MAX_DISPLACEMENT 0x1FFFFFFF   // offsets whose bytes fit in a displacement
+
+// The error of each instruction: its status, or ERROR_IN_EAX when a function of kplrt.c returned it
+#define NO_ERROR 0
+#define ERROR_IN_EAX -1
+
+FILE *asmFile;
+CodeBlock *asmCode;
+int *asmErrors;
+char *asmTargets;           // the addresses a jump or a call goes to
+char *asmEntries;           // those a call goes to
+
+// One line of assembly, indented as an instruction
+void asmLine(char *format, ...) {
+  va_list args;
+
+  fputc('\t', asmFile);
+  va_start(args, format);
+  vfprintf(asmFile, format, args);
+  va_end(args);
+  fputc('\n', asmFile);
+}
+
+int asmOp(CodeAddress i) {
+  return (i == asmCode->codeSize) ? OP_HL : plainOp(asmCode->code[i].op);
+}
+
+// Whether address i runs only after the instruction before it
+int asmFollows(CodeAddress i) {
+  return (i < asmCode->codeSize) && !asmTargets[i];
+}
+
+// The jump to the report of error status at address i, if cc holds
+void asmError(char *cc, CodeAddress i, int status) {
+  asmErrors[i] = status;
+  asmLine("j%s\t.Le%d", cc, i);
+}
+
+/******************* Templates ******************************/
+
+// s[t + k], s[b + q] and the static links of jit.c
+#define STACK "(%%rbx,%%r13,4)"
+#define FRAME "(%%rbx,%%r12,4)"
+
+void asmLoadTop(void) {
+  asmLine("movl\t" STACK ", %%r14d");
+}
+
+void asmSpillTop(void) {
+  asmLine("movl\t%%r14d, " STACK);
+}
+
+// s[t] := top; t := t + 1, before a push
+void asmGrow(void) {
+  asmSpillTop();
+  asmLine("incq\t%%r13");
+}
+
+// t := t - 1; top := s[t]
+void asmPop(void) {
+  asmLine("decq\t%%r13");
+  asmLoadTop();
+}
+
+// eax := base(p), for p > 0
+void asmBase(int p) {
+  asmLine("movl\t%%r12d, %%eax");
+  for (; p > 0; p--)
+    asmLine("movl\t12(%%rbx,%%rax,4), %%eax");
+}
+
+// top := s[reg + q], where reg holds b or base(p)
+void asmLoadWord(char *reg, WORD q) {
+  if ((q >= -MAX_DISPLACEMENT) && (q <= MAX_DISPLACEMENT))
+    asmLine("movl\t%d(%%rbx,%%%s,4), %%r14d", 4 * q, reg);
+  else {
+    asmLine("leaq\t%d(%%%s), %%rax", q, reg);
+    asmLine("movl\t(%%rbx,%%rax,4), %%r14d");
+  }
+}
+
+char* conditionName(int op) {
+  switch (op) {
+  case OP_EQ: return "e";
+  case OP_NE: return "ne";
+  case OP_GT: return "g";
+  case OP_LT: return "l";
+  case OP_GE: return "ge";
+  default: return "le";
+  }
+}
+
+// The condition under which FJ jumps after the comparison op
+char* falseConditionName(int op) {
+  switch (op) {
+  case OP_EQ: return "ne";
+  case OP_NE: return "e";
+  case OP_GT: return "le";
+  case OP_LT: return "ge";
+  case OP_GE: return "l";
+  default: return "g";
+  }
+}
+
+int asmComparison(int op) {
+  return (op >= OP_EQ) && (op <= OP_LE);
+}
+
+/* The flags of a comparison into top, dropping drop words, or with fused
+ * into the jump of the FJ after it, which pops the result. */
+void asmCondition(int op, int drop, int fused, WORD fjTarget) {
+  // Neither lea nor mov touches the flags
+  if (fused) {
+    asmLine("leaq\t%d(%%r13), %%r13", -drop - 1);
+    asmLoadTop();
+    asmLine("j%s\t.L%d", falseConditionName(op), fjTarget);
+  } else {
+    asmLine("set%s\t%%al", conditionName(op));
+    asmLine("movzbl\t%%al, %%r14d");
+    if (drop > 0)
+      asmLine("leaq\t%d(%%r13), %%r13", -drop);
+  }
+}
+
+int asmFoldable(int op) {
+  return (op == OP_AD) || (op == OP_SB) || (op == OP_ML) || asmComparison(op);
+}
+
+/* The arithmetic or comparison op on top and the operand of LC q, or of
+ * LV 0,q, which is not pushed. */
+void asmFolded(int operandOp, WORD q, int op, int fused, WORD fjTarget) {
+  char *name;
+
+  if (op == OP_ML) {
+    if (operandOp == OP_LC)
+      asmLine("imull\t$%d, %%r14d, %%r14d", q);
+    else asmLine("imull\t%d" FRAME ", %%r14d", 4 * q);
+    return;
+  }
+  name = (op == OP_AD) ? "addl" : ((op == OP_SB) ? "subl" : "cmpl");
+  if (operandOp == OP_LC)
+    asmLine("%s\t$%d, %%r14d", name, q);
+  else asmLine("%s\t%d" FRAME ", %%r14d", name, 4 * q);
+  if (asmComparison(op))
+    asmCondition(op, 0, fused, fjTarget);
+}
+
+// A function of kplrt.c that returns a status
+void asmCallChecked(char *function, CodeAddress i) {
+  asmLine("call\t%s", function);
+  asmLine("testl\t%%eax, %%eax");
+  asmError("ne", i, ERROR_IN_EAX);
+}
+
+/* The assembly of the instruction at address i, or with fused set of the
+ * comparison there and the FJ after it. */
+void asmInstruction(CodeAddress i, int op, WORD p, WORD q, int fused, WORD fjTarget) {
+  switch (op) {
+  case OP_LA:
+    if (p == 0) {
+      asmGrow();
+      asmLine("leal\t%d(%%r12), %%r14d", q);
+    } else {
+      asmBase(p);
+      asmGrow();
+      asmLine("leal\t%d(%%rax), %%r14d", q);
+    }
+    break;
+  case OP_LV:
+    if (p == 0) {
+      asmGrow();
+      asmLoadWord("r12", q);
+    } else {
+      asmBase(p);
+      asmGrow();
+      asmLoadWord("rax", q);
+    }
+    break;
+  case OP_LC:
+    asmGrow();
+    asmLine("movl\t$%d, %%r14d", q);
+    break;
+  case OP_LI:
+    asmLine("cmpq\tkplStackSize(%%rip), %%r14");
+    asmError("ae", i, VM_BAD_ADDRESS);
+    asmLine("movl\t(%%rbx,%%r14,4), %%r14d");
+    break;
+  case OP_INT:
+    asmLine("leaq\t%d(%%r13), %%rax", q);
+    asmLine("cmpq\tkplStackLimit(%%rip), %%rax");
+    asmError("ge", i, VM_STACK_OVERFLOW);
+    asmSpillTop();
+    asmLine("movq\t%%rax, %%r13");
+    asmLoadTop();
+    break;
+  case OP_DCT:
+    asmSpillTop();
+    asmLine("subq\t$%d, %%r13", q);
+    asmLoadTop();
+    break;
+  case OP_J:
+    asmLine("jmp\t.L%d", q);
+    break;
+  case OP_FJ:
+    asmLine("movl\t%%r14d, %%eax");
+    asmPop();
+    asmLine("testl\t%%eax, %%eax");
+    asmLine("je\t.L%d", q);
+    break;
+  case OP_HL:
+    asmLine("jmp\t.Lhalt");
+    break;
+  case OP_ST:
+    asmLine("movl\t-4" STACK ", %%eax");
+    asmLine("cmpq\tkplStackSize(%%rip), %%rax");
+    asmError("ae", i, VM_BAD_ADDRESS);
+    asmLine("movl\t%%r14d, (%%rbx,%%rax,4)");
+    asmLine("subq\t$2, %%r13");
+    asmLoadTop();
+    break;
+  case OP_CP:
+    asmLine("movl\t-4" STACK ", %%edi");
+    asmLine("movl\t%%r14d, %%esi");
+    asmLine("movl\t$%d, %%edx", q);
+    asmCallChecked("kplCopy", i);
+    asmLine("subq\t$2, %%r13");
+    asmLoadTop();
+    break;
+  case OP_CALL:
+    asmSpillTop();
+    asmLine("movl\t%%r12d, 8" STACK);
+    asmLine("movl\t$%d, 12" STACK, i + 1);
+    if (p == 0)
+      asmLine("movl\t%%r12d, 16" STACK);
+    else {
+      asmBase(p);
+      asmLine("movl\t%%eax, 16" STACK);
+    }
+    asmLine("leaq\t1(%%r13), %%r12");
+    asmLine("call\t.L%d", q);
+    break;
+  case OP_EP:
+    asmLine("leaq\t-1(%%r12), %%r13");
+    asmLine("movl\t8" STACK ", %%r12d");
+    asmLoadTop();
+    asmLine("addq\t$8, %%rsp");
+    asmLine("ret");
+    break;
+  case OP_EF:
+    asmLine("movq\t%%r12, %%r13");
+    asmLine("movl\t4" STACK ", %%r12d");
+    asmLoadTop();
+    asmLine("addq\t$8, %%rsp");
+    asmLine("ret");
+    break;
+  case OP_RC:
+  case OP_RI:
+    asmCallChecked(op == OP_RC ? "kplReadChar" : "kplReadInt", i);
+    asmGrow();
+    asmLine("movl\tkplValue(%%rip), %%r14d");
+    break;
+  case OP_WRC:
+  case OP_WRI:
+    asmLine("movl\t%%r14d, %%edi");
+    asmLine("call\t%s", op == OP_WRC ? "kplWriteChar" : "kplWriteInt");
+    asmPop();
+    break;
+  case OP_WLN:
+    asmLine("call\tkplWriteLn");
+    break;
+  case OP_AD:
+    asmLine("addl\t-4" STACK ", %%r14d");
+    asmLine("decq\t%%r13");
+    break;
+  case OP_SB:
+    asmLine("movl\t-4" STACK ", %%eax");
+    asmLine("subl\t%%r14d, %%eax");
+    asmLine("movl\t%%eax, %%r14d");
+    asmLine("decq\t%%r13");
+    break;
+  case OP_ML:
+    asmLine("imull\t-4" STACK ", %%r14d");
+    asmLine("decq\t%%r13");
+    break;
+  case OP_DV:
+    // The most negative integer divided by -1 wraps around
+    asmLine("testl\t%%r14d, %%r14d");
+    asmError("e", i, VM_DIVISION_BY_ZERO);
+    asmLine("movl\t-4" STACK ", %%eax");
+    asmLine("cmpl\t$-1, %%r14d");
+    asmLine("jne\t1f");
+    asmLine("negl\t%%eax");
+    asmLine("jmp\t2f");
+    fprintf(asmFile, "1:\n");
+    asmLine("cltd");
+    asmLine("idivl\t%%r14d");
+    fprintf(asmFile, "2:\n");
+    asmLine("movl\t%%eax, %%r14d");
+    asmLine("decq\t%%r13");
+    break;
+  case OP_NEG:
+    asmLine("negl\t%%r14d");
+    break;
+  case OP_CV:
+    asmGrow();
+    break;
+  case OP_EQ:
+  case OP_NE:
+  case OP_GT:
+  case OP_LT:
+  case OP_GE:
+  case OP_LE:
+    asmLine("movl\t-4" STACK ", %%eax");
+    asmLine("cmpl\t%%r14d, %%eax");
+    asmCondition(op, 1, fused, fjTarget);
+    break;
+  case OP_SUM:
+    asmLine("movl\t-4" STACK ", %%edi");
+    asmLine("movl\t%%r14d, %%esi");
+    asmCallChecked("kplSum", i);
+    asmLine("movl\tkplValue(%%rip), %%r14d");
+    asmLine("decq\t%%r13");
+    break;
+  }
+}
+
+/******************* The program ******************************/
+
+/* kplRun(s, nativeStack): the machine in the registers of jit.h, on the
+ * native stack of kplrt.c. The code leaves at .Lhalt, or at .Lexit with
+ * the status in eax. */
+void asmEntry(void) {
+  fprintf(asmFile, "\t.text\n\t.globl\tkplRun\n\t.type\tkplRun, @function\nkplRun:\n");
+  asmLine("pushq\t%%rbx");
+  asmLine("pushq\t%%r12");
+  asmLine("pushq\t%%r13");
+  asmLine("pushq\t%%r14");
+  asmLine("movq\t%%rsp, savedRsp(%%rip)");
+  asmLine("movq\t%%rsi, %%rsp");
+  asmLine("movq\t%%rdi, %%rbx");
+  asmLine("xorl\t%%r12d, %%r12d");
+  asmLine("movq\t$-1, %%r13");
+  asmLine("xorl\t%%r14d, %%r14d");
+}
+
+void asmExit(void) {
+  fprintf(asmFile, ".L%d:\n.Lhalt:\n", asmCode->codeSize);
+  asmLine("xorl\t%%eax, %%eax");
+  fprintf(asmFile, ".Lexit:\n");
+  asmLine("movq\tsavedRsp(%%rip), %%rsp");
+  asmLine("popq\t%%r14");
+  asmLine("popq\t%%r13");
+  asmLine("popq\t%%r12");
+  asmLine("popq\t%%rbx");
+  asmLine("ret");
+}
+
+// Each error sets its address and status and leaves
+void asmErrorReports(void) {
+  CodeAddress i;
+
+  for (i = 0; i < asmCode->codeSize; i++) {
+    if (asmErrors[i] == NO_ERROR)
+      continue;
+    fprintf(asmFile, ".Le%d:\n", i);
+    asmLine("movl\t$%d, kplErrorAddress(%%rip)", i);
+    if (asmErrors[i] != ERROR_IN_EAX)
+      asmLine("movl\t$%d, %%eax", asmErrors[i]);
+    asmLine("jmp\t.Lexit");
+  }
+  asmLine(".size\tkplRun, .-kplRun");
+  asmLine(".local\tsavedRsp");
+  asmLine(".comm\tsavedRsp,8,8");
+  asmLine(".section\t.note.GNU-stack,\"\",@progbits");
+}
+
+/* Every address in order, into the code of its template, under the
+ * label of its address. A constant or local operand goes straight to
+ * the arithmetic or comparison after it, and a comparison to the FJ
+ * after it; a subroutine keeps rsp 16-byte aligned for kplrt.c. */
+void asmCodeBlock(void) {
+  Instruction *instruction;
+  CodeAddress i, last, next;
+  char text[MAX_INSTRUCTION_TEXT];
+  WORD fjTarget;
+  int op, folded, fused, label = 0;
+
+  for (i = 0; i < asmCode->codeSize; i++) {
+    instruction = &(asmCode->code[i]);
+    op = asmOp(i);
+    if ((op == OP_J) || (op == OP_FJ) || (op == OP_CALL))
+      asmTargets[instruction->q] = 1;
+    if (op == OP_CALL)
+      asmEntries[instruction->q] = 1;
+  }
+
+  for (i = 0; i < asmCode->codeSize; i++) {
+    instruction = &(asmCode->code[i]);
+    op = asmOp(i);
+    while ((label < asmCode->labelCount) && (asmCode->labels[label].address <= i))
+      fprintf(asmFile, "# %s\n", asmCode->labels[label++].name);
+    formatInstruction(text, instruction);
+    fprintf(asmFile, ".L%d:\t\t\t\t# %s\n", i, text);
+    if (asmEntries[i])
+      asmLine("subq\t$8, %%rsp");
+
+    folded = ((op == OP_LC) || ((op == OP_LV) && (instruction->p == 0) &&
+                                (instruction->q >= -MAX_DISPLACEMENT) && (instruction->q <= MAX_DISPLACEMENT))) &&
+      asmFollows(i + 1) && asmFoldable(asmOp(i + 1));
+    last = folded ? i + 1 : i;
+    fused = asmComparison(asmOp(last)) && asmFollows(last + 1) && (asmOp(last + 1) == OP_FJ);
+    if (fused)
+      last++;
+    fjTarget = fused ? asmCode->code[last].q : 0;
+    next = last + 1;
+    if (folded)
+      asmFolded(op, instruction->q, asmOp(i + 1), fused, fjTarget);
+    else if ((op == OP_J) && (instruction->q == next))
+      ;
+    else asmInstruction(i, op, instruction->p, instruction->q, fused, fjTarget);
+    i = next - 1;
+  }
+}
+
+// The jumps and calls must stay in the code
+int asmCheckTargets(CodeBlock *codeBlock) {
+  Instruction *instruction;
+  int i, op;
+
+  for (i = 0; i < codeBlock->codeSize; i++) {
+    instruction = &(codeBlock->code[i]);
+    op = plainOp(instruction->op);
+    if (((op == OP_J) || (op == OP_FJ)) && ((instruction->q < 0) || (instruction->q > codeBlock->codeSize)))
+      return 0;
+    if ((op == OP_CALL) && ((instruction->q < 0) || (instruction->q >= codeBlock->codeSize)))
+      return 0;
+  }
+  return 1;
+}
+
+int saveAssembly(CodeBlock *codeBlock, char *fileName) {
+  int ok;
+
+  if (!asmCheckTargets(codeBlock))
+    return IO_ERROR;
+  asmFile = fopen(fileName, "w");
+  if (asmFile == NULL)
+    return IO_ERROR;
+  asmCode = codeBlock;
+  asmErrors = (int*) calloc(codeBlock->codeSize + 1, sizeof(int));
+  asmTargets = (char*) calloc(codeBlock->codeSize + 1, sizeof(char));
+  asmEntries = (char*) calloc(codeBlock->codeSize + 1, sizeof(char));
+
+  fprintf(asmFile, "# Generated by kplc -S, for the runtime of kplrt.c\n");
+  asmEntry();
+  asmCodeBlock();
+  asmExit();
+  asmErrorReports();
+
+  free(asmErrors);
+  free(asmTargets);
+  free(asmEntries);
+  ok = !ferror(asmFile);
+  ok = (fclose(asmFile) == 0) && ok;
+  return ok ? IO_SUCCESS : IO_ERROR;
+}
@@ -0,0 +1,25 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __ASMGEN_H__
+#define __ASMGEN_H__
+
+#include "instructions.h"
+
+/* Translation of the stack machine of instructions.h to x86-64 assembly
+ * for the GNU assembler, ahead of time, for the runtime of kplrt.h. The
+ * machine is that of jit.h: s in rbx, b in r12, t in r13 and the top of
+ * the stack in r14d, with the same templates, folded operands and fused
+ * comparisons, and the static links in the frames.
+ *
+ * The whole program is translated. CALL becomes a native call and EP/EF
+ * a native return, so the code must be as kplc generates it: every
+ * subroutine entered by CALL only, at its INT. The errors are those of
+ * vm.h, at the same addresses. */
+
+int saveAssembly(CodeBlock *codeBlock, char *fileName);
+
+#endif
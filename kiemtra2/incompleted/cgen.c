@@ -0,0 +1,583 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "reader.h"
+#include "cgen.h"
+#include "vm.h"
+
+#define UNREACHED -2        // the depth of an address no path reaches
+#define MAX_DEPTH 0x1000000 // words of a frame and its operands
+#define MAX_LINKS 16         // static links followed by one LA, LV or CALL
+#define MAX_SLOT_TEXT 48
+#define MAX_BASE_TEXT (MAX_LINKS * 8 + 16)
+
+/* The depth k of an address is t - b when it runs: the top is slot k of
+ * the frame, -1 before the INT of a block. */
+
+FILE *cFile;
+CodeBlock *cCode;
+int *cDepths;
+int *cFrames;               // the size of the frame each address runs in
+char *cTargets;             // the addresses a jump or a call goes to
+char *cFunctions;           // the subroutines that return with EF
+char *cLocals;              // whether slot k + 1 of the frame is in a C variable
+char *cDeclared;            // the C variables used, by slot + 1
+int cMaxSlot;
+int cMaxDepth;
+int cFailed;
+int cReturns;               // whether an EP or EF is reached
+int cHalts;                 // whether the code jumps to halt
+int cStatus;                // whether a function of kplrt.c returns a status
+int cFrame;                 // whether f is used
+
+void cLine(char *format, ...) {
+  va_list args;
+
+  fputs("  ", cFile);
+  va_start(args, format);
+  vfprintf(cFile, format, args);
+  va_end(args);
+  fputc('\n', cFile);
+}
+
+int cOp(CodeAddress i) {
+  return plainOp(cCode->code[i].op);
+}
+
+/******************* Depths ******************************/
+
+// Address i is reached at depth k, in a frame of frame words
+void cReach(CodeAddress *work, int *workCount, CodeAddress i, int k, int frame) {
+  if ((i < 0) || (i > cCode->codeSize) || (k < -1) || (k > MAX_DEPTH)) {
+    cFailed = 1;
+    return;
+  }
+  if (k > cMaxDepth)
+    cMaxDepth = k;
+  if (i == cCode->codeSize)
+    return;
+  if (cDepths[i] == UNREACHED) {
+    cDepths[i] = k;
+    cFrames[i] = frame;
+    work[(*workCount)++] = i;
+  } else if ((cDepths[i] != k) || (cFrames[i] != frame))
+    cFailed = 1;
+}
+
+// Whether the subroutine at address entry returns with EF, up to the next body
+int cReturnsValue(CodeAddress entry) {
+  CodeAddress i, end = cCode->codeSize;
+  int label;
+
+  for (label = 0; label < cCode->labelCount; label++)
+    if (cCode->labels[label].address > entry) {
+      end = cCode->labels[label].address;
+      break;
+    }
+  for (i = entry; i < end; i++)
+    if ((cOp(i) == OP_EP) || (cOp(i) == OP_EF))
+      return cOp(i) == OP_EF;
+  return 0;
+}
+
+/* The depth of every address reached from the program's start and from
+ * the subroutines it calls, each entered at depth -1. */
+void cFindDepths(void) {
+  Instruction *instruction;
+  CodeAddress *work;
+  CodeAddress i;
+  int workCount = 0;
+  int k, frame, op;
+
+  work = (CodeAddress*) malloc((cCode->codeSize + 1) * sizeof(CodeAddress));
+  for (i = 0; i <= cCode->codeSize; i++)
+    cDepths[i] = UNREACHED;
+  if (cCode->codeSize > 0)
+    cReach(work, &workCount, 0, -1, 0);
+  while ((workCount > 0) && !cFailed) {
+    i = work[--workCount];
+    instruction = &(cCode->code[i]);
+    op = cOp(i);
+    k = cDepths[i];
+    frame = cFrames[i];
+    if (((op == OP_LA) || (op == OP_LV) || (op == OP_CALL)) &&
+        ((instruction->p < 0) || (instruction->p > MAX_LINKS))) {
+      cFailed = 1;
+      break;
+    }
+    switch (op) {
+    case OP_LA:
+    case OP_LV:
+    case OP_LC:
+    case OP_CV:
+    case OP_RC:
+    case OP_RI:
+      cReach(work, &workCount, i + 1, k + 1, frame);
+      break;
+    case OP_INT:
+      // The first INT of a body makes its frame
+      cReach(work, &workCount, i + 1, k + instruction->q, k < 0 ? instruction->q : frame);
+      break;
+    case OP_DCT:
+      cReach(work, &workCount, i + 1, k - instruction->q, frame);
+      break;
+    case OP_J:
+      cReach(work, &workCount, instruction->q, k, frame);
+      if (!cFailed)
+        cTargets[instruction->q] = 1;
+      break;
+    case OP_FJ:
+      cReach(work, &workCount, instruction->q, k - 1, frame);
+      if (!cFailed)
+        cTargets[instruction->q] = 1;
+      cReach(work, &workCount, i + 1, k - 1, frame);
+      break;
+    case OP_HL:
+      break;
+    case OP_ST:
+    case OP_CP:
+      cReach(work, &workCount, i + 1, k - 2, frame);
+      break;
+    case OP_CALL:
+      if ((instruction->q < 0) || (instruction->q >= cCode->codeSize) || (cOp(instruction->q) != OP_INT)) {
+        cFailed = 1;
+        break;
+      }
+      cTargets[instruction->q] = 1;
+      cFunctions[instruction->q] = cReturnsValue(instruction->q);
+      cReach(work, &workCount, instruction->q, -1, 0);
+      cReach(work, &workCount, i + 1, k + cFunctions[instruction->q], frame);
+      break;
+    case OP_EP:
+    case OP_EF:
+      cReturns = 1;
+      break;
+    case OP_NEG:
+    case OP_LI:
+    case OP_WLN:
+      cReach(work, &workCount, i + 1, k, frame);
+      break;
+    default:
+      cReach(work, &workCount, i + 1, k - 1, frame);
+    }
+  }
+  free(work);
+}
+
+/******************* Slots ******************************/
+
+// Slot j as C: its variable, or the word of the frame
+char* cSlot(int j) {
+  static char texts[4][MAX_SLOT_TEXT];
+  static int next = 0;
+  char *text = texts[next];
+
+  next = (next + 1) % 4;
+  if ((j >= 0) && cLocals[j + 1]) {
+    sprintf(text, "x%d", j);
+    cDeclared[j + 1] = 1;
+    if (j > cMaxSlot)
+      cMaxSlot = j;
+  } else {
+    sprintf(text, "f[%d]", j);
+    cFrame = 1;
+  }
+  return text;
+}
+
+// Slot j as the variable an operation leaves its result in
+char* cResult(int j) {
+  if (j < 0) {
+    cFailed = 1;
+    return "x";
+  }
+  cLocals[j + 1] = 1;
+  return cSlot(j);
+}
+
+// The operands above the frame, which jumps keep in their variables
+void cCheckLocals(int frame, int k) {
+  int j;
+
+  for (j = frame; j <= k; j++)
+    if (!cLocals[j + 1])
+      cFailed = 1;
+}
+
+void cResetLocals(int frame, int k) {
+  int j;
+
+  for (j = -1; j <= k; j++)
+    cLocals[j + 1] = (j >= frame);
+}
+
+// The frame p static links out, as C
+char* cBase(char *text, int p) {
+  char inner[MAX_BASE_TEXT];
+
+  if (p == 0) {
+    sprintf(text, "b");
+    return text;
+  }
+  sprintf(text, "f[3]");
+  cFrame = 1;
+  for (; p > 1; p--) {
+    sprintf(inner, "s[%s + 3]", text);
+    sprintf(text, "%s", inner);
+  }
+  return text;
+}
+
+/******************* Instructions ******************************/
+
+// The label of address i, where the halt after the code is shared
+char* cLabel(char *text, CodeAddress i) {
+  if (i == cCode->codeSize) {
+    cHalts = 1;
+    sprintf(text, "halt");
+  } else sprintf(text, "L%d", i);
+  return text;
+}
+
+void cArithmetic(int k, char *op) {
+  char *x = cSlot(k - 1), *y = cSlot(k);
+
+  cLine("%s = (WORD) ((unsigned) %s %s (unsigned) %s);", cResult(k - 1), x, op, y);
+}
+
+void cComparison(int k, char *op) {
+  char *x = cSlot(k - 1), *y = cSlot(k);
+
+  cLine("%s = (%s %s %s);", cResult(k - 1), x, op, y);
+}
+
+// A function of kplrt.c that returns a status
+void cCallChecked(CodeAddress i, char *call) {
+  cStatus = 1;
+  cLine("if ((status = %s) != VM_SUCCESS)", call);
+  cLine("  FAIL(%d, status);", i);
+}
+
+/* Instruction i at depth k in a frame of frame words. Returns whether
+ * the next address runs after it. */
+int cInstruction(CodeAddress i, int k, int frame) {
+  Instruction *instruction = &(cCode->code[i]);
+  char base[MAX_BASE_TEXT];
+  char call[MAX_SLOT_TEXT * 4];
+  char *x, *y;
+  WORD p = instruction->p, q = instruction->q;
+  int j;
+
+  switch (cOp(i)) {
+  case OP_LA:
+    cLine("%s = %s + %d;", cResult(k + 1), cBase(base, p), q);
+    break;
+  case OP_LV:
+    cFrame = cFrame || (p == 0);
+    if (p == 0)
+      cLine("%s = f[%d];", cResult(k + 1), q);
+    else cLine("%s = s[%s + %d];", cResult(k + 1), cBase(base, p), q);
+    break;
+  case OP_LC:
+    cLine("%s = %d;", cResult(k + 1), q);
+    break;
+  case OP_LI:
+    x = cSlot(k);
+    cLine("CHECK_ADDRESS(%d, %s);", i, x);
+    cLine("%s = s[%s];", cResult(k), x);
+    break;
+  case OP_INT:
+    cLine("if (b + %d >= kplStackLimit)", k + q);
+    cLine("  FAIL(%d, VM_STACK_OVERFLOW);", i);
+    for (j = k + 1; j <= k + q; j++)
+      cLocals[j + 1] = 0;
+    break;
+  case OP_DCT:
+    for (j = k - q + 1; j <= k; j++)
+      if ((j >= 0) && cLocals[j + 1]) {
+        cFrame = 1;
+        cLine("f[%d] = %s;", j, cSlot(j));
+        cLocals[j + 1] = 0;
+      }
+    break;
+  case OP_J:
+    cCheckLocals(frame, k);
+    cLine("goto %s;", cLabel(base, q));
+    return 0;
+  case OP_FJ:
+    cCheckLocals(frame, k - 1);
+    cLine("if (%s == 0)", cSlot(k));
+    cLine("  goto %s;", cLabel(base, q));
+    break;
+  case OP_HL:
+    cHalts = 1;
+    cLine("goto halt;");
+    return 0;
+  case OP_ST:
+    x = cSlot(k - 1);
+    cLine("CHECK_ADDRESS(%d, %s);", i, x);
+    cLine("s[%s] = %s;", x, cSlot(k));
+    break;
+  case OP_CP:
+    sprintf(call, "kplCopy(%s, %s, %d)", cSlot(k - 1), cSlot(k), q);
+    cCallChecked(i, call);
+    break;
+  case OP_CALL:
+    // The operands live across the call are kept in the frame
+    cFrame = 1;
+    for (j = frame; j <= k; j++)
+      if (cLocals[j + 1])
+        cLine("f[%d] = %s;", j, cSlot(j));
+    cLine("f[%d] = b;", k + 2);
+    cLine("f[%d] = %d;", k + 3, i + 1);
+    cLine("f[%d] = %s;", k + 4, cBase(base, p));
+    cLine("b += %d;", k + 1);
+    cLine("f = s + b;");
+    cLine("goto L%d;", q);
+    if (!cReturns)
+      break;
+    fprintf(cFile, " r%d:\n", i + 1);
+    for (j = frame; j <= k; j++)
+      if (cLocals[j + 1])
+        cLine("%s = f[%d];", cSlot(j), j);
+    if (cFunctions[q])
+      cLocals[k + 2] = 0;
+    break;
+  case OP_EP:
+  case OP_EF:
+    cFrame = 1;
+    cLine("ra = f[2];");
+    cLine("from = %d;", i);
+    cLine("b = f[1];");
+    cLine("f = s + b;");
+    cLine("goto ret;");
+    return 0;
+  case OP_RC:
+  case OP_RI:
+    cCallChecked(i, cOp(i) == OP_RC ? "kplReadChar()" : "kplReadInt()");
+    cLine("%s = kplValue;", cResult(k + 1));
+    break;
+  case OP_WRC:
+    cLine("kplWriteChar(%s);", cSlot(k));
+    break;
+  case OP_WRI:
+    cLine("kplWriteInt(%s);", cSlot(k));
+    break;
+  case OP_WLN:
+    cLine("kplWriteLn();");
+    break;
+  case OP_AD:
+    cArithmetic(k, "+");
+    break;
+  case OP_SB:
+    cArithmetic(k, "-");
+    break;
+  case OP_ML:
+    cArithmetic(k, "*");
+    break;
+  case OP_DV:
+    // The most negative integer divided by -1 wraps around
+    x = cSlot(k - 1);
+    y = cSlot(k);
+    cLine("if (%s == 0)", y);
+    cLine("  FAIL(%d, VM_DIVISION_BY_ZERO);", i);
+    cLine("%s = (%s == -1) ? (WORD) (0u - (unsigned) %s) : %s / %s;", cResult(k - 1), y, x, x, y);
+    break;
+  case OP_NEG:
+    x = cSlot(k);
+    cLine("%s = (WORD) (0u - (unsigned) %s);", cResult(k), x);
+    break;
+  case OP_CV:
+    x = cSlot(k);
+    cLine("%s = %s;", cResult(k + 1), x);
+    break;
+  case OP_EQ:
+    cComparison(k, "==");
+    break;
+  case OP_NE:
+    cComparison(k, "!=");
+    break;
+  case OP_GT:
+    cComparison(k, ">");
+    break;
+  case OP_LT:
+    cComparison(k, "<");
+    break;
+  case OP_GE:
+    cComparison(k, ">=");
+    break;
+  case OP_LE:
+    cComparison(k, "<=");
+    break;
+  case OP_SUM:
+    sprintf(call, "kplSum(%s, %s)", cSlot(k - 1), cSlot(k));
+    cCallChecked(i, call);
+    cLine("%s = kplValue;", cResult(k - 1));
+    break;
+  }
+  return 1;
+}
+
+/******************* The program ******************************/
+
+/* Every address reached, in order, under a label if a jump or a call
+ * goes there. Those that follow one that does not go on start with the
+ * operands in their variables. */
+void cBody(void) {
+  Instruction plain;
+  CodeAddress i;
+  char text[MAX_INSTRUCTION_TEXT];
+  int label = 0, follows = 0;
+
+  for (i = 0; (i < cCode->codeSize) && !cFailed; i++) {
+    while ((label < cCode->labelCount) && (cCode->labels[label].address <= i))
+      fprintf(cFile, "\n  /* %s */\n", cCode->labels[label++].name);
+    if (cDepths[i] == UNREACHED) {
+      follows = 0;
+      continue;
+    }
+    if (cTargets[i]) {
+      if (follows)
+        cCheckLocals(cFrames[i], cDepths[i]);
+      fprintf(cFile, " L%d:\n", i);
+    }
+    if (cTargets[i] || !follows)
+      cResetLocals(cFrames[i], cDepths[i]);
+    plain = cCode->code[i];
+    plain.op = cOp(i);
+    formatInstruction(text, &plain);
+    cLine("/* %d: %s */", i, text);
+    follows = cInstruction(i, cDepths[i], cFrames[i]);
+  }
+  if (follows) {
+    cHalts = 1;
+    cLine("goto halt;");
+  }
+}
+
+// EP and EF go on after the CALL that put the return address in the frame
+void cReturnSwitch(void) {
+  CodeAddress i;
+  int halts = 1;
+
+  fprintf(cFile, " ret:\n");
+  cLine("switch (ra) {");
+  for (i = 0; i < cCode->codeSize; i++)
+    if ((cDepths[i] != UNREACHED) && (cOp(i) == OP_CALL)) {
+      cLine("case %d: goto r%d;", i + 1, i + 1);
+      if (i + 1 == cCode->codeSize)
+        halts = 0;
+    }
+  if (halts)
+    cLine("case %d: goto halt;", cCode->codeSize);
+  cLine("}");
+  cLine("FAIL(from, VM_BAD_JUMP);");
+  cHalts = cHalts || halts;
+}
+
+void cDeclarations(void) {
+  int j, count = 0;
+
+  if (cFrame)
+    fprintf(cFile, "  WORD *f = s;\n");
+  fprintf(cFile, "  WORD b = 0;\n");
+  for (j = 0; j <= cMaxSlot; j++)
+    if (cDeclared[j + 1]) {
+      if (count % 8 == 0)
+        fprintf(cFile, "%s  WORD x%d", count > 0 ? ";\n" : "", j);
+      else fprintf(cFile, ", x%d", j);
+      count++;
+    }
+  if (count > 0)
+    fprintf(cFile, ";\n");
+  if (cReturns)
+    fprintf(cFile, "  int ra, from;\n");
+  if (cStatus)
+    fprintf(cFile, "  int status;\n");
+  fprintf(cFile, "\n");
+}
+
+void cPrologue(void) {
+  fprintf(cFile, "/* Generated by kplc --emit-c, for the runtime of kplrt.c */\n\n");
+  fprintf(cFile, "typedef int WORD;\n\n");
+  fprintf(cFile, "extern long kplStackSize;\nextern long kplStackLimit;\n");
+  fprintf(cFile, "extern WORD kplValue;\nextern int kplErrorAddress;\n\n");
+  fprintf(cFile, "int kplCopy(WORD a, WORD from, WORD count);\nint kplSum(WORD a, WORD count);\n");
+  fprintf(cFile, "int kplReadChar(void);\nint kplReadInt(void);\n");
+  fprintf(cFile, "void kplWriteChar(WORD x);\nvoid kplWriteInt(WORD x);\nvoid kplWriteLn(void);\n\n");
+  fprintf(cFile, "#define VM_SUCCESS %d\n#define VM_STACK_OVERFLOW %d\n#define VM_BAD_ADDRESS %d\n",
+          VM_SUCCESS, VM_STACK_OVERFLOW, VM_BAD_ADDRESS);
+  fprintf(cFile, "#define VM_DIVISION_BY_ZERO %d\n#define VM_BAD_JUMP %d\n\n", VM_DIVISION_BY_ZERO, VM_BAD_JUMP);
+  fprintf(cFile, "#define FAIL(address, code) do { kplErrorAddress = (address); return (code); } while (0)\n");
+  fprintf(cFile, "#define CHECK_ADDRESS(address, a) if ((unsigned) (a) >= (unsigned) kplStackSize) "
+          "FAIL(address, VM_BAD_ADDRESS)\n\n");
+  fprintf(cFile, "int kplRun(WORD *s, void *nativeStack) {\n");
+}
+
+int saveC(CodeBlock *codeBlock, char *fileName) {
+  FILE *body;
+  int n = codeBlock->codeSize + 1;
+  int ch, ok;
+
+  cCode = codeBlock;
+  cDepths = (int*) malloc(n * sizeof(int));
+  cFrames = (int*) calloc(n, sizeof(int));
+  cTargets = (char*) calloc(n, sizeof(char));
+  cFunctions = (char*) calloc(n, sizeof(char));
+  cMaxSlot = -1;
+  cFailed = 0;
+  cReturns = 0;
+  cHalts = 0;
+  cStatus = 0;
+  cFrame = 0;
+  cMaxDepth = -1;
+
+  // The body first, for the variables it uses
+  cFindDepths();
+  cLocals = (char*) calloc(cMaxDepth + 8, sizeof(char));
+  cDeclared = (char*) calloc(cMaxDepth + 8, sizeof(char));
+  body = tmpfile();
+  ok = (body != NULL) && !cFailed;
+  if (ok) {
+    cFile = body;
+    cBody();
+    if (cReturns)
+      cReturnSwitch();
+    if (cHalts)
+      fprintf(cFile, " halt:\n");
+    cLine("return VM_SUCCESS;");
+    fprintf(cFile, "}\n");
+    ok = !cFailed && !ferror(body);
+  }
+
+  if (ok) {
+    cFile = fopen(fileName, "w");
+    ok = (cFile != NULL);
+  }
+  if (ok) {
+    cPrologue();
+    cDeclarations();
+    rewind(body);
+    while ((ch = getc(body)) != EOF)
+      putc(ch, cFile);
+    ok = !ferror(cFile);
+    ok = (fclose(cFile) == 0) && ok;
+  }
+
+  if (body != NULL)
+    fclose(body);
+  free(cDepths);
+  free(cFrames);
+  free(cTargets);
+  free(cFunctions);
+  free(cLocals);
+  free(cDeclared);
+  return ok ? IO_SUCCESS : IO_ERROR;
+}
@@ -0,0 +1,33 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __CGEN_H__
+#define __CGEN_H__
+
+#include "instructions.h"
+
+/* Translation of the stack machine of instructions.h to C99, for the
+ * runtime of kplrt.h and an optimizing C compiler:
+ *
+ *     kplc prog.kpl --emit-c prog.c
+ *     gcc -O2 prog.c kplrt.o -pthread -o prog
+ *
+ * The program becomes one function over the memory of the machine, so
+ * frames, addresses and errors are those of vm.h. f points to the frame
+ * of the running block, and the variables of enclosing blocks are
+ * reached through the static links of the frames. The operand stack
+ * above the frame is in C variables, one per depth, which are stored in
+ * the frame only when a call needs them there. CALL stores the reserved
+ * words and jumps to the subroutine; EP and EF go back through a switch
+ * on the return address in the frame, so deep recursion overflows the
+ * machine's stack, as in the interpreter, not C's.
+ *
+ * The depth of the stack must be the same at every address however it
+ * is reached, as in the code kplc generates. */
+
+int saveC(CodeBlock *codeBlock, char *fileName);
+
+#endif
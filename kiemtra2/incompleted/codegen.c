@@ -0,0 +1,466 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "asmgen.h"
+#include "cgen.h"
+#include "passes.h"
+
+extern SymTab* symtab;
+
+CodeBlock *codeBlock = NULL;
+
+// By code label, the frames the optimizer needs to know
+IrFrame *codeFrames = NULL;
+int codeFrameCount = 0;
+int codeFrameMax = 0;
+
+/* A subroutine's body follows the subroutines it declares, so a call to
+ * it from one of them is emitted before its code address is known. Such
+ * calls wait here, in address order, until genBlockEntry patches them. */
+struct PendingCall_ {
+  Object *callee;
+  CodeAddress site;
+};
+
+typedef struct PendingCall_ PendingCall;
+
+PendingCall *pendingCalls = NULL;
+int pendingCallCount = 0;
+int pendingCallMax = 0;
+
+/******************* Code buffer ******************************/
+
+void freePendingCalls(void) {
+  free(pendingCalls);
+  pendingCalls = NULL;
+  pendingCallCount = 0;
+  pendingCallMax = 0;
+}
+
+void addPendingCall(Object *callee, CodeAddress site) {
+  if (pendingCallCount == pendingCallMax) {
+    pendingCallMax = (pendingCallMax == 0) ? 8 : pendingCallMax * 2;
+    pendingCalls = (PendingCall*) realloc(pendingCalls, pendingCallMax * sizeof(PendingCall));
+  }
+  pendingCalls[pendingCallCount].callee = callee;
+  pendingCalls[pendingCallCount].site = site;
+  pendingCallCount++;
+}
+
+// The subroutine a pending CALL of the current block jumps to, from its level difference
+Object* pendingCallee(int level) {
+  Scope *scope = symtab->currentScope;
+
+  for (; level > 1; level--)
+    scope = scope->outer;
+  return scope->owner;
+}
+
+void freeCodeFrames(void) {
+  int i;
+
+  for (i = 0; i < codeFrameCount; i++)
+    free(codeFrames[i].slots);
+  free(codeFrames);
+  codeFrames = NULL;
+  codeFrameCount = 0;
+  codeFrameMax = 0;
+}
+
+void initCodeBuffer(void) {
+  if (codeBlock != NULL)
+    freeCodeBlock(codeBlock);
+  freeCodeFrames();
+  freePendingCalls();
+  codeBlock = createCodeBlock();
+}
+
+void cleanCodeBuffer(void) {
+  if (codeBlock != NULL)
+    freeCodeBlock(codeBlock);
+  freeCodeFrames();
+  freePendingCalls();
+  codeBlock = NULL;
+}
+
+CodeAddress getCurrentCodeAddress(void) {
+  return codeBlock->codeSize;
+}
+
+Instruction* getInstruction(CodeAddress address) {
+  return &(codeBlock->code[address]);
+}
+
+// Drop the code emitted from address on, and the pending calls in it
+void rewindCode(CodeAddress address) {
+  truncateCode(codeBlock, address);
+  while ((pendingCallCount > 0) && (pendingCalls[pendingCallCount - 1].site >= address))
+    pendingCallCount--;
+}
+
+// Code of the current block taken apart by rewindCode; its pending calls wait again
+void appendCode(Instruction *code, int count) {
+  CodeAddress address;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    address = emitCode(codeBlock, code[i].op, code[i].p, code[i].q);
+    if ((code[i].op == OP_CALL) && (code[i].q < 0))
+      addPendingCall(pendingCallee(code[i].p), address);
+  }
+}
+
+// The code file runs the sequences of superops.h as superinstructions
+int serialize(char *fileName) {
+  fuseCode(codeBlock);
+  return saveCode(codeBlock, fileName);
+}
+
+// So do the C of cgen.h and the assembly of asmgen.h
+int serializeAssembly(char *fileName) {
+  return saveAssembly(codeBlock, fileName);
+}
+
+int serializeC(char *fileName) {
+  return saveC(codeBlock, fileName);
+}
+
+// Through the SSA form of ssa.h and its passes, before any of the above
+void optimizeCode(void) {
+  runPasses(codeBlock, codeFrames, codeFrameCount);
+}
+
+/******************* Objects ******************************/
+
+int isPredefined(Object *obj) {
+  return findObject(symtab->globalObjectList, obj->name) == obj;
+}
+
+int isPredefinedFunction(Object *func) {
+  return (func->kind == OBJ_FUNCTION) && isPredefined(func);
+}
+
+int isPredefinedProcedure(Object *proc) {
+  return (proc->kind == OBJ_PROCEDURE) && isPredefined(proc);
+}
+
+// How many static links lead from the current frame to a frame of the given level
+int levelDifference(int level) {
+  return symtab->currentScope->level - level;
+}
+
+int countParams(ObjectNode *paramList) {
+  int count = 0;
+
+  for (; paramList != NULL; paramList = paramList->next)
+    count++;
+  return count;
+}
+
+void genVariableAddress(Object *var) {
+  genLA(levelDifference(var->varAttrs.level), var->varAttrs.localOffset);
+}
+
+void genVariableValue(Object *var) {
+  genLV(levelDifference(var->varAttrs.level), var->varAttrs.localOffset);
+}
+
+// A VAR parameter holds the address of its argument
+void genParameterAddress(Object *param) {
+  if (param->paramAttrs.kind == PARAM_REFERENCE)
+    genLV(levelDifference(param->paramAttrs.level), param->paramAttrs.localOffset);
+  else genLA(levelDifference(param->paramAttrs.level), param->paramAttrs.localOffset);
+}
+
+void genParameterValue(Object *param) {
+  genLV(levelDifference(param->paramAttrs.level), param->paramAttrs.localOffset);
+  if (param->paramAttrs.kind == PARAM_REFERENCE)
+    genLI();
+}
+
+// Only the function itself assigns its return value, to word 0 of its frame
+void genReturnValueAddress(Object *func) {
+  genLA(levelDifference(func->funcAttrs.scope->level), 0);
+}
+
+void genConstant(ConstantValue *value) {
+  if (value->type == TP_CHAR)
+    genLC((unsigned char) value->charValue);
+  else genLC(value->intValue);
+}
+
+// Arrays are assigned by copying their words
+void genStore(Type *type) {
+  if (type->typeClass == TP_ARRAY)
+    genCP(sizeOfType(type));
+  else genST();
+}
+
+enum IrType slotType(Type *type) {
+  switch (type->typeClass) {
+  case TP_INT:
+    return IRT_INT;
+  case TP_CHAR:
+    return IRT_CHAR;
+  default:
+    return IRT_NONE;
+  }
+}
+
+// Which words of the current frame hold a scalar variable or parameter
+void recordFrame(Object *owner) {
+  Scope *scope = symtab->currentScope;
+  IrFrame *frame;
+  ObjectNode *node;
+  Object *obj;
+  int offset;
+
+  if (codeFrameCount == codeFrameMax) {
+    codeFrameMax = (codeFrameMax == 0) ? 8 : codeFrameMax * 2;
+    codeFrames = (IrFrame*) realloc(codeFrames, codeFrameMax * sizeof(IrFrame));
+  }
+  frame = &codeFrames[codeFrameCount++];
+  frame->size = scope->frameSize;
+  frame->level = scope->level;
+  frame->result = (owner->kind == OBJ_FUNCTION) ? slotType(owner->funcAttrs.returnType) : IRT_NONE;
+  frame->slots = (enum IrType*) calloc((scope->frameSize > 0) ? scope->frameSize : 1, sizeof(enum IrType));
+  for (node = scope->objList; node != NULL; node = node->next) {
+    obj = node->object;
+    if (obj->kind == OBJ_VARIABLE) {
+      offset = obj->varAttrs.localOffset;
+      if ((offset >= 0) && (offset < scope->frameSize))
+        frame->slots[offset] = slotType(obj->varAttrs.type);
+    } else if (obj->kind == OBJ_PARAMETER) {
+      offset = obj->paramAttrs.localOffset;
+      if ((offset >= 0) && (offset < scope->frameSize))
+        frame->slots[offset] = (obj->paramAttrs.kind == PARAM_REFERENCE) ? IRT_ADDR : slotType(obj->paramAttrs.type);
+    }
+  }
+}
+
+// The calls to owner from the subroutines it declares
+void patchPendingCalls(Object *owner, CodeAddress address) {
+  int i, count = 0;
+
+  for (i = 0; i < pendingCallCount; i++)
+    if (pendingCalls[i].callee == owner)
+      updateJump(pendingCalls[i].site, address);
+    else pendingCalls[count++] = pendingCalls[i];
+  pendingCallCount = count;
+}
+
+// The body of the current block starts here
+void genBlockEntry(Object *owner) {
+  CodeAddress address = getCurrentCodeAddress();
+
+  switch (owner->kind) {
+  case OBJ_FUNCTION:
+    owner->funcAttrs.codeAddress = address;
+    break;
+  case OBJ_PROCEDURE:
+    owner->procAttrs.codeAddress = address;
+    break;
+  default:
+    owner->progAttrs.codeAddress = address;
+    break;
+  }
+  addCodeLabel(codeBlock, owner->name, address);
+  patchPendingCalls(owner, address);
+  genINT(symtab->currentScope->frameSize);
+}
+
+// The body of the current block ends here: its frame has all its temporaries
+void genBlockExit(Object *owner) {
+  CodeAddress address;
+
+  switch (owner->kind) {
+  case OBJ_FUNCTION:
+    address = owner->funcAttrs.codeAddress;
+    break;
+  case OBJ_PROCEDURE:
+    address = owner->procAttrs.codeAddress;
+    break;
+  default:
+    address = owner->progAttrs.codeAddress;
+    break;
+  }
+  getInstruction(address)->q = symtab->currentScope->frameSize;
+  recordFrame(owner);
+}
+
+// The offset of words of the current frame for a value of type, as long as the block runs
+int genTemporary(Type *type) {
+  return allocateTemporary(symtab->currentScope, sizeOfType(type));
+}
+
+void genPredefinedProcedureCall(Object *proc) {
+  if (strcmp(proc->name, "WRITEI") == 0)
+    genWRI();
+  else if (strcmp(proc->name, "WRITEC") == 0)
+    genWRC();
+  else genWLN();
+}
+
+void genPredefinedFunctionCall(Object *func) {
+  if (strcmp(func->name, "READI") == 0)
+    genRI();
+  else genRC();
+}
+
+// A call to an enclosing subroutine waits for its body
+void genSubroutineCall(Object *callee, Scope *scope, CodeAddress label) {
+  genCALL(levelDifference(scope->level - 1), label);
+  if (label < 0)
+    addPendingCall(callee, getCurrentCodeAddress() - 1);
+}
+
+void genProcedureCall(Object *proc) {
+  genDCT(RESERVED_WORDS + countParams(proc->procAttrs.paramList));
+  genSubroutineCall(proc, proc->procAttrs.scope, proc->procAttrs.codeAddress);
+}
+
+void genFunctionCall(Object *func) {
+  genDCT(RESERVED_WORDS + countParams(func->funcAttrs.paramList));
+  genSubroutineCall(func, func->funcAttrs.scope, func->funcAttrs.codeAddress);
+}
+
+/******************* Instructions ******************************/
+
+void genLA(int level, int offset) {
+  emitCode(codeBlock, OP_LA, level, offset);
+}
+
+void genLV(int level, int offset) {
+  emitCode(codeBlock, OP_LV, level, offset);
+}
+
+void genLC(WORD constant) {
+  emitCode(codeBlock, OP_LC, 0, constant);
+}
+
+void genLI(void) {
+  emitCode(codeBlock, OP_LI, 0, 0);
+}
+
+void genINT(int delta) {
+  emitCode(codeBlock, OP_INT, 0, delta);
+}
+
+void genDCT(int delta) {
+  emitCode(codeBlock, OP_DCT, 0, delta);
+}
+
+CodeAddress genJ(CodeAddress label) {
+  return emitCode(codeBlock, OP_J, 0, label);
+}
+
+CodeAddress genFJ(CodeAddress label) {
+  return emitCode(codeBlock, OP_FJ, 0, label);
+}
+
+void genHL(void) {
+  emitCode(codeBlock, OP_HL, 0, 0);
+}
+
+void genST(void) {
+  emitCode(codeBlock, OP_ST, 0, 0);
+}
+
+void genCP(int size) {
+  emitCode(codeBlock, OP_CP, 0, size);
+}
+
+void genCALL(int level, CodeAddress label) {
+  emitCode(codeBlock, OP_CALL, level, label);
+}
+
+void genEP(void) {
+  emitCode(codeBlock, OP_EP, 0, 0);
+}
+
+void genEF(void) {
+  emitCode(codeBlock, OP_EF, 0, 0);
+}
+
+void genRC(void) {
+  emitCode(codeBlock, OP_RC, 0, 0);
+}
+
+void genRI(void) {
+  emitCode(codeBlock, OP_RI, 0, 0);
+}
+
+void genWRC(void) {
+  emitCode(codeBlock, OP_WRC, 0, 0);
+}
+
+void genWRI(void) {
+  emitCode(codeBlock, OP_WRI, 0, 0);
+}
+
+void genWLN(void) {
+  emitCode(codeBlock, OP_WLN, 0, 0);
+}
+
+void genAD(void) {
+  emitCode(codeBlock, OP_AD, 0, 0);
+}
+
+void genSB(void) {
+  emitCode(codeBlock, OP_SB, 0, 0);
+}
+
+void genML(void) {
+  emitCode(codeBlock, OP_ML, 0, 0);
+}
+
+void genDV(void) {
+  emitCode(codeBlock, OP_DV, 0, 0);
+}
+
+void genNEG(void) {
+  emitCode(codeBlock, OP_NEG, 0, 0);
+}
+
+void genCV(void) {
+  emitCode(codeBlock, OP_CV, 0, 0);
+}
+
+void genEQ(void) {
+  emitCode(codeBlock, OP_EQ, 0, 0);
+}
+
+void genNE(void) {
+  emitCode(codeBlock, OP_NE, 0, 0);
+}
+
+void genGT(void) {
+  emitCode(codeBlock, OP_GT, 0, 0);
+}
+
+void genLT(void) {
+  emitCode(codeBlock, OP_LT, 0, 0);
+}
+
+void genGE(void) {
+  emitCode(codeBlock, OP_GE, 0, 0);
+}
+
+void genLE(void) {
+  emitCode(codeBlock, OP_LE, 0, 0);
+}
+
+void genSUM(void) {
+  emitCode(codeBlock, OP_SUM, 0, 0);
+}
+
+void updateJump(CodeAddress jump, CodeAddress label) {
+  codeBlock->code[jump].q = label;
+}
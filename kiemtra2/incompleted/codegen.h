@@ -0,0 +1,103 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __CODEGEN_H__
+#define __CODEGEN_H__
+
+#include "symtab.h"
+#include "instructions.h"
+
+/* Code generation for the stack machine of instructions.h, driven by the
+ * parser as it checks the program.
+ *
+ * A block's code follows the code of the subroutines it declares. Its
+ * body starts with INT frameSize, and calls jump straight there, so the
+ * only jump over subroutines is the program's, at address 0. Temporaries
+ * of the body come after the variables; genBlockExit sets the INT to
+ * the frame size they end with. Calls to a
+ * subroutine from the ones it declares are patched once its body starts.
+ * A call reserves the four reserved words, pushes the arguments (a value,
+ * or an address for a VAR parameter), drops them all again and executes
+ * CALL, which makes them the start of the callee's frame.
+ *
+ * Array indexes start at 1. The constant part of an element's offset is
+ * added to the LA that loads the array.
+ *
+ * Once the program is checked, optimizeCode takes the code through the
+ * SSA form of ssa.h and back, with the frames genBlockExit records for
+ * it; kplc -O0 leaves it as generated.
+ *
+ * Incremental reparsing does not maintain the code. */
+
+#define DC_VALUE 0          // a jump target still to be patched
+
+extern CodeBlock *codeBlock;
+
+void initCodeBuffer(void);
+void cleanCodeBuffer(void);
+CodeAddress getCurrentCodeAddress(void);
+Instruction* getInstruction(CodeAddress address);
+void rewindCode(CodeAddress address);
+void appendCode(Instruction *code, int count);
+int serialize(char *fileName);
+int serializeAssembly(char *fileName);
+int serializeC(char *fileName);
+void optimizeCode(void);
+
+int isPredefinedFunction(Object *func);
+int isPredefinedProcedure(Object *proc);
+
+void genVariableAddress(Object *var);
+void genVariableValue(Object *var);
+void genParameterAddress(Object *param);
+void genParameterValue(Object *param);
+void genReturnValueAddress(Object *func);
+void genConstant(ConstantValue *value);
+void genStore(Type *type);
+void genBlockEntry(Object *owner);
+void genBlockExit(Object *owner);
+int genTemporary(Type *type);
+void genPredefinedProcedureCall(Object *proc);
+void genPredefinedFunctionCall(Object *func);
+void genProcedureCall(Object *proc);
+void genFunctionCall(Object *func);
+
+void genLA(int level, int offset);
+void genLV(int level, int offset);
+void genLC(WORD constant);
+void genLI(void);
+void genINT(int delta);
+void genDCT(int delta);
+CodeAddress genJ(CodeAddress label);
+CodeAddress genFJ(CodeAddress label);
+void genHL(void);
+void genST(void);
+void genCP(int size);
+void genCALL(int level, CodeAddress label);
+void genEP(void);
+void genEF(void);
+void genRC(void);
+void genRI(void);
+void genWRC(void);
+void genWRI(void);
+void genWLN(void);
+void genAD(void);
+void genSB(void);
+void genML(void);
+void genDV(void);
+void genNEG(void);
+void genCV(void);
+void genEQ(void);
+void genNE(void);
+void genGT(void);
+void genLT(void);
+void genGE(void);
+void genLE(void);
+void genSUM(void);
+
+void updateJump(CodeAddress jump, CodeAddress label);
+
+#endif
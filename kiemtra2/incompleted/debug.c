@@ -46,42 +46,47 @@ void printObject(Object* obj, int indent) {
   case OBJ_CONSTANT:
     pad(indent);
     printf("Const %s = ", obj->name);
-    printConstantValue(obj->constAttrs->value);
+    printConstantValue(&(obj->constAttrs.value));
     break;
   case OBJ_TYPE:
     pad(indent);
     printf("Type %s = ", obj->name);
-    printType(obj->typeAttrs->actualType);
+    printType(obj->typeAttrs.actualType);
     break;
   case OBJ_VARIABLE:
     pad(indent);
     printf("Var %s : ", obj->name);
-    printType(obj->varAttrs->type);
+    printType(obj->varAttrs.type);
     break;
   case OBJ_PARAMETER:
     pad(indent);
-    if (obj->paramAttrs->kind == PARAM_VALUE) 
+    if (obj->paramAttrs.kind == PARAM_VALUE) 
       printf("Param %s : ", obj->name);
     else
       printf("Param VAR %s : ", obj->name);
-    printType(obj->paramAttrs->type);
+    printType(obj->paramAttrs.type);
     break;
   case OBJ_FUNCTION:
     pad(indent);
     printf("Function %s : ",obj->name);
-    printType(obj->funcAttrs->returnType);
+    printType(obj->funcAttrs.returnType);
     printf("\n");
-    printScope(obj->funcAttrs->scope, indent + 4);
+    printScope(obj->funcAttrs.scope, indent + 4);
     break;
   case OBJ_PROCEDURE:
     pad(indent);
     printf("Procedure %s\n",obj->name);
-    printScope(obj->procAttrs->scope, indent + 4);
+    printScope(obj->procAttrs.scope, indent + 4);
     break;
   case OBJ_PROGRAM:
     pad(indent);
     printf("Program %s\n",obj->name);
-    printScope(obj->progAttrs->scope, indent + 4);
+    printScope(obj->progAttrs.scope, indent + 4);
+    break;
+  case OBJ_MODULE:
+    pad(indent);
+    printf("Module %s\n",obj->name);
+    printScope(obj->progAttrs.scope, indent + 4);
     break;
   }
 }
@@ -99,3 +104,85 @@ void printScope(Scope* scope, int indent) {
   printObjectList(scope->objList, indent);
 }
 
+/******************* Mapped symbol files ******************************/
+
+void printSymFileType(SymFile* symFile, int type) {
+  SymFileType* t = &(symFile->types[type]);
+
+  switch (t->typeClass) {
+  case TP_INT:
+    printf("Int");
+    break;
+  case TP_CHAR:
+    printf("Char");
+    break;
+  case TP_ARRAY:
+    printf("Arr(%d,",t->arraySize);
+    printSymFileType(symFile, t->elementType);
+    printf(")");
+    break;
+  }
+}
+
+void printSymFileObject(SymFile* symFile, int obj, int indent) {
+  SymFileObject* o = &(symFile->objects[obj]);
+
+  switch (o->kind) {
+  case OBJ_CONSTANT:
+    pad(indent);
+    printf("Const %s = ", o->name);
+    if (o->valueType == TP_INT)
+      printf("%d",o->value);
+    else
+      printf("\'%c\'",o->value);
+    break;
+  case OBJ_TYPE:
+    pad(indent);
+    printf("Type %s = ", o->name);
+    printSymFileType(symFile, o->type);
+    break;
+  case OBJ_VARIABLE:
+    pad(indent);
+    printf("Var %s : ", o->name);
+    printSymFileType(symFile, o->type);
+    break;
+  case OBJ_PARAMETER:
+    pad(indent);
+    if (o->value == PARAM_VALUE)
+      printf("Param %s : ", o->name);
+    else
+      printf("Param VAR %s : ", o->name);
+    printSymFileType(symFile, o->type);
+    break;
+  case OBJ_FUNCTION:
+    pad(indent);
+    printf("Function %s : ",o->name);
+    printSymFileType(symFile, o->type);
+    printf("\n");
+    printSymFileList(symFile, o->scope, indent + 4);
+    break;
+  case OBJ_PROCEDURE:
+    pad(indent);
+    printf("Procedure %s\n",o->name);
+    printSymFileList(symFile, o->scope, indent + 4);
+    break;
+  case OBJ_PROGRAM:
+    pad(indent);
+    printf("Program %s\n",o->name);
+    printSymFileList(symFile, o->scope, indent + 4);
+    break;
+  case OBJ_MODULE:
+    pad(indent);
+    printf("Module %s\n",o->name);
+    printSymFileList(symFile, o->scope, indent + 4);
+    break;
+  }
+}
+
+void printSymFileList(SymFile* symFile, int node, int indent) {
+  while (node != SYMFILE_NONE) {
+    printSymFileObject(symFile, symFile->nodes[node].object, indent);
+    printf("\n");
+    node = symFile->nodes[node].next;
+  }
+}
@@ -8,6 +8,7 @@
 #define __DEBUG_H_
 
 #include "symtab.h"
+#include "symfile.h"
 
 void printType(Type* type);
 void printConstantValue(ConstantValue* value);
@@ -15,4 +16,8 @@ void printObject(Object* obj, int indent);
 void printObjectList(ObjectNode* objList, int indent);
 void printScope(Scope* scope, int indent);
 
+void printSymFileType(SymFile* symFile, int type);
+void printSymFileObject(SymFile* symFile, int obj, int indent);
+void printSymFileList(SymFile* symFile, int node, int indent);
+
 #endif
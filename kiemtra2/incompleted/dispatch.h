@@ -0,0 +1,53 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __DISPATCH_H__
+#define __DISPATCH_H__
+
+/* Instruction dispatch shared by the interpreters. Each handler starts
+ * with CASE(op) and ends with NEXT() or, after changing pc, DISPATCH().
+ * BEGIN_DISPATCH() runs the instruction at pc and END_DISPATCH() closes
+ * the handlers.
+ *
+ * Built with GCC or Clang the handlers are threaded through computed
+ * gotos, pc->handler holding the address of the handler; defining
+ * SWITCH_DISPATCH, or any other compiler, gives a loop over a switch on
+ * pc->op. Defining COUNT_DISPATCH counts the instructions dispatched in
+ * vmDispatchCount. Defining PROFILE_DISPATCH counts them too, switches
+ * dispatch and passes each one to PROFILE(), which the interpreter
+ * defines. */
+
+#if defined(__GNUC__) && !defined(SWITCH_DISPATCH) && !defined(PROFILE_DISPATCH)
+#define THREADED_DISPATCH
+#endif
+
+#if defined(PROFILE_DISPATCH)
+#define COUNT() (vmDispatchCount++, PROFILE())
+#elif defined(COUNT_DISPATCH)
+#define COUNT() vmDispatchCount++
+#else
+#define COUNT()
+#endif
+
+#ifdef THREADED_DISPATCH
+#define CASE(op) do_##op:
+#define DISPATCH() do { COUNT(); goto *pc->handler; } while (0)
+#define NEXT() do { pc++; DISPATCH(); } while (0)
+#define SET_OP(instruction, opCode) (instruction)->handler = handlers[opCode]
+#define BEGIN_DISPATCH() DISPATCH();
+#define END_DISPATCH()
+#else
+#define CASE(op) case op:
+#define DISPATCH() continue
+#define NEXT() { pc++; continue; }
+#define SET_OP(instruction, opCode) (instruction)->op = (opCode)
+#define BEGIN_DISPATCH() for (;;) { COUNT(); switch (pc->op) {
+#define END_DISPATCH() } }
+#endif
+
+extern long vmDispatchCount;
+
+#endif
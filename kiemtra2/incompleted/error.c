@@ -8,7 +8,7 @@
 #include <stdlib.h>
 #include "error.h"
 
-#define NUM_OF_ERRORS 31
+#define NUM_OF_ERRORS 37
 
 struct ErrorMessage
 {
@@ -16,7 +16,7 @@ struct ErrorMessage
   char *message;
 };
 
-struct ErrorMessage errors[31] = {
+struct ErrorMessage errors[NUM_OF_ERRORS] = {
     {ERR_END_OF_COMMENT, "End of comment expected."},
     {ERR_IDENT_TOO_LONG, "Identifier too long."},
     {ERR_INVALID_CONSTANT_CHAR, "Invalid char constant."},
@@ -47,7 +47,24 @@ struct ErrorMessage errors[31] = {
     {ERR_TYPE_INCONSISTENCY, "Type inconsistency"},
     {ERR_NORETURNFUNCTION, "Need an assignment statement in function."},
     {ERR_OPERATOR_ASSIGN_WITH_CHAR_OR_STRING, "Operater assign with char or string!"},
-    {ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, "The number of arguments and the number of parameters are inconsistent."}};
+    {ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, "The number of arguments and the number of parameters are inconsistent."},
+    {ERR_DUPLICATE_TARGET, "Variable assigned twice in one assignment."},
+    {ERR_INVALID_SUM_RANGE, "Both bounds of a SUM range must index the same array."},
+    {ERR_DIVISION_BY_ZERO, "Division by zero in a constant expression."},
+    {ERR_INVALID_ARRAY_SIZE, "An array size must be a positive integer constant."},
+    {ERR_UNDECLARED_MODULE, "Undeclared module: no valid interface file."},
+    {ERR_FRAME_TOO_LARGE, "The variables of a block do not fit in its frame."}};
+
+jmp_buf *errorRecovery = NULL;
+char errorReport[MAX_ERROR_LEN];
+
+void reportError(void)
+{
+  if (errorRecovery != NULL)
+    longjmp(*errorRecovery, 1);
+  printf("%s\n", errorReport);
+  exit(0);
+}
 
 void error(ErrorCode err, int lineNo, int colNo)
 {
@@ -55,15 +72,15 @@ void error(ErrorCode err, int lineNo, int colNo)
   for (i = 0; i < NUM_OF_ERRORS; i++)
     if (errors[i].errorCode == err)
     {
-      printf("%d-%d:%s\n", lineNo, colNo, errors[i].message);
-      exit(0);
+      snprintf(errorReport, MAX_ERROR_LEN, "%d-%d:%s", lineNo, colNo, errors[i].message);
+      reportError();
     }
 }
 
 void missingToken(TokenType tokenType, int lineNo, int colNo)
 {
-  printf("%d-%d:Missing %s\n", lineNo, colNo, tokenToString(tokenType));
-  exit(0);
+  snprintf(errorReport, MAX_ERROR_LEN, "%d-%d:Missing %s", lineNo, colNo, tokenToString(tokenType));
+  reportError();
 }
 
 void assert(char *msg)
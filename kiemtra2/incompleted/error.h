@@ -6,8 +6,11 @@
 
 #ifndef __ERROR_H__
 #define __ERROR_H__
+#include <setjmp.h>
 #include "token.h"
 
+#define MAX_ERROR_LEN 128
+
 typedef enum
 {
   ERR_END_OF_COMMENT,
@@ -40,9 +43,21 @@ typedef enum
   ERR_TYPE_INCONSISTENCY,
   ERR_OPERATOR_ASSIGN_WITH_CHAR_OR_STRING,
   ERR_NORETURNFUNCTION,
-  ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY
+  ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY,
+  ERR_DUPLICATE_TARGET,
+  ERR_INVALID_SUM_RANGE,
+  ERR_DIVISION_BY_ZERO,
+  ERR_INVALID_ARRAY_SIZE,
+  ERR_UNDECLARED_MODULE,
+  ERR_FRAME_TOO_LARGE
 } ErrorCode;
 
+/* An error ends the compile: it is printed and kplc exits. With
+ * errorRecovery set, as the incremental reparser does, the diagnostic is
+ * left in errorReport instead and control returns to errorRecovery. */
+extern jmp_buf *errorRecovery;
+extern char errorReport[MAX_ERROR_LEN];
+
 void error(ErrorCode err, int lineNo, int colNo);
 void missingToken(TokenType tokenType, int lineNo, int colNo);
 void assert(char *msg);
@@ -0,0 +1,349 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "reader.h"
+#include "scanner.h"
+#include "parser.h"
+#include "incremental.h"
+#include "codegen.h"
+#include "multiassign.h"
+
+extern SymTab *symtab;
+extern Token *currentToken;
+extern Token *lookAhead;
+
+/* Ranges recorded while parsing: every subroutine on a full parse, only
+ * the ones nested in the reparsed subroutine otherwise. */
+SubroutineRange *recRanges;
+int recCount, recMax;
+int recording = 0;
+int baseDepth, openDepth;
+
+/******************* Range recording ******************************/
+
+int openSubroutineRange(Token *keyword) {
+  SubroutineRange *range;
+
+  if (!recording)
+    return -1;
+
+  if (recCount == recMax) {
+    recMax = (recMax == 0) ? 16 : recMax * 2;
+    recRanges = (SubroutineRange*) realloc(recRanges, recMax * sizeof(SubroutineRange));
+  }
+  range = &recRanges[recCount];
+  range->start.offset = keyword->offset;
+  range->start.lineNo = keyword->lineNo;
+  range->start.colNo = keyword->colNo;
+  range->depth = baseDepth + openDepth;
+  openDepth++;
+  return recCount++;
+}
+
+void markSubroutineBody(int range, Object *owner, Token *first) {
+  SubroutineRange *r;
+
+  if (range < 0)
+    return;
+
+  r = &recRanges[range];
+  r->owner = owner;
+  r->body.offset = first->offset;
+  r->body.lineNo = first->lineNo;
+  r->body.colNo = first->colNo;
+}
+
+void closeSubroutineRange(int range, Token *semicolon) {
+  if (range < 0)
+    return;
+  recRanges[range].end = semicolon->offset + 1;
+  openDepth--;
+}
+
+/******************* Source positions ******************************/
+
+// Move pos forward to offset, counting lines and columns the way readChar does
+void advancePos(char *source, SourcePos *pos, int offset) {
+  while (pos->offset < offset) {
+    pos->offset++;
+    pos->colNo++;
+    if (source[pos->offset] == '\n') {
+      pos->lineNo++;
+      pos->colNo = 0;
+    }
+  }
+}
+
+// Relocate a position that follows an edit ending at oldEnd (now at newEnd)
+void shiftPos(SourcePos *pos, SourcePos *oldEnd, SourcePos *newEnd) {
+  if (pos->offset < oldEnd->offset)
+    return;
+  if (pos->lineNo == oldEnd->lineNo)
+    pos->colNo += newEnd->colNo - oldEnd->colNo;
+  pos->lineNo += newEnd->lineNo - oldEnd->lineNo;
+  pos->offset += newEnd->offset - oldEnd->offset;
+}
+
+void replaceText(IncrementalParse *parse, int offset, int removed, char *text, int inserted) {
+  int size = parse->sourceSize - removed + inserted;
+
+  if (size + 1 > parse->sourceMax) {
+    parse->sourceMax = 2 * (size + 1);
+    parse->source = (char*) realloc(parse->source, parse->sourceMax);
+  }
+  memmove(parse->source + offset + inserted, parse->source + offset + removed,
+          parse->sourceSize - offset - removed + 1);
+  memcpy(parse->source + offset, text, inserted);
+  parse->sourceSize = size;
+}
+
+/******************* Parsing ******************************/
+
+// The ranges are handed to the recorder and back: parse->ranges is NULL meanwhile
+void fullParse(IncrementalParse *parse) {
+  recRanges = parse->ranges;
+  recMax = parse->rangeMax;
+  recCount = 0;
+  baseDepth = openDepth = 0;
+  recording = 1;
+  parse->ranges = NULL;
+  parse->rangeMax = 0;
+  parse->valid = 1;
+
+  initSymTab();
+  initCodeBuffer();
+  openInputBuffer(parse->source, parse->sourceSize, 0, 1, 1);
+  currentToken = lookAhead = NULL;
+  lookAhead = getValidToken();
+  compileProgram();
+
+  freeToken(currentToken);
+  freeToken(lookAhead);
+  closeInputStream();
+
+  recording = 0;
+  parse->ranges = recRanges;
+  parse->rangeMax = recMax;
+  parse->rangeCount = recCount;
+}
+
+// Recompile the block of subroutine r after an edit inside it; 0 if its end moved unexpectedly
+int reparseSubroutine(IncrementalParse *parse, int r, SourcePos *oldEnd, SourcePos *newEnd) {
+  SubroutineRange *range = &parse->ranges[r];
+  Object *owner = range->owner;
+  Scope *scope;
+  ObjectNode *param, *lastParam = NULL;
+  Scope **hidden;
+  int hiddenCount, depth, end, last, i, delta;
+  CodeAddress codeEnd = getCurrentCodeAddress(), codeAddress;
+
+  if (owner->kind == OBJ_FUNCTION) {
+    scope = owner->funcAttrs.scope;
+    param = owner->funcAttrs.paramList;
+    codeAddress = owner->funcAttrs.codeAddress;
+  } else {
+    scope = owner->procAttrs.scope;
+    param = owner->procAttrs.paramList;
+    codeAddress = owner->procAttrs.codeAddress;
+  }
+  for (; param != NULL; param = param->next)
+    lastParam = (lastParam == NULL) ? scope->objList : lastParam->next;
+
+  // Hide what a full compile would not have declared yet: everything after
+  // the subroutine and after each enclosing subroutine
+  hidden = (Scope**) malloc((range->depth + 1) * sizeof(Scope*));
+  hidden[0] = scope->outer;
+  hideObjectsAfter(scope->outer, owner);
+  hiddenCount = 1;
+  depth = range->depth;
+  for (i = r - 1; (i >= 0) && (depth > 0); i--)
+    if (parse->ranges[i].depth == depth - 1) {
+      hidden[hiddenCount] = hidden[hiddenCount - 1]->outer;
+      hideObjectsAfter(hidden[hiddenCount++], parse->ranges[i].owner);
+      depth--;
+    }
+
+  freeObjectsAfter(scope, lastParam);
+
+  recRanges = NULL;
+  recCount = recMax = 0;
+  baseDepth = range->depth + 1;
+  openDepth = 0;
+  recording = 1;
+
+  openInputBuffer(parse->source, parse->sourceSize,
+                  range->body.offset, range->body.lineNo, range->body.colNo);
+  currentToken = lookAhead = NULL;
+  lookAhead = getValidToken();
+  range->body.offset = lookAhead->offset;
+  range->body.lineNo = lookAhead->lineNo;
+  range->body.colNo = lookAhead->colNo;
+
+  // Only the subroutine's own objects are bound: lookupObject finds the
+  // visible objects of the enclosing scopes in their indexes
+  symtab->unboundScope = scope->outer;
+  enterBlock(scope);
+  compileBlock();
+  eat(SB_SEMICOLON);
+  exitBlock();
+  symtab->currentScope = NULL;
+  symtab->unboundScope = NULL;
+
+  // The code is not maintained: drop what the block emitted
+  rewindCode(codeEnd);
+  if (owner->kind == OBJ_FUNCTION)
+    owner->funcAttrs.codeAddress = codeAddress;
+  else owner->procAttrs.codeAddress = codeAddress;
+  end = currentToken->offset + 1;
+
+  freeToken(currentToken);
+  freeToken(lookAhead);
+  closeInputStream();
+  recording = 0;
+
+  for (i = 0; i < hiddenCount; i++)
+    showAllObjects(hidden[i]);
+  free(hidden);
+
+  delta = newEnd->offset - oldEnd->offset;
+  if (end != range->end + delta) {
+    free(recRanges);
+    return 0;
+  }
+
+  // Splice the new nested ranges in place of the old ones and relocate the rest
+  last = r + 1;
+  while ((last < parse->rangeCount) && (parse->ranges[last].start.offset < range->end))
+    last++;
+
+  if (parse->rangeCount - (last - r - 1) + recCount > parse->rangeMax) {
+    parse->rangeMax = 2 * (parse->rangeCount + recCount);
+    parse->ranges = (SubroutineRange*) realloc(parse->ranges, parse->rangeMax * sizeof(SubroutineRange));
+  }
+  memmove(parse->ranges + r + 1 + recCount, parse->ranges + last,
+          (parse->rangeCount - last) * sizeof(SubroutineRange));
+  if (recCount > 0)
+    memcpy(parse->ranges + r + 1, recRanges, recCount * sizeof(SubroutineRange));
+  parse->rangeCount = parse->rangeCount - (last - r - 1) + recCount;
+  free(recRanges);
+
+  for (i = 0; i < parse->rangeCount; i++) {
+    if ((i > r) && (i <= r + recCount))
+      continue;
+    if (i != r) {
+      shiftPos(&parse->ranges[i].start, oldEnd, newEnd);
+      shiftPos(&parse->ranges[i].body, oldEnd, newEnd);
+    }
+    if (parse->ranges[i].end >= oldEnd->offset)
+      parse->ranges[i].end += delta;
+  }
+  return 1;
+}
+
+// After an error: drop what the parse had built, and its tokens and input
+void abandonParse(IncrementalParse *parse) {
+  // A token being scanned when the error came is both
+  if (lookAhead != currentToken)
+    freeToken(lookAhead);
+  freeToken(currentToken);
+  currentToken = lookAhead = NULL;
+  closeInputStream();
+  trackAssignPair(NULL);
+
+  if (recording) {
+    if (parse->ranges == NULL) {
+      parse->ranges = recRanges;
+      parse->rangeMax = recMax;
+    } else free(recRanges);
+    recording = 0;
+  }
+  parse->rangeCount = 0;
+
+  cleanCodeBuffer();
+  cleanSymTab();
+  parse->valid = 0;
+  strcpy(parse->diagnostic, errorReport);
+}
+
+IncrementalParse* parseIncremental(char *source, int size) {
+  IncrementalParse *parse = (IncrementalParse*) malloc(sizeof(IncrementalParse));
+  jmp_buf recovery;
+
+  parse->sourceSize = size;
+  parse->sourceMax = size + 1;
+  parse->source = (char*) malloc(parse->sourceMax);
+  memcpy(parse->source, source, size);
+  parse->source[size] = '\0';
+  parse->ranges = NULL;
+  parse->rangeCount = parse->rangeMax = 0;
+  parse->diagnostic[0] = '\0';
+
+  errorRecovery = &recovery;
+  if (setjmp(recovery) == 0)
+    fullParse(parse);
+  else abandonParse(parse);
+  errorRecovery = NULL;
+  return parse;
+}
+
+int applyEdit(IncrementalParse *parse, int offset, int removed, char *text, int inserted) {
+  SourcePos oldEnd, newEnd;
+  jmp_buf recovery;
+  int i;
+  volatile int r = -1;  // Live across setjmp
+
+  // The innermost subroutine whose block contains the whole edit
+  for (i = 0; i < parse->rangeCount; i++) {
+    if (parse->ranges[i].start.offset >= offset + removed)
+      break;
+    if ((parse->ranges[i].body.offset <= offset) && (offset + removed <= parse->ranges[i].end))
+      r = i;
+  }
+
+  if (r >= 0) {
+    oldEnd = parse->ranges[r].body;
+    advancePos(parse->source, &oldEnd, offset + removed);
+  }
+
+  replaceText(parse, offset, removed, text, inserted);
+
+  errorRecovery = &recovery;
+  if (setjmp(recovery) != 0) {
+    errorRecovery = NULL;
+    abandonParse(parse);
+    return REPARSE_ERROR;
+  }
+
+  if (parse->valid && (r >= 0)) {
+    newEnd = parse->ranges[r].body;
+    advancePos(parse->source, &newEnd, offset + inserted);
+    if (reparseSubroutine(parse, r, &oldEnd, &newEnd)) {
+      errorRecovery = NULL;
+      return REPARSE_SUBROUTINE;
+    }
+  }
+
+  if (parse->valid) {
+    cleanSymTab();
+    cleanCodeBuffer();
+  }
+  fullParse(parse);
+  errorRecovery = NULL;
+  return REPARSE_FULL;
+}
+
+void freeIncrementalParse(IncrementalParse *parse) {
+  if (parse->valid) {
+    cleanSymTab();
+    cleanCodeBuffer();
+  }
+  free(parse->source);
+  free(parse->ranges);
+  free(parse);
+}
@@ -0,0 +1,64 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __INCREMENTAL_H__
+#define __INCREMENTAL_H__
+
+#include "token.h"
+#include "symtab.h"
+#include "error.h"
+
+#define REPARSE_FULL 0
+#define REPARSE_SUBROUTINE 1
+#define REPARSE_ERROR 2
+
+struct SourcePos_ {
+  int offset;
+  int lineNo, colNo;
+};
+
+typedef struct SourcePos_ SourcePos;
+
+/* Source range of one FUNCTION/PROCEDURE declaration. Ranges are kept in
+ * declaration order, so the subroutines nested in a range follow it. */
+struct SubroutineRange_ {
+  Object *owner;
+  int depth;
+  SourcePos start;    // FUNCTION or PROCEDURE keyword
+  SourcePos body;     // first token of the block
+  int end;            // just past the closing ';'
+};
+
+typedef struct SubroutineRange_ SubroutineRange;
+
+struct IncrementalParse_ {
+  char *source;
+  int sourceSize;
+  int sourceMax;
+  SubroutineRange *ranges;
+  int rangeCount;
+  int rangeMax;
+  int valid;                        // the symbol table matches the source
+  char diagnostic[MAX_ERROR_LEN];   // the first error of the last parse, if it failed
+};
+
+typedef struct IncrementalParse_ IncrementalParse;
+
+/* parseIncremental and applyEdit catch the first error of a parse rather
+ * than exiting: the parse is left invalid, with its diagnostic, and the
+ * edit returns REPARSE_ERROR. The symbol table is then gone; the next
+ * edit parses the whole source again. What the statement being compiled
+ * had allocated when the error came is not freed. */
+
+IncrementalParse* parseIncremental(char *source, int size);
+int applyEdit(IncrementalParse *parse, int offset, int removed, char *text, int inserted);
+void freeIncrementalParse(IncrementalParse *parse);
+
+int openSubroutineRange(Token *keyword);
+void markSubroutineBody(int range, Object *owner, Token *first);
+void closeSubroutineRange(int range, Token *semicolon);
+
+#endif
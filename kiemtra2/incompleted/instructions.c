@@ -0,0 +1,313 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "reader.h"
+#include "instructions.h"
+
+#define INIT_CODE_SIZE 256
+#define INIT_LABELS 16
+
+char *opCodeNames[PLAIN_OP_COUNT] = {
+  "LA", "LV", "LC", "LI", "INT", "DCT", "J", "FJ", "HL", "ST", "CP", "CALL", "EP", "EF",
+  "RC", "RI", "WRC", "WRI", "WLN", "AD", "SB", "ML", "DV", "NEG", "CV",
+  "EQ", "NE", "GT", "LT", "GE", "LE", "SUM"
+};
+
+SuperOp superOps[OP_COUNT - PLAIN_OP_COUNT + 1] = {
+#define SUPEROP(name, length, op1, op2, op3, op4) { #name, length, { OP_##op1, OP_##op2, OP_##op3, OP_##op4 } },
+#include "superops.h"
+#undef SUPEROP
+  { NULL, 0, { OP_NONE, OP_NONE, OP_NONE, OP_NONE } }
+};
+
+/******************* Code blocks ******************************/
+
+CodeBlock* createCodeBlock(void) {
+  CodeBlock *codeBlock = (CodeBlock*) malloc(sizeof(CodeBlock));
+  codeBlock->code = NULL;
+  codeBlock->codeSize = 0;
+  codeBlock->maxSize = 0;
+  codeBlock->labels = NULL;
+  codeBlock->labelCount = 0;
+  codeBlock->labelMax = 0;
+  return codeBlock;
+}
+
+void freeCodeBlock(CodeBlock *codeBlock) {
+  free(codeBlock->code);
+  free(codeBlock->labels);
+  free(codeBlock);
+}
+
+CodeAddress emitCode(CodeBlock *codeBlock, enum OpCode op, WORD p, WORD q) {
+  Instruction *instruction;
+
+  if (codeBlock->codeSize == codeBlock->maxSize) {
+    codeBlock->maxSize = (codeBlock->maxSize == 0) ? INIT_CODE_SIZE : codeBlock->maxSize * 2;
+    codeBlock->code = (Instruction*) realloc(codeBlock->code, codeBlock->maxSize * sizeof(Instruction));
+  }
+  instruction = &(codeBlock->code[codeBlock->codeSize]);
+  instruction->op = op;
+  instruction->p = p;
+  instruction->q = q;
+  return codeBlock->codeSize++;
+}
+
+void addCodeLabel(CodeBlock *codeBlock, char *name, CodeAddress address) {
+  CodeLabel *label;
+
+  if (codeBlock->labelCount == codeBlock->labelMax) {
+    codeBlock->labelMax = (codeBlock->labelMax == 0) ? INIT_LABELS : codeBlock->labelMax * 2;
+    codeBlock->labels = (CodeLabel*) realloc(codeBlock->labels, codeBlock->labelMax * sizeof(CodeLabel));
+  }
+  label = &(codeBlock->labels[codeBlock->labelCount++]);
+  strncpy(label->name, name, MAX_IDENT_LEN);
+  label->name[MAX_IDENT_LEN] = '\0';
+  label->address = address;
+}
+
+// Drop the instructions from address on, and the labels that point there
+void truncateCode(CodeBlock *codeBlock, CodeAddress address) {
+  if (address < codeBlock->codeSize)
+    codeBlock->codeSize = address;
+  while ((codeBlock->labelCount > 0) && (codeBlock->labels[codeBlock->labelCount - 1].address >= address))
+    codeBlock->labelCount--;
+}
+
+/******************* Superinstructions ******************************/
+
+int isSuperOp(enum OpCode op) {
+  return (op >= PLAIN_OP_COUNT) && (op < OP_COUNT);
+}
+
+SuperOp* getSuperOp(enum OpCode op) {
+  return &superOps[op - PLAIN_OP_COUNT];
+}
+
+// The opcode a superinstruction took the place of
+enum OpCode plainOp(enum OpCode op) {
+  return isSuperOp(op) ? getSuperOp(op)->ops[0] : op;
+}
+
+// Whether op may be in a sequence, last or not
+int canFuse(enum OpCode op, int last) {
+  switch (op) {
+  case OP_HL:
+  case OP_CALL:
+  case OP_EP:
+  case OP_EF:
+    return 0;
+  case OP_J:
+  case OP_FJ:
+    return last;
+  default:
+    return (op >= 0) && (op < PLAIN_OP_COUNT);
+  }
+}
+
+int matchSuperOp(CodeBlock *codeBlock, CodeAddress address, SuperOp *superOp) {
+  int i;
+
+  if (address + superOp->length > codeBlock->codeSize)
+    return 0;
+  for (i = 0; i < superOp->length; i++)
+    if (plainOp(codeBlock->code[address + i].op) != superOp->ops[i])
+      return 0;
+  return 1;
+}
+
+// Whether the superinstruction at address is followed by the rest of its sequence, as fuseCode leaves it
+int checkSuperOp(CodeBlock *codeBlock, CodeAddress address) {
+  SuperOp *superOp = getSuperOp(codeBlock->code[address].op);
+  int i;
+
+  if (address + superOp->length > codeBlock->codeSize)
+    return 0;
+  for (i = 1; i < superOp->length; i++)
+    if (codeBlock->code[address + i].op != superOp->ops[i])
+      return 0;
+  return 1;
+}
+
+// Replace the sequences of superops.h, trying them in their order there
+void fuseCode(CodeBlock *codeBlock) {
+  CodeAddress address = 0;
+  int op;
+
+  while (address < codeBlock->codeSize) {
+    for (op = PLAIN_OP_COUNT; op < OP_COUNT; op++)
+      if (matchSuperOp(codeBlock, address, getSuperOp(op)))
+        break;
+    if (op < OP_COUNT) {
+      codeBlock->code[address].op = op;
+      address += getSuperOp(op)->length;
+    } else address++;
+  }
+}
+
+void defuseCode(CodeBlock *codeBlock) {
+  int i;
+
+  for (i = 0; i < codeBlock->codeSize; i++)
+    codeBlock->code[i].op = plainOp(codeBlock->code[i].op);
+}
+
+/******************* Printing ******************************/
+
+char* opCodeName(enum OpCode op) {
+  if ((op >= 0) && (op < PLAIN_OP_COUNT))
+    return opCodeNames[op];
+  return isSuperOp(op) ? getSuperOp(op)->name : "???";
+}
+
+// A superinstruction shows the operands of the instruction it replaced
+void formatInstruction(char *text, Instruction *instruction) {
+  switch (plainOp(instruction->op)) {
+  case OP_LA:
+  case OP_LV:
+  case OP_CALL:
+    sprintf(text, "%s %d,%d", opCodeName(instruction->op), instruction->p, instruction->q);
+    break;
+  case OP_LC:
+  case OP_INT:
+  case OP_DCT:
+  case OP_J:
+  case OP_FJ:
+  case OP_CP:
+    sprintf(text, "%s %d", opCodeName(instruction->op), instruction->q);
+    break;
+  default:
+    sprintf(text, "%s", opCodeName(instruction->op));
+    break;
+  }
+}
+
+void printInstruction(Instruction *instruction) {
+  char text[MAX_INSTRUCTION_TEXT];
+
+  formatInstruction(text, instruction);
+  printf("%s", text);
+}
+
+void printCodeBlock(CodeBlock *codeBlock) {
+  int i, label = 0;
+
+  for (i = 0; i < codeBlock->codeSize; i++) {
+    while ((label < codeBlock->labelCount) && (codeBlock->labels[label].address == i))
+      printf("%s:\n", codeBlock->labels[label++].name);
+    printf("%6d:  ", i);
+    printInstruction(&(codeBlock->code[i]));
+    printf("\n");
+  }
+}
+
+void printRegionMix(CodeBlock *codeBlock, char *name, CodeAddress start, CodeAddress end) {
+  int counts[OP_COUNT];
+  int i, op, best;
+
+  if (start >= end)
+    return;
+  memset(counts, 0, sizeof(counts));
+  for (i = start; i < end; i++)
+    counts[codeBlock->code[i].op]++;
+
+  printf("%s: %d instructions\n", name, end - start);
+  // Most frequent first
+  for (;;) {
+    best = -1;
+    for (op = 0; op < OP_COUNT; op++)
+      if ((counts[op] > 0) && ((best < 0) || (counts[op] > counts[best])))
+        best = op;
+    if (best < 0)
+      break;
+    printf("    %-11s %6d %6.1f%%\n", opCodeName(best), counts[best], 100.0 * counts[best] / (end - start));
+    counts[best] = 0;
+  }
+}
+
+// For each labelled body, how often each opcode occurs in its code
+void printInstructionMix(CodeBlock *codeBlock) {
+  CodeAddress end;
+  int i;
+
+  if (codeBlock->labelCount == 0) {
+    printRegionMix(codeBlock, "(code)", 0, codeBlock->codeSize);
+    return;
+  }
+  printRegionMix(codeBlock, "(entry)", 0, codeBlock->labels[0].address);
+  for (i = 0; i < codeBlock->labelCount; i++) {
+    end = (i + 1 < codeBlock->labelCount) ? codeBlock->labels[i + 1].address : codeBlock->codeSize;
+    printRegionMix(codeBlock, codeBlock->labels[i].name, codeBlock->labels[i].address, end);
+  }
+}
+
+/******************* Code files ******************************/
+
+int saveCode(CodeBlock *codeBlock, char *fileName) {
+  CodeFileHeader header;
+  FILE *f;
+  int ok;
+
+  header.magic = CODEFILE_MAGIC;
+  header.version = CODEFILE_VERSION;
+  header.superopSet = SUPEROP_SET;
+  header.codeSize = codeBlock->codeSize;
+  header.labelCount = codeBlock->labelCount;
+
+  f = fopen(fileName, "wb");
+  if (f == NULL)
+    return IO_ERROR;
+  ok = (fwrite(&header, sizeof(header), 1, f) == 1)
+    && (fwrite(codeBlock->code, sizeof(Instruction), codeBlock->codeSize, f) == (size_t) codeBlock->codeSize)
+    && (fwrite(codeBlock->labels, sizeof(CodeLabel), codeBlock->labelCount, f) == (size_t) codeBlock->labelCount);
+  ok = (fclose(f) == 0) && ok;
+  return ok ? IO_SUCCESS : IO_ERROR;
+}
+
+CodeBlock* loadCode(char *fileName) {
+  CodeFileHeader header;
+  CodeBlock *codeBlock;
+  FILE *f;
+  int ok, i;
+
+  f = fopen(fileName, "rb");
+  if (f == NULL)
+    return NULL;
+  if ((fread(&header, sizeof(header), 1, f) != 1) || (header.magic != CODEFILE_MAGIC) ||
+      (header.version != CODEFILE_VERSION) || (header.codeSize < 0) || (header.labelCount < 0)) {
+    fclose(f);
+    return NULL;
+  }
+
+  codeBlock = createCodeBlock();
+  codeBlock->maxSize = (header.codeSize > 0) ? header.codeSize : 1;
+  codeBlock->code = (Instruction*) malloc(codeBlock->maxSize * sizeof(Instruction));
+  codeBlock->codeSize = header.codeSize;
+  codeBlock->labelMax = (header.labelCount > 0) ? header.labelCount : 1;
+  codeBlock->labels = (CodeLabel*) malloc(codeBlock->labelMax * sizeof(CodeLabel));
+  codeBlock->labelCount = header.labelCount;
+  ok = (fread(codeBlock->code, sizeof(Instruction), header.codeSize, f) == (size_t) header.codeSize)
+    && (fread(codeBlock->labels, sizeof(CodeLabel), header.labelCount, f) == (size_t) header.labelCount);
+  fclose(f);
+
+  // Reject opcodes no machine could execute, and superinstructions of another
+  // set or not followed by their sequence
+  for (i = 0; ok && (i < codeBlock->codeSize); i++)
+    if (((int) codeBlock->code[i].op < 0) || (codeBlock->code[i].op >= OP_COUNT))
+      ok = 0;
+  for (i = 0; ok && (i < codeBlock->codeSize); i++)
+    if (isSuperOp(codeBlock->code[i].op) && ((header.superopSet != SUPEROP_SET) || !checkSuperOp(codeBlock, i)))
+      ok = 0;
+  if (!ok) {
+    freeCodeBlock(codeBlock);
+    return NULL;
+  }
+  return codeBlock;
+}
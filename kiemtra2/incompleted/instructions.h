@@ -0,0 +1,145 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __INSTRUCTIONS_H__
+#define __INSTRUCTIONS_H__
+
+#include "token.h"
+
+/* Stack machine. The memory s holds the frames of the active blocks, t
+ * is the top of the stack, b the base of the current frame and pc the
+ * next instruction. base(p) follows p static links from b. Every value,
+ * an address included, is one word. */
+
+enum OpCode {
+  OP_LA,    // Load Address:    t := t + 1; s[t] := base(p) + q
+  OP_LV,    // Load Value:      t := t + 1; s[t] := s[base(p) + q]
+  OP_LC,    // Load Constant:   t := t + 1; s[t] := q
+  OP_LI,    // Load Indirect:   s[t] := s[s[t]]
+  OP_INT,   // Increment t:     t := t + q
+  OP_DCT,   // Decrement t:     t := t - q
+  OP_J,     // Jump:            pc := q
+  OP_FJ,    // False Jump:      if s[t] = 0 then pc := q; t := t - 1
+  OP_HL,    // Halt
+  OP_ST,    // Store:           s[s[t-1]] := s[t]; t := t - 2
+  OP_CP,    // Copy:            the q words at s[t] to s[t-1]; t := t - 2
+  OP_CALL,  // Call:            s[t+2] := b; s[t+3] := pc; s[t+4] := base(p); b := t + 1; pc := q
+  OP_EP,    // Exit Procedure:  t := b - 1; pc := s[b+2]; b := s[b+1]
+  OP_EF,    // Exit Function:   t := b; pc := s[b+2]; b := s[b+1]
+  OP_RC,    // Read Char:       t := t + 1; s[t] := the character read
+  OP_RI,    // Read Integer:    t := t + 1; s[t] := the integer read
+  OP_WRC,   // Write Char:      write s[t] as a character; t := t - 1
+  OP_WRI,   // Write Integer:   write s[t]; t := t - 1
+  OP_WLN,   // New Line
+  OP_AD,    // Add:             t := t - 1; s[t] := s[t] + s[t+1]
+  OP_SB,    // Subtract:        t := t - 1; s[t] := s[t] - s[t+1]
+  OP_ML,    // Multiply:        t := t - 1; s[t] := s[t] * s[t+1]
+  OP_DV,    // Divide:          t := t - 1; s[t] := s[t] / s[t+1]
+  OP_NEG,   // Negate:          s[t] := - s[t]
+  OP_CV,    // Copy Top:        s[t+1] := s[t]; t := t + 1
+  OP_EQ,    // Equal:           t := t - 1; s[t] := (s[t] = s[t+1])
+  OP_NE,    // Not Equal
+  OP_GT,    // Greater Than
+  OP_LT,    // Less Than
+  OP_GE,    // Greater or Equal
+  OP_LE,    // Less or Equal
+  OP_SUM,   // Sum:             t := t - 1; s[t] := the s[t+1] words from s[s[t]] added up
+  // Superinstructions: each replaces the first instruction of its sequence
+#define SUPEROP(name, length, op1, op2, op3, op4) OP_##name,
+#include "superops.h"
+#undef SUPEROP
+  OP_COUNT
+};
+
+/* A superinstruction runs a sequence of instructions with one dispatch.
+ * It takes the place of the opcode of the first one and leaves the
+ * others where they are, so its operands are theirs and jumps into the
+ * sequence still find them. Only the last one may jump, and none may
+ * call, return or halt. The sequences are generated into superops.h by
+ * kplsuper from profiles of kplrun-profile. */
+
+#define PLAIN_OP_COUNT (OP_SUM + 1)
+#define MAX_SUPEROP_LENGTH 4
+#define OP_NONE OP_COUNT    // pads the sequences of superops.h
+#define MAX_INSTRUCTION_TEXT 64   // of formatInstruction
+
+struct SuperOp_ {
+  char *name;
+  int length;
+  enum OpCode ops[MAX_SUPEROP_LENGTH];
+};
+
+typedef struct SuperOp_ SuperOp;
+
+typedef int WORD;
+typedef int CodeAddress;
+
+struct Instruction_ {
+  enum OpCode op;
+  WORD p;
+  WORD q;
+};
+
+typedef struct Instruction_ Instruction;
+
+// Where the body of a subroutine or of the program starts
+struct CodeLabel_ {
+  char name[MAX_IDENT_LEN + 1];
+  CodeAddress address;
+};
+
+typedef struct CodeLabel_ CodeLabel;
+
+struct CodeBlock_ {
+  Instruction *code;
+  int codeSize;
+  int maxSize;
+  CodeLabel *labels;    // in address order
+  int labelCount;
+  int labelMax;
+};
+
+typedef struct CodeBlock_ CodeBlock;
+
+/* A code file is a header followed by the instructions, then the
+ * labels. */
+
+#define CODEFILE_MAGIC 0x424C504B   /* "KPLB" */
+#define CODEFILE_VERSION 2
+
+struct CodeFileHeader_ {
+  int magic;
+  int version;
+  int superopSet;       // SUPEROP_SET of the superinstructions the code uses
+  int codeSize;
+  int labelCount;
+};
+
+typedef struct CodeFileHeader_ CodeFileHeader;
+
+CodeBlock* createCodeBlock(void);
+void freeCodeBlock(CodeBlock *codeBlock);
+CodeAddress emitCode(CodeBlock *codeBlock, enum OpCode op, WORD p, WORD q);
+void addCodeLabel(CodeBlock *codeBlock, char *name, CodeAddress address);
+void truncateCode(CodeBlock *codeBlock, CodeAddress address);
+
+int isSuperOp(enum OpCode op);
+SuperOp* getSuperOp(enum OpCode op);
+enum OpCode plainOp(enum OpCode op);
+int canFuse(enum OpCode op, int last);
+void fuseCode(CodeBlock *codeBlock);
+void defuseCode(CodeBlock *codeBlock);
+
+char* opCodeName(enum OpCode op);
+void formatInstruction(char *text, Instruction *instruction);
+void printInstruction(Instruction *instruction);
+void printCodeBlock(CodeBlock *codeBlock);
+void printInstructionMix(CodeBlock *codeBlock);
+
+int saveCode(CodeBlock *codeBlock, char *fileName);
+CodeBlock* loadCode(char *fileName);
+
+#endif
@@ -0,0 +1,992 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jit.h"
+#include "reduce.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <stddef.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define MIN_FRAME_SIZE 4          // RESERVED_WORDS of symtab.h, which every subroutine's INT reserves
+#define CODE_BYTES 192            // of machine code reserved per instruction
+#define NATIVE_MARGIN 65536       // bytes of native stack for the C functions the code calls
+#define MAX_OPERAND 0x1FFFFFFF    // offsets of LV whose bytes fit in a displacement
+
+enum Register { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+#define NO_INDEX -1
+
+// The condition codes of the comparisons, for SETcc and Jcc
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_L 0xC
+#define CC_GE 0xD
+#define CC_LE 0xE
+#define CC_G 0xF
+
+// Read and written by the machine code through r15
+struct JitContext_ {
+  WORD *s;
+  long stackSize;
+  long limit;
+  long b;
+  long t;
+  WORD top;
+  WORD value;               // what RC, RI and SUM leave for the code
+  int errorAddress;
+  void *savedRsp;
+  void *nativeStack;        // the top of the stack the code runs on
+};
+
+typedef struct JitContext_ JitContext;
+
+typedef int (*EnterFunction)(JitContext *context, void *code, int call);
+
+struct JitCode_ {
+  JitContext context;
+  CodeBlock *codeBlock;
+  int codeSize;
+  int stackSize;
+  unsigned char *region;
+  size_t regionSize;
+  size_t regionUsed;        // page aligned: executable below, writable above
+  long *native;             // where each address was compiled, -1 if it was not
+  char *subroutine;         // the addresses compiled as subroutine entries
+  size_t exitOffset;        // leaves the code with the status in eax
+  unsigned char *nativeStackBase;
+  size_t nativeStackSize;
+};
+
+// A rel32 in the code, to resolve once every unit is compiled
+struct Fixup_ {
+  size_t position;
+  CodeAddress target;
+};
+
+typedef struct Fixup_ Fixup;
+
+// A jump to the code that reports the error of an instruction
+struct ErrorSite_ {
+  size_t position;
+  CodeAddress address;
+  int status;               // -1 when a C function left it in eax
+};
+
+typedef struct ErrorSite_ ErrorSite;
+
+struct Emitter_ {
+  JitCode *jit;
+  size_t position;
+  size_t end;
+  int overflow;
+  Fixup *fixups;
+  int fixupCount;
+  ErrorSite *errors;
+  int errorCount;
+};
+
+typedef struct Emitter_ Emitter;
+
+/******************* Machine code ******************************/
+
+void emitByte(Emitter *e, int b) {
+  if (e->position < e->end)
+    e->jit->region[e->position++] = (unsigned char) b;
+  else e->overflow = 1;
+}
+
+void emitDword(Emitter *e, int d) {
+  int i;
+
+  for (i = 0; i < 4; i++)
+    emitByte(e, (unsigned) d >> (8 * i));
+}
+
+void emitQword(Emitter *e, unsigned long q) {
+  int i;
+
+  for (i = 0; i < 8; i++)
+    emitByte(e, (int) (q >> (8 * i)));
+}
+
+void emitRex(Emitter *e, int w, int reg, int index, int rm) {
+  int rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+
+  if (index != NO_INDEX)
+    rex |= (index >> 3) << 1;
+  if (rex != 0x40)
+    emitByte(e, rex);
+}
+
+// Opcodes above 0xFF are two bytes, the first 0x0F
+void emitOpcode(Emitter *e, int opcode) {
+  if (opcode > 0xFF)
+    emitByte(e, opcode >> 8);
+  emitByte(e, opcode & 0xFF);
+}
+
+// op reg, rm with two registers
+void emitRegisters(Emitter *e, int w, int opcode, int reg, int rm) {
+  emitRex(e, w, reg, NO_INDEX, rm);
+  emitOpcode(e, opcode);
+  emitByte(e, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// op reg, [base + index * 4 + disp]
+void emitMem(Emitter *e, int w, int opcode, int reg, int base, int index, int disp) {
+  int mod;
+
+  emitRex(e, w, reg, index, base);
+  emitOpcode(e, opcode);
+  if ((disp == 0) && ((base & 7) != RBP))
+    mod = 0x00;
+  else if ((disp >= -128) && (disp <= 127))
+    mod = 0x40;
+  else mod = 0x80;
+  if ((index == NO_INDEX) && ((base & 7) != RSP))
+    emitByte(e, mod | ((reg & 7) << 3) | (base & 7));
+  else {
+    emitByte(e, mod | ((reg & 7) << 3) | RSP);
+    if (index == NO_INDEX)
+      emitByte(e, (RSP << 3) | (base & 7));
+    else emitByte(e, 0x80 | ((index & 7) << 3) | (base & 7));
+  }
+  if (mod == 0x40)
+    emitByte(e, disp);
+  else if (mod == 0x80)
+    emitDword(e, disp);
+}
+
+void emitMovImm(Emitter *e, int reg, int imm) {
+  emitRex(e, 0, 0, NO_INDEX, reg);
+  emitByte(e, 0xB8 | (reg & 7));
+  emitDword(e, imm);
+}
+
+void emitCallC(Emitter *e, void *function) {
+  emitRex(e, 1, 0, NO_INDEX, RAX);
+  emitByte(e, 0xB8);
+  emitQword(e, (unsigned long) function);
+  emitRegisters(e, 0, 0xFF, 2, RAX);            // call rax
+}
+
+// add, sub or cmp of a register with an immediate
+void emitImm(Emitter *e, int w, int digit, int reg, int imm) {
+  if ((imm >= -128) && (imm <= 127)) {
+    emitRegisters(e, w, 0x83, digit, reg);
+    emitByte(e, imm);
+  } else {
+    emitRegisters(e, w, 0x81, digit, reg);
+    emitDword(e, imm);
+  }
+}
+
+// The opcode extensions of 0x81 and 0x83; digit * 8 + 3 is the opcode of op reg, [mem]
+#define ADD 0
+#define SUB 5
+#define CMP 7
+
+// A jump whose rel32 is resolved later: opcode 0xE9, 0xE8 or 0x0F8x
+void emitJump(Emitter *e, int opcode, CodeAddress target) {
+  emitOpcode(e, opcode);
+  if (e->overflow)
+    return;
+  e->fixups[e->fixupCount].position = e->position;
+  e->fixups[e->fixupCount].target = target;
+  e->fixupCount++;
+  emitDword(e, 0);
+}
+
+// A conditional jump to the report of error status at address
+void emitError(Emitter *e, int cc, CodeAddress address, int status) {
+  emitOpcode(e, 0x0F80 | cc);
+  if (e->overflow)
+    return;
+  e->errors[e->errorCount].position = e->position;
+  e->errors[e->errorCount].address = address;
+  e->errors[e->errorCount].status = status;
+  e->errorCount++;
+  emitDword(e, 0);
+}
+
+void patchRel32(Emitter *e, size_t position, size_t target) {
+  int rel = (int) ((long) target - (long) (position + 4));
+
+  memcpy(e->jit->region + position, &rel, 4);
+}
+
+/******************* Runtime ******************************/
+
+// Called from the machine code, which checks the status they return
+
+int jitCopy(JitContext *context, WORD a, WORD from, WORD count) {
+  unsigned size = context->stackSize - count;
+
+  if (((unsigned) a > size) || ((unsigned) from > size))
+    return VM_BAD_ADDRESS;
+  memmove(context->s + a, context->s + from, count * sizeof(WORD));
+  return VM_SUCCESS;
+}
+
+int jitSum(JitContext *context, WORD a, WORD count) {
+  if ((count < 0) || ((unsigned) a > (unsigned) context->stackSize) || (count > context->stackSize - a))
+    return VM_BAD_ADDRESS;
+  context->value = sumWords(context->s + a, count);
+  return VM_SUCCESS;
+}
+
+int jitReadChar(JitContext *context) {
+  char ch;
+
+  if (scanf(" %c", &ch) != 1)
+    return VM_BAD_INPUT;
+  context->value = (unsigned char) ch;
+  return VM_SUCCESS;
+}
+
+int jitReadInt(JitContext *context) {
+  if (scanf("%d", &(context->value)) != 1)
+    return VM_BAD_INPUT;
+  return VM_SUCCESS;
+}
+
+void jitWriteChar(WORD x) {
+  putchar(x);
+}
+
+void jitWriteInt(WORD x) {
+  printf("%d", x);
+}
+
+void jitWriteLn(void) {
+  putchar('\n');
+}
+
+/******************* Templates ******************************/
+
+// s[t + k] and the word q of the current frame
+#define STACK(k) RBX, R13, 4 * (k)
+#define FRAME(q) RBX, R12, 4 * (q)
+
+#define CONTEXT(field) R15, NO_INDEX, (int) offsetof(JitContext, field)
+
+void emitLoadTop(Emitter *e) {
+  emitMem(e, 0, 0x8B, R14, STACK(0));
+}
+
+void emitSpillTop(Emitter *e) {
+  emitMem(e, 0, 0x89, R14, STACK(0));
+}
+
+// s[t] := top; t := t + 1, before a push
+void emitGrow(Emitter *e) {
+  emitSpillTop(e);
+  emitRegisters(e, 1, 0xFF, 0, R13);            // inc r13
+}
+
+// t := t - 1; top := s[t]
+void emitPop(Emitter *e) {
+  emitRegisters(e, 1, 0xFF, 1, R13);            // dec r13
+  emitLoadTop(e);
+}
+
+// eax := base(p), for p > 0
+void emitBase(Emitter *e, int p) {
+  emitRegisters(e, 0, 0x89, R12, RAX);
+  for (; p > 0; p--)
+    emitMem(e, 0, 0x8B, RAX, RBX, RAX, 12);
+}
+
+void emitPrologue(Emitter *e) {
+  emitImm(e, 1, SUB, RSP, 8);              // keeps rsp 16-byte aligned for the C functions
+}
+
+void emitReturn(Emitter *e) {
+  emitImm(e, 1, ADD, RSP, 8);
+  emitByte(e, 0xC3);
+}
+
+int conditionCode(int op) {
+  switch (op) {
+  case OP_EQ: return CC_E;
+  case OP_NE: return CC_NE;
+  case OP_GT: return CC_G;
+  case OP_LT: return CC_L;
+  case OP_GE: return CC_GE;
+  default: return CC_LE;
+  }
+}
+
+int isComparison(int op) {
+  return (op >= OP_EQ) && (op <= OP_LE);
+}
+
+/* The flags of a comparison into top, dropping drop words, or with fused
+ * into the jump of the FJ after it, which pops the result. */
+void emitCondition(Emitter *e, int op, int drop, int fused, WORD fjTarget) {
+  // Neither lea nor mov touches the flags
+  if (fused) {
+    emitMem(e, 1, 0x8D, R13, R13, NO_INDEX, -drop - 1);
+    emitLoadTop(e);
+    emitJump(e, 0x0F80 | (conditionCode(op) ^ 1), fjTarget);
+  } else {
+    emitRegisters(e, 0, 0x0F90 | conditionCode(op), 0, RAX);  // setcc al
+    emitRegisters(e, 0, 0x0FB6, R14, RAX);                    // movzx r14d, al
+    if (drop > 0)
+      emitMem(e, 1, 0x8D, R13, R13, NO_INDEX, -drop);
+  }
+}
+
+int isFoldable(int op) {
+  return (op == OP_AD) || (op == OP_SB) || (op == OP_ML) || isComparison(op);
+}
+
+/* The arithmetic or comparison op on top and the operand of LC q, or of
+ * LV 0,q, which is not pushed. */
+void emitFolded(Emitter *e, int operandOp, WORD q, int op, int fused, WORD fjTarget) {
+  int digit;
+
+  if (op == OP_ML) {
+    if (operandOp == OP_LC) {
+      emitRegisters(e, 0, 0x69, R14, R14);                    // imul r14d, r14d, q
+      emitDword(e, q);
+    } else emitMem(e, 0, 0x0FAF, R14, FRAME(q));
+    return;
+  }
+  digit = (op == OP_AD) ? ADD : ((op == OP_SB) ? SUB : CMP);
+  if (operandOp == OP_LC)
+    emitImm(e, 0, digit, R14, q);
+  else emitMem(e, 0, digit * 8 + 3, R14, FRAME(q));
+  if (isComparison(op))
+    emitCondition(e, op, 0, fused, fjTarget);
+}
+
+/* The machine code of the instruction at address i, or with fused set
+ * of the comparison there and the FJ after it. */
+void emitInstruction(Emitter *e, CodeAddress i, int op, WORD p, WORD q, int fused, WORD fjTarget) {
+  int skip;
+  size_t start;
+
+  switch (op) {
+  case OP_LA:
+    if (p == 0) {
+      emitGrow(e);
+      emitMem(e, 0, 0x8D, R14, R12, NO_INDEX, q);           // lea r14d, [r12 + q]
+    } else {
+      emitBase(e, p);
+      emitGrow(e);
+      emitMem(e, 0, 0x8D, R14, RAX, NO_INDEX, q);
+    }
+    break;
+  case OP_LV:
+    if (p == 0) {
+      emitGrow(e);
+      emitMem(e, 0, 0x8B, R14, FRAME(q));
+    } else {
+      emitBase(e, p);
+      emitGrow(e);
+      emitMem(e, 0, 0x8B, R14, RBX, RAX, 4 * q);
+    }
+    break;
+  case OP_LC:
+    emitGrow(e);
+    emitMovImm(e, R14, q);
+    break;
+  case OP_LI:
+    emitMem(e, 1, 0x3B, R14, CONTEXT(stackSize));         // cmp r14, stackSize
+    emitError(e, 0x3, i, VM_BAD_ADDRESS);                 // jae
+    emitMem(e, 0, 0x8B, R14, RBX, R14, 0);
+    break;
+  case OP_INT:
+    emitMem(e, 1, 0x8D, RAX, R13, NO_INDEX, q);            // lea rax, [r13 + q]
+    emitMem(e, 1, 0x3B, RAX, CONTEXT(limit));
+    emitError(e, CC_GE, i, VM_STACK_OVERFLOW);
+    emitSpillTop(e);
+    emitRegisters(e, 1, 0x89, RAX, R13);
+    emitLoadTop(e);
+    break;
+  case OP_DCT:
+    emitSpillTop(e);
+    emitImm(e, 1, SUB, R13, q);
+    emitLoadTop(e);
+    break;
+  case OP_J:
+    emitJump(e, 0xE9, q);
+    break;
+  case OP_FJ:
+    emitRegisters(e, 0, 0x89, R14, RAX);
+    emitPop(e);
+    emitRegisters(e, 0, 0x85, RAX, RAX);                        // test eax, eax
+    emitJump(e, 0x0F80 | CC_E, q);
+    break;
+  case OP_HL:
+    emitJump(e, 0xE9, e->jit->codeSize);
+    break;
+  case OP_ST:
+    emitMem(e, 0, 0x8B, RAX, STACK(-1));
+    emitMem(e, 1, 0x3B, RAX, CONTEXT(stackSize));
+    emitError(e, 0x3, i, VM_BAD_ADDRESS);
+    emitMem(e, 0, 0x89, R14, RBX, RAX, 0);
+    emitImm(e, 1, SUB, R13, 2);
+    emitLoadTop(e);
+    break;
+  case OP_CP:
+    emitRegisters(e, 1, 0x89, R15, RDI);
+    emitMem(e, 0, 0x8B, RSI, STACK(-1));
+    emitRegisters(e, 0, 0x89, R14, RDX);
+    emitMovImm(e, RCX, q);
+    emitCallC(e, (void*) jitCopy);
+    emitRegisters(e, 0, 0x85, RAX, RAX);
+    emitError(e, CC_NE, i, -1);
+    emitImm(e, 1, SUB, R13, 2);
+    emitLoadTop(e);
+    break;
+  case OP_CALL:
+    emitSpillTop(e);
+    emitMem(e, 0, 0x89, R12, STACK(2));
+    emitMem(e, 0, 0xC7, 0, STACK(3));
+    emitDword(e, i + 1);
+    if (p == 0)
+      emitMem(e, 0, 0x89, R12, STACK(4));
+    else {
+      emitBase(e, p);
+      emitMem(e, 0, 0x89, RAX, STACK(4));
+    }
+    emitMem(e, 1, 0x8D, R12, R13, NO_INDEX, 1);            // lea r12, [r13 + 1]
+    emitJump(e, 0xE8, q);
+    break;
+  case OP_EP:
+    emitMem(e, 1, 0x8D, R13, R12, NO_INDEX, -1);
+    emitMem(e, 0, 0x8B, R12, STACK(2));
+    emitLoadTop(e);
+    emitReturn(e);
+    break;
+  case OP_EF:
+    emitRegisters(e, 1, 0x89, R12, R13);
+    emitMem(e, 0, 0x8B, R12, STACK(1));
+    emitLoadTop(e);
+    emitReturn(e);
+    break;
+  case OP_RC:
+  case OP_RI:
+    emitRegisters(e, 1, 0x89, R15, RDI);
+    emitCallC(e, op == OP_RC ? (void*) jitReadChar : (void*) jitReadInt);
+    emitRegisters(e, 0, 0x85, RAX, RAX);
+    emitError(e, CC_NE, i, -1);
+    emitGrow(e);
+    emitMem(e, 0, 0x8B, R14, CONTEXT(value));
+    break;
+  case OP_WRC:
+  case OP_WRI:
+    emitRegisters(e, 0, 0x89, R14, RDI);
+    emitCallC(e, op == OP_WRC ? (void*) jitWriteChar : (void*) jitWriteInt);
+    emitPop(e);
+    break;
+  case OP_WLN:
+    emitCallC(e, (void*) jitWriteLn);
+    break;
+  case OP_AD:
+    emitMem(e, 0, 0x03, R14, STACK(-1));                  // add r14d, s[t - 1]
+    emitRegisters(e, 1, 0xFF, 1, R13);
+    break;
+  case OP_SB:
+    emitMem(e, 0, 0x8B, RAX, STACK(-1));
+    emitRegisters(e, 0, 0x29, R14, RAX);                        // sub eax, r14d
+    emitRegisters(e, 0, 0x89, RAX, R14);
+    emitRegisters(e, 1, 0xFF, 1, R13);
+    break;
+  case OP_ML:
+    emitMem(e, 0, 0x0FAF, R14, STACK(-1));                // imul r14d, s[t - 1]
+    emitRegisters(e, 1, 0xFF, 1, R13);
+    break;
+  case OP_DV:
+    // The most negative integer divided by -1 wraps around
+    emitRegisters(e, 0, 0x85, R14, R14);
+    emitError(e, CC_E, i, VM_DIVISION_BY_ZERO);
+    emitMem(e, 0, 0x8B, RAX, STACK(-1));
+    emitRegisters(e, 0, 0x83, CMP, R14);
+    emitByte(e, -1);
+    emitByte(e, 0x75);                                    // jne
+    emitByte(e, 0);
+    start = e->position;
+    emitRegisters(e, 0, 0xF7, 3, RAX);                          // neg eax
+    emitByte(e, 0xEB);                                    // jmp
+    emitByte(e, 0);
+    skip = e->position - start;
+    start = e->position;
+    emitByte(e, 0x99);                                    // cdq
+    emitRegisters(e, 0, 0xF7, 7, R14);                          // idiv r14d
+    if (!e->overflow) {
+      e->jit->region[start - 1] = (unsigned char) (e->position - start);
+      e->jit->region[start - skip - 1] = (unsigned char) skip;
+    }
+    emitRegisters(e, 0, 0x89, RAX, R14);
+    emitRegisters(e, 1, 0xFF, 1, R13);
+    break;
+  case OP_NEG:
+    emitRegisters(e, 0, 0xF7, 3, R14);
+    break;
+  case OP_CV:
+    emitGrow(e);
+    break;
+  case OP_EQ:
+  case OP_NE:
+  case OP_GT:
+  case OP_LT:
+  case OP_GE:
+  case OP_LE:
+    emitMem(e, 0, 0x8B, RAX, STACK(-1));
+    emitRegisters(e, 0, 0x39, R14, RAX);                        // cmp eax, r14d
+    emitCondition(e, op, 1, fused, fjTarget);
+    break;
+  case OP_SUM:
+    emitRegisters(e, 1, 0x89, R15, RDI);
+    emitMem(e, 0, 0x8B, RSI, STACK(-1));
+    emitRegisters(e, 0, 0x89, R14, RDX);
+    emitCallC(e, (void*) jitSum);
+    emitRegisters(e, 0, 0x85, RAX, RAX);
+    emitError(e, CC_NE, i, -1);
+    emitMem(e, 0, 0x8B, R14, CONTEXT(value));
+    emitRegisters(e, 1, 0xFF, 1, R13);
+    break;
+  }
+}
+
+/******************* Units ******************************/
+
+struct Analysis_ {
+  int *unit;                // of each address, -1 if in none
+  char *target;             // whether a jump goes there
+  CodeAddress *entries;     // of the units
+  char *subroutine;         // whether each unit is a subroutine
+  int unitCount;
+  CodeAddress *work;
+  int workCount;
+};
+
+typedef struct Analysis_ Analysis;
+
+int opAt(JitCode *jit, CodeAddress i) {
+  return (i == jit->codeSize) ? OP_HL : plainOp(jit->codeBlock->code[i].op);
+}
+
+// Whether unit u may go on at address i
+int reach(JitCode *jit, Analysis *a, int u, CodeAddress i, int jump) {
+  if ((i < 0) || (i > jit->codeSize))
+    return 0;
+  // The halt after the code is shared
+  if (i == jit->codeSize)
+    return 1;
+  if (jump)
+    a->target[i] = 1;
+  if (jit->native[i] >= 0)
+    return 0;
+  if (a->unit[i] < 0) {
+    a->unit[i] = u;
+    a->work[a->workCount++] = i;
+    return 1;
+  }
+  return (a->unit[i] == u) && !(a->subroutine[u] && (a->entries[u] == i));
+}
+
+// The unit of the subroutine at address i, which may be new
+int reachSubroutine(JitCode *jit, Analysis *a, CodeAddress i) {
+  Instruction *instruction;
+  int u;
+
+  if ((i < 0) || (i >= jit->codeSize))
+    return 0;
+  if (jit->native[i] >= 0)
+    return jit->subroutine[i];
+  u = a->unit[i];
+  if (u >= 0)
+    return a->subroutine[u] && (a->entries[u] == i);
+  instruction = &(jit->codeBlock->code[i]);
+  if ((plainOp(instruction->op) != OP_INT) || (instruction->q < MIN_FRAME_SIZE))
+    return 0;
+  u = a->unitCount++;
+  a->entries[u] = i;
+  a->subroutine[u] = 1;
+  a->unit[i] = u;
+  return 1;
+}
+
+/* The units of the code from entry: every address each can reach without
+ * calling, then those of the subroutines they call that are not compiled
+ * yet. 0 if they overlap or can't be compiled. */
+int findUnits(JitCode *jit, Analysis *a, CodeAddress entry) {
+  Instruction *instruction;
+  CodeAddress i;
+  int u, op;
+
+  a->unitCount = 1;
+  a->entries[0] = entry;
+  a->subroutine[0] = (entry != 0);
+  a->unit[entry] = 0;
+  for (u = 0; u < a->unitCount; u++) {
+    a->workCount = 0;
+    a->work[a->workCount++] = a->entries[u];
+    while (a->workCount > 0) {
+      i = a->work[--a->workCount];
+      instruction = &(jit->codeBlock->code[i]);
+      op = opAt(jit, i);
+      if ((op == OP_LV) && ((instruction->q < -MAX_OPERAND) || (instruction->q > MAX_OPERAND)))
+        return 0;
+      switch (op) {
+      case OP_J:
+        if (!reach(jit, a, u, instruction->q, 1))
+          return 0;
+        break;
+      case OP_FJ:
+        if (!reach(jit, a, u, instruction->q, 1) || !reach(jit, a, u, i + 1, 0))
+          return 0;
+        break;
+      case OP_HL:
+        break;
+      case OP_EP:
+      case OP_EF:
+        if (!a->subroutine[u])
+          return 0;
+        break;
+      case OP_CALL:
+        if (!reachSubroutine(jit, a, instruction->q) || !reach(jit, a, u, i + 1, 0))
+          return 0;
+        break;
+      default:
+        if (!reach(jit, a, u, i + 1, 0))
+          return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+// Address i and on of unit u, into machine code
+// Whether address i runs only after the instruction before it, in unit u
+int follows(JitCode *jit, Analysis *a, int u, CodeAddress i) {
+  return (i < jit->codeSize) && (a->unit[i] == u) && !a->target[i];
+}
+
+/* The addresses of unit u in order, each into the code of its template.
+ * A constant or local operand goes straight to the arithmetic or
+ * comparison after it, and a comparison to the FJ after it. */
+void emitUnit(Emitter *e, Analysis *a, int u) {
+  JitCode *jit = e->jit;
+  Instruction *instruction;
+  CodeAddress i, last, next;
+  WORD fjTarget;
+  int op, folded, fused;
+
+  for (i = 0; i < jit->codeSize; i++) {
+    if (a->unit[i] != u)
+      continue;
+    instruction = &(jit->codeBlock->code[i]);
+    op = opAt(jit, i);
+    jit->native[i] = e->position;
+    if (a->subroutine[u] && (a->entries[u] == i))
+      emitPrologue(e);
+
+    folded = ((op == OP_LC) || ((op == OP_LV) && (instruction->p == 0))) &&
+      follows(jit, a, u, i + 1) && isFoldable(opAt(jit, i + 1));
+    last = folded ? i + 1 : i;
+    fused = isComparison(opAt(jit, last)) && follows(jit, a, u, last + 1) && (opAt(jit, last + 1) == OP_FJ);
+    if (fused)
+      last++;
+    fjTarget = fused ? jit->codeBlock->code[last].q : 0;
+    next = last + 1;
+    if (folded)
+      emitFolded(e, op, instruction->q, opAt(jit, i + 1), fused, fjTarget);
+    else if ((op == OP_J) && (instruction->q == next) && (next < jit->codeSize))
+      ;
+    else emitInstruction(e, i, op, instruction->p, instruction->q, fused, fjTarget);
+    if ((op == OP_J) || (op == OP_HL) || (op == OP_EP) || (op == OP_EF))
+      continue;
+    if (next == jit->codeSize)
+      emitJump(e, 0xE9, next);
+    i = next - 1;
+  }
+}
+
+/* Compiles the unit at entry, the program's if entry is 0 and a
+ * subroutine's otherwise, with the subroutines it calls. */
+int jitCompile(JitCode *jit, CodeAddress entry) {
+  Analysis a;
+  Emitter e;
+  CodeAddress i;
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t end;
+  int n = jit->codeSize + 1;
+  int u, ok;
+
+  if ((entry < 0) || (entry >= jit->codeSize))
+    return 0;
+  if (jit->native[entry] >= 0)
+    return 1;
+
+  a.unit = (int*) malloc(n * sizeof(int));
+  for (i = 0; i < n; i++)
+    a.unit[i] = -1;
+  a.target = (char*) calloc(n, sizeof(char));
+  a.entries = (CodeAddress*) malloc(n * sizeof(CodeAddress));
+  a.subroutine = (char*) malloc(n * sizeof(char));
+  a.work = (CodeAddress*) malloc(n * sizeof(CodeAddress));
+  ok = findUnits(jit, &a, entry);
+
+  e.jit = jit;
+  e.position = jit->regionUsed;
+  e.end = jit->regionSize;
+  e.overflow = 0;
+  e.fixups = (Fixup*) malloc(n * sizeof(Fixup));
+  e.fixupCount = 0;
+  e.errors = (ErrorSite*) malloc(n * sizeof(ErrorSite));
+  e.errorCount = 0;
+
+  if (ok) {
+    for (u = 0; u < a.unitCount; u++)
+      emitUnit(&e, &a, u);
+
+    // Each error sets its address and status and leaves
+    for (i = 0; (i < e.errorCount) && !e.overflow; i++) {
+      patchRel32(&e, e.errors[i].position, e.position);
+      emitMem(&e, 0, 0xC7, 0, CONTEXT(errorAddress));
+      emitDword(&e, e.errors[i].address);
+      if (e.errors[i].status >= 0)
+        emitMovImm(&e, RAX, e.errors[i].status);
+      emitByte(&e, 0xE9);
+      emitDword(&e, (int) ((long) jit->exitOffset - (long) (e.position + 4)));
+    }
+
+    ok = !e.overflow;
+    if (ok) {
+      for (i = 0; i < e.fixupCount; i++)
+        patchRel32(&e, e.fixups[i].position, jit->native[e.fixups[i].target]);
+      end = (e.position + page - 1) / page * page;
+      ok = (mprotect(jit->region + jit->regionUsed, end - jit->regionUsed, PROT_READ | PROT_EXEC) == 0);
+      if (ok)
+        jit->regionUsed = end;
+    }
+  }
+
+  for (i = 0; i < jit->codeSize; i++)
+    if (a.unit[i] >= 0) {
+      if (!ok)
+        jit->native[i] = -1;
+      else if (a.subroutine[a.unit[i]] && (a.entries[a.unit[i]] == i))
+        jit->subroutine[i] = 1;
+    }
+  free(a.unit);
+  free(a.target);
+  free(a.entries);
+  free(a.subroutine);
+  free(a.work);
+  free(e.fixups);
+  free(e.errors);
+  return ok;
+}
+
+/******************* Entering the code ******************************/
+
+void emitPush(Emitter *e, int reg) {
+  emitRex(e, 0, 0, NO_INDEX, reg);
+  emitByte(e, 0x50 | (reg & 7));
+}
+
+void emitPopRegister(Emitter *e, int reg) {
+  emitRex(e, 0, 0, NO_INDEX, reg);
+  emitByte(e, 0x58 | (reg & 7));
+}
+
+/* int enter(JitContext *context, void *code, int call): the state of the
+ * machine from the context, onto the native stack of the code, which is
+ * jumped to or, with call, called as a subroutine. The code leaves at
+ * halt, or at exit with the status in eax, saving the state. */
+void emitEnter(Emitter *e) {
+  emitPush(e, RBX);
+  emitPush(e, RBP);
+  emitPush(e, R12);
+  emitPush(e, R13);
+  emitPush(e, R14);
+  emitPush(e, R15);
+  emitRegisters(e, 1, 0x89, RDI, R15);
+  emitMem(e, 1, 0x89, RSP, CONTEXT(savedRsp));
+  emitMem(e, 1, 0x8B, RSP, CONTEXT(nativeStack));
+  emitMem(e, 1, 0x8B, RBX, CONTEXT(s));
+  emitMem(e, 1, 0x8B, R12, CONTEXT(b));
+  emitMem(e, 1, 0x8B, R13, CONTEXT(t));
+  emitMem(e, 0, 0x8B, R14, CONTEXT(top));
+  emitRegisters(e, 0, 0x85, RDX, RDX);
+  emitByte(e, 0x75);                      // jnz +2
+  emitByte(e, 2);
+  emitRegisters(e, 0, 0xFF, 4, RSI);            // jmp rsi
+  emitRegisters(e, 0, 0xFF, 2, RSI);            // call rsi
+  emitMovImm(e, RAX, JIT_RETURNED);
+  emitByte(e, 0xEB);                      // jmp +2
+  emitByte(e, 2);
+
+  e->jit->native[e->jit->codeSize] = e->position;
+  emitRegisters(e, 0, 0x31, RAX, RAX);          // xor eax, eax
+  e->jit->exitOffset = e->position;
+  emitMem(e, 1, 0x89, R12, CONTEXT(b));
+  emitMem(e, 1, 0x89, R13, CONTEXT(t));
+  emitMem(e, 0, 0x89, R14, CONTEXT(top));
+  emitMem(e, 1, 0x8B, RSP, CONTEXT(savedRsp));
+  emitPopRegister(e, R15);
+  emitPopRegister(e, R14);
+  emitPopRegister(e, R13);
+  emitPopRegister(e, R12);
+  emitPopRegister(e, RBP);
+  emitPopRegister(e, RBX);
+  emitByte(e, 0xC3);
+}
+
+int jitSupported(void) {
+  return 1;
+}
+
+/* The code of every subroutine nested in the frames of the stack takes
+ * 16 bytes of native stack, and each frame at least MIN_FRAME_SIZE
+ * words, so the stack machine overflows first. */
+JitCode* newJit(CodeBlock *codeBlock, int stackSize) {
+  JitCode *jit;
+  Emitter e;
+  size_t page = sysconf(_SC_PAGESIZE);
+  int i;
+
+  jit = (JitCode*) malloc(sizeof(JitCode));
+  jit->codeBlock = codeBlock;
+  jit->codeSize = codeBlock->codeSize;
+  jit->stackSize = stackSize;
+  jit->regionSize = ((size_t) (jit->codeSize + 1) * CODE_BYTES + (codeBlock->labelCount + 2) * page)
+    / page * page;
+  jit->region = (unsigned char*) mmap(NULL, jit->regionSize, PROT_READ | PROT_WRITE,
+                                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  jit->nativeStackSize = ((size_t) stackSize / MIN_FRAME_SIZE * 16 + NATIVE_MARGIN + page - 1) / page * page;
+  jit->nativeStackBase = (unsigned char*) mmap(NULL, jit->nativeStackSize + page, PROT_READ | PROT_WRITE,
+                                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if ((jit->region == MAP_FAILED) || (jit->nativeStackBase == MAP_FAILED)) {
+    if (jit->region != MAP_FAILED)
+      munmap(jit->region, jit->regionSize);
+    if (jit->nativeStackBase != MAP_FAILED)
+      munmap(jit->nativeStackBase, jit->nativeStackSize + page);
+    free(jit);
+    return NULL;
+  }
+  // A guard page under the native stack
+  mprotect(jit->nativeStackBase, page, PROT_NONE);
+
+  jit->native = (long*) malloc((jit->codeSize + 1) * sizeof(long));
+  for (i = 0; i <= jit->codeSize; i++)
+    jit->native[i] = -1;
+  jit->subroutine = (char*) calloc(jit->codeSize + 1, sizeof(char));
+
+  e.jit = jit;
+  e.position = 0;
+  e.end = page;
+  e.overflow = 0;
+  emitEnter(&e);
+  mprotect(jit->region, page, PROT_READ | PROT_EXEC);
+  jit->regionUsed = page;
+
+  jit->context.stackSize = stackSize;
+  jit->context.limit = stackSize - STACK_MARGIN;
+  jit->context.nativeStack = jit->nativeStackBase + page + jit->nativeStackSize;
+  return jit;
+}
+
+void freeJit(JitCode *jit) {
+  size_t page = sysconf(_SC_PAGESIZE);
+
+  munmap(jit->region, jit->regionSize);
+  munmap(jit->nativeStackBase, jit->nativeStackSize + page);
+  free(jit->native);
+  free(jit->subroutine);
+  free(jit);
+}
+
+int jitCompiled(JitCode *jit, CodeAddress address) {
+  return (address >= 0) && (address < jit->codeSize) && (jit->native[address] >= 0);
+}
+
+int enterJit(JitCode *jit, CodeAddress address, int call, WORD *s, int *b, int *t, WORD *top) {
+  JitContext *context = &(jit->context);
+  int status;
+
+  context->s = s;
+  context->b = *b;
+  context->t = *t;
+  context->top = *top;
+  context->errorAddress = 0;
+  status = ((EnterFunction) jit->region)(context, jit->region + jit->native[address], call);
+  *b = context->b;
+  *t = context->t;
+  *top = context->top;
+  vmErrorAddress = context->errorAddress;
+  return status;
+}
+
+int jitEnter(JitCode *jit, CodeAddress address, WORD *s, int *b, int *t, WORD *top) {
+  return enterJit(jit, address, 0, s, b, t, top);
+}
+
+int jitCall(JitCode *jit, CodeAddress entry, WORD *s, int *b, int *t, WORD *top) {
+  return enterJit(jit, entry, 1, s, b, t, top);
+}
+
+int runJit(JitCode *jit) {
+  WORD *memory;
+  WORD top = 0;
+  int b = 0, t = -1;
+  int status;
+
+  // s[-1] takes the top spilled by the first push
+  memory = (WORD*) calloc(jit->stackSize + 1, sizeof(WORD));
+  status = jitEnter(jit, 0, memory + 1, &b, &t, &top);
+  fflush(stdout);
+  free(memory);
+  return status;
+}
+
+#else
+
+int jitSupported(void) {
+  return 0;
+}
+
+JitCode* newJit(CodeBlock *codeBlock, int stackSize) {
+  return NULL;
+}
+
+void freeJit(JitCode *jit) {
+}
+
+int jitCompile(JitCode *jit, CodeAddress entry) {
+  return 0;
+}
+
+int jitCompiled(JitCode *jit, CodeAddress address) {
+  return 0;
+}
+
+int jitEnter(JitCode *jit, CodeAddress address, WORD *s, int *b, int *t, WORD *top) {
+  return VM_SUCCESS;
+}
+
+int jitCall(JitCode *jit, CodeAddress entry, WORD *s, int *b, int *t, WORD *top) {
+  return VM_SUCCESS;
+}
+
+int runJit(JitCode *jit) {
+  return VM_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __JIT_H__
+#define __JIT_H__
+
+#include "vm.h"
+
+/* Compiler from the stack machine of instructions.h to x86-64 machine
+ * code, for Linux. Every instruction becomes a fixed template of machine
+ * instructions over the memory of the stack machine: s is in rbx, b in
+ * r12, t in r13 and the top of the stack in r14d, and each template
+ * starts and ends with the machine in that state. A constant or local
+ * operand goes straight into the arithmetic or comparison after it, and
+ * a comparison into the FJ after it.
+ *
+ * The code is compiled a unit at a time: the body of the program or of
+ * a subroutine, from its entry to its returns, with the subroutines it
+ * calls. CALL becomes a native call and EP/EF a native return, so the
+ * return addresses in the frames are written but not read. The units
+ * are written to pages that are made executable only once written.
+ *
+ * The errors are those of vm.h, at the same addresses. Code kplc would
+ * not generate, such as a jump into another unit or a subroutine that
+ * does not start with its INT, is not compiled and the interpreter runs
+ * it instead. */
+
+typedef struct JitCode_ JitCode;
+
+#define JIT_RETURNED -1     // jitCall: the subroutine returned, not the machine stopped
+
+int jitSupported(void);
+JitCode* newJit(CodeBlock *codeBlock, int stackSize);   // NULL where there is no JIT
+void freeJit(JitCode *jit);
+int jitCompile(JitCode *jit, CodeAddress entry);        // 0 if the unit can't be compiled
+int jitCompiled(JitCode *jit, CodeAddress address);     // whether native code starts there
+
+/* The compiled code at address, on the stack machine s, b, t and top,
+ * which it leaves as it stopped. jitEnter runs the program's unit until
+ * the machine stops; jitCall runs the subroutine whose frame CALL has
+ * just set up, until it returns or the machine stops. The status is
+ * that of vm.h, or JIT_RETURNED. */
+int jitEnter(JitCode *jit, CodeAddress address, WORD *s, int *b, int *t, WORD *top);
+int jitCall(JitCode *jit, CodeAddress entry, WORD *s, int *b, int *t, WORD *top);
+int runJit(JitCode *jit);                               // the program, once address 0 is compiled
+
+#endif
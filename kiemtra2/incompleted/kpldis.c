@@ -0,0 +1,57 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "instructions.h"
+#include "regcode.h"
+
+/******************************************************************/
+
+int main(int argc, char *argv[]) {
+  CodeBlock *codeBlock;
+  RegCode *regCode;
+  char *fileName = NULL;
+  int mix = 0;
+  int registers = 0;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--mix") == 0)
+      mix = 1;
+    else if (strcmp(argv[i], "--reg") == 0)
+      registers = 1;
+    else fileName = argv[i];
+  }
+
+  if (fileName == NULL) {
+    printf("kpldis: no code file.\n");
+    return -1;
+  }
+
+  codeBlock = loadCode(fileName);
+  if (codeBlock == NULL) {
+    printf("Can\'t load code file!\n");
+    return -1;
+  }
+
+  if (registers) {
+    regCode = translateCode(codeBlock);
+    if (regCode == NULL) {
+      printf("Can\'t translate the code!\n");
+      freeCodeBlock(codeBlock);
+      return -1;
+    }
+    printRegCode(regCode);
+    freeRegCode(regCode);
+  } else if (mix)
+    printInstructionMix(codeBlock);
+  else printCodeBlock(codeBlock);
+  freeCodeBlock(codeBlock);
+  return 0;
+}
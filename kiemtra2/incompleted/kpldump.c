@@ -0,0 +1,32 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "symfile.h"
+#include "debug.h"
+
+/******************************************************************/
+
+int main(int argc, char *argv[]) {
+  SymFile *symFile;
+
+  if (argc <= 1) {
+    printf("kpldump: no symbol file.\n");
+    return -1;
+  }
+
+  symFile = loadSymFile(argv[1]);
+  if (symFile == NULL) {
+    printf("Can\'t load symbol file!\n");
+    return -1;
+  }
+
+  printSymFileObject(symFile, symFile->header->program, 0);
+  closeSymFile(symFile);
+  return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "incremental.h"
+#include "debug.h"
+
+extern SymTab* symtab;
+
+/* Replays edits on a program through the incremental reparser, as an
+ * editor's watch loop would, printing after each one how it was reparsed
+ * and then the symbol table, or the error.
+ *
+ * Each line of the edit file is OLD|NEW: the first occurrence of OLD in
+ * the current source is replaced by NEW. In both, \n stands for a line
+ * break. */
+
+#define MAX_EDIT_LEN 1024
+
+char* readFile(char *fileName, int *size) {
+  FILE *f = fopen(fileName, "rb");
+  char *text;
+  long length;
+
+  if (f == NULL)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  length = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  text = (char*) malloc(length + 1);
+  if (fread(text, 1, length, f) != (size_t) length) {
+    free(text);
+    fclose(f);
+    return NULL;
+  }
+  text[length] = '\0';
+  fclose(f);
+  *size = (int) length;
+  return text;
+}
+
+// Replace each \n of text by a line break, in place
+void unescape(char *text) {
+  char *from = text, *to = text;
+
+  while (*from != '\0') {
+    if ((from[0] == '\\') && (from[1] == 'n')) {
+      *to++ = '\n';
+      from += 2;
+    } else *to++ = *from++;
+  }
+  *to = '\0';
+}
+
+void printParse(IncrementalParse *parse) {
+  if (parse->valid)
+    printObject(symtab->program, 0);
+  else printf("%s", parse->diagnostic);
+  printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+  IncrementalParse *parse;
+  FILE *edits;
+  char line[MAX_EDIT_LEN];
+  char *source, *bar, *found;
+  int size, result, n = 0;
+
+  if (argc <= 2) {
+    printf("kpledit: no source or edit file.\n");
+    return -1;
+  }
+
+  source = readFile(argv[1], &size);
+  if (source == NULL) {
+    printf("Can\'t read input file!\n");
+    return -1;
+  }
+  edits = fopen(argv[2], "r");
+  if (edits == NULL) {
+    printf("Can\'t read edit file!\n");
+    free(source);
+    return -1;
+  }
+
+  parse = parseIncremental(source, size);
+  free(source);
+  printf("parse: %s\n", parse->valid ? "ok" : "error");
+  printParse(parse);
+
+  while (fgets(line, MAX_EDIT_LEN, edits) != NULL) {
+    line[strcspn(line, "\n")] = '\0';
+    bar = strchr(line, '|');
+    if (bar == NULL)
+      continue;
+    *bar = '\0';
+    unescape(line);
+    unescape(bar + 1);
+    n++;
+
+    found = strstr(parse->source, line);
+    if (found == NULL) {
+      printf("edit %d: not found\n\n", n);
+      continue;
+    }
+    result = applyEdit(parse, found - parse->source, strlen(line), bar + 1, strlen(bar + 1));
+    switch (result) {
+    case REPARSE_SUBROUTINE:
+      printf("edit %d: subroutine\n", n);
+      break;
+    case REPARSE_FULL:
+      printf("edit %d: full\n", n);
+      break;
+    default:
+      printf("edit %d: error\n", n);
+      break;
+    }
+    printParse(parse);
+  }
+
+  fclose(edits);
+  freeIncrementalParse(parse);
+  return 0;
+}
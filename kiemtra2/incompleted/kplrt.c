@@ -0,0 +1,140 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "kplrt.h"
+#include "vm.h"
+#include "reduce.h"
+
+#define MIN_FRAME_SIZE 4          // RESERVED_WORDS of symtab.h, which every subroutine's INT reserves
+#define NATIVE_MARGIN 65536       // bytes of native stack for the functions below
+
+WORD *kplMemory;
+long kplStackSize;
+long kplStackLimit;
+WORD kplValue;
+CodeAddress kplErrorAddress;
+
+// Those of vm.c, which the program does not link
+char *kplErrorMessages[] = {
+  "Success",
+  "Stack overflow",
+  "Address out of memory",
+  "Division by zero",
+  "Invalid input",
+  "Jump out of the code"
+};
+
+/******************* Called from the program ******************************/
+
+int kplCopy(WORD a, WORD from, WORD count) {
+  unsigned size = kplStackSize - count;
+
+  if (((unsigned) a > size) || ((unsigned) from > size))
+    return VM_BAD_ADDRESS;
+  memmove(kplMemory + a, kplMemory + from, count * sizeof(WORD));
+  return VM_SUCCESS;
+}
+
+int kplSum(WORD a, WORD count) {
+  if ((count < 0) || ((unsigned) a > (unsigned) kplStackSize) || (count > kplStackSize - a))
+    return VM_BAD_ADDRESS;
+  kplValue = sumWords(kplMemory + a, count);
+  return VM_SUCCESS;
+}
+
+int kplReadChar(void) {
+  char ch;
+
+  if (scanf(" %c", &ch) != 1)
+    return VM_BAD_INPUT;
+  kplValue = (unsigned char) ch;
+  return VM_SUCCESS;
+}
+
+int kplReadInt(void) {
+  if (scanf("%d", &kplValue) != 1)
+    return VM_BAD_INPUT;
+  return VM_SUCCESS;
+}
+
+void kplWriteChar(WORD x) {
+  putchar(x);
+}
+
+void kplWriteInt(WORD x) {
+  printf("%d", x);
+}
+
+void kplWriteLn(void) {
+  putchar('\n');
+}
+
+/******************************************************************/
+
+double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/* The code of every subroutine nested in the frames of the stack takes
+ * 16 bytes of native stack, and each frame at least MIN_FRAME_SIZE
+ * words, so the stack machine overflows first. */
+int main(int argc, char *argv[]) {
+  char *nativeStack;
+  long stackSize = DEFAULT_STACK_SIZE;
+  long nativeSize;
+  int timing = 0;
+  int i, status;
+  double start;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--time") == 0)
+      timing = 1;
+    else if ((strcmp(argv[i], "--stack") == 0) && (i + 1 < argc))
+      stackSize = atol(argv[++i]);
+    else {
+      printf("%s: unknown option %s.\n", argv[0], argv[i]);
+      return -1;
+    }
+  }
+
+  if (stackSize <= STACK_MARGIN) {
+    printf("%s: the stack needs more than %d words.\n", argv[0], STACK_MARGIN);
+    return -1;
+  }
+
+  // s[-1] takes the top spilled by the first push
+  kplMemory = (WORD*) calloc(stackSize + 1, sizeof(WORD));
+  nativeSize = (stackSize / MIN_FRAME_SIZE * 16 + NATIVE_MARGIN + 15) / 16 * 16;
+  nativeStack = (char*) malloc(nativeSize + 16);
+  if ((kplMemory == NULL) || (nativeStack == NULL)) {
+    printf("%s: can\'t allocate the stack.\n", argv[0]);
+    return -1;
+  }
+  kplMemory++;
+  kplStackSize = stackSize;
+  kplStackLimit = stackSize - STACK_MARGIN;
+
+  start = now();
+  status = kplRun(kplMemory, (void*) (((unsigned long) nativeStack + nativeSize) & ~15UL));
+  fflush(stdout);
+  if (timing)
+    fprintf(stderr, "%s: %.3f s (compiled)\n", argv[0], now() - start);
+  free(kplMemory - 1);
+  free(nativeStack);
+
+  if (status != VM_SUCCESS) {
+    printf("Runtime error at %d: %s!\n", kplErrorAddress, kplErrorMessages[status]);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,46 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __KPLRT_H__
+#define __KPLRT_H__
+
+#include "instructions.h"
+
+/* Runtime of the programs kplc -S compiles to assembly and kplc
+ * --emit-c to C. Its main allocates the memory of the stack machine and
+ * a native stack, which the C does not use, runs kplRun and reports the
+ * error it stops with as kplrun does. The program calls the functions
+ * below, which return a status of vm.h where they can fail and leave
+ * what they read or sum in kplValue.
+ *
+ * The compiled program is linked with kplrt.o alone, and -pthread for
+ * the threads SUM may start:
+ *
+ *     kplc -S prog.kpl -o prog.s
+ *     gcc prog.s kplrt.o -pthread -o prog
+ *
+ *     kplc prog.kpl --emit-c prog.c
+ *     gcc -O2 prog.c kplrt.o -pthread -o prog
+ *
+ * and takes the options --stack WORDS and --time of kplrun. */
+
+extern long kplStackSize;
+extern long kplStackLimit;
+extern WORD kplValue;
+extern CodeAddress kplErrorAddress;
+
+// The program, on the memory s, with nativeStack the top of the stack the assembly runs on
+int kplRun(WORD *s, void *nativeStack);
+
+int kplCopy(WORD a, WORD from, WORD count);
+int kplSum(WORD a, WORD count);
+int kplReadChar(void);
+int kplReadInt(void);
+void kplWriteChar(WORD x);
+void kplWriteInt(WORD x);
+void kplWriteLn(void);
+
+#endif
@@ -0,0 +1,139 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "reader.h"
+#include "vm.h"
+#include "regvm.h"
+#include "jit.h"
+
+double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/******************************************************************/
+
+int main(int argc, char *argv[]) {
+  CodeBlock *codeBlock;
+  RegCode *regCode = NULL;
+  JitCode *jit = NULL;
+  char *fileName = NULL;
+  char *profileName = NULL;
+  int stackSize = DEFAULT_STACK_SIZE;
+  int timing = 0;
+  int registers = 0;
+  int plain = 0;
+  int native = 0;
+  int tiered = 1;
+  int i, status;
+  double start;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--time") == 0)
+      timing = 1;
+    else if (strcmp(argv[i], "--reg") == 0)
+      registers = 1;
+    else if (strcmp(argv[i], "--plain") == 0)
+      plain = 1;
+    else if (strcmp(argv[i], "--jit") == 0)
+      native = 1;
+    else if (strcmp(argv[i], "--interp") == 0)
+      tiered = 0;
+    else if ((strcmp(argv[i], "--profile") == 0) && (i + 1 < argc))
+      profileName = argv[++i];
+    else if ((strcmp(argv[i], "--stack") == 0) && (i + 1 < argc))
+      stackSize = atoi(argv[++i]);
+    else fileName = argv[i];
+  }
+
+  if (fileName == NULL) {
+    printf("kplrun: no code file.\n");
+    return -1;
+  }
+
+  if (stackSize <= STACK_MARGIN) {
+    printf("kplrun: the stack needs more than %d words.\n", STACK_MARGIN);
+    return -1;
+  }
+
+  if (native && registers) {
+    printf("kplrun: the JIT compiles the stack code, not the register code.\n");
+    return -1;
+  }
+
+  if ((profileName != NULL) && (registers || native || !vmProfiling())) {
+    printf("kplrun: profiles come from the stack machine of kplrun-profile.\n");
+    return -1;
+  }
+
+  codeBlock = loadCode(fileName);
+  if (codeBlock == NULL) {
+    printf("Can\'t load code file!\n");
+    return -1;
+  }
+  if (plain)
+    defuseCode(codeBlock);
+
+  // The register code is translated when it is loaded, before the clock starts
+  if (registers) {
+    regCode = translateCode(codeBlock);
+    if (regCode == NULL) {
+      printf("Can\'t translate the code!\n");
+      freeCodeBlock(codeBlock);
+      return -1;
+    }
+  }
+
+  // So is the native code, or the interpreter runs what can't be compiled
+  if (native) {
+    jit = newJit(codeBlock, stackSize);
+    if ((jit == NULL) || !jitCompile(jit, 0)) {
+      fprintf(stderr, "kplrun: can\'t compile %s to native code, interpreting it.\n", fileName);
+      native = 0;
+    }
+  }
+
+  start = now();
+  if (native)
+    status = runJit(jit);
+  else if (registers)
+    status = runRegCode(regCode, stackSize);
+  else if (tiered)
+    status = runTiered(codeBlock, stackSize);
+  else status = runCode(codeBlock, stackSize);
+  if (timing) {
+    if (native)
+      fprintf(stderr, "%s: %.3f s (native code)\n", fileName, now() - start);
+    else {
+      fprintf(stderr, "%s: %.3f s (%s machine, %s dispatch", fileName, now() - start,
+              registers ? "register" : "stack", vmDispatchName());
+      if (vmDispatchCount >= 0)
+        fprintf(stderr, ", %ld instructions", vmDispatchCount);
+      else if (!registers && tiered && jitSupported())
+        fprintf(stderr, ", tiered");
+      fprintf(stderr, ")\n");
+    }
+  }
+  if ((profileName != NULL) && (saveProfile(codeBlock, profileName) != IO_SUCCESS))
+    printf("Can\'t write profile %s!\n", profileName);
+  if (regCode != NULL)
+    freeRegCode(regCode);
+  if (jit != NULL)
+    freeJit(jit);
+  freeCodeBlock(codeBlock);
+
+  if (status != VM_SUCCESS) {
+    printf("Runtime error at %d: %s!\n", vmErrorAddress, vmErrorMessage(status));
+    return -1;
+  }
+  return 0;
+}
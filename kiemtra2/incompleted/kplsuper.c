@@ -0,0 +1,206 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "instructions.h"
+
+#define DEFAULT_MAX_SUPEROPS 12
+#define MIN_SAVING 1000     // a superinstruction saves at least 1/MIN_SAVING of the dispatches
+#define MAX_LINE 256
+
+struct Sequence_ {
+  enum OpCode ops[MAX_SUPEROP_LENGTH];
+  int length;
+  long count;               // runs not yet taken by a chosen sequence
+  long saving;              // dispatches saved when chosen
+};
+
+typedef struct Sequence_ Sequence;
+
+Sequence *sequences = NULL;
+int sequenceCount = 0;
+int sequenceMax = 0;
+long totalCount = 0;
+
+int findOpCode(char *name) {
+  int op;
+
+  for (op = 0; op < PLAIN_OP_COUNT; op++)
+    if (strcmp(opCodeName(op), name) == 0)
+      return op;
+  return -1;
+}
+
+void addSequence(Sequence *sequence) {
+  int i;
+
+  for (i = 0; i < sequenceCount; i++)
+    if ((sequences[i].length == sequence->length) &&
+        (memcmp(sequences[i].ops, sequence->ops, sequence->length * sizeof(enum OpCode)) == 0)) {
+      sequences[i].count += sequence->count;
+      return;
+    }
+  if (sequenceCount == sequenceMax) {
+    sequenceMax = (sequenceMax == 0) ? 64 : sequenceMax * 2;
+    sequences = (Sequence*) realloc(sequences, sequenceMax * sizeof(Sequence));
+  }
+  sequences[sequenceCount++] = *sequence;
+}
+
+// The lines "op NAME COUNT" and "seq NAME... COUNT" of a profile
+int readProfile(char *fileName) {
+  char line[MAX_LINE];
+  char *word, *words[MAX_SUPEROP_LENGTH + 2];
+  Sequence sequence;
+  FILE *f;
+  int n, i, op;
+
+  f = fopen(fileName, "r");
+  if (f == NULL)
+    return 0;
+  while (fgets(line, MAX_LINE, f) != NULL) {
+    n = 0;
+    for (word = strtok(line, " \n"); (word != NULL) && (n < MAX_SUPEROP_LENGTH + 2); word = strtok(NULL, " \n"))
+      words[n++] = word;
+    if ((n == 3) && (strcmp(words[0], "op") == 0))
+      totalCount += atol(words[2]);
+    else if ((n >= 4) && (strcmp(words[0], "seq") == 0)) {
+      sequence.length = n - 2;
+      for (i = 0; i < sequence.length; i++) {
+        op = findOpCode(words[i + 1]);
+        if ((op < 0) || !canFuse(op, i == sequence.length - 1))
+          break;
+        sequence.ops[i] = op;
+      }
+      if (i < sequence.length)
+        continue;
+      for (; i < MAX_SUPEROP_LENGTH; i++)
+        sequence.ops[i] = OP_NONE;
+      sequence.count = atol(words[n - 1]);
+      sequence.saving = 0;
+      addSequence(&sequence);
+    }
+  }
+  fclose(f);
+  return 1;
+}
+
+// Whether inner runs whenever outer does
+int contains(Sequence *outer, Sequence *inner) {
+  int offset;
+
+  for (offset = 0; offset + inner->length <= outer->length; offset++)
+    if (memcmp(outer->ops + offset, inner->ops, inner->length * sizeof(enum OpCode)) == 0)
+      return 1;
+  return 0;
+}
+
+/* Greedily, the sequence that saves the most dispatches. Its runs no
+ * longer count for the sequences inside it, which fuseCode will not
+ * find there. */
+int chooseSequences(int maxSuperops) {
+  Sequence chosen;
+  int count, best, i;
+
+  for (count = 0; count < maxSuperops; count++) {
+    best = -1;
+    for (i = count; i < sequenceCount; i++)
+      if ((best < 0) || (sequences[i].count * (sequences[i].length - 1) >
+                         sequences[best].count * (sequences[best].length - 1)))
+        best = i;
+    if ((best < 0) || (sequences[best].count * (sequences[best].length - 1) * MIN_SAVING < totalCount) ||
+        (sequences[best].count == 0))
+      break;
+
+    chosen = sequences[best];
+    chosen.saving = chosen.count * (chosen.length - 1);
+    sequences[best] = sequences[count];
+    sequences[count] = chosen;
+    for (i = count + 1; i < sequenceCount; i++)
+      if (contains(&chosen, &sequences[i]))
+        sequences[i].count = (sequences[i].count > chosen.count) ? sequences[i].count - chosen.count : 0;
+  }
+  return count;
+}
+
+// The longest first, as fuseCode tries them in order
+int compareSequences(const void *p1, const void *p2) {
+  const Sequence *s1 = (const Sequence*) p1, *s2 = (const Sequence*) p2;
+
+  if (s1->length != s2->length)
+    return s2->length - s1->length;
+  return (s1->saving < s2->saving) - (s1->saving > s2->saving);
+}
+
+unsigned hashSequences(int count) {
+  unsigned hash = 2166136261u;
+  int i, j;
+
+  for (i = 0; i < count; i++) {
+    hash = (hash ^ (unsigned) sequences[i].length) * 16777619u;
+    for (j = 0; j < sequences[i].length; j++)
+      hash = (hash ^ (unsigned) sequences[i].ops[j]) * 16777619u;
+  }
+  return hash & 0x7FFFFFFF;
+}
+
+void printSuperops(int count, char **fileNames, int fileCount) {
+  char name[MAX_LINE];
+  int i, j;
+
+  printf("/*\n * Generated by kplsuper from");
+  for (i = 0; i < fileCount; i++)
+    printf(" %s", fileNames[i]);
+  printf(".\n * SUPEROP(name, length, op1, op2, op3, op4), tried in this order.\n */\n\n");
+  printf("#define SUPEROP_SET 0x%08X\n\n", count > 0 ? hashSequences(count) : 0);
+  printf("#ifdef SUPEROP\n");
+  for (i = 0; i < count; i++) {
+    name[0] = '\0';
+    for (j = 0; j < sequences[i].length; j++) {
+      if (j > 0)
+        strcat(name, "_");
+      strcat(name, opCodeName(sequences[i].ops[j]));
+    }
+    printf("SUPEROP(%s, %d", name, sequences[i].length);
+    for (j = 0; j < MAX_SUPEROP_LENGTH; j++)
+      printf(", %s", (j < sequences[i].length) ? opCodeName(sequences[i].ops[j]) : "NONE");
+    printf(")   // %ld of %ld dispatches\n", sequences[i].saving, totalCount);
+  }
+  printf("#endif\n");
+}
+
+/******************************************************************/
+
+int main(int argc, char *argv[]) {
+  int maxSuperops = DEFAULT_MAX_SUPEROPS;
+  int first = 1;
+  int i, count;
+
+  if ((argc > 2) && (strcmp(argv[1], "--max") == 0)) {
+    maxSuperops = atoi(argv[2]);
+    first = 3;
+  }
+
+  if (first >= argc) {
+    printf("kplsuper: no profile.\n");
+    return -1;
+  }
+
+  for (i = first; i < argc; i++)
+    if (!readProfile(argv[i])) {
+      printf("Can\'t read profile %s!\n", argv[i]);
+      return -1;
+    }
+
+  count = chooseSequences(maxSuperops);
+  qsort(sequences, count, sizeof(Sequence), compareSequences);
+  printSuperops(count, argv + first, argc - first);
+  free(sequences);
+  return 0;
+}
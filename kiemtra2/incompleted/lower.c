@@ -0,0 +1,778 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lower.h"
+#include "symtab.h"
+
+// How a value is lowered
+#define LOWER_DEAD 0        // not at all: nothing uses it
+#define LOWER_NONE 1        // no value, emitted where it is
+#define LOWER_DROP 2        // emitted where it is, its value dropped
+#define LOWER_INLINE 3      // emitted where its one user takes it
+#define LOWER_REMAT 4       // emitted again wherever it is used
+#define LOWER_SLOT 5        // stored in a word of the frame where it is, loaded where it is used
+
+#define MAX_REMAT_COST 3    // instructions
+#define MAX_THREADED_JUMPS 8
+
+#define BITS 32
+#define TEST_BIT(set, i) (((set)[(i) / BITS] >> ((i) % BITS)) & 1u)
+#define SET_BIT(set, i) ((set)[(i) / BITS] |= 1u << ((i) % BITS))
+#define CLEAR_BIT(set, i) ((set)[(i) / BITS] &= ~(1u << ((i) % BITS)))
+
+/* The values in words are found where they are used and defined by
+ * emitting the code of the function a first time without the code: each
+ * block is a point, and so is each edge out of it, where the phis of the
+ * successor take their values. */
+
+struct LowerEvents_ {
+  int *events;              // node * 2 for a use, node * 2 + 1 for a definition
+  int count;
+  int max;
+};
+
+typedef struct LowerEvents_ LowerEvents;
+
+IrFunction *lowerFn;
+CodeBlock *lowerCode;
+int lowerRecording;
+int lowerPoint;             // block * 3, then + 1 + succ for its edges
+int lowerFrameSize;
+
+char *lowerKinds;           // by value id
+int *lowerNodes;            // by value id, the node of a value in a word, -1 for the others
+IrInstr **lowerValues;      // by node
+int lowerNodeCount;
+int *lowerParents;          // of the nodes coalesced into one
+int *lowerMembers;          // the next node of the same class, round
+int *lowerWords;            // by class, the word of the frame
+unsigned *lowerInterference;
+int lowerRowWords;
+LowerEvents *lowerEvents;   // by point
+IrInstr **lowerCopied;
+
+int *lowerBlockIndex;       // by block id, its place in the function
+CodeAddress *lowerBlockAddresses;
+CodeAddress *lowerJumps;
+int *lowerJumpTargets;
+int lowerJumpCount;
+int lowerJumpMax;
+CodeAddress *lowerTrampolines;  // the FJs whose edge needs copies, by block
+CodeAddress *lowerCalls;
+int lowerCallCount;
+int lowerCallMax;
+
+/******************* Emission ******************************/
+
+enum OpCode lowerOpCode(enum IrOp op) {
+  switch (op) {
+  case IR_LI:
+    return OP_LI;
+  case IR_SUM:
+    return OP_SUM;
+  case IR_AD:
+    return OP_AD;
+  case IR_SB:
+    return OP_SB;
+  case IR_ML:
+    return OP_ML;
+  case IR_DV:
+    return OP_DV;
+  case IR_NEG:
+    return OP_NEG;
+  case IR_EQ:
+    return OP_EQ;
+  case IR_NE:
+    return OP_NE;
+  case IR_GT:
+    return OP_GT;
+  case IR_LT:
+    return OP_LT;
+  case IR_GE:
+    return OP_GE;
+  case IR_LE:
+    return OP_LE;
+  case IR_RC:
+    return OP_RC;
+  case IR_RI:
+    return OP_RI;
+  case IR_ST:
+    return OP_ST;
+  case IR_WRC:
+    return OP_WRC;
+  case IR_WRI:
+    return OP_WRI;
+  case IR_WLN:
+    return OP_WLN;
+  case IR_EP:
+    return OP_EP;
+  case IR_EF:
+    return OP_EF;
+  default:
+    return OP_HL;
+  }
+}
+
+CodeAddress lowerEmit(enum OpCode op, WORD p, WORD q) {
+  if (lowerRecording)
+    return 0;
+  return emitCode(lowerCode, op, p, q);
+}
+
+void lowerEvent(IrInstr *value, int definition) {
+  LowerEvents *events = &lowerEvents[lowerPoint];
+  int node = lowerNodes[value->id];
+
+  if (!lowerRecording || (node < 0))
+    return;
+  if (events->count == events->max) {
+    events->max = (events->max == 0) ? 8 : events->max * 2;
+    events->events = (int*) realloc(events->events, events->max * sizeof(int));
+  }
+  events->events[events->count++] = node * 2 + definition;
+}
+
+int lowerFind(int node) {
+  while (lowerParents[node] != node) {
+    lowerParents[node] = lowerParents[lowerParents[node]];
+    node = lowerParents[node];
+  }
+  return node;
+}
+
+WORD lowerWordOf(IrInstr *value) {
+  if (lowerRecording)
+    return 0;
+  return lowerWords[lowerFind(lowerNodes[value->id])];
+}
+
+void lowerJump(enum OpCode op, IrBlock *target) {
+  CodeAddress address = lowerEmit(op, 0, 0);
+
+  if (lowerRecording)
+    return;
+  if (lowerJumpCount == lowerJumpMax) {
+    lowerJumpMax = (lowerJumpMax == 0) ? 16 : lowerJumpMax * 2;
+    lowerJumps = (CodeAddress*) realloc(lowerJumps, lowerJumpMax * sizeof(CodeAddress));
+    lowerJumpTargets = (int*) realloc(lowerJumpTargets, lowerJumpMax * sizeof(int));
+  }
+  lowerJumps[lowerJumpCount] = address;
+  lowerJumpTargets[lowerJumpCount++] = lowerBlockIndex[target->id];
+}
+
+void lowerOperation(IrInstr *instr);
+
+// Pushes a value
+void lowerValue(IrInstr *value) {
+  if (lowerKinds[value->id] == LOWER_SLOT) {
+    lowerEvent(value, 0);
+    lowerEmit(OP_LV, 0, lowerWordOf(value));
+  } else lowerOperation(value);
+}
+
+// Emits an instruction after its arguments
+void lowerOperation(IrInstr *instr) {
+  CodeAddress address;
+  int k;
+
+  switch (instr->op) {
+  case IR_CONST:
+    lowerEmit(OP_LC, 0, instr->q);
+    break;
+  case IR_UNDEF:
+    lowerEmit(OP_LC, 0, 0);
+    break;
+  case IR_LA:
+    lowerEmit(OP_LA, instr->p, instr->q);
+    break;
+  case IR_LV:
+    lowerEmit(OP_LV, instr->p, instr->q);
+    break;
+  case IR_CALL:
+    lowerEmit(OP_INT, 0, RESERVED_WORDS);
+    for (k = RESERVED_WORDS; k < instr->argCount; k++)
+      lowerValue(instr->args[k]);
+    lowerEmit(OP_DCT, 0, instr->argCount);
+    // To the label, until the function there has its address
+    address = lowerEmit(OP_CALL, instr->p, instr->q);
+    if (lowerRecording)
+      break;
+    if (lowerCallCount == lowerCallMax) {
+      lowerCallMax = (lowerCallMax == 0) ? 16 : lowerCallMax * 2;
+      lowerCalls = (CodeAddress*) realloc(lowerCalls, lowerCallMax * sizeof(CodeAddress));
+    }
+    lowerCalls[lowerCallCount++] = address;
+    break;
+  case IR_CP:
+    lowerValue(instr->args[0]);
+    lowerValue(instr->args[1]);
+    lowerEmit(OP_CP, 0, instr->q);
+    break;
+  default:
+    for (k = 0; k < instr->argCount; k++)
+      lowerValue(instr->args[k]);
+    lowerEmit(lowerOpCode(instr->op), 0, 0);
+    break;
+  }
+}
+
+// Emits an instruction that is not part of another's operands
+void lowerRoot(IrInstr *instr) {
+  switch (lowerKinds[instr->id]) {
+  case LOWER_NONE:
+    lowerOperation(instr);
+    break;
+  case LOWER_DROP:
+    lowerOperation(instr);
+    lowerEmit(OP_DCT, 0, 1);
+    break;
+  case LOWER_SLOT:
+    if (instr->op == IR_ENTRY)
+      lowerEvent(instr, 1);
+    else if (instr->op != IR_PHI) {
+      lowerEmit(OP_LA, 0, lowerWordOf(instr));
+      lowerOperation(instr);
+      lowerEvent(instr, 1);
+      lowerEmit(OP_ST, 0, 0);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+/* The phis of successor succ of block take their arguments all at once:
+ * every address and value is pushed before the first is stored. Returns
+ * how many words are stored, emitting them only if emitting is set. */
+int lowerCopies(IrBlock *block, int succ, int emitting) {
+  IrBlock *to = block->succs[succ];
+  IrInstr *phi, *arg;
+  int k = irPredIndex(to, block);
+  int count = 0, c;
+
+  for (phi = to->first; (phi != NULL) && (phi->op == IR_PHI); phi = phi->next) {
+    arg = phi->args[k];
+    if ((lowerKinds[phi->id] != LOWER_SLOT) || (arg->op == IR_UNDEF))
+      continue;
+    if (!lowerRecording && (lowerKinds[arg->id] == LOWER_SLOT) && (lowerWordOf(arg) == lowerWordOf(phi)))
+      continue;
+    if (emitting) {
+      lowerEmit(OP_LA, 0, lowerWordOf(phi));
+      lowerValue(arg);
+    }
+    lowerCopied[count++] = phi;
+  }
+  if (emitting)
+    for (c = count - 1; c >= 0; c--) {
+      lowerEvent(lowerCopied[c], 1);
+      lowerEmit(OP_ST, 0, 0);
+    }
+  return count;
+}
+
+void lowerBlock(int b) {
+  IrBlock *block = lowerFn->blocks[b];
+  IrBlock *next = (b + 1 < lowerFn->blockCount) ? lowerFn->blocks[b + 1] : NULL;
+  IrInstr *last = block->last;
+  IrInstr *instr;
+
+  lowerPoint = b * 3;
+  if (!lowerRecording)
+    lowerBlockAddresses[b] = lowerCode->codeSize;
+  if (b == 0)
+    lowerEmit(OP_INT, 0, lowerFrameSize);
+  for (instr = block->first; instr != last; instr = instr->next)
+    lowerRoot(instr);
+
+  if (last->op == IR_FJ) {
+    lowerValue(last->args[0]);
+    if (lowerRecording) {
+      lowerPoint = b * 3 + 2;
+      lowerCopies(block, 1, 1);
+    } else if (lowerCopies(block, 1, 0) > 0)
+      // To copies of its own at the end of the function
+      lowerTrampolines[b] = lowerEmit(OP_FJ, 0, 0);
+    else lowerJump(OP_FJ, block->succs[1]);
+  } else if (last->op != IR_J) {
+    lowerOperation(last);
+    return;
+  }
+  lowerPoint = b * 3 + 1;
+  lowerCopies(block, 0, 1);
+  if (block->succs[0] != next)
+    lowerJump(OP_J, block->succs[0]);
+}
+
+/******************* Kinds ******************************/
+
+// Whether the instruction must keep its place among the others that do
+int lowerOrdered(IrInstr *instr) {
+  return (instr->op != IR_PHI) && !irIsTerminator(instr->op) && !irIsPure(instr);
+}
+
+void lowerClassify(IrBlock **order, int blockCount) {
+  IrUses *uses = irComputeUses(lowerFn);
+  int *costs = (int*) calloc(lowerFn->valueCount, sizeof(int));
+  IrInstr *instr, *arg, *user;
+  int b, k, id, useCount, cost, remat;
+
+  for (b = 0; b < blockCount; b++)
+    for (instr = order[b]->first; instr != NULL; instr = instr->next) {
+      id = instr->id;
+      useCount = uses->starts[id + 1] - uses->starts[id];
+      if (instr->type == IRT_NONE)
+        lowerKinds[id] = LOWER_NONE;
+      else if ((instr->op == IR_CONST) || (instr->op == IR_LA) || (instr->op == IR_UNDEF)) {
+        lowerKinds[id] = LOWER_REMAT;
+        costs[id] = 1;
+      } else if (useCount == 0)
+        lowerKinds[id] = irIsPure(instr) ? LOWER_DEAD : LOWER_DROP;
+      else if ((instr->op == IR_ENTRY) || (instr->op == IR_PHI))
+        lowerKinds[id] = LOWER_SLOT;
+      else {
+        cost = 1;
+        remat = irIsPure(instr);
+        // Over the words of its arguments, or their own operations again
+        for (k = 0; k < instr->argCount; k++) {
+          arg = instr->args[k];
+          if (lowerKinds[arg->id] == LOWER_REMAT)
+            cost += costs[arg->id];
+          else if (lowerKinds[arg->id] == LOWER_SLOT)
+            cost++;
+          else remat = 0;
+        }
+        user = uses->users[uses->starts[id]];
+        if (remat && (cost <= MAX_REMAT_COST)) {
+          lowerKinds[id] = LOWER_REMAT;
+          costs[id] = cost;
+        } else if ((useCount == 1) && (user->op != IR_PHI) && (user->block == instr->block))
+          lowerKinds[id] = LOWER_INLINE;
+        else lowerKinds[id] = LOWER_SLOT;
+      }
+    }
+  irFreeUses(uses);
+  free(costs);
+}
+
+// Whether the ordered instructions of the operands of instr, and instr, come next in ordered
+int lowerCheckTree(IrInstr *instr, IrInstr **ordered, int orderedCount, int *position) {
+  int k;
+
+  for (k = 0; k < instr->argCount; k++)
+    if ((lowerKinds[instr->args[k]->id] == LOWER_INLINE) &&
+        !lowerCheckTree(instr->args[k], ordered, orderedCount, position))
+      return 0;
+  if (lowerOrdered(instr)) {
+    if ((*position >= orderedCount) || (ordered[*position] != instr))
+      return 0;
+    (*position)++;
+  }
+  return 1;
+}
+
+// The ordered operands of instr go to words, and are emitted where they are
+int lowerDemote(IrInstr *instr) {
+  IrInstr *arg;
+  int k, count = 0;
+
+  for (k = 0; k < instr->argCount; k++) {
+    arg = instr->args[k];
+    if (lowerKinds[arg->id] != LOWER_INLINE)
+      continue;
+    count += lowerDemote(arg);
+    if (lowerOrdered(arg)) {
+      lowerKinds[arg->id] = LOWER_SLOT;
+      count++;
+    }
+  }
+  return count;
+}
+
+/* An operand emitted where its user is moves past whatever comes
+ * between them: the instructions that read or write memory, read input
+ * or may fail must still run in the order they are in. */
+int lowerOrderBlock(IrBlock *block) {
+  IrInstr **ordered;
+  IrInstr *instr;
+  int orderedCount = 0, position, demoted, kind;
+
+  for (instr = block->first; instr != NULL; instr = instr->next)
+    if (lowerOrdered(instr))
+      orderedCount++;
+  ordered = (IrInstr**) malloc((orderedCount + 1) * sizeof(IrInstr*));
+  orderedCount = 0;
+  for (instr = block->first; instr != NULL; instr = instr->next)
+    if (lowerOrdered(instr))
+      ordered[orderedCount++] = instr;
+
+  for (;;) {
+    position = 0;
+    for (instr = block->first; instr != NULL; instr = instr->next) {
+      kind = lowerKinds[instr->id];
+      if ((kind == LOWER_INLINE) || (kind == LOWER_REMAT) || (kind == LOWER_DEAD))
+        continue;
+      if (!lowerCheckTree(instr, ordered, orderedCount, &position))
+        break;
+    }
+    if (instr == NULL)
+      break;
+    demoted = lowerDemote(instr);
+    if ((position < orderedCount) && (lowerKinds[ordered[position]->id] == LOWER_INLINE)) {
+      lowerKinds[ordered[position]->id] = LOWER_SLOT;
+      demoted++;
+    }
+    if (demoted == 0)
+      break;
+  }
+  free(ordered);
+  return instr == NULL;
+}
+
+/******************* Words ******************************/
+
+int lowerSuccessors(int point, int *succs) {
+  IrBlock *block = lowerFn->blocks[point / 3];
+  int part = point % 3;
+
+  if (part == 0) {
+    succs[0] = point + 1;
+    succs[1] = point + 2;
+    return block->succCount;
+  }
+  if (part - 1 >= block->succCount)
+    return 0;
+  succs[0] = lowerBlockIndex[block->succs[part - 1]->id] * 3;
+  return 1;
+}
+
+// The values live after point, from those live into its successors
+void lowerLiveOut(unsigned *liveIn, int point, unsigned *live) {
+  int succs[2];
+  int count, s, w;
+
+  memset(live, 0, lowerRowWords * sizeof(unsigned));
+  count = lowerSuccessors(point, succs);
+  for (s = 0; s < count; s++)
+    for (w = 0; w < lowerRowWords; w++)
+      live[w] |= liveIn[succs[s] * lowerRowWords + w];
+}
+
+void lowerInterfere(int a, int b) {
+  if (a == b)
+    return;
+  SET_BIT(lowerInterference + a * lowerRowWords, b);
+  SET_BIT(lowerInterference + b * lowerRowWords, a);
+}
+
+void lowerComputeInterference(void) {
+  int points = lowerFn->blockCount * 3;
+  unsigned *liveIn = (unsigned*) calloc(points * lowerRowWords + 1, sizeof(unsigned));
+  unsigned *live = (unsigned*) malloc((lowerRowWords + 1) * sizeof(unsigned));
+  LowerEvents *events;
+  int point, e, node, u, w, changed = 1;
+
+  while (changed) {
+    changed = 0;
+    for (point = points - 1; point >= 0; point--) {
+      lowerLiveOut(liveIn, point, live);
+      events = &lowerEvents[point];
+      for (e = events->count - 1; e >= 0; e--) {
+        node = events->events[e] / 2;
+        if (events->events[e] % 2)
+          CLEAR_BIT(live, node);
+        else SET_BIT(live, node);
+      }
+      if (memcmp(live, liveIn + point * lowerRowWords, lowerRowWords * sizeof(unsigned)) != 0) {
+        memcpy(liveIn + point * lowerRowWords, live, lowerRowWords * sizeof(unsigned));
+        changed = 1;
+      }
+    }
+  }
+
+  // A value defined interferes with every other live there
+  for (point = 0; point < points; point++) {
+    lowerLiveOut(liveIn, point, live);
+    events = &lowerEvents[point];
+    for (e = events->count - 1; e >= 0; e--) {
+      node = events->events[e] / 2;
+      if (events->events[e] % 2) {
+        for (w = 0; w < lowerRowWords; w++)
+          if (live[w] != 0)
+            for (u = w * BITS; (u < (w + 1) * BITS) && (u < lowerNodeCount); u++)
+              if (TEST_BIT(live, u))
+                lowerInterfere(node, u);
+        CLEAR_BIT(live, node);
+      } else SET_BIT(live, node);
+    }
+  }
+  free(liveIn);
+  free(live);
+}
+
+// Whether a node of the class of b interferes with one of the class of a
+int lowerClassesInterfere(int a, int b) {
+  unsigned *row = lowerInterference + a * lowerRowWords;
+  int member = b;
+
+  do {
+    if (TEST_BIT(row, member))
+      return 1;
+    member = lowerMembers[member];
+  } while (member != b);
+  return 0;
+}
+
+// The word an entry value is in from the start, -1 for the others
+int lowerPrecolor(int node) {
+  return (lowerValues[node]->op == IR_ENTRY) ? lowerValues[node]->q : -1;
+}
+
+/* A phi and its arguments share a word where they do not interfere:
+ * the copy on the edge is then no copy at all. The row of a class is
+ * that of all its nodes. */
+void lowerCoalesce(int *precolors) {
+  IrInstr *phi, *arg;
+  int node, a, b, k, w, next;
+  unsigned *row;
+
+  for (node = 0; node < lowerNodeCount; node++) {
+    phi = lowerValues[node];
+    if (phi->op != IR_PHI)
+      continue;
+    for (k = 0; k < phi->argCount; k++) {
+      arg = phi->args[k];
+      if (lowerNodes[arg->id] < 0)
+        continue;
+      a = lowerFind(node);
+      b = lowerFind(lowerNodes[arg->id]);
+      if ((a == b) || lowerClassesInterfere(a, b) ||
+          ((precolors[a] >= 0) && (precolors[b] >= 0) && (precolors[a] != precolors[b])))
+        continue;
+      lowerParents[b] = a;
+      if (precolors[a] < 0)
+        precolors[a] = precolors[b];
+      row = lowerInterference + a * lowerRowWords;
+      for (w = 0; w < lowerRowWords; w++)
+        row[w] |= lowerInterference[b * lowerRowWords + w];
+      next = lowerMembers[a];
+      lowerMembers[a] = lowerMembers[b];
+      lowerMembers[b] = next;
+    }
+  }
+}
+
+// Whether values may go in word w of the frame
+int lowerInPool(int w) {
+  return (w >= lowerFn->frameSize) || ((w >= RESERVED_WORDS) && lowerFn->promoted[w]);
+}
+
+/* Gives every class a word no class it interferes with has: an entry
+ * value's own, else a phi's word if free, else the first free one of the
+ * promoted words and those above the frame. Returns the frame size. */
+int lowerAssignWords(void) {
+  int *precolors = (int*) malloc((lowerNodeCount + 1) * sizeof(int));
+  int limit = lowerFn->frameSize + lowerNodeCount + 1;
+  char *used = (char*) calloc(limit, sizeof(char));
+  unsigned *row;
+  IrInstr *value;
+  int frameSize = lowerFn->frameSize;
+  int node, u, w, member, word, pass;
+
+  for (node = 0; node < lowerNodeCount; node++)
+    precolors[node] = lowerPrecolor(node);
+  lowerCoalesce(precolors);
+
+  for (node = 0; node < lowerNodeCount; node++)
+    lowerWords[node] = -1;
+  // The entry values first, in their own words
+  for (pass = 0; pass < 2; pass++)
+    for (node = 0; node < lowerNodeCount; node++) {
+      if ((lowerFind(node) != node) || ((precolors[node] >= 0) != (pass == 0)))
+        continue;
+      if (pass == 0) {
+        lowerWords[node] = precolors[node];
+        continue;
+      }
+      row = lowerInterference + node * lowerRowWords;
+      for (u = 0; u < lowerNodeCount; u++)
+        if (TEST_BIT(row, u) && (lowerWords[lowerFind(u)] >= 0) && (lowerWords[lowerFind(u)] < limit))
+          used[lowerWords[lowerFind(u)]] = 1;
+      word = -1;
+      member = node;
+      do {
+        value = lowerValues[member];
+        if ((value->op == IR_PHI) && (value->q < limit) && lowerInPool(value->q) && !used[value->q])
+          word = value->q;
+        member = lowerMembers[member];
+      } while ((member != node) && (word < 0));
+      for (w = RESERVED_WORDS; (word < 0) && (w < limit); w++)
+        if (lowerInPool(w) && !used[w])
+          word = w;
+      lowerWords[node] = word;
+      memset(used, 0, limit * sizeof(char));
+    }
+
+  for (node = 0; node < lowerNodeCount; node++)
+    if (lowerWords[lowerFind(node)] >= frameSize)
+      frameSize = lowerWords[lowerFind(node)] + 1;
+  free(precolors);
+  free(used);
+  return frameSize;
+}
+
+/******************* Functions ******************************/
+
+// A jump to a jump goes where that one goes, and a jump to a return returns
+void lowerThreadJumps(void) {
+  Instruction *jump, *target;
+  int k, n;
+
+  for (k = 0; k < lowerJumpCount; k++) {
+    jump = &(lowerCode->code[lowerJumps[k]]);
+    for (n = 0; n < MAX_THREADED_JUMPS; n++) {
+      target = &(lowerCode->code[jump->q]);
+      if ((target->op != OP_J) || (target->q == jump->q))
+        break;
+      jump->q = target->q;
+    }
+    target = &(lowerCode->code[jump->q]);
+    if ((jump->op == OP_J) && ((target->op == OP_EP) || (target->op == OP_EF) || (target->op == OP_HL)))
+      *jump = *target;
+  }
+}
+
+// Lowers fn at the end of lowerCode; returns whether it could
+int lowerFunction(IrFunction *fn, CodeAddress *address) {
+  IrBlock **order = (IrBlock**) malloc(fn->blockCount * sizeof(IrBlock*));
+  int points = fn->blockCount * 3;
+  int ok = 1, b, k, id;
+
+  lowerFn = fn;
+  irResolveArgs(fn);
+  if (irReversePostorder(fn, order) != fn->blockCount) {
+    free(order);
+    return 0;
+  }
+  lowerKinds = (char*) calloc(fn->valueCount, sizeof(char));
+  lowerNodes = (int*) malloc(fn->valueCount * sizeof(int));
+  lowerValues = (IrInstr**) malloc((fn->valueCount + 1) * sizeof(IrInstr*));
+  lowerCopied = (IrInstr**) malloc((fn->valueCount + 1) * sizeof(IrInstr*));
+  lowerBlockIndex = (int*) malloc(fn->blockIds * sizeof(int));
+  lowerBlockAddresses = (CodeAddress*) malloc(fn->blockCount * sizeof(CodeAddress));
+  lowerTrampolines = (CodeAddress*) malloc(fn->blockCount * sizeof(CodeAddress));
+  lowerEvents = (LowerEvents*) calloc(points, sizeof(LowerEvents));
+  lowerJumpCount = 0;
+  for (b = 0; b < fn->blockCount; b++) {
+    lowerBlockIndex[fn->blocks[b]->id] = b;
+    lowerTrampolines[b] = -1;
+  }
+
+  lowerClassify(order, fn->blockCount);
+  for (b = 0; (b < fn->blockCount) && ok; b++)
+    ok = lowerOrderBlock(fn->blocks[b]);
+
+  if (ok) {
+    lowerNodeCount = 0;
+    for (id = 0; id < fn->valueCount; id++) {
+      lowerNodes[id] = -1;
+      if ((fn->values[id]->block != NULL) && (lowerKinds[id] == LOWER_SLOT)) {
+        lowerNodes[id] = lowerNodeCount;
+        lowerValues[lowerNodeCount++] = fn->values[id];
+      }
+    }
+    lowerRowWords = lowerNodeCount / BITS + 1;
+    lowerParents = (int*) malloc((lowerNodeCount + 1) * sizeof(int));
+    lowerMembers = (int*) malloc((lowerNodeCount + 1) * sizeof(int));
+    lowerWords = (int*) malloc((lowerNodeCount + 1) * sizeof(int));
+    lowerInterference = (unsigned*) calloc(lowerNodeCount * lowerRowWords + 1, sizeof(unsigned));
+    for (k = 0; k < lowerNodeCount; k++) {
+      lowerParents[k] = k;
+      lowerMembers[k] = k;
+    }
+
+    lowerRecording = 1;
+    for (b = 0; b < fn->blockCount; b++)
+      lowerBlock(b);
+    lowerComputeInterference();
+    lowerFrameSize = lowerAssignWords();
+
+    lowerRecording = 0;
+    *address = lowerCode->codeSize;
+    for (b = 0; b < fn->blockCount; b++)
+      lowerBlock(b);
+    for (b = 0; b < fn->blockCount; b++)
+      if (lowerTrampolines[b] >= 0) {
+        lowerCode->code[lowerTrampolines[b]].q = lowerCode->codeSize;
+        lowerPoint = b * 3 + 2;
+        lowerCopies(fn->blocks[b], 1, 1);
+        lowerJump(OP_J, fn->blocks[b]->succs[1]);
+      }
+    for (k = 0; k < lowerJumpCount; k++)
+      lowerCode->code[lowerJumps[k]].q = lowerBlockAddresses[lowerJumpTargets[k]];
+    lowerThreadJumps();
+
+    free(lowerParents);
+    free(lowerMembers);
+    free(lowerWords);
+    free(lowerInterference);
+  }
+
+  for (k = 0; k < points; k++)
+    free(lowerEvents[k].events);
+  free(lowerEvents);
+  free(lowerKinds);
+  free(lowerNodes);
+  free(lowerValues);
+  free(lowerCopied);
+  free(lowerBlockIndex);
+  free(lowerBlockAddresses);
+  free(lowerTrampolines);
+  free(order);
+  return ok;
+}
+
+/* The functions are lowered in the order of their labels after the jump
+ * to the body of the program, as kplc lays them out. */
+int lowerIr(IrProgram *program) {
+  CodeBlock *code = program->code;
+  CodeAddress *addresses = (CodeAddress*) malloc(program->functionCount * sizeof(CodeAddress));
+  int label, k, ok = 1;
+
+  lowerCode = createCodeBlock();
+  lowerCalls = NULL;
+  lowerCallCount = 0;
+  lowerCallMax = 0;
+  lowerJumps = NULL;
+  lowerJumpTargets = NULL;
+  lowerJumpMax = 0;
+  emitCode(lowerCode, OP_J, 0, 0);
+  for (label = 0; (label < program->functionCount) && ok; label++)
+    ok = lowerFunction(program->functions[label], &addresses[label]);
+
+  if (ok && (program->functionCount == code->labelCount)) {
+    for (k = 0; k < lowerCallCount; k++)
+      lowerCode->code[lowerCalls[k]].q = addresses[lowerCode->code[lowerCalls[k]].q];
+    lowerCode->code[0].q = addresses[code->labelCount - 1];
+    for (label = 0; label < code->labelCount; label++)
+      code->labels[label].address = addresses[label];
+    free(code->code);
+    code->code = lowerCode->code;
+    code->codeSize = lowerCode->codeSize;
+    code->maxSize = lowerCode->maxSize;
+    lowerCode->code = NULL;
+  } else ok = 0;
+
+  freeCodeBlock(lowerCode);
+  free(lowerCalls);
+  free(lowerJumps);
+  free(lowerJumpTargets);
+  free(addresses);
+  return ok;
+}
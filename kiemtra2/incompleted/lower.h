@@ -0,0 +1,31 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __LOWER_H__
+#define __LOWER_H__
+
+#include "ssa.h"
+
+/* Lowering of the SSA form of ssa.h back into stack code, as kplc
+ * generates it: a subroutine's body starts with INT and its frame size,
+ * and a call reserves the four words, pushes its arguments and drops
+ * them before CALL.
+ *
+ * An operation whose one user comes after it in the same block is
+ * computed on the operand stack where the user takes it, as long as
+ * nothing that reads or writes memory moves past it. A constant, an
+ * address or a small operation on them is computed again wherever it is
+ * used. Every other value is stored in a word of the frame: the words of
+ * the promoted variables are used again, and the frame grows by as many
+ * words as are live at once beyond them. A phi takes the values of its
+ * arguments as its block is entered, through the same word where it can.
+ *
+ * The code of the program is replaced only when every function could be
+ * lowered. */
+
+int lowerIr(IrProgram *program);
+
+#endif
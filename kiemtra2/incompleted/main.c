@@ -6,19 +6,56 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "reader.h"
 #include "parser.h"
+#include "xref.h"
+#include "memstats.h"
+#include "passes.h"
 
 /******************************************************************/
 
 int main(int argc, char *argv[]) {
-  if (argc <= 1) {
+  char *fileName = NULL;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--decls-only") == 0)
+      declsOnly = 1;
+    else if (strcmp(argv[i], "--xref") == 0)
+      xrefEnabled = 1;
+    else if (strcmp(argv[i], "--mem-stats") == 0)
+      memStats = 1;
+    else if ((strcmp(argv[i], "--emit-sym") == 0) && (i + 1 < argc))
+      symFileName = argv[++i];
+    else if (strcmp(argv[i], "-S") == 0)
+      assemblyOutput = 1;
+    else if ((strcmp(argv[i], "--emit-c") == 0) && (i + 1 < argc))
+      cFileName = argv[++i];
+    else if (strcmp(argv[i], "-O0") == 0)
+      optimizing = 0;
+    else if (strcmp(argv[i], "--time-passes") == 0)
+      timePasses = 1;
+    else if (strcmp(argv[i], "--dump-ir") == 0)
+      dumpIr = 1;
+    else if ((strcmp(argv[i], "-o") == 0) && (i + 1 < argc))
+      codeFileName = argv[++i];
+    else fileName = argv[i];
+  }
+
+  if (fileName == NULL) {
     printf("parser: no input file.\n");
     return -1;
   }
 
-  if (compile(argv[1]) == IO_ERROR) {
+  // The bodies are skipped: there would be no code to write
+  if (declsOnly && ((codeFileName != NULL) || (cFileName != NULL))) {
+    printf("parser: --decls-only writes no code (-o, -S, --emit-c).\n");
+    return -1;
+  }
+
+  if (compile(fileName) == IO_ERROR) {
     printf("Can\'t read input file!\n");
     return -1;
   }
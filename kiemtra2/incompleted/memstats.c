@@ -0,0 +1,90 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "memstats.h"
+
+struct MemCounter_ {
+  long allocs;
+  long frees;
+  long bytes;           // allocated in all
+  long live;
+  long peak;
+};
+
+typedef struct MemCounter_ MemCounter;
+
+int memStats = 0;
+
+MemCounter counters[MEM_CATEGORIES];
+long totalLive = 0;
+long totalPeak = 0;
+
+char *categoryNames[MEM_CATEGORIES] = {
+  "token", "object", "scope", "objnode", "type", "constant", "binding", "other"
+};
+
+void countAlloc(enum MemCategory category, size_t size) {
+  MemCounter *c = &counters[category];
+
+  c->allocs++;
+  c->bytes += size;
+  c->live += size;
+  if (c->live > c->peak)
+    c->peak = c->live;
+  totalLive += size;
+  if (totalLive > totalPeak)
+    totalPeak = totalLive;
+}
+
+void countFree(enum MemCategory category, size_t size) {
+  counters[category].frees++;
+  counters[category].live -= size;
+  totalLive -= size;
+}
+
+void* memAlloc(enum MemCategory category, size_t size) {
+  countAlloc(category, size);
+  return malloc(size);
+}
+
+void* memCalloc(enum MemCategory category, size_t count, size_t size) {
+  countAlloc(category, count * size);
+  return calloc(count, size);
+}
+
+// A resize counts as freeing the old block and allocating the new one
+void* memRealloc(enum MemCategory category, void *block, size_t oldSize, size_t newSize) {
+  if (block != NULL)
+    countFree(category, oldSize);
+  countAlloc(category, newSize);
+  return realloc(block, newSize);
+}
+
+void memFree(enum MemCategory category, void *block, size_t size) {
+  if (block == NULL)
+    return;
+  countFree(category, size);
+  free(block);
+}
+
+void printMemStats(void) {
+  MemCounter total = { 0, 0, 0, 0, 0 };
+  int i;
+
+  printf("%-12s %10s %10s %12s %12s %12s\n", "category", "allocs", "frees", "bytes", "peak live", "live");
+  for (i = 0; i < MEM_CATEGORIES; i++) {
+    printf("%-12s %10ld %10ld %12ld %12ld %12ld\n", categoryNames[i], counters[i].allocs,
+           counters[i].frees, counters[i].bytes, counters[i].peak, counters[i].live);
+    total.allocs += counters[i].allocs;
+    total.frees += counters[i].frees;
+    total.bytes += counters[i].bytes;
+  }
+  printf("%-12s %10ld %10ld %12ld %12ld %12ld\n", "total", total.allocs, total.frees,
+         total.bytes, totalPeak, totalLive);
+}
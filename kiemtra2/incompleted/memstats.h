@@ -0,0 +1,40 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __MEMSTATS_H__
+#define __MEMSTATS_H__
+
+#include <stddef.h>
+
+/* Counting allocator. The scanner, the parser and the symbol table
+ * allocate through these functions, naming the category the memory is
+ * for; callers pass the size of a block back when they free it, so no
+ * header is added to the block. printMemStats reports, per category, the
+ * allocations and frees made, the bytes allocated in all and the most
+ * bytes live at any one time. */
+
+enum MemCategory {
+  MEM_TOKEN,
+  MEM_OBJECT,
+  MEM_SCOPE,        // scopes and their name indexes
+  MEM_OBJNODE,
+  MEM_TYPE,         // types and the array type table
+  MEM_CONSTANT,
+  MEM_BINDING,      // binding stacks and bindings
+  MEM_OTHER,
+  MEM_CATEGORIES
+};
+
+extern int memStats;
+
+void* memAlloc(enum MemCategory category, size_t size);
+void* memCalloc(enum MemCategory category, size_t count, size_t size);
+void* memRealloc(enum MemCategory category, void *block, size_t oldSize, size_t newSize);
+void memFree(enum MemCategory category, void *block, size_t size);
+
+void printMemStats(void);
+
+#endif
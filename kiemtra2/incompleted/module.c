@@ -0,0 +1,157 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "symfile.h"
+#include "module.h"
+
+extern SymTab* symtab;
+
+// Directory of the source being compiled, where interface files live
+char modulePath[1024] = "";
+
+void setModulePath(char *sourceFileName) {
+  char *slash = strrchr(sourceFileName, '/');
+  int len = (slash == NULL) ? 0 : slash - sourceFileName + 1;
+
+  if (len >= (int) sizeof(modulePath))
+    len = 0;
+  strncpy(modulePath, sourceFileName, len);
+  modulePath[len] = '\0';
+}
+
+char* interfaceFileName(char *moduleName) {
+  char *fileName = (char*) malloc(strlen(modulePath) + strlen(moduleName) + strlen(INTERFACE_EXTENSION) + 1);
+  strcpy(fileName, modulePath);
+  strcat(fileName, moduleName);
+  strcat(fileName, INTERFACE_EXTENSION);
+  return fileName;
+}
+
+/******************* Import ******************************/
+
+/* loadSymFile has checked every index of the image, so they are followed
+ * here as they are. What it cannot know is what a module may export: an
+ * object of any other kind, or a parameter list naming something else,
+ * makes the whole interface invalid. */
+
+Type* importType(SymFile *symFile, int index) {
+  SymFileType *t;
+
+  if (index == SYMFILE_NONE)
+    return NULL;
+  t = &(symFile->types[index]);
+  switch (t->typeClass) {
+  case TP_INT:
+    return makeIntType();
+  case TP_CHAR:
+    return makeCharType();
+  default:
+    return makeArrayType(t->arraySize, importType(symFile, t->elementType));
+  }
+}
+
+int importParams(SymFile *symFile, int node, Object *owner, Scope *scope) {
+  SymFileObject *p;
+  Object *param;
+
+  for (; node != SYMFILE_NONE; node = symFile->nodes[node].next) {
+    p = &(symFile->objects[symFile->nodes[node].object]);
+    if (p->kind != OBJ_PARAMETER)
+      return 0;
+    param = createParameterObject(p->name, p->value, owner);
+    param->paramAttrs.type = importType(symFile, p->type);
+    addParameter(owner, param);
+    addObjectToScope(scope, param);
+  }
+  return 1;
+}
+
+// The object, or NULL if a module cannot export it
+Object* importObject(SymFile *symFile, int index, Scope *scope) {
+  SymFileObject *o = &(symFile->objects[index]);
+  Object *obj;
+  int ok = 1;
+
+  switch (o->kind) {
+  case OBJ_CONSTANT:
+    obj = createConstantObject(o->name);
+    obj->constAttrs.value.type = o->valueType;
+    if (o->valueType == TP_INT)
+      obj->constAttrs.value.intValue = o->value;
+    else obj->constAttrs.value.charValue = (char) o->value;
+    break;
+  case OBJ_TYPE:
+    obj = createTypeObject(o->name);
+    obj->typeAttrs.actualType = importType(symFile, o->type);
+    break;
+  case OBJ_VARIABLE:
+    obj = createVariableObject(o->name);
+    obj->varAttrs.type = importType(symFile, o->type);
+    obj->varAttrs.scope = scope;
+    break;
+  case OBJ_FUNCTION:
+    obj = createFunctionObject(o->name);
+    obj->funcAttrs.returnType = importType(symFile, o->type);
+    obj->funcAttrs.scope->outer = scope;
+    obj->funcAttrs.scope->level = scope->level + 1;
+    ok = importParams(symFile, o->paramList, obj, obj->funcAttrs.scope);
+    break;
+  case OBJ_PROCEDURE:
+    obj = createProcedureObject(o->name);
+    obj->procAttrs.scope->outer = scope;
+    obj->procAttrs.scope->level = scope->level + 1;
+    ok = importParams(symFile, o->paramList, obj, obj->procAttrs.scope);
+    break;
+  default:
+    return NULL;
+  }
+
+  if (!ok) {
+    freeObject(obj);
+    return NULL;
+  }
+  return obj;
+}
+
+// Load the interface of a module and bind what it exports; NULL if there is no valid one
+Object* importModule(char *moduleName) {
+  char *fileName = interfaceFileName(moduleName);
+  SymFile *symFile = loadSymFile(fileName);
+  SymFileObject *o;
+  Object *module, *obj;
+  Scope *scope;
+  int node;
+
+  free(fileName);
+  if (symFile == NULL)
+    return NULL;
+
+  o = &(symFile->objects[symFile->header->program]);
+  if (o->kind != OBJ_MODULE) {
+    closeSymFile(symFile);
+    return NULL;
+  }
+
+  module = createModuleObject(o->name);
+  scope = module->progAttrs.scope;
+  for (node = o->scope; node != SYMFILE_NONE; node = symFile->nodes[node].next) {
+    obj = importObject(symFile, symFile->nodes[node].object, scope);
+    if (obj == NULL) {
+      closeSymFile(symFile);
+      freeObject(module);
+      return NULL;
+    }
+    addObjectToScope(scope, obj);
+  }
+  closeSymFile(symFile);
+
+  addObject(&(symtab->importList), module);
+  importScope(scope);
+  return module;
+}
@@ -0,0 +1,27 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __MODULE_H__
+#define __MODULE_H__
+
+#include "symtab.h"
+
+/* Modules are checked separately but never linked. Compiling MODULE M
+ * writes the interface file M.kpi next to the source; a program or
+ * module that says USES M loads that file instead of M's source and is
+ * type-checked against it. Since M's code is not loaded, kplc writes no
+ * code (-o, -S, --emit-c) for a unit that uses modules. Everything
+ * declared at M's top level is exported. Imported objects are bound
+ * beneath the importer's own declarations, which may hide them; of two
+ * used modules exporting the same name, the one named later wins. */
+
+#define INTERFACE_EXTENSION ".kpi"
+
+void setModulePath(char *sourceFileName);
+char* interfaceFileName(char *moduleName);
+Object* importModule(char *moduleName);
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+
+#include "multiassign.h"
+
+AssignPair *trackedPair = NULL;
+
+/******************* Read tracking ******************************/
+
+void trackAssignPair(AssignPair *pair) {
+  trackedPair = pair;
+}
+
+void noteRead(Object *obj) {
+  if (trackedPair == NULL)
+    return;
+
+  if ((obj->kind == OBJ_PARAMETER) && (obj->paramAttrs.kind == PARAM_REFERENCE))
+    trackedPair->readsAll = 1;
+
+  if (trackedPair->readCount == trackedPair->readMax) {
+    trackedPair->readMax = (trackedPair->readMax == 0) ? 4 : trackedPair->readMax * 2;
+    trackedPair->reads = (Object**) realloc(trackedPair->reads, trackedPair->readMax * sizeof(Object*));
+  }
+  trackedPair->reads[trackedPair->readCount++] = obj;
+}
+
+void noteCall(void) {
+  if (trackedPair != NULL)
+    trackedPair->hasCall = 1;
+}
+
+void initAssignPair(AssignPair *pair, Object *target) {
+  pair->target = target;
+  pair->indexed = 0;
+  pair->reads = NULL;
+  pair->readCount = pair->readMax = 0;
+  pair->readsAll = 0;
+  pair->hasCall = 0;
+  pair->copied = 0;
+}
+
+void freeAssignPair(AssignPair *pair) {
+  free(pair->reads);
+}
+
+/******************* Planning ******************************/
+
+// Does evaluating pair p read the location stored by pair t?
+int readsTarget(AssignPair *p, AssignPair *t) {
+  int i;
+
+  if (p->readsAll)
+    return 1;
+  if ((t->target->kind == OBJ_PARAMETER) && (t->target->paramAttrs.kind == PARAM_REFERENCE))
+    return p->readCount > 0;
+  for (i = 0; i < p->readCount; i++)
+    if (p->reads[i] == t->target)
+      return 1;
+  return 0;
+}
+
+// Is pair i read by a pair still to be evaluated?
+int isBlocked(AssignPair *pairs, int count, int *evaluated, int i) {
+  int j;
+
+  for (j = 0; j < count; j++)
+    if ((j != i) && !evaluated[j] && readsTarget(&pairs[j], &pairs[i]))
+      return 1;
+  return 0;
+}
+
+// Does pair i read a pair still to be evaluated, whose store comes before its own?
+int readsPending(AssignPair *pairs, int count, int *evaluated, int i) {
+  int j;
+
+  for (j = 0; j < count; j++)
+    if ((j != i) && !evaluated[j] && readsTarget(&pairs[i], &pairs[j]))
+      return 1;
+  return 0;
+}
+
+int planParallelAssign(AssignPair *pairs, int count, AssignStep *steps) {
+  int *evaluated = (int*) calloc(count, sizeof(int));
+  int stepCount = 0, deferred = 0;
+  int i, hasCall = 0;
+
+  for (i = 0; i < count; i++)
+    hasCall = hasCall || pairs[i].hasCall;
+
+  while (stepCount < count) {
+    if (hasCall) {
+      // Source order: only an array pair nothing later reads is stored directly
+      i = stepCount;
+      if (pairs[i].copied && !isBlocked(pairs, count, evaluated, i))
+        steps[stepCount].kind = STEP_STORE;
+      else steps[stepCount].kind = STEP_DEFER;
+    } else {
+      // A pair can be stored once no other pending pair reads its target
+      for (i = 0; i < count; i++)
+        if (!evaluated[i] && !isBlocked(pairs, count, evaluated, i))
+          break;
+
+      if (i < count)
+        steps[stepCount].kind = STEP_STORE;
+      else {
+        // Every pending pair is blocked: break a cycle at the leftmost
+        // scalar pair, whose value can wait on the stack
+        for (i = 0; (i < count) && (evaluated[i] || pairs[i].copied); i++) ;
+        if (i == count)
+          for (i = 0; evaluated[i]; i++) ;
+        steps[stepCount].kind = STEP_DEFER;
+      }
+    }
+
+    steps[stepCount].pair = i;
+    steps[stepCount].cycle = 0;
+    if (steps[stepCount].kind == STEP_DEFER) {
+      steps[stepCount].cycle = readsPending(pairs, count, evaluated, i);
+      deferred++;
+    }
+    stepCount++;
+    evaluated[i] = 1;
+  }
+
+  free(evaluated);
+  return deferred;
+}
@@ -0,0 +1,64 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __MULTIASSIGN_H__
+#define __MULTIASSIGN_H__
+
+#include "symtab.h"
+
+/* Multiple assignment V1, ..., Vn := E1, ..., En is simultaneous: every
+ * target address and every Ei is evaluated with the values held before
+ * the statement, then all the stores happen. Stores to two targets that
+ * denote the same array element happen in an unspecified order.
+ *
+ * planParallelAssign orders the pairs so that most of them can be stored
+ * as soon as they are evaluated. A pair is stored directly once no pair
+ * still to be evaluated reads its target; only pairs on a cycle of the
+ * read graph (A, B := B, A) are deferred, their address and value staying
+ * on the operand stack until the deferred stores run, last in first out,
+ * after the final step. No temporaries are allocated.
+ *
+ * A function call keeps the pairs in source order. Scalar pairs are then
+ * all deferred; an array pair is stored directly unless a later pair
+ * reads its target.
+ *
+ * Only the address of an array value stays on the stack, so an array
+ * pair deferred while it reads the target of a pair evaluated after it
+ * is marked cycle: its value is copied into a frame temporary, whose
+ * address waits on the stack instead. */
+
+#define STEP_STORE 0
+#define STEP_DEFER 1
+
+struct AssignPair_ {
+  Object *target;
+  int indexed;          // an array element rather than the whole variable
+  Object **reads;       // variables and parameters read by the index and value
+  int readCount;
+  int readMax;
+  int readsAll;         // reads through a VAR parameter: may read any target
+  int hasCall;          // calls a function, whose side effects keep source order
+  int copied;           // an array, whose words are copied when stored
+};
+
+struct AssignStep_ {
+  int pair;
+  int kind;
+  int cycle;            // deferred, but reads a target stored before it
+};
+
+typedef struct AssignPair_ AssignPair;
+typedef struct AssignStep_ AssignStep;
+
+void trackAssignPair(AssignPair *pair);
+void noteRead(Object *obj);
+void noteCall(void);
+
+void initAssignPair(AssignPair *pair, Object *target);
+void freeAssignPair(AssignPair *pair);
+int planParallelAssign(AssignPair *pairs, int count, AssignStep *steps);
+
+#endif
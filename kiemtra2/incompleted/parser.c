@@ -13,6 +13,14 @@
 #include "semantics.h"
 #include "error.h"
 #include "debug.h"
+#include "symfile.h"
+#include "incremental.h"
+#include "multiassign.h"
+#include "module.h"
+#include "xref.h"
+#include "memstats.h"
+#include "codegen.h"
+#include "passes.h"
 
 Token *currentToken;
 Token *lookAhead;
@@ -23,12 +31,24 @@ extern Type *arrayType;
 extern Type *floatType;
 extern SymTab *symtab;
 int HasReturnFunction = 0;
+Object *lvalueObject;  // target of the last lvalue compiled
+int lvalueIndexed;
+Token lvalueToken;     // its name, where it was used
+int exprConstant;      // the expression just compiled has a compile-time value
+ConstantValue exprValue;
+CodeAddress exprStart; // where the code of the expression just compiled starts
+int declsOnly = 0;
+char *symFileName = NULL;
+char *codeFileName = NULL;
+int assemblyOutput = 0;   // the code file is x86-64 assembly
+char *cFileName = NULL;
+
 void scan(void)
 {
   Token *tmp = currentToken;
   currentToken = lookAhead;
   lookAhead = getValidToken();
-  free(tmp);
+  freeToken(tmp);
 }
 
 void eat(TokenType tokenType)
@@ -44,21 +64,57 @@ void eat(TokenType tokenType)
 void compileProgram(void)
 {
   Object *program;
+  CodeAddress entry;
 
-  eat(KW_PROGRAM);
-  eat(TK_IDENT);
+  if (lookAhead->tokenType == KW_MODULE)
+  {
+    eat(KW_MODULE);
+    eat(TK_IDENT);
+
+    program = createModuleObject(currentToken->string);
+    symtab->program = program;
+  }
+  else
+  {
+    eat(KW_PROGRAM);
+    eat(TK_IDENT);
 
-  program = createProgramObject(currentToken->string);
-  enterBlock(program->progAttrs->scope);
+    program = createProgramObject(currentToken->string);
+  }
+  enterBlock(program->progAttrs.scope);
 
   eat(SB_SEMICOLON);
 
+  compileUses();
+  entry = genJ(DC_VALUE);
   compileBlock();
   eat(SB_PERIOD);
+  genHL();
+  updateJump(entry, program->progAttrs.codeAddress);
 
   exitBlock();
 }
 
+void compileUses(void)
+{
+  if (lookAhead->tokenType == KW_USES)
+  {
+    eat(KW_USES);
+    eat(TK_IDENT);
+    if (importModule(currentToken->string) == NULL)
+      error(ERR_UNDECLARED_MODULE, currentToken->lineNo, currentToken->colNo);
+
+    while (lookAhead->tokenType == SB_COMMA)
+    {
+      eat(SB_COMMA);
+      eat(TK_IDENT);
+      if (importModule(currentToken->string) == NULL)
+        error(ERR_UNDECLARED_MODULE, currentToken->lineNo, currentToken->colNo);
+    }
+    eat(SB_SEMICOLON);
+  }
+}
+
 void compileBlock(void)
 {
   Object *constObj;
@@ -78,7 +134,8 @@ void compileBlock(void)
       eat(SB_EQ);
       constValue = compileConstant();
 
-      constObj->constAttrs->value = constValue;
+      constObj->constAttrs.value = *constValue;
+      memFree(MEM_CONSTANT, constValue, sizeof(ConstantValue));
       declareObject(constObj);
 
       eat(SB_SEMICOLON);
@@ -109,7 +166,7 @@ void compileBlock2(void)
       eat(SB_EQ);
       actualType = compileType();
 
-      typeObj->typeAttrs->actualType = actualType;
+      typeObj->typeAttrs.actualType = actualType;
       declareObject(typeObj);
 
       eat(SB_SEMICOLON);
@@ -140,7 +197,8 @@ void compileBlock3(void)
       eat(SB_COLON);
       varType = compileType();
 
-      varObj->varAttrs->type = varType;
+      varObj->varAttrs.type = varType;
+      checkFrameSpace(varType);
       declareObject(varObj);
 
       eat(SB_SEMICOLON);
@@ -155,16 +213,46 @@ void compileBlock3(void)
 void compileBlock4(void)
 {
   compileSubDecls();
+  genBlockEntry(symtab->currentScope->owner);
   compileBlock5();
+  genBlockExit(symtab->currentScope->owner);
 }
 
 void compileBlock5(void)
 {
   eat(KW_BEGIN);
-  compileStatements();
+  if (declsOnly)
+    skipStatements();
+  else
+    compileStatements();
   eat(KW_END);
 }
 
+// Skim a statement body by balancing BEGIN/END, stopping before the END that closes the block
+void skipStatements(void)
+{
+  int depth = 0;
+
+  while ((depth > 0) || (lookAhead->tokenType != KW_END))
+  {
+    switch (lookAhead->tokenType)
+    {
+    case KW_BEGIN:
+      depth++;
+      break;
+    case KW_END:
+      depth--;
+      break;
+    case TK_EOF:
+      missingToken(KW_END, lookAhead->lineNo, lookAhead->colNo);
+      break;
+    default:
+      break;
+    }
+    scan();
+  }
+}
+
 void compileSubDecls(void)
 {
   while ((lookAhead->tokenType == KW_FUNCTION) || (lookAhead->tokenType == KW_PROCEDURE))
@@ -180,139 +268,82 @@ void compileFuncDecl(void)
 {
   Object *funcObj;
   Type *returnType;
+  int range;
 
   eat(KW_FUNCTION);
+  range = openSubroutineRange(currentToken);
   eat(TK_IDENT);
 
   checkFreshIdent(currentToken->string);
   funcObj = createFunctionObject(currentToken->string);
   declareObject(funcObj);
 
-  enterBlock(funcObj->funcAttrs->scope);
+  enterBlock(funcObj->funcAttrs.scope);
 
   compileParams();
 
   eat(SB_COLON);
   returnType = compileBasicType();
-  funcObj->funcAttrs->returnType = returnType;
+  funcObj->funcAttrs.returnType = returnType;
 
   eat(SB_SEMICOLON);
+  markSubroutineBody(range, funcObj, lookAhead);
   compileBlock();
+  genEF();
   eat(SB_SEMICOLON);
+  closeSubroutineRange(range, currentToken);
   exitBlock();
 }
 
 void compileProcDecl(void)
 {
   Object *procObj;
+  int range;
 
   eat(KW_PROCEDURE);
+  range = openSubroutineRange(currentToken);
   eat(TK_IDENT);
 
   checkFreshIdent(currentToken->string);
   procObj = createProcedureObject(currentToken->string);
   declareObject(procObj);
 
-  enterBlock(procObj->procAttrs->scope);
+  enterBlock(procObj->procAttrs.scope);
 
   compileParams();
 
   eat(SB_SEMICOLON);
+  markSubroutineBody(range, procObj, lookAhead);
   compileBlock();
+  genEP();
   eat(SB_SEMICOLON);
+  closeSubroutineRange(range, currentToken);
 
   exitBlock();
 }
 
-ConstantValue *compileUnsignedConstant(void)
-{
-  ConstantValue *constValue;
-  Object *obj;
-
-  switch (lookAhead->tokenType)
-  {
-  case TK_NUMBER:
-    eat(TK_NUMBER);
-    constValue = makeIntConstant(currentToken->value);
-    break;
-  case TK_IDENT:
-    eat(TK_IDENT);
-
-    obj = checkDeclaredConstant(currentToken->string);
-    constValue = duplicateConstantValue(obj->constAttrs->value);
-
-    break;
-  case TK_CHAR:
-    eat(TK_CHAR);
-    constValue = makeCharConstant(currentToken->string[0]);
-    break;
-  default:
-    error(ERR_INVALID_CONSTANT, lookAhead->lineNo, lookAhead->colNo);
-    break;
-  }
-  return constValue;
-}
-
 ConstantValue *compileConstant(void)
 {
-  ConstantValue *constValue;
-
-  switch (lookAhead->tokenType)
-  {
-  case SB_PLUS:
-    eat(SB_PLUS);
-    constValue = compileConstant2();
-    break;
-  case SB_MINUS:
-    eat(SB_MINUS);
-    constValue = compileConstant2();
-    constValue->intValue = -constValue->intValue;
-    break;
-  case TK_CHAR:
-    eat(TK_CHAR);
-    constValue = makeCharConstant(currentToken->string[0]);
-    break;
-  // case TK_STRING:
-  //   eat(TK_STRING);
-  //   constValue = makeStringConsttant(currentToken->string[0]);
-  //   break;
-  default:
-    constValue = compileConstant2();
-    break;
-  }
-  return constValue;
-}
-
-ConstantValue *compileConstant2(void)
-{
-  ConstantValue *constValue;
-  Object *obj;
-
-  switch (lookAhead->tokenType)
-  {
-  case TK_NUMBER:
-    eat(TK_NUMBER);
-    constValue = makeIntConstant(currentToken->value);
-    break;
-  case TK_IDENT:
-    eat(TK_IDENT);
-    obj = checkDeclaredConstant(currentToken->string);
-    if (obj->constAttrs->value->type == TP_INT)
-      constValue = duplicateConstantValue(obj->constAttrs->value);
-    else
-      error(ERR_UNDECLARED_INT_CONSTANT, currentToken->lineNo, currentToken->colNo);
-    break;
-  default:
-    error(ERR_INVALID_CONSTANT, lookAhead->lineNo, lookAhead->colNo);
-    break;
-  }
-  return constValue;
+  int lineNo = lookAhead->lineNo;
+  int colNo = lookAhead->colNo;
+  CodeAddress start = getCurrentCodeAddress();
+
+  // An expression over literals and constants, folded as it is compiled
+  compileExpression();
+  if (!exprConstant)
+    error(ERR_INVALID_CONSTANT, lineNo, colNo);
+  rewindCode(start);
+
+  if (exprValue.type == TP_INT)
+    return makeIntConstant(exprValue.intValue);
+  return makeCharConstant(exprValue.charValue);
 }
 
 Type *compileType(void)
 {
   Type *type;
   Type *elementType;
+  ConstantValue *constValue;
   int arraySize;
   Object *obj;
 
@@ -329,9 +360,12 @@ Type *compileType(void)
   case KW_ARRAY:
     eat(KW_ARRAY);
     eat(SB_LSEL);
-    eat(TK_NUMBER);
 
-    arraySize = currentToken->value;
+    constValue = compileConstant();
+    if ((constValue->type != TP_INT) || (constValue->intValue <= 0))
+      error(ERR_INVALID_ARRAY_SIZE, currentToken->lineNo, currentToken->colNo);
+    arraySize = constValue->intValue;
+    memFree(MEM_CONSTANT, constValue, sizeof(ConstantValue));
 
     eat(SB_RSEL);
     eat(KW_OF);
@@ -341,7 +375,7 @@ Type *compileType(void)
   case TK_IDENT:
     eat(TK_IDENT);
     obj = checkDeclaredType(currentToken->string);
-    type = duplicateType(obj->typeAttrs->actualType);
+    type = obj->typeAttrs.actualType;
     break;
   default:
     error(ERR_INVALID_TYPE, lookAhead->lineNo, lookAhead->colNo);
@@ -411,7 +445,7 @@ void compileParam(void)
   param = createParameterObject(currentToken->string, paramKind, symtab->currentScope->owner);
   eat(SB_COLON);
   type = compileBasicType();
-  param->paramAttrs->type = type;
+  param->paramAttrs.type = type;
   declareObject(param);
 }
 
@@ -425,76 +459,12 @@ void compileStatements(void)
   }
 }
 
-void compileMultipleAssignSt(void)
-{
-  Object *varObj;
-  Type *valueType;
-  Type *type;
-  int hasMoreVars = 1;   // Còn biến để xử lý
-  int hasMoreValues = 1; // Còn giá trị để xử lý
-
-  // Bắt đầu xử lý danh sách biến và giá trị song song
-  do
-  {
-    // Xử lý biến
-    if (hasMoreVars)
-    {
-      eat(TK_IDENT);
-      varObj = checkDeclaredLValueIdent(currentToken->string); // Kiểm tra biến hợp lệ
-    }
-
-    // Xử lý giá trị
-    if (hasMoreValues)
-    {
-      if (lookAhead->tokenType == SB_ASSIGN)
-      { // Bắt đầu xử lý giá trị
-        eat(SB_ASSIGN);
-      }
-      type = compileExpression();
-      checkExpressionType(type); // Lấy kiểu biểu thức
-    }
-
-    // Kiểm tra sự tương thích kiểu giữa biến và giá trị
-    if (varObj != NULL && valueType != NULL)
-    {
-      checkTypeEquality(varObj->varAttrs->type, valueType); // Kiểm tra kiểu
-    }
-
-    // Di chuyển đến phần tử tiếp theo
-    if (lookAhead->tokenType == SB_COMMA)
-    {
-      eat(SB_COMMA); // Đọc dấu phẩy và kiểm tra tiếp
-    }
-    else
-    {
-      hasMoreVars = 0;   // Hết biến
-      hasMoreValues = 0; // Hết giá trị
-    }
-
-  } while (hasMoreVars || hasMoreValues);
-
-  // Kiểm tra nếu số biến và số giá trị không khớp
-  if (hasMoreVars != hasMoreValues)
-  {
-    error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
-  }
-}
-
 void compileStatement(void)
 {
   switch (lookAhead->tokenType)
   {
   case TK_IDENT:
-    // Nếu token tiếp theo là dấu ',' => đây là gán nhiều biến
-    if (lookAhead->tokenType == SB_COMMA)
-    {
-      compileMultipleAssignSt();
-    }
-    // Nếu không, đây là gán một biến thông thường
-    else
-    {
-      compileAssignSt();
-    }
+    compileAssignSt();
     break;
   case KW_CALL:
     compileCallSt();
@@ -532,6 +502,9 @@ Type *compileLValue(void)
   eat(TK_IDENT);
   // check if the identifier is a function identifier, or a variable identifier, or a parameter
   var = checkDeclaredLValueIdent(currentToken->string);
+  lvalueObject = var;
+  lvalueIndexed = 0;
+  lvalueToken = *currentToken;
   Object *owner = symtab->currentScope->owner;
   if (strcmp(currentToken->string, owner->name) == 0 && lookAhead->tokenType == SB_ASSIGN)
   {
@@ -539,27 +512,31 @@ Type *compileLValue(void)
   }
   if (var->kind == OBJ_VARIABLE)
   {
-    if (var->varAttrs->type->typeClass == TP_ARRAY)
+    genVariableAddress(var);
+    if (var->varAttrs.type->typeClass == TP_ARRAY)
     {
       if (lookAhead->tokenType == SB_LSEL)
       {
-        varType = compileIndexes(var->varAttrs->type);
+        varType = compileIndexes(var->varAttrs.type);
+        lvalueIndexed = 1;
       }
       else
-        varType = var->varAttrs->type;
+        varType = var->varAttrs.type;
     }
     else
     {
-      varType = var->varAttrs->type;
+      varType = var->varAttrs.type;
     }
   }
   else if (var->kind == OBJ_PARAMETER)
   {
-    varType = var->paramAttrs->type;
+    genParameterAddress(var);
+    varType = var->paramAttrs.type;
   }
   else if (var->kind == OBJ_FUNCTION)
   {
-    varType = var->funcAttrs->returnType;
+    genReturnValueAddress(var);
+    varType = var->funcAttrs.returnType;
   }
   else
   {
@@ -578,12 +555,24 @@ void compileCallSt(void)
 
   proc = checkDeclaredProcedure(currentToken->string);
 
-  compileArguments(proc->procAttrs->paramList);
+  if (isPredefinedProcedure(proc))
+  {
+    compileArguments(proc->procAttrs.paramList);
+    genPredefinedProcedureCall(proc);
+  }
+  else
+  {
+    genINT(RESERVED_WORDS);
+    compileArguments(proc->procAttrs.paramList);
+    genProcedureCall(proc);
+  }
 }
 
-void compileAssign(void)
+TokenType compileAssign(void)
 {
-  switch (lookAhead->tokenType)
+  TokenType assignOp = lookAhead->tokenType;
+
+  switch (assignOp)
   {
   case SB_ASSIGN:
     eat(SB_ASSIGN);
@@ -601,63 +590,164 @@ void compileAssign(void)
     eat(SB_ASSIGN_DIVIDE);
     break;
   default:
+    missingToken(SB_ASSIGN, lookAhead->lineNo, lookAhead->colNo);
     break;
   }
+  return assignOp;
 }
 
 void compileAssignSt(void)
 {
-  //*** TODO: parse the assignment and check type consistency for multiple variables
-  Type *varType;
+  AssignPair *pairs = NULL;
+  AssignStep *steps;
+  Type **varTypes = NULL;
   Type *expType;
-  Object *var;
-  int varCount = 0, expCount = 0;
-
-  // Parse the list of variables
+  TokenType assignOp;
+  int varCount = 0, expCount = 0, maxVars = 0;
+  int i, k, temporary;
+  CodeAddress start = getCurrentCodeAddress();
+  CodeAddress *targetCode = NULL; // where the code of each lvalue starts
+  Token *targetTokens = NULL;     // where each lvalue is named
+  CodeAddress *valueCode;         // where the code of each expression starts
+  Instruction *code;
+  int codeSize;
+
+  // Parse the list of lvalues; each one, indexes included, is compiled once
   do
   {
-    eat(TK_IDENT);
-    var = checkDeclaredLValueIdent(currentToken->string);
-    varType = (var->kind == OBJ_VARIABLE) ? var->varAttrs->type : NULL;
-
-    if (varCount == 0)
-      checkDeclaredLValueIdent(currentToken->string);
-
-    if (lookAhead->tokenType == SB_COMMA)
-    {
+    if (varCount > 0)
       eat(SB_COMMA);
-      varCount++;
-    }
-    else
+    if (varCount == maxVars)
     {
-      break;
+      maxVars = (maxVars == 0) ? 4 : maxVars * 2;
+      varTypes = (Type **)memRealloc(MEM_OTHER, varTypes, varCount * sizeof(Type *), maxVars * sizeof(Type *));
+      pairs = (AssignPair *)memRealloc(MEM_OTHER, pairs, varCount * sizeof(AssignPair), maxVars * sizeof(AssignPair));
+      targetCode = (CodeAddress *)memRealloc(MEM_OTHER, targetCode, varCount * sizeof(CodeAddress), maxVars * sizeof(CodeAddress));
+      targetTokens = (Token *)memRealloc(MEM_OTHER, targetTokens, varCount * sizeof(Token), maxVars * sizeof(Token));
     }
-  } while (lookAhead->tokenType == TK_IDENT);
-
-  compileAssign(); // Process assignment operator
-
-  // Parse the list of expressions
+    targetCode[varCount] = getCurrentCodeAddress();
+    initAssignPair(&pairs[varCount], NULL);
+    trackAssignPair(&pairs[varCount]);
+    varTypes[varCount] = compileLValue();
+    trackAssignPair(NULL);
+    pairs[varCount].target = lvalueObject;
+    pairs[varCount].indexed = lvalueIndexed;
+    pairs[varCount].copied = (varTypes[varCount]->typeClass == TP_ARRAY);
+    targetTokens[varCount] = lvalueToken;
+
+    for (i = 0; i < varCount; i++)
+      if ((pairs[i].target == lvalueObject) && !pairs[i].indexed && !lvalueIndexed)
+        error(ERR_DUPLICATE_TARGET, currentToken->lineNo, currentToken->colNo);
+    varCount++;
+  } while (lookAhead->tokenType == SB_COMMA);
+
+  assignOp = compileAssign();
+  // A compound assignment reads its targets as well; the write before
+  // gave each one its cross-reference list
+  if (assignOp != SB_ASSIGN)
+    for (i = 0; i < varCount; i++)
+      recordXref(pairs[i].target, NULL, XREF_READ, &targetTokens[i]);
+  valueCode = (CodeAddress *)memAlloc(MEM_OTHER, (varCount + 1) * sizeof(CodeAddress));
+
+  // Parse the list of expressions, pairing each with its lvalue
   do
   {
-    expType = compileExpression();
-
+    if (expCount > 0)
+      eat(SB_COMMA);
     if (expCount < varCount)
-      checkTypeEquality(varType, expType);
-
-    if (lookAhead->tokenType == SB_COMMA)
     {
-      eat(SB_COMMA);
-      expCount++;
+      valueCode[expCount] = getCurrentCodeAddress();
+      trackAssignPair(&pairs[expCount]);
     }
-    else
+    expType = compileExpression();
+    trackAssignPair(NULL);
+    if (expCount < varCount)
     {
-      break;
+      if (assignOp == SB_ASSIGN)
+        checkTypeEquality(varTypes[expCount], expType);
+      else
+        checkCompoundAssignType(varTypes[expCount], expType);
     }
-  } while (1);
+    expCount++;
+  } while (lookAhead->tokenType == SB_COMMA);
 
   // Ensure the number of variables and expressions match
   if (varCount != expCount)
     error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+
+  // Order the stores so that only pairs on a read cycle are deferred
+  steps = (AssignStep *)memAlloc(MEM_OTHER, varCount * sizeof(AssignStep));
+  planParallelAssign(pairs, varCount, steps);
+
+  // Take the code of the statement apart and emit it again in the planned order
+  valueCode[varCount] = getCurrentCodeAddress();
+  codeSize = valueCode[varCount] - start;
+  code = (Instruction *)memAlloc(MEM_OTHER, codeSize * sizeof(Instruction));
+  memcpy(code, getInstruction(start), codeSize * sizeof(Instruction));
+  rewindCode(start);
+
+  for (k = 0; k < varCount; k++)
+  {
+    i = steps[k].pair;
+    appendCode(code + (targetCode[i] - start), ((i + 1 < varCount) ? targetCode[i + 1] : valueCode[0]) - targetCode[i]);
+    if (assignOp != SB_ASSIGN)
+    {
+      genCV();
+      genLI();
+    }
+    if (pairs[i].copied && steps[k].cycle)
+    {
+      // Only the address of an array waits on the stack, and a store before
+      // its own would change the words there: it waits in a temporary
+      checkFrameSpace(varTypes[i]);
+      temporary = genTemporary(varTypes[i]);
+      genLA(0, temporary);
+      appendCode(code + (valueCode[i] - start), valueCode[i + 1] - valueCode[i]);
+      genCP(sizeOfType(varTypes[i]));
+      genLA(0, temporary);
+      continue;
+    }
+    appendCode(code + (valueCode[i] - start), valueCode[i + 1] - valueCode[i]);
+    genAssignOperation(assignOp);
+    if (steps[k].kind == STEP_STORE)
+      genStore(varTypes[i]);
+  }
+  // The deferred pairs are still on the stack, the last one on top
+  for (k = varCount - 1; k >= 0; k--)
+    if (steps[k].kind == STEP_DEFER)
+      genStore(varTypes[steps[k].pair]);
+
+  memFree(MEM_OTHER, code, codeSize * sizeof(Instruction));
+  memFree(MEM_OTHER, valueCode, (varCount + 1) * sizeof(CodeAddress));
+  memFree(MEM_OTHER, targetCode, maxVars * sizeof(CodeAddress));
+  memFree(MEM_OTHER, targetTokens, maxVars * sizeof(Token));
+  memFree(MEM_OTHER, steps, varCount * sizeof(AssignStep));
+  for (i = 0; i < varCount; i++)
+    freeAssignPair(&pairs[i]);
+  memFree(MEM_OTHER, pairs, maxVars * sizeof(AssignPair));
+  memFree(MEM_OTHER, varTypes, maxVars * sizeof(Type *));
+}
+
+// The operation of a compound assignment, between the old value and the new
+void genAssignOperation(TokenType assignOp)
+{
+  switch (assignOp)
+  {
+  case SB_ASSIGN_PLUS:
+    genAD();
+    break;
+  case SB_ASSIGN_SUBTRACT:
+    genSB();
+    break;
+  case SB_ASSIGN_TIMES:
+    genML();
+    break;
+  case SB_ASSIGN_DIVIDE:
+    genDV();
+    break;
+  default:
+    break;
+  }
 }
 
 void compileGroupSt(void)
@@ -669,12 +759,22 @@ void compileGroupSt(void)
 
 void compileIfSt(void)
 {
+  CodeAddress fjump, jump;
+
   eat(KW_IF);
   compileCondition();
   eat(KW_THEN);
+  fjump = genFJ(DC_VALUE);
   compileStatement();
   if (lookAhead->tokenType == KW_ELSE)
+  {
+    jump = genJ(DC_VALUE);
+    updateJump(fjump, getCurrentCodeAddress());
     compileElseSt();
+    updateJump(jump, getCurrentCodeAddress());
+  }
+  else
+    updateJump(fjump, getCurrentCodeAddress());
 }
 
 void compileElseSt(void)
@@ -685,10 +785,16 @@ void compileElseSt(void)
 
 void compileWhileSt(void)
 {
+  CodeAddress begin = getCurrentCodeAddress();
+  CodeAddress fjump;
+
   eat(KW_WHILE);
   compileCondition();
+  fjump = genFJ(DC_VALUE);
   eat(KW_DO);
   compileStatement();
+  genJ(begin);
+  updateJump(fjump, getCurrentCodeAddress());
 }
 
 void compileForSt(void)
@@ -696,26 +802,47 @@ void compileForSt(void)
   //*** TODO: Check type consistency of FOR's variable
   Object *var;
   Type *type;
+  CodeAddress begin, fjump;
 
   eat(KW_FOR);
   eat(TK_IDENT);
 
   // check if the identifier is a variable
-  var = checkDeclaredVariable(currentToken->string);
-  checkForStType(var->varAttrs->type);
+  var = checkDeclaredVariable(currentToken->string, XREF_WRITE);
+  checkForStType(var->varAttrs.type);
+
+  // The address of the variable stays on the stack for the whole loop
+  genVariableAddress(var);
+  genCV();
   eat(SB_ASSIGN);
   type = compileExpression();
   checkForStType(type);
+  genST();
 
-  checkTypeEquality(var->varAttrs->type, type);
+  checkTypeEquality(var->varAttrs.type, type);
 
+  begin = getCurrentCodeAddress();
+  genCV();
+  genLI();
   eat(KW_TO);
   type = compileExpression();
   checkForStType(type);
-  checkTypeEquality(var->varAttrs->type, type);
+  checkTypeEquality(var->varAttrs.type, type);
+  genLE();
+  fjump = genFJ(DC_VALUE);
 
   eat(KW_DO);
   compileStatement();
+
+  genCV();
+  genCV();
+  genLI();
+  genLC(1);
+  genAD();
+  genST();
+  genJ(begin);
+  updateJump(fjump, getCurrentCodeAddress());
+  genDCT(1);
 }
 
 void compileArgument(Object *param)
@@ -724,15 +851,15 @@ void compileArgument(Object *param)
   //       If the corresponding parameter is a reference, the argument must be a lvalue
   Type *type;
 
-  if (param->paramAttrs->kind == PARAM_VALUE)
+  if (param->paramAttrs.kind == PARAM_VALUE)
   {
     type = compileExpression();
-    checkTypeEquality(type, param->paramAttrs->type);
+    checkTypeEquality(type, param->paramAttrs.type);
   }
   else
   {
     type = compileLValue();
-    checkTypeEquality(type, param->paramAttrs->type);
+    checkTypeEquality(type, param->paramAttrs.type);
   }
 }
 
@@ -801,11 +928,13 @@ void compileCondition(void)
   //*** TODO: check the type consistency of LHS and RSH, check the basic type
   Type *type1;
   Type *type2;
+  TokenType op;
 
   type1 = compileExpression();
   checkBasicType(type1);
 
-  switch (lookAhead->tokenType)
+  op = lookAhead->tokenType;
+  switch (op)
   {
   case SB_EQ:
     eat(SB_EQ);
@@ -831,6 +960,95 @@ void compileCondition(void)
 
   type2 = compileExpression();
   checkTypeEquality(type1, type2);
+
+  switch (op)
+  {
+  case SB_EQ:
+    genEQ();
+    break;
+  case SB_NEQ:
+    genNE();
+    break;
+  case SB_LE:
+    genLE();
+    break;
+  case SB_LT:
+    genLT();
+    break;
+  case SB_GE:
+    genGE();
+    break;
+  default:
+    genGT();
+    break;
+  }
+}
+
+// Fold left op (the expression just compiled) when both operands are integer constants
+void foldOperation(int leftConstant, ConstantValue *left, TokenType op)
+{
+  unsigned a, b;
+
+  if (!leftConstant || !exprConstant || (left->type != TP_INT) || (exprValue.type != TP_INT))
+  {
+    exprConstant = 0;
+    return;
+  }
+
+  a = (unsigned)left->intValue;
+  b = (unsigned)exprValue.intValue;
+  switch (op)
+  {
+  case SB_PLUS:
+    exprValue.intValue = (int)(a + b);
+    break;
+  case SB_MINUS:
+    exprValue.intValue = (int)(a - b);
+    break;
+  case SB_TIMES:
+    exprValue.intValue = (int)(a * b);
+    break;
+  case SB_SLASH:
+    if (exprValue.intValue == 0)
+      error(ERR_DIVISION_BY_ZERO, currentToken->lineNo, currentToken->colNo);
+    // As the VM does, the most negative integer divided by -1 wraps around
+    if (exprValue.intValue == -1)
+      exprValue.intValue = (int)(0u - a);
+    else
+      exprValue.intValue = left->intValue / exprValue.intValue;
+    break;
+  default:
+    break;
+  }
+}
+
+// Emit op for the two operands just compiled, or replace them by their folded value
+void genOperation(CodeAddress leftStart, TokenType op)
+{
+  if (exprConstant)
+  {
+    rewindCode(leftStart);
+    genConstant(&exprValue);
+  }
+  else
+  {
+    switch (op)
+    {
+    case SB_PLUS:
+      genAD();
+      break;
+    case SB_MINUS:
+      genSB();
+      break;
+    case SB_TIMES:
+      genML();
+      break;
+    default:
+      genDV();
+      break;
+    }
+  }
+  exprStart = leftStart;
 }
 
 Type *compileExpression(void)
@@ -845,9 +1063,19 @@ Type *compileExpression(void)
     checkExpressionType(type);
     break;
   case SB_MINUS:
+    // The sign applies to the first term only: -A + B is (-A) + B
     eat(SB_MINUS);
-    type = compileExpression2();
+    type = compileTerm();
     checkExpressionType(type);
+    if (exprConstant)
+    {
+      exprValue.intValue = (int)(0u - (unsigned)exprValue.intValue);
+      rewindCode(exprStart);
+      genConstant(&exprValue);
+    }
+    else
+      genNEG();
+    compileExpression3();
     break;
   // case TK_STRING:
   //   if (currentToken->tokenType != SB_ASSIGN)
@@ -877,6 +1105,9 @@ Type *compileExpression2(void)
 Type *compileExpression3(void)
 {
   Type *type;
+  int leftConstant = exprConstant;
+  ConstantValue left = exprValue;
+  CodeAddress leftStart = exprStart;
 
   switch (lookAhead->tokenType)
   {
@@ -885,6 +1116,8 @@ Type *compileExpression3(void)
     type = compileTerm();
     checkExpressionType(type);
     // checkIntType(type);
+    foldOperation(leftConstant, &left, SB_PLUS);
+    genOperation(leftStart, SB_PLUS);
     compileExpression3();
     break;
   case SB_MINUS:
@@ -892,6 +1125,8 @@ Type *compileExpression3(void)
     type = compileTerm();
     checkExpressionType(type);
     // checkIntType(type);
+    foldOperation(leftConstant, &left, SB_MINUS);
+    genOperation(leftStart, SB_MINUS);
     compileExpression3();
     break;
     // check the FOLLOW set
@@ -930,6 +1165,9 @@ Type *compileTerm(void)
 void compileTerm2(void)
 {
   Type *type;
+  int leftConstant = exprConstant;
+  ConstantValue left = exprValue;
+  CodeAddress leftStart = exprStart;
 
   switch (lookAhead->tokenType)
   {
@@ -938,6 +1176,8 @@ void compileTerm2(void)
     type = compileFactor();
     checkExpressionType(type);
     // checkIntType(type);
+    foldOperation(leftConstant, &left, SB_TIMES);
+    genOperation(leftStart, SB_TIMES);
     compileTerm2();
     break;
   case SB_SLASH:
@@ -945,6 +1185,8 @@ void compileTerm2(void)
     type = compileFactor();
     checkExpressionType(type);
     // checkIntType(type);
+    foldOperation(leftConstant, &left, SB_SLASH);
+    genOperation(leftStart, SB_SLASH);
     compileTerm2();
     break;
     // check the FOLLOW set
@@ -978,16 +1220,32 @@ Type *compileFactor(void)
   Object *obj;
   Type *type;
   int check = 0;
+  int constant = 0;
+  ConstantValue value;
+  CodeAddress start = getCurrentCodeAddress();
 
   switch (lookAhead->tokenType)
   {
   case TK_NUMBER:
     eat(TK_NUMBER);
     type = intType;
+    constant = 1;
+    value.type = TP_INT;
+    value.intValue = currentToken->value;
+    genConstant(&value);
     break;
   case TK_CHAR:
     eat(TK_CHAR);
     type = charType;
+    constant = 1;
+    value.type = TP_CHAR;
+    value.charValue = currentToken->string[0];
+    genConstant(&value);
+    break;
+  case KW_SUM:
+    type = compileSumSt();
+    constant = exprConstant;
+    value = exprValue;
     break;
   case TK_IDENT:
     if (currentToken->tokenType != SB_ASSIGN)
@@ -1001,7 +1259,7 @@ Type *compileFactor(void)
     switch (obj->kind)
     {
     case OBJ_CONSTANT:
-      switch (obj->constAttrs->value->type)
+      switch (obj->constAttrs.value.type)
       {
       case TP_INT:
         type = intType;
@@ -1012,13 +1270,20 @@ Type *compileFactor(void)
       default:
         break;
       }
+      constant = 1;
+      value = obj->constAttrs.value;
+      genConstant(&value);
       break;
     case OBJ_VARIABLE:
-      if (obj->varAttrs->type->typeClass == TP_ARRAY)
+      noteRead(obj);
+      if (obj->varAttrs.type->typeClass == TP_ARRAY)
       {
+        // An array without indexes stands for its address
+        genVariableAddress(obj);
         if (lookAhead->tokenType == SB_LSEL)
         {
-          type = compileIndexes(obj->varAttrs->type);
+          type = compileIndexes(obj->varAttrs.type);
+          genLI();
         }
         else
         {
@@ -1027,20 +1292,34 @@ Type *compileFactor(void)
             error(ERR_OPERATOR_ASSIGN_WITH_CHAR_OR_STRING, currentToken->lineNo, currentToken->colNo);
           }
           else
-            type = obj->varAttrs->type;
+            type = obj->varAttrs.type;
         }
       }
       else
       {
-        type = obj->varAttrs->type;
+        genVariableValue(obj);
+        type = obj->varAttrs.type;
       }
       break;
     case OBJ_PARAMETER:
-      type = obj->paramAttrs->type;
+      noteRead(obj);
+      genParameterValue(obj);
+      type = obj->paramAttrs.type;
       break;
     case OBJ_FUNCTION:
-      compileArguments(obj->funcAttrs->paramList);
-      type = obj->funcAttrs->returnType;
+      noteCall();
+      if (isPredefinedFunction(obj))
+      {
+        compileArguments(obj->funcAttrs.paramList);
+        genPredefinedFunctionCall(obj);
+      }
+      else
+      {
+        genINT(RESERVED_WORDS);
+        compileArguments(obj->funcAttrs.paramList);
+        genFunctionCall(obj);
+      }
+      type = obj->funcAttrs.returnType;
       break;
     default:
       error(ERR_INVALID_FACTOR, currentToken->lineNo, currentToken->colNo);
@@ -1051,49 +1330,142 @@ Type *compileFactor(void)
     error(ERR_INVALID_FACTOR, lookAhead->lineNo, lookAhead->colNo);
   }
 
+  // Set last: indexes and arguments compiled above are expressions too
+  exprConstant = constant;
+  exprValue = value;
+  exprStart = start;
   return type;
 }
 
+// Follows the LA of the array: the constant part of the offset is added to that LA
 Type *compileIndexes(Type *arrayType)
 {
   Type *type;
+  Instruction *base;
+  CodeAddress baseAddress = getCurrentCodeAddress() - 1;
+  CodeAddress start;
+  unsigned offset = 0;
+  int elementSize;
   //*** TODO: parse a sequence of indexes, check the consistency to the arrayType, and return the element type
   while (lookAhead->tokenType == SB_LSEL)
   {
     eat(SB_LSEL);
+    start = getCurrentCodeAddress();
     type = compileExpression();
     checkIntType(type);
     checkArrayType(arrayType);
+    // Indexes start at 1
+    elementSize = sizeOfType(arrayType->elementType);
+    if (exprConstant)
+    {
+      rewindCode(start);
+      offset += ((unsigned)exprValue.intValue - 1) * elementSize;
+    }
+    else
+    {
+      if (elementSize != 1)
+      {
+        genLC(elementSize);
+        genML();
+      }
+      genAD();
+      offset -= elementSize;
+    }
     arrayType = arrayType->elementType;
     eat(SB_RSEL);
   }
 
+  base = getInstruction(baseAddress);
+  base->q = (int)((unsigned)base->q + offset);
   checkBasicType(arrayType);
   return arrayType;
 }
 
 Type *compileSumSt(void)
 {
-  Type *type1;
-  Type *type2;
+  Type *type;
+  Object *obj;
+  int constant;
+  unsigned sum;
+  CodeAddress start = getCurrentCodeAddress();
+
   eat(KW_SUM);
-  type1 = compileExpression();
-  if (lookAhead->tokenType == SB_COMMA)
+  exprConstant = 0;
+
+  obj = (lookAhead->tokenType == TK_IDENT) ? lookupObject(lookAhead->string) : NULL;
+  if ((obj != NULL) && (obj->kind == OBJ_VARIABLE) && (obj->varAttrs.type->typeClass == TP_ARRAY))
   {
-    while (lookAhead->tokenType == SB_COMMA)
+    eat(TK_IDENT);
+    recordUse(obj, XREF_READ);
+    noteRead(obj);
+    genVariableAddress(obj);
+
+    // SUM A: every element of an integer array
+    if (lookAhead->tokenType != SB_LSEL)
     {
-      eat(SB_COMMA);
-      type2 = compileExpression();
-      checkTypeEquality(type1, type2);
+      checkIntArrayType(obj->varAttrs.type);
+      genLC(sizeOfType(obj->varAttrs.type));
+      genSUM();
+      exprConstant = 0;
+      return intType;
     }
+
+    // SUM A(.i.) TO A(.j.): the elements stored from A(.i.) to A(.j.)
+    type = compileIndexes(obj->varAttrs.type);
+    checkIntType(type);
+    genCV();
+    eat(KW_TO);
+    eat(TK_IDENT);
+    if (checkDeclaredVariable(currentToken->string, XREF_READ) != obj)
+      error(ERR_INVALID_SUM_RANGE, currentToken->lineNo, currentToken->colNo);
+    genVariableAddress(obj);
+    type = compileIndexes(obj->varAttrs.type);
+    checkIntType(type);
+    // The count of elements from the first address to the second, both included
+    genSB();
+    genNEG();
+    genLC(1);
+    genAD();
+    genSUM();
+    // The indexes may have been constants: the sum is not
+    exprConstant = 0;
+    return intType;
   }
-  else
-    error(ERR_INVALID_EXPRESSION, lookAhead->lineNo, lookAhead->colNo);
-  return type1;
+
+  // SUM (E1, E2, ...): the list is closed, so that a SUM can be one of the
+  // arguments of a call or of the sources of a multiple assignment
+  eat(SB_LPAR);
+  type = compileExpression();
+  checkIntType(type);
+  constant = exprConstant;
+  sum = (unsigned)exprValue.intValue;
+
+  while (lookAhead->tokenType == SB_COMMA)
+  {
+    eat(SB_COMMA);
+    type = compileExpression();
+    checkIntType(type);
+    genAD();
+    constant = constant && exprConstant;
+    sum += (unsigned)exprValue.intValue;
+  }
+  eat(SB_RPAR);
+
+  exprConstant = constant;
+  exprValue.type = TP_INT;
+  exprValue.intValue = (int)sum;
+  if (constant)
+  {
+    rewindCode(start);
+    genConstant(&exprValue);
+  }
+  return intType;
 }
 
 int compile(char *fileName)
 {
+  char *interfaceName;
+
   if (openInputStream(fileName) == IO_ERROR)
     return IO_ERROR;
 
@@ -1101,15 +1473,59 @@ int compile(char *fileName)
   lookAhead = getValidToken();
 
   initSymTab();
+  setModulePath(fileName);
+  initCodeBuffer();
 
   compileProgram();
 
   printObject(symtab->program, 0);
 
+  if (xrefEnabled)
+  {
+    printXrefs();
+    freeXrefs();
+  }
+
+  if ((symFileName != NULL) && (saveSymFile(symFileName) == IO_ERROR))
+    printf("Can\'t write symbol file %s!\n", symFileName);
+
+  if (symtab->program->kind == OBJ_MODULE)
+  {
+    interfaceName = interfaceFileName(symtab->program->name);
+    if (saveInterfaceFile(interfaceName) == IO_ERROR)
+      printf("Can\'t write interface file %s!\n", interfaceName);
+    free(interfaceName);
+  }
+
+  // Every backend takes the optimized code
+  if (optimizing && (symtab->importList == NULL) && ((codeFileName != NULL) || (cFileName != NULL) || dumpIr))
+    optimizeCode();
+
+  if (codeFileName != NULL)
+  {
+    // Modules are only checked: calls into one would need its code too
+    if (symtab->importList != NULL)
+      printf("Can\'t write code file %s: a program using modules is only checked!\n", codeFileName);
+    else if ((assemblyOutput ? serializeAssembly(codeFileName) : serialize(codeFileName)) == IO_ERROR)
+      printf("Can\'t write code file %s!\n", codeFileName);
+  }
+
+  if (cFileName != NULL)
+  {
+    if (symtab->importList != NULL)
+      printf("Can\'t write C file %s: a program using modules is only checked!\n", cFileName);
+    else if (serializeC(cFileName) == IO_ERROR)
+      printf("Can\'t write C file %s!\n", cFileName);
+  }
+
+  cleanCodeBuffer();
   cleanSymTab();
 
-  free(currentToken);
-  free(lookAhead);
+  freeToken(currentToken);
+  freeToken(lookAhead);
   closeInputStream();
+
+  if (memStats)
+    printMemStats();
   return IO_SUCCESS;
 }
\ No newline at end of file
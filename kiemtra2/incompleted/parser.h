@@ -7,16 +7,32 @@
 #define __PARSER_H__
 #include "token.h"
 #include "symtab.h"
+#include "instructions.h"
+
+extern int declsOnly;
+extern char *symFileName;
+extern char *codeFileName;
+extern int assemblyOutput;
+extern char *cFileName;
+
+/* Whether the expression compiled last is a compile-time constant, and
+ * its value if so. Literals and CONST names are constants, and so are
+ * sums, differences, products, quotients and SUM lists of integer
+ * constants. */
+extern int exprConstant;
+extern ConstantValue exprValue;
 
 void scan(void);
 void eat(TokenType tokenType);
 
 void compileProgram(void);
+void compileUses(void);
 void compileBlock(void);
 void compileBlock2(void);
 void compileBlock3(void);
 void compileBlock4(void);
 void compileBlock5(void);
+void skipStatements(void);
 void compileConstDecls(void);
 void compileConstDecl(void);
 void compileTypeDecls(void);
@@ -26,9 +42,7 @@ void compileVarDecl(void);
 void compileSubDecls(void);
 void compileFuncDecl(void);
 void compileProcDecl(void);
-ConstantValue *compileUnsignedConstant(void);
 ConstantValue *compileConstant(void);
-ConstantValue *compileConstant2(void);
 Type *compileType(void);
 Type *compileBasicType(void);
 void compileParams(void);
@@ -36,7 +50,9 @@ void compileParam(void);
 void compileStatements(void);
 void compileStatement(void);
 Type *compileLValue(void);
+TokenType compileAssign(void);
 void compileAssignSt(void);
+void genAssignOperation(TokenType assignOp);
 void compileCallSt(void);
 void compileGroupSt(void);
 void compileIfSt(void);
@@ -46,6 +62,8 @@ void compileForSt(void);
 void compileArgument(Object *param);
 void compileArguments(ObjectNode *paramList);
 void compileCondition(void);
+void foldOperation(int leftConstant, ConstantValue *left, TokenType op);
+void genOperation(CodeAddress leftStart, TokenType op);
 Type *compileExpression(void);
 Type *compileExpression2(void);
 Type *compileExpression3(void);
@@ -0,0 +1,749 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "passes.h"
+#include "lower.h"
+#include "symtab.h"
+
+int optimizing = 1;
+int timePasses = 0;
+int dumpIr = 0;
+
+IrPass irPasses[] = {
+  { "promote", promoteVariables },
+  { "sccp", propagateConstants },
+  { "gvn", numberValues },
+  { "dce", eliminateDeadCode }
+};
+
+#define PASS_COUNT ((int) (sizeof(irPasses) / sizeof(IrPass)))
+
+/******************* Promotion ******************************/
+
+// The label of the block p levels out from the one at label: its subroutines come before it
+int passOuterLabel(IrProgram *program, int label, int p) {
+  int level, next;
+
+  for (; p > 0; p--) {
+    level = program->frames[label].level;
+    for (next = label + 1; next < program->functionCount; next++)
+      if (program->frames[next].level == level - 1)
+        break;
+    if (next == program->functionCount)
+      return -1;
+    label = next;
+  }
+  return label;
+}
+
+// Word q of the frame at label is reached some other way than by its own loads and stores
+void passEscape(IrProgram *program, char **escaped, int label, WORD q) {
+  if ((label >= 0) && (q >= 0) && (q < program->functions[label]->frameSize))
+    escaped[label][q] = 1;
+}
+
+// Whether instr loads or stores the word at its first argument, which is the address of word q of the frame
+int passAccessesWord(IrInstr *instr, WORD *q) {
+  IrInstr *address;
+
+  if ((instr->op == IR_LV) && (instr->p == 0)) {
+    *q = instr->q;
+    return 1;
+  }
+  if ((instr->op != IR_LI) && (instr->op != IR_ST))
+    return 0;
+  address = irResolve(instr->args[0]);
+  if ((address->op != IR_LA) || (address->p != 0))
+    return 0;
+  *q = address->q;
+  return 1;
+}
+
+int promoteFunction(IrFunction *fn, char *escaped) {
+  IrBlock *entry = fn->blocks[0];
+  IrBlock *block;
+  IrInstr *instr, *next, *position, *value;
+  int *varOf = (int*) malloc(fn->frameSize * sizeof(int));
+  int *varWords = (int*) malloc(fn->frameSize * sizeof(int));
+  int varCount = 0, count = 0, b;
+  WORD q;
+
+  for (q = 0; q < fn->frameSize; q++) {
+    varOf[q] = -1;
+    if ((q >= RESERVED_WORDS) && (fn->frame->slots[q] != IRT_NONE) && !escaped[q]) {
+      varOf[q] = varCount;
+      varWords[varCount++] = q;
+      fn->promoted[q] = 1;
+    }
+  }
+  if (varCount > 0) {
+    irBeginRenaming(fn, varCount, varWords);
+    // The variables start as the words of the frame
+    position = entry->first;
+    for (b = 0; b < varCount; b++) {
+      value = irNewInstr(fn, IR_ENTRY, fn->frame->slots[varWords[b]], 0, varWords[b], 0);
+      irInsertBefore(position, value);
+      irWriteVariable(b, entry, value);
+    }
+    for (b = 0; b < fn->blockCount; b++) {
+      block = fn->blocks[b];
+      for (instr = block->first; instr != NULL; instr = next) {
+        next = instr->next;
+        if (!passAccessesWord(instr, &q) || (q < 0) || (q >= fn->frameSize) || (varOf[q] < 0))
+          continue;
+        if (instr->op == IR_ST) {
+          irWriteVariable(varOf[q], block, irResolve(instr->args[1]));
+          irRemove(instr);
+        } else irReplace(instr, irReadVariable(varOf[q], block));
+        count++;
+      }
+      irFillBlock(block);
+    }
+    irEndRenaming();
+  }
+  free(varOf);
+  free(varWords);
+  return count;
+}
+
+/* A word can be promoted when it is only loaded and stored in its own
+ * frame: neither a block nested in it reaches it through a static link
+ * nor does its address go anywhere but to LI or ST. */
+int promoteVariables(IrProgram *program) {
+  char **escaped = (char**) malloc(program->functionCount * sizeof(char*));
+  IrFunction *fn;
+  IrInstr *instr, *arg;
+  int label, b, k, count = 0;
+
+  for (label = 0; label < program->functionCount; label++)
+    escaped[label] = (char*) calloc(program->functions[label]->frameSize, sizeof(char));
+  for (label = 0; label < program->functionCount; label++) {
+    fn = program->functions[label];
+    for (b = 0; b < fn->blockCount; b++)
+      for (instr = fn->blocks[b]->first; instr != NULL; instr = instr->next) {
+        if (((instr->op == IR_LA) || (instr->op == IR_LV)) && (instr->p > 0))
+          passEscape(program, escaped, passOuterLabel(program, label, instr->p), instr->q);
+        for (k = 0; k < instr->argCount; k++) {
+          arg = irResolve(instr->args[k]);
+          if ((arg->op == IR_LA) && (arg->p == 0) &&
+              !((k == 0) && ((instr->op == IR_LI) || (instr->op == IR_ST))))
+            passEscape(program, escaped, label, arg->q);
+        }
+      }
+  }
+  for (label = 0; label < program->functionCount; label++) {
+    count += promoteFunction(program->functions[label], escaped[label]);
+    free(escaped[label]);
+  }
+  free(escaped);
+  return count;
+}
+
+/******************* Constant propagation ******************************/
+
+/* Wegman and Zadeck's sparse conditional constant propagation. A value
+ * is unknown until it is evaluated, then a constant, then anything; only
+ * the edges found to be taken carry values to the phis. */
+
+#define LATTICE_UNKNOWN 0
+#define LATTICE_CONSTANT 1
+#define LATTICE_ANY 2
+
+char *sccpStates;
+WORD *sccpConstants;
+char *sccpVisited;          // by block id
+char *sccpEdges;            // by block id, two per block
+IrUses *sccpUses;
+IrInstr **sccpValueWork;
+int sccpValueCount;
+IrBlock **sccpBlockWork;
+int sccpBlockCount;
+
+// The result of the operation as the machine computes it, which wraps around
+WORD passFold(enum IrOp op, WORD a, WORD b) {
+  switch (op) {
+  case IR_AD:
+    return (WORD) ((unsigned) a + (unsigned) b);
+  case IR_SB:
+    return (WORD) ((unsigned) a - (unsigned) b);
+  case IR_ML:
+    return (WORD) ((unsigned) a * (unsigned) b);
+  case IR_DV:
+    return (b == -1) ? (WORD) (0u - (unsigned) a) : a / b;
+  case IR_NEG:
+    return (WORD) (0u - (unsigned) a);
+  case IR_EQ:
+    return a == b;
+  case IR_NE:
+    return a != b;
+  case IR_GT:
+    return a > b;
+  case IR_LT:
+    return a < b;
+  case IR_GE:
+    return a >= b;
+  default:
+    return a <= b;
+  }
+}
+
+void sccpMarkEdge(IrBlock *block, int succ) {
+  if (sccpEdges[block->id * 2 + succ])
+    return;
+  sccpEdges[block->id * 2 + succ] = 1;
+  sccpBlockWork[sccpBlockCount++] = block->succs[succ];
+}
+
+int sccpEdgeTaken(IrBlock *pred, IrBlock *block) {
+  return sccpEdges[pred->id * 2 + ((pred->succs[0] == block) ? 0 : 1)];
+}
+
+void sccpEvaluate(IrInstr *instr) {
+  IrInstr *arg;
+  int state = LATTICE_UNKNOWN;
+  WORD constant = 0, a = 0;
+  int k, id = instr->id;
+
+  if (instr->op == IR_J) {
+    sccpMarkEdge(instr->block, 0);
+    return;
+  }
+  if (instr->op == IR_FJ) {
+    arg = instr->args[0];
+    if (sccpStates[arg->id] == LATTICE_ANY) {
+      sccpMarkEdge(instr->block, 0);
+      sccpMarkEdge(instr->block, 1);
+    } else if (sccpStates[arg->id] == LATTICE_CONSTANT)
+      sccpMarkEdge(instr->block, (sccpConstants[arg->id] == 0) ? 1 : 0);
+    return;
+  }
+  if ((instr->type == IRT_NONE) || (sccpStates[id] == LATTICE_ANY))
+    return;
+
+  switch (instr->op) {
+  case IR_CONST:
+    state = LATTICE_CONSTANT;
+    constant = instr->q;
+    break;
+  case IR_PHI:
+    for (k = 0; (k < instr->argCount) && (state != LATTICE_ANY); k++) {
+      if (!sccpEdgeTaken(instr->block->preds[k], instr->block))
+        continue;
+      arg = instr->args[k];
+      if (sccpStates[arg->id] == LATTICE_ANY)
+        state = LATTICE_ANY;
+      else if (sccpStates[arg->id] == LATTICE_CONSTANT) {
+        if (state == LATTICE_UNKNOWN) {
+          state = LATTICE_CONSTANT;
+          constant = sccpConstants[arg->id];
+        } else if (constant != sccpConstants[arg->id])
+          state = LATTICE_ANY;
+      }
+    }
+    break;
+  case IR_AD:
+  case IR_SB:
+  case IR_ML:
+  case IR_DV:
+  case IR_NEG:
+  case IR_EQ:
+  case IR_NE:
+  case IR_GT:
+  case IR_LT:
+  case IR_GE:
+  case IR_LE:
+    state = LATTICE_CONSTANT;
+    for (k = 0; k < instr->argCount; k++) {
+      arg = instr->args[k];
+      if (sccpStates[arg->id] == LATTICE_ANY) {
+        state = LATTICE_ANY;
+        break;
+      }
+      if (sccpStates[arg->id] == LATTICE_UNKNOWN)
+        state = LATTICE_UNKNOWN;
+    }
+    if (state == LATTICE_CONSTANT) {
+      a = sccpConstants[instr->args[0]->id];
+      if (instr->argCount == 1)
+        constant = passFold(instr->op, a, 0);
+      else if ((instr->op == IR_DV) && (sccpConstants[instr->args[1]->id] == 0))
+        state = LATTICE_ANY;    // left to fail when it runs
+      else constant = passFold(instr->op, a, sccpConstants[instr->args[1]->id]);
+    }
+    break;
+  default:
+    state = LATTICE_ANY;
+  }
+
+  if (state > sccpStates[id]) {
+    sccpStates[id] = state;
+    sccpConstants[id] = constant;
+    for (k = sccpUses->starts[id]; k < sccpUses->starts[id + 1]; k++)
+      sccpValueWork[sccpValueCount++] = sccpUses->users[k];
+  }
+}
+
+int propagateFunction(IrFunction *fn) {
+  IrBlock *block;
+  IrInstr *instr, *next, *constant;
+  IrBlock **dead;
+  int deadCount = 0, count = 0, b, k, taken;
+
+  irResolveArgs(fn);
+  sccpStates = (char*) calloc(fn->valueCount, sizeof(char));
+  sccpConstants = (WORD*) calloc(fn->valueCount, sizeof(WORD));
+  sccpVisited = (char*) calloc(fn->blockIds, sizeof(char));
+  sccpEdges = (char*) calloc(fn->blockIds * 2, sizeof(char));
+  sccpUses = irComputeUses(fn);
+  // A value is pushed again each time one of its arguments goes down, at most twice per use
+  sccpValueWork = (IrInstr**) malloc((2 * sccpUses->starts[fn->valueCount] + fn->valueCount + 1) * sizeof(IrInstr*));
+  sccpBlockWork = (IrBlock**) malloc((2 * fn->blockIds + 1) * sizeof(IrBlock*));
+  sccpValueCount = 0;
+  sccpBlockCount = 0;
+
+  sccpBlockWork[sccpBlockCount++] = fn->blocks[0];
+  while ((sccpBlockCount > 0) || (sccpValueCount > 0)) {
+    if (sccpBlockCount > 0) {
+      block = sccpBlockWork[--sccpBlockCount];
+      for (instr = block->first; instr != NULL; instr = instr->next)
+        if (!sccpVisited[block->id] || (instr->op == IR_PHI))
+          sccpEvaluate(instr);
+      sccpVisited[block->id] = 1;
+    } else {
+      instr = sccpValueWork[--sccpValueCount];
+      if (sccpVisited[instr->block->id])
+        sccpEvaluate(instr);
+    }
+  }
+
+  // A condition still unknown would leave its jump without a way to go
+  for (b = 0; b < fn->blockCount; b++) {
+    block = fn->blocks[b];
+    if (sccpVisited[block->id] && (block->last->op == IR_FJ) &&
+        (sccpStates[block->last->args[0]->id] == LATTICE_UNKNOWN))
+      break;
+  }
+  if (b == fn->blockCount) {
+    dead = (IrBlock**) malloc(fn->blockCount * sizeof(IrBlock*));
+    for (b = 0; b < fn->blockCount; b++) {
+      block = fn->blocks[b];
+      if (!sccpVisited[block->id]) {
+        dead[deadCount++] = block;
+        continue;
+      }
+      instr = block->last;
+      if ((instr->op == IR_FJ) && (sccpStates[instr->args[0]->id] == LATTICE_CONSTANT)) {
+        taken = (sccpConstants[instr->args[0]->id] == 0) ? 1 : 0;
+        irRemoveEdge(block, 1 - taken);
+        instr->op = IR_J;
+        instr->argCount = 0;
+        count++;
+      }
+      for (instr = block->first; instr != NULL; instr = next) {
+        next = instr->next;
+        if ((instr->type == IRT_NONE) || (instr->op == IR_CONST) || (sccpStates[instr->id] != LATTICE_CONSTANT))
+          continue;
+        constant = irNewInstr(fn, IR_CONST, instr->type, 0, sccpConstants[instr->id], 0);
+        if (instr->op == IR_PHI)
+          irInsertAfterPhis(block, constant);
+        else irInsertBefore(instr, constant);
+        irReplace(instr, constant);
+        count++;
+      }
+    }
+    for (k = 0; k < deadCount; k++)
+      irRemoveBlock(fn, dead[k]);
+    count += deadCount;
+    free(dead);
+    irSimplifyPhis(fn);
+  }
+
+  free(sccpStates);
+  free(sccpConstants);
+  free(sccpVisited);
+  free(sccpEdges);
+  free(sccpValueWork);
+  free(sccpBlockWork);
+  irFreeUses(sccpUses);
+  return count;
+}
+
+int propagateConstants(IrProgram *program) {
+  int label, count = 0;
+
+  for (label = 0; label < program->functionCount; label++)
+    count += propagateFunction(program->functions[label]);
+  return count;
+}
+
+/******************* Value numbering ******************************/
+
+/* The blocks are walked down the dominator tree, with a table of the
+ * operations seen on the way from the entry. An operation reads no
+ * memory and has no effect but, perhaps, to fail dividing by zero,
+ * which its dominating twin would have done first. */
+
+#define GVN_BUCKETS 1024
+
+struct GvnEntry_ {
+  IrInstr *instr;
+  int bucket;               // as hashed then: a phi's arguments may be replaced since
+  int next;
+};
+
+typedef struct GvnEntry_ GvnEntry;
+
+GvnEntry *gvnEntries;
+int gvnEntryCount;
+int gvnBuckets[GVN_BUCKETS];
+
+int gvnNumbered(IrInstr *instr) {
+  return (instr->op == IR_DV) || ((instr->op != IR_UNDEF) && irIsPure(instr));
+}
+
+int gvnCommutative(enum IrOp op) {
+  return (op == IR_AD) || (op == IR_ML) || (op == IR_EQ) || (op == IR_NE);
+}
+
+// The arguments of instr in the order they are compared in
+IrInstr* gvnArg(IrInstr *instr, int k) {
+  IrInstr *a, *b;
+
+  if (!gvnCommutative(instr->op))
+    return irResolve(instr->args[k]);
+  a = irResolve(instr->args[0]);
+  b = irResolve(instr->args[1]);
+  if (a->id > b->id)
+    return (k == 0) ? b : a;
+  return (k == 0) ? a : b;
+}
+
+unsigned gvnHash(IrInstr *instr) {
+  unsigned hash = instr->op * 31u + (unsigned) instr->p * 17u + (unsigned) instr->q;
+  int k;
+
+  if (instr->op == IR_PHI)
+    hash = hash * 31u + instr->block->id;
+  for (k = 0; k < instr->argCount; k++)
+    hash = hash * 31u + gvnArg(instr, k)->id;
+  return hash % GVN_BUCKETS;
+}
+
+int gvnSame(IrInstr *a, IrInstr *b) {
+  int k;
+
+  if ((a->op != b->op) || (a->p != b->p) || (a->q != b->q) || (a->argCount != b->argCount))
+    return 0;
+  if ((a->op == IR_PHI) && (a->block != b->block))
+    return 0;
+  for (k = 0; k < a->argCount; k++)
+    if (gvnArg(a, k) != gvnArg(b, k))
+      return 0;
+  return 1;
+}
+
+int numberFunction(IrFunction *fn) {
+  IrBlock **order = (IrBlock**) malloc(fn->blockCount * sizeof(IrBlock*));
+  int *rpo = (int*) malloc(fn->blockIds * sizeof(int));
+  IrBlock **idom = (IrBlock**) calloc(fn->blockIds, sizeof(IrBlock*));
+  int *firstChild = (int*) malloc(fn->blockIds * sizeof(int));
+  int *nextSibling = (int*) malloc(fn->blockIds * sizeof(int));
+  IrBlock **byId = (IrBlock**) calloc(fn->blockIds, sizeof(IrBlock*));
+  int *stack, *marks;
+  IrBlock *block, *dom, *a, *b;
+  IrInstr *instr, *next;
+  int count = 0, blocks, changed, top, i, k, bucket, entry, id;
+
+  blocks = irReversePostorder(fn, order);
+  for (i = 0; i < fn->blockIds; i++) {
+    rpo[i] = -1;
+    firstChild[i] = -1;
+  }
+  for (i = 0; i < blocks; i++) {
+    rpo[order[i]->id] = i;
+    byId[order[i]->id] = order[i];
+  }
+
+  // Dominators, as Cooper, Harvey and Kennedy find them
+  idom[order[0]->id] = order[0];
+  changed = 1;
+  while (changed) {
+    changed = 0;
+    for (i = 1; i < blocks; i++) {
+      block = order[i];
+      dom = NULL;
+      for (k = 0; k < block->predCount; k++) {
+        b = block->preds[k];
+        if ((rpo[b->id] < 0) || (idom[b->id] == NULL))
+          continue;
+        if (dom == NULL) {
+          dom = b;
+          continue;
+        }
+        a = dom;
+        while (a != b) {
+          while (rpo[a->id] > rpo[b->id])
+            a = idom[a->id];
+          while (rpo[b->id] > rpo[a->id])
+            b = idom[b->id];
+        }
+        dom = a;
+      }
+      if (idom[block->id] != dom) {
+        idom[block->id] = dom;
+        changed = 1;
+      }
+    }
+  }
+  for (i = blocks - 1; i > 0; i--) {
+    id = order[i]->id;
+    nextSibling[id] = firstChild[idom[id]->id];
+    firstChild[idom[id]->id] = id;
+  }
+
+  // Down the tree, each block's entries taken out on the way back up
+  gvnEntries = (GvnEntry*) malloc((fn->valueCount + 1) * sizeof(GvnEntry));
+  gvnEntryCount = 0;
+  for (i = 0; i < GVN_BUCKETS; i++)
+    gvnBuckets[i] = -1;
+  stack = (int*) malloc((2 * blocks + 1) * sizeof(int));
+  marks = (int*) malloc((blocks + 1) * sizeof(int));
+  top = 0;
+  stack[top++] = order[0]->id;
+  while (top > 0) {
+    id = stack[--top];
+    if (id < 0) {
+      // Leaving block -id - 1
+      entry = marks[rpo[-id - 1]];
+      while (gvnEntryCount > entry) {
+        gvnEntryCount--;
+        gvnBuckets[gvnEntries[gvnEntryCount].bucket] = gvnEntries[gvnEntryCount].next;
+      }
+      continue;
+    }
+    block = byId[id];
+    marks[rpo[id]] = gvnEntryCount;
+    stack[top++] = -id - 1;
+    for (k = firstChild[id]; k >= 0; k = nextSibling[k])
+      stack[top++] = k;
+    for (instr = block->first; instr != NULL; instr = next) {
+      next = instr->next;
+      if (!gvnNumbered(instr))
+        continue;
+      bucket = gvnHash(instr);
+      for (entry = gvnBuckets[bucket]; entry >= 0; entry = gvnEntries[entry].next)
+        if (gvnSame(gvnEntries[entry].instr, instr))
+          break;
+      if (entry >= 0) {
+        irReplace(instr, gvnEntries[entry].instr);
+        count++;
+      } else {
+        gvnEntries[gvnEntryCount].instr = instr;
+        gvnEntries[gvnEntryCount].bucket = bucket;
+        gvnEntries[gvnEntryCount].next = gvnBuckets[bucket];
+        gvnBuckets[bucket] = gvnEntryCount++;
+      }
+    }
+  }
+  irSimplifyPhis(fn);
+
+  free(gvnEntries);
+  free(stack);
+  free(marks);
+  free(order);
+  free(rpo);
+  free(idom);
+  free(firstChild);
+  free(nextSibling);
+  free(byId);
+  return count;
+}
+
+int numberValues(IrProgram *program) {
+  int label, count = 0;
+
+  for (label = 0; label < program->functionCount; label++)
+    count += numberFunction(program->functions[label]);
+  return count;
+}
+
+/******************* Dead code ******************************/
+
+// Whether nothing but the users of its value need instr
+int dceRemovable(IrInstr *instr) {
+  return (instr->type != IRT_NONE) && (irIsPure(instr) || (instr->op == IR_LV));
+}
+
+// Block b of fn only follows its one predecessor, which only jumps to it: they become one
+int dceMergeBlock(IrFunction *fn, int b) {
+  IrBlock *block = fn->blocks[b];
+  IrBlock *pred, *succ;
+  IrInstr *instr;
+  int s;
+
+  if ((b == 0) || (block->predCount != 1))
+    return 0;
+  pred = block->preds[0];
+  if ((pred == block) || (pred->succCount != 1))
+    return 0;
+  irSimplifyPhis(fn);
+  irRemove(pred->last);
+  while (block->first != NULL) {
+    instr = block->first;
+    irRemove(instr);
+    irAppend(pred, instr);
+  }
+  pred->succCount = block->succCount;
+  for (s = 0; s < block->succCount; s++) {
+    succ = block->succs[s];
+    pred->succs[s] = succ;
+    succ->preds[irPredIndex(succ, block)] = pred;
+  }
+  memmove(fn->blocks + b, fn->blocks + b + 1, (fn->blockCount - b - 1) * sizeof(IrBlock*));
+  fn->blockCount--;
+  free(block->preds);
+  free(block);
+  return 1;
+}
+
+int eliminateFunction(IrFunction *fn) {
+  char *live = (char*) calloc(fn->valueCount, sizeof(char));
+  IrInstr **work = (IrInstr**) malloc((fn->valueCount + 1) * sizeof(IrInstr*));
+  IrBlock **order = (IrBlock**) malloc(fn->blockCount * sizeof(IrBlock*));
+  char *reached = (char*) calloc(fn->blockIds, sizeof(char));
+  IrInstr *instr, *next, *arg;
+  int workCount = 0, count = 0, blocks, b, k;
+
+  // The blocks no path reaches
+  blocks = irReversePostorder(fn, order);
+  for (b = 0; b < blocks; b++)
+    reached[order[b]->id] = 1;
+  for (b = fn->blockCount - 1; b > 0; b--)
+    if (!reached[fn->blocks[b]->id]) {
+      irRemoveBlock(fn, fn->blocks[b]);
+      count++;
+    }
+  if (count > 0)
+    irSimplifyPhis(fn);
+
+  // The values what is left needs
+  irResolveArgs(fn);
+  live[fn->undef->id] = 1;
+  for (b = 0; b < fn->blockCount; b++)
+    for (instr = fn->blocks[b]->first; instr != NULL; instr = instr->next)
+      if (!dceRemovable(instr) && !live[instr->id]) {
+        live[instr->id] = 1;
+        work[workCount++] = instr;
+      }
+  while (workCount > 0) {
+    instr = work[--workCount];
+    for (k = 0; k < instr->argCount; k++) {
+      arg = instr->args[k];
+      if (!live[arg->id]) {
+        live[arg->id] = 1;
+        work[workCount++] = arg;
+      }
+    }
+  }
+  for (b = 0; b < fn->blockCount; b++)
+    for (instr = fn->blocks[b]->first; instr != NULL; instr = next) {
+      next = instr->next;
+      if (!live[instr->id]) {
+        irRemove(instr);
+        count++;
+      }
+    }
+
+  for (b = fn->blockCount - 1; b > 0; b--)
+    count += dceMergeBlock(fn, b);
+
+  free(live);
+  free(work);
+  free(order);
+  free(reached);
+  return count;
+}
+
+int eliminateDeadCode(IrProgram *program) {
+  int label, count = 0;
+
+  for (label = 0; label < program->functionCount; label++)
+    count += eliminateFunction(program->functions[label]);
+  return count;
+}
+
+/******************* Pass manager ******************************/
+
+double passClock(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+void printPassTime(char *name, double seconds, int changes) {
+  if (changes < 0)
+    printf("%-10s %9.3f\n", name, seconds * 1000);
+  else printf("%-10s %9.3f %8d\n", name, seconds * 1000, changes);
+}
+
+/* Builds the SSA form of the code, runs the passes over it and lowers it
+ * back into the code. Returns whether the code was optimized; when it is
+ * not as kplc generates it, it is left as it is. */
+int runPasses(CodeBlock *code, IrFrame *frames, int frameCount) {
+  IrProgram *program;
+  double times[PASS_COUNT];
+  int changes[PASS_COUNT];
+  double start, buildTime, lowerTime;
+  int k, lowered;
+
+  start = passClock();
+  program = buildIr(code, frames, frameCount);
+  buildTime = passClock() - start;
+  if ((program != NULL) && !verifyIr(program)) {
+    freeIr(program);
+    program = NULL;
+  }
+  if (program == NULL) {
+    if (timePasses)
+      printf("The code is not optimized.\n");
+    return 0;
+  }
+
+  for (k = 0; k < PASS_COUNT; k++) {
+    start = passClock();
+    changes[k] = irPasses[k].run(program);
+    times[k] = passClock() - start;
+    if (!verifyIr(program)) {
+      printf("Can\'t optimize: pass %s broke the SSA form!\n", irPasses[k].name);
+      freeIr(program);
+      return 0;
+    }
+  }
+  if (dumpIr)
+    printIr(program);
+
+  start = passClock();
+  lowered = lowerIr(program);
+  lowerTime = passClock() - start;
+  freeIr(program);
+
+  if (timePasses) {
+    printf("%-10s %9s %8s\n", "pass", "time (ms)", "changes");
+    printPassTime("build", buildTime, -1);
+    for (k = 0; k < PASS_COUNT; k++) {
+      printPassTime(irPasses[k].name, times[k], changes[k]);
+      buildTime += times[k];
+    }
+    printPassTime("lower", lowerTime, -1);
+    printPassTime("total", buildTime + lowerTime, -1);
+  }
+  return lowered;
+}
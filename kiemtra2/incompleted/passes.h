@@ -0,0 +1,50 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __PASSES_H__
+#define __PASSES_H__
+
+#include "ssa.h"
+
+/* The passes over the SSA form of ssa.h, which runPasses runs in order
+ * between building the form from the code and lowering it back:
+ *
+ *   promote  scalar variables and parameters whose address is not
+ *            taken become values, with phis where paths meet
+ *   sccp     sparse conditional constant propagation: the values that
+ *            are constant on the paths that can run become constants, a
+ *            jump on a constant goes one way and the blocks no path
+ *            reaches go
+ *   gvn      global value numbering: an operation on the same values as
+ *            one that dominates it takes its value
+ *   dce      dead code elimination: what no effect depends on goes, and
+ *            a block only reached by a jump from the one before joins it
+ *
+ * A pass returns the changes it made. The form is checked after each
+ * one; should a pass leave it broken, the code is left as generated.
+ * With timePasses every stage is timed and the times printed. */
+
+extern int optimizing;      // -O0 clears it
+extern int timePasses;
+extern int dumpIr;          // print the SSA form as lowered
+
+typedef int (*IrPassFunction)(IrProgram *program);
+
+struct IrPass_ {
+  char *name;
+  IrPassFunction run;
+};
+
+typedef struct IrPass_ IrPass;
+
+int promoteVariables(IrProgram *program);
+int propagateConstants(IrProgram *program);
+int numberValues(IrProgram *program);
+int eliminateDeadCode(IrProgram *program);
+
+int runPasses(CodeBlock *code, IrFrame *frames, int frameCount);
+
+#endif
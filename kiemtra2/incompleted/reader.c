@@ -8,11 +8,18 @@
 #include "reader.h"
 
 FILE *inputStream;
+char *inputBuffer = NULL;
+int inputSize;
+int inputOffset;
 int lineNo, colNo;
 int currentChar;
 
 int readChar(void) {
-  currentChar = getc(inputStream);
+  inputOffset ++;
+  if (inputBuffer != NULL)
+    currentChar = (inputOffset < inputSize) ? (unsigned char) inputBuffer[inputOffset] : EOF;
+  else
+    currentChar = getc(inputStream);
   colNo ++;
   if (currentChar == '\n') {
     lineNo ++;
@@ -27,11 +34,26 @@ int openInputStream(char *fileName) {
     return IO_ERROR;
   lineNo = 1;
   colNo = 0;
+  inputOffset = -1;
+  readChar();
+  return IO_SUCCESS;
+}
+
+// Read from memory, starting at the character at offset whose position is (line, col)
+int openInputBuffer(char *buffer, int size, int offset, int line, int col) {
+  inputBuffer = buffer;
+  inputSize = size;
+  lineNo = line;
+  colNo = col - 1;
+  inputOffset = offset - 1;
   readChar();
   return IO_SUCCESS;
 }
 
 void closeInputStream() {
-  fclose(inputStream);
+  if (inputBuffer != NULL)
+    inputBuffer = NULL;
+  else
+    fclose(inputStream);
 }
 
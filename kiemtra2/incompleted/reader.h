@@ -12,6 +12,7 @@
 
 int readChar(void);
 int openInputStream(char *fileName);
+int openInputBuffer(char *buffer, int size, int offset, int line, int col);
 void closeInputStream(void);
 
 #endif
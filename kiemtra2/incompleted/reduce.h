@@ -0,0 +1,101 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __REDUCE_H__
+#define __REDUCE_H__
+
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "instructions.h"
+
+/* The reduction SUM runs, shared by the interpreters, the JIT and the
+ * runtime of compiled programs. Each includes its own copy, so that
+ * kplrt.o still stands alone. Words are added modulo 2^32, as AD adds
+ * them, so the order they are added in does not change the sum.
+ *
+ * sumWords adds SUM_LANES words at a time in vector registers. From
+ * SUM_THREAD_WORDS words on, it splits them into slices, one per
+ * processor up to SUM_MAX_THREADS, and sums the slices in threads.
+ * Programs that SUM use threads, so they link with -pthread. */
+
+#define SUM_LANES 4  // one 128-bit register; wider vectors spill without AVX
+#define SUM_THREAD_WORDS (1 << 18)  // below, starting threads costs more than it saves
+#define SUM_MAX_THREADS 8
+
+struct SumSlice_ {
+  WORD *words;
+  long count;
+  unsigned sum;
+};
+
+typedef struct SumSlice_ SumSlice;
+
+#ifdef __GNUC__
+typedef unsigned SumVector __attribute__ ((vector_size (SUM_LANES * sizeof(unsigned))));
+#endif
+
+static unsigned sumSlice(WORD *words, long count) {
+  unsigned sum = 0;
+  long i = 0;
+#ifdef __GNUC__
+  SumVector total = { 0 }, v;
+  int k;
+
+  for (; i + SUM_LANES <= count; i += SUM_LANES) {
+    memcpy(&v, words + i, sizeof(v));
+    total += v;
+  }
+  for (k = 0; k < SUM_LANES; k++)
+    sum += total[k];
+#endif
+  for (; i < count; i++)
+    sum += (unsigned) words[i];
+  return sum;
+}
+
+static void* sumThread(void *slice) {
+  SumSlice *s = (SumSlice*) slice;
+
+  s->sum = sumSlice(s->words, s->count);
+  return NULL;
+}
+
+static WORD sumWords(WORD *words, int count) {
+  pthread_t threads[SUM_MAX_THREADS];
+  SumSlice slices[SUM_MAX_THREADS];
+  char started[SUM_MAX_THREADS];
+  long processors, slice;
+  unsigned sum = 0;
+  int n, k;
+
+  if (count < SUM_THREAD_WORDS)
+    return (WORD) sumSlice(words, count);
+
+  processors = sysconf(_SC_NPROCESSORS_ONLN);
+  n = (processors < 1) ? 1 : ((processors > SUM_MAX_THREADS) ? SUM_MAX_THREADS : (int) processors);
+  slice = (count + n - 1) / n;
+  for (k = 0; k < n; k++) {
+    slices[k].words = words + k * slice;
+    slices[k].count = (k < n - 1) ? slice : count - k * slice;
+  }
+
+  // The first slice is summed here, as is any whose thread does not start
+  for (k = 1; k < n; k++)
+    started[k] = (pthread_create(&threads[k], NULL, sumThread, &slices[k]) == 0);
+  sumThread(&slices[0]);
+  for (k = 1; k < n; k++)
+    if (started[k])
+      pthread_join(threads[k], NULL);
+    else sumThread(&slices[k]);
+
+  for (k = 0; k < n; k++)
+    sum += slices[k].sum;
+  return (WORD) sum;
+}
+
+#endif
@@ -0,0 +1,844 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "regcode.h"
+
+#define INIT_REG_CODE 256
+#define NO_SLOT INT_MIN
+#define UNKNOWN_DEPTH INT_MIN
+
+char *regOpCodeNames[R_OP_COUNT] = {
+  "MOV", "LDC", "LEA", "LEAX", "LEAN", "LDN", "STN", "LDI", "STI", "LDX", "STX", "CP", "SUM",
+  "ADD", "SUB", "MUL", "DIV", "ADDI", "SUBI", "MULI", "DIVI", "NEG",
+  "EQ", "NE", "GT", "LT", "GE", "LE",
+  "BEQ", "BNE", "BGT", "BLT", "BGE", "BLE", "BEQI", "BNEI", "BGTI", "BLTI", "BGEI", "BLEI",
+  "J", "FJ", "ENTER", "CALL", "RET", "RC", "RI", "WRC", "WRI", "WLN", "HL"
+};
+
+/* What the stack code would have pushed, held back until it is used. A
+ * value is canonical when it is SYM_SLOT of its own depth: the slot the
+ * stack code would have pushed it to holds it. */
+
+#define SYM_SLOT 0      // the word in slot a
+#define SYM_CONST 1     // the constant a
+#define SYM_ADDR 2      // the address of slot a
+#define SYM_INDEXED 3   // the address of slot a + s[b]
+#define SYM_OUTER 4     // the address base(a) + b
+
+struct SymValue_ {
+  int kind;
+  WORD a;
+  WORD b;
+};
+
+typedef struct SymValue_ SymValue;
+
+static CodeBlock *source;
+static RegCode *regCode;
+static CodeAddress current;        // the stack instruction being translated
+static SymValue *symStack;         // symStack[i + 1] is the value at depth i
+static int symMax;
+static int depth;                  // t - b
+static int reachable;
+static int lastDest;               // the slot written by the last instruction, and nothing else
+static int *isTarget;
+static int *targetDepth;           // the stack at the start of each jump target
+static SymValue **targetStack;
+static CodeAddress *regAddress;
+static int again;                  // a target's stack lost a held back value
+static int failed;
+
+/******************* Register code ******************************/
+
+RegCode* createRegCode(void) {
+  RegCode *code = (RegCode*) malloc(sizeof(RegCode));
+  code->code = NULL;
+  code->origins = NULL;
+  code->codeSize = 0;
+  code->maxSize = 0;
+  code->labels = NULL;
+  code->labelCount = 0;
+  return code;
+}
+
+void freeRegCode(RegCode *code) {
+  free(code->code);
+  free(code->origins);
+  free(code->labels);
+  free(code);
+}
+
+int emitReg(enum RegOpCode op, WORD a, WORD b, WORD c) {
+  RegInstruction *instruction;
+
+  if (regCode->codeSize == regCode->maxSize) {
+    regCode->maxSize = (regCode->maxSize == 0) ? INIT_REG_CODE : regCode->maxSize * 2;
+    regCode->code = (RegInstruction*) realloc(regCode->code, regCode->maxSize * sizeof(RegInstruction));
+    regCode->origins = (CodeAddress*) realloc(regCode->origins, regCode->maxSize * sizeof(CodeAddress));
+  }
+  instruction = &(regCode->code[regCode->codeSize]);
+  instruction->op = op;
+  instruction->a = a;
+  instruction->b = b;
+  instruction->c = c;
+  regCode->origins[regCode->codeSize] = current;
+  lastDest = NO_SLOT;
+  return regCode->codeSize++;
+}
+
+// An instruction that only writes slot a
+void emitWrite(enum RegOpCode op, WORD a, WORD b, WORD c) {
+  emitReg(op, a, b, c);
+  lastDest = a;
+}
+
+/******************* Symbolic stack ******************************/
+
+SymValue* symAt(int i) {
+  return &symStack[i + 1];
+}
+
+void growSymStack(int newDepth) {
+  if (newDepth + 2 > symMax) {
+    while (newDepth + 2 > symMax)
+      symMax = (symMax == 0) ? 64 : symMax * 2;
+    symStack = (SymValue*) realloc(symStack, symMax * sizeof(SymValue));
+  }
+}
+
+void setSym(int i, int kind, WORD a, WORD b) {
+  SymValue *value = symAt(i);
+  value->kind = kind;
+  value->a = a;
+  value->b = b;
+}
+
+void pushSym(int kind, WORD a, WORD b) {
+  growSymStack(depth + 1);
+  depth++;
+  setSym(depth, kind, a, b);
+}
+
+int popSym(int count) {
+  if (depth - count < -1) {
+    failed = 1;
+    return 0;
+  }
+  depth -= count;
+  return 1;
+}
+
+int isCanonical(int i) {
+  return (symAt(i)->kind == SYM_SLOT) && (symAt(i)->a == i);
+}
+
+int dependsOn(SymValue *value, int slot) {
+  return ((value->kind == SYM_SLOT) && (value->a == slot)) ||
+    ((value->kind == SYM_INDEXED) && (value->b == slot));
+}
+
+void materialize(int i);
+
+// Before slot is written: give the values that read it their own slots
+void clearSlot(int slot) {
+  int i;
+
+  for (i = -1; i <= depth; i++)
+    if ((i != slot) && !isCanonical(i) && dependsOn(symAt(i), slot))
+      materialize(i);
+}
+
+// Put the value at depth i in its slot
+void materialize(int i) {
+  SymValue value = *symAt(i);
+
+  if (isCanonical(i))
+    return;
+  clearSlot(i);
+  switch (value.kind) {
+  case SYM_SLOT:
+    emitWrite(R_MOV, i, value.a, 0);
+    break;
+  case SYM_CONST:
+    emitWrite(R_LDC, i, value.a, 0);
+    break;
+  case SYM_ADDR:
+    emitWrite(R_LEA, i, value.a, 0);
+    break;
+  case SYM_INDEXED:
+    emitWrite(R_LEAX, i, value.a, value.b);
+    break;
+  default:
+    emitWrite(R_LEAN, i, value.a, value.b);
+    break;
+  }
+  setSym(i, SYM_SLOT, i, 0);
+}
+
+// The top count values, each in some slot
+void symInSlots(int count) {
+  int i;
+
+  for (i = depth - count + 1; i <= depth; i++)
+    if (symAt(i)->kind != SYM_SLOT)
+      materialize(i);
+}
+
+// Before memory is written through an address: the values read from memory
+void flushMemory(void) {
+  int i;
+
+  for (i = -1; i <= depth; i++)
+    if (((symAt(i)->kind == SYM_SLOT) && !isCanonical(i)) || (symAt(i)->kind == SYM_INDEXED))
+      materialize(i);
+}
+
+void flushAll(void) {
+  int i;
+
+  for (i = -1; i <= depth; i++)
+    materialize(i);
+}
+
+// The value of slot k, which the stack may hold back
+void pushSlotValue(int k) {
+  if ((k >= -1) && (k <= depth) && !isCanonical(k))
+    materialize(k);
+  pushSym(SYM_SLOT, k, 0);
+}
+
+/******************* Jump targets ******************************/
+
+// Constants and frame addresses do not change between blocks
+int isInvariant(SymValue *value) {
+  return (value->kind == SYM_CONST) || (value->kind == SYM_ADDR) || (value->kind == SYM_OUTER);
+}
+
+int sameSym(SymValue *v1, SymValue *v2) {
+  return (v1->kind == v2->kind) && (v1->a == v2->a) && ((v1->kind == SYM_SLOT) || (v1->b == v2->b));
+}
+
+// Agree with the stack a jump target starts with, before jumping or falling into it
+void joinTarget(CodeAddress address) {
+  SymValue *stack;
+  int i;
+
+  if ((address < 0) || (address > source->codeSize)) {
+    failed = 1;
+    return;
+  }
+
+  if (targetDepth[address] == UNKNOWN_DEPTH) {
+    for (i = -1; i <= depth; i++)
+      if (!isInvariant(symAt(i)))
+        materialize(i);
+    targetDepth[address] = depth;
+    targetStack[address] = (SymValue*) malloc((depth + 2) * sizeof(SymValue));
+    memcpy(targetStack[address], symStack, (depth + 2) * sizeof(SymValue));
+    return;
+  }
+
+  if (targetDepth[address] != depth) {
+    failed = 1;
+    return;
+  }
+  stack = targetStack[address];
+  for (i = -1; i <= depth; i++) {
+    if (sameSym(&stack[i + 1], symAt(i)))
+      continue;
+    if ((stack[i + 1].kind != SYM_SLOT) || (stack[i + 1].a != i)) {
+      // Held back on another way in: the target must take it from its
+      // slot, and the ways in already translated must put it there
+      stack[i + 1].kind = SYM_SLOT;
+      stack[i + 1].a = i;
+      again = 1;
+    }
+    materialize(i);
+  }
+}
+
+void enterTarget(CodeAddress address) {
+  if (reachable)
+    joinTarget(address);
+  if (failed)
+    return;
+
+  if (targetDepth[address] == UNKNOWN_DEPTH) {
+    // The start of a body
+    depth = -1;
+    setSym(-1, SYM_SLOT, -1, 0);
+    joinTarget(address);
+  } else {
+    depth = targetDepth[address];
+    growSymStack(depth);
+    memcpy(symStack, targetStack[address], (depth + 2) * sizeof(SymValue));
+  }
+  reachable = 1;
+  lastDest = NO_SLOT;
+}
+
+/******************* Translation ******************************/
+
+int returnsValue(CodeAddress address) {
+  for (; (address >= 0) && (address < source->codeSize); address++) {
+    if (source->code[address].op == OP_EF)
+      return 1;
+    if (source->code[address].op == OP_EP)
+      return 0;
+  }
+  failed = 1;
+  return 0;
+}
+
+WORD foldValues(enum OpCode op, WORD x, WORD y) {
+  switch (op) {
+  case OP_AD:
+    return (WORD) ((unsigned) x + (unsigned) y);
+  case OP_SB:
+    return (WORD) ((unsigned) x - (unsigned) y);
+  default:
+    return (WORD) ((unsigned) x * (unsigned) y);
+  }
+}
+
+void translateArithmetic(enum OpCode op) {
+  SymValue *left = symAt(depth - 1), *right = symAt(depth);
+  int dest = depth - 1;
+  WORD x, y;
+
+  // Addresses of elements
+  if ((op == OP_AD) && (right->kind == SYM_CONST) &&
+      ((left->kind == SYM_ADDR) || (left->kind == SYM_INDEXED))) {
+    left->a += right->a;
+    popSym(1);
+    return;
+  }
+  if ((op == OP_AD) && (right->kind == SYM_CONST) && (left->kind == SYM_OUTER)) {
+    left->b += right->a;
+    popSym(1);
+    return;
+  }
+  if ((op == OP_AD) && (left->kind == SYM_ADDR) && (right->kind == SYM_SLOT)) {
+    setSym(dest, SYM_INDEXED, left->a, right->a);
+    popSym(1);
+    return;
+  }
+
+  if ((left->kind == SYM_CONST) && (right->kind == SYM_CONST) && (op != OP_DV)) {
+    left->a = foldValues(op, left->a, right->a);
+    popSym(1);
+    return;
+  }
+
+  if (right->kind == SYM_CONST) {
+    // The constant stays an immediate operand
+    y = right->a;
+    if (symAt(depth - 1)->kind != SYM_SLOT)
+      materialize(depth - 1);
+    x = symAt(depth - 1)->a;
+    popSym(1);
+    clearSlot(dest);
+    switch (op) {
+    case OP_AD:
+      emitWrite(R_ADDI, dest, x, y);
+      break;
+    case OP_SB:
+      emitWrite(R_SUBI, dest, x, y);
+      break;
+    case OP_ML:
+      emitWrite(R_MULI, dest, x, y);
+      break;
+    default:
+      emitWrite(R_DIVI, dest, x, y);
+      break;
+    }
+  } else {
+    symInSlots(2);
+    x = symAt(depth - 1)->a;
+    y = symAt(depth)->a;
+    popSym(1);
+    clearSlot(dest);
+    switch (op) {
+    case OP_AD:
+      emitWrite(R_ADD, dest, x, y);
+      break;
+    case OP_SB:
+      emitWrite(R_SUB, dest, x, y);
+      break;
+    case OP_ML:
+      emitWrite(R_MUL, dest, x, y);
+      break;
+    default:
+      emitWrite(R_DIV, dest, x, y);
+      break;
+    }
+  }
+  setSym(dest, SYM_SLOT, dest, 0);
+}
+
+// The register opcode of a comparison, or of the branch taken when it is false
+enum RegOpCode compareOp(enum OpCode op, int branch, int immediate) {
+  enum RegOpCode values[] = { R_EQ, R_NE, R_GT, R_LT, R_GE, R_LE };
+  enum RegOpCode negations[] = { R_BNE, R_BEQ, R_BLE, R_BGE, R_BLT, R_BGT };
+  int i = op - OP_EQ;
+
+  if (!branch)
+    return values[i];
+  return immediate ? negations[i] + (R_BEQI - R_BEQ) : negations[i];
+}
+
+// A comparison, joined with the FJ after it when nothing jumps between them
+int translateCompare(CodeAddress address) {
+  enum OpCode op = source->code[address].op;
+  CodeAddress target;
+  SymValue *right;
+  WORD x, y;
+  int immediate;
+
+  if ((address + 1 >= source->codeSize) || (source->code[address + 1].op != OP_FJ) || isTarget[address + 1]) {
+    symInSlots(2);
+    x = symAt(depth - 1)->a;
+    y = symAt(depth)->a;
+    popSym(1);
+    clearSlot(depth);
+    emitWrite(compareOp(op, 0, 0), depth, x, y);
+    setSym(depth, SYM_SLOT, depth, 0);
+    return 0;
+  }
+
+  target = source->code[address + 1].q;
+  right = symAt(depth);
+  immediate = (right->kind == SYM_CONST);
+  if (immediate) {
+    y = right->a;
+    if (symAt(depth - 1)->kind != SYM_SLOT)
+      materialize(depth - 1);
+  } else {
+    symInSlots(2);
+    y = symAt(depth)->a;
+  }
+  x = symAt(depth - 1)->a;
+  popSym(2);
+  joinTarget(target);
+  emitReg(compareOp(op, 1, immediate), x, y, target);
+  return 1;
+}
+
+void translateStore(void) {
+  SymValue *address, *value;
+  WORD v;
+  int valueDepth = depth;
+  int before;
+
+  if (symAt(depth - 1)->kind == SYM_CONST)
+    materialize(depth - 1);
+  if ((symAt(depth - 1)->kind != SYM_ADDR) && (symAt(depth)->kind != SYM_SLOT))
+    materialize(depth);
+  address = symAt(depth - 1);
+  value = symAt(depth);
+
+  if (address->kind == SYM_ADDR) {
+    WORD k = address->a;
+
+    if (value->kind == SYM_CONST) {
+      v = value->a;
+      popSym(2);
+      clearSlot(k);
+      emitWrite(R_LDC, k, v, 0);
+      return;
+    }
+    if (value->kind != SYM_SLOT)
+      materialize(depth);
+    v = value->a;
+    popSym(2);
+    before = regCode->codeSize;
+    clearSlot(k);
+    // The value was just computed into its slot: compute it into k instead
+    if ((regCode->codeSize == before) && (v == valueDepth) && (lastDest == valueDepth)) {
+      regCode->code[regCode->codeSize - 1].a = k;
+      lastDest = k;
+    } else if (v != k)
+      emitWrite(R_MOV, k, v, 0);
+    return;
+  }
+
+  v = value->a;
+  switch (address->kind) {
+  case SYM_OUTER:
+    popSym(2);
+    emitReg(R_STN, address->a, address->b, v);
+    break;
+  case SYM_INDEXED:
+    popSym(2);
+    flushMemory();
+    emitReg(R_STX, address->a, address->b, v);
+    break;
+  default:
+    popSym(2);
+    flushMemory();
+    emitReg(R_STI, address->a, v, 0);
+    break;
+  }
+}
+
+void translateLoadIndirect(void) {
+  SymValue *address = symAt(depth);
+  WORD a = address->a, b = address->b;
+
+  switch (address->kind) {
+  case SYM_ADDR:
+    popSym(1);
+    pushSlotValue(a);
+    return;
+  case SYM_OUTER:
+    clearSlot(depth);
+    emitWrite(R_LDN, depth, a, b);
+    break;
+  case SYM_INDEXED:
+    clearSlot(depth);
+    emitWrite(R_LDX, depth, a, b);
+    break;
+  case SYM_CONST:
+    materialize(depth);
+    emitWrite(R_LDI, depth, depth, 0);
+    break;
+  default:
+    clearSlot(depth);
+    emitWrite(R_LDI, depth, a, 0);
+    break;
+  }
+  setSym(depth, SYM_SLOT, depth, 0);
+}
+
+void translateInstruction(CodeAddress address) {
+  Instruction *instruction = &(source->code[address]);
+  WORD p = instruction->p, q = instruction->q;
+  WORD x, y;
+  int i;
+
+  switch (instruction->op) {
+  case OP_LA:
+    if (p == 0)
+      pushSym(SYM_ADDR, q, 0);
+    else pushSym(SYM_OUTER, p, q);
+    break;
+  case OP_LV:
+    if (p == 0)
+      pushSlotValue(q);
+    else {
+      clearSlot(depth + 1);
+      emitWrite(R_LDN, depth + 1, p, q);
+      pushSym(SYM_SLOT, depth + 1, 0);
+    }
+    break;
+  case OP_LC:
+    pushSym(SYM_CONST, q, 0);
+    break;
+  case OP_LI:
+    translateLoadIndirect();
+    break;
+  case OP_INT:
+    if (depth == -1)
+      emitReg(R_ENTER, q, 0, 0);
+    growSymStack(depth + q);
+    for (i = 1; i <= q; i++)
+      setSym(depth + i, SYM_SLOT, depth + i, 0);
+    depth += q;
+    break;
+  case OP_DCT:
+    // Arguments go to memory for the callee
+    if ((address + 1 < source->codeSize) && (source->code[address + 1].op == OP_CALL))
+      flushAll();
+    popSym(q);
+    break;
+  case OP_J:
+    joinTarget(q);
+    emitReg(R_J, q, 0, 0);
+    reachable = 0;
+    break;
+  case OP_FJ:
+    symInSlots(1);
+    x = symAt(depth)->a;
+    popSym(1);
+    joinTarget(q);
+    emitReg(R_FJ, x, q, 0);
+    break;
+  case OP_HL:
+    emitReg(R_HL, 0, 0, 0);
+    reachable = 0;
+    break;
+  case OP_ST:
+    translateStore();
+    break;
+  case OP_CP:
+    symInSlots(2);
+    x = symAt(depth - 1)->a;
+    y = symAt(depth)->a;
+    popSym(2);
+    flushMemory();
+    emitReg(R_CP, x, y, q);
+    break;
+  case OP_CALL:
+    flushAll();
+    emitReg(R_CALL, p, depth + 1, q);
+    if (returnsValue(q))
+      pushSym(SYM_SLOT, depth + 1, 0);
+    break;
+  case OP_EP:
+  case OP_EF:
+    emitReg(R_RET, 0, 0, 0);
+    reachable = 0;
+    break;
+  case OP_RC:
+  case OP_RI:
+    clearSlot(depth + 1);
+    emitWrite((instruction->op == OP_RC) ? R_RC : R_RI, depth + 1, 0, 0);
+    pushSym(SYM_SLOT, depth + 1, 0);
+    break;
+  case OP_WRC:
+  case OP_WRI:
+    symInSlots(1);
+    x = symAt(depth)->a;
+    popSym(1);
+    emitReg((instruction->op == OP_WRC) ? R_WRC : R_WRI, x, 0, 0);
+    break;
+  case OP_WLN:
+    emitReg(R_WLN, 0, 0, 0);
+    break;
+  case OP_AD:
+  case OP_SB:
+  case OP_ML:
+  case OP_DV:
+    translateArithmetic(instruction->op);
+    break;
+  case OP_NEG:
+    if (symAt(depth)->kind == SYM_CONST) {
+      symAt(depth)->a = (WORD) (0u - (unsigned) symAt(depth)->a);
+      break;
+    }
+    symInSlots(1);
+    x = symAt(depth)->a;
+    clearSlot(depth);
+    emitWrite(R_NEG, depth, x, 0);
+    setSym(depth, SYM_SLOT, depth, 0);
+    break;
+  case OP_CV:
+    growSymStack(depth + 1);
+    *symAt(depth + 1) = *symAt(depth);
+    depth++;
+    break;
+  case OP_EQ:
+  case OP_NE:
+  case OP_GT:
+  case OP_LT:
+  case OP_GE:
+  case OP_LE:
+    // The FJ joined with the comparison was translated too
+    if (translateCompare(address))
+      regAddress[address + 1] = regCode->codeSize;
+    break;
+  case OP_SUM:
+    symInSlots(2);
+    x = symAt(depth - 1)->a;
+    y = symAt(depth)->a;
+    popSym(1);
+    clearSlot(depth);
+    emitWrite(R_SUM, depth, x, y);
+    setSym(depth, SYM_SLOT, depth, 0);
+    break;
+  default:
+    failed = 1;
+    break;
+  }
+}
+
+void translatePass(void) {
+  CodeAddress address;
+  Instruction *instruction;
+
+  regCode->codeSize = 0;
+  depth = -1;
+  setSym(-1, SYM_SLOT, -1, 0);
+  reachable = 1;
+  lastDest = NO_SLOT;
+
+  for (address = 0; (address < source->codeSize) && !failed; address++) {
+    current = address;
+    if (isTarget[address])
+      enterTarget(address);
+    else if (!reachable) {
+      depth = -1;
+      setSym(-1, SYM_SLOT, -1, 0);
+      reachable = 1;
+    }
+    regAddress[address] = regCode->codeSize;
+    translateInstruction(address);
+
+    // Skip the FJ joined with a comparison
+    instruction = &(source->code[address]);
+    if ((instruction->op >= OP_EQ) && (instruction->op <= OP_LE) && (address + 1 < source->codeSize) &&
+        (source->code[address + 1].op == OP_FJ) && !isTarget[address + 1])
+      address++;
+  }
+
+  // One more instruction halts a machine that runs off the end
+  current = source->codeSize;
+  if (isTarget[source->codeSize] && !failed)
+    enterTarget(source->codeSize);
+  regAddress[source->codeSize] = regCode->codeSize;
+  if (reachable)
+    emitReg(R_HL, 0, 0, 0);
+}
+
+// Stack addresses to register addresses
+void patchTargets(void) {
+  RegInstruction *instruction;
+  int i;
+
+  for (i = 0; i < regCode->codeSize; i++) {
+    instruction = &(regCode->code[i]);
+    if ((instruction->op >= R_BEQ) && (instruction->op <= R_BLEI))
+      instruction->c = regAddress[instruction->c];
+    else if (instruction->op == R_J)
+      instruction->a = regAddress[instruction->a];
+    else if (instruction->op == R_FJ)
+      instruction->b = regAddress[instruction->b];
+    else if (instruction->op == R_CALL)
+      instruction->c = regAddress[instruction->c];
+  }
+}
+
+void markTargets(void) {
+  Instruction *instruction;
+  int i;
+
+  for (i = 0; i < source->labelCount; i++)
+    if ((source->labels[i].address >= 0) && (source->labels[i].address <= source->codeSize))
+      isTarget[source->labels[i].address] = 1;
+  for (i = 0; i < source->codeSize; i++) {
+    instruction = &(source->code[i]);
+    if ((instruction->op == OP_J) || (instruction->op == OP_FJ) || (instruction->op == OP_CALL)) {
+      if ((instruction->q < 0) || (instruction->q > source->codeSize))
+        failed = 1;
+      else isTarget[instruction->q] = 1;
+    }
+  }
+}
+
+RegCode* translateCode(CodeBlock *codeBlock) {
+  CodeBlock plain;
+  RegCode *result;
+  int size = codeBlock->codeSize + 1;
+  int i;
+
+  // Superinstructions translate as the instructions they replaced
+  plain = *codeBlock;
+  plain.code = (Instruction*) malloc(size * sizeof(Instruction));
+  for (i = 0; i < codeBlock->codeSize; i++) {
+    plain.code[i] = codeBlock->code[i];
+    plain.code[i].op = plainOp(codeBlock->code[i].op);
+  }
+  source = &plain;
+  regCode = createRegCode();
+  symStack = NULL;
+  symMax = 0;
+  growSymStack(0);
+  isTarget = (int*) calloc(size, sizeof(int));
+  targetDepth = (int*) malloc(size * sizeof(int));
+  targetStack = (SymValue**) calloc(size, sizeof(SymValue*));
+  regAddress = (CodeAddress*) calloc(size, sizeof(CodeAddress));
+  for (i = 0; i < size; i++)
+    targetDepth[i] = UNKNOWN_DEPTH;
+  failed = 0;
+
+  markTargets();
+  // The stacks at the targets only lose held back values, so this ends
+  do {
+    again = 0;
+    if (!failed)
+      translatePass();
+  } while (again && !failed);
+
+  if (!failed) {
+    patchTargets();
+    regCode->labelCount = codeBlock->labelCount;
+    regCode->labels = (CodeLabel*) malloc((codeBlock->labelCount + 1) * sizeof(CodeLabel));
+    for (i = 0; i < codeBlock->labelCount; i++) {
+      regCode->labels[i] = codeBlock->labels[i];
+      if ((codeBlock->labels[i].address >= 0) && (codeBlock->labels[i].address <= codeBlock->codeSize))
+        regCode->labels[i].address = regAddress[codeBlock->labels[i].address];
+    }
+    result = regCode;
+  } else {
+    freeRegCode(regCode);
+    result = NULL;
+  }
+
+  for (i = 0; i < size; i++)
+    free(targetStack[i]);
+  free(targetStack);
+  free(targetDepth);
+  free(isTarget);
+  free(regAddress);
+  free(symStack);
+  free(plain.code);
+  regCode = NULL;
+  source = NULL;
+  return result;
+}
+
+/******************* Printing ******************************/
+
+char* regOpCodeName(enum RegOpCode op) {
+  return ((op >= 0) && (op < R_OP_COUNT)) ? regOpCodeNames[op] : "???";
+}
+
+void printRegInstruction(RegInstruction *instruction) {
+  switch (instruction->op) {
+  case R_RET:
+  case R_WLN:
+  case R_HL:
+    printf("%s", regOpCodeName(instruction->op));
+    break;
+  case R_J:
+  case R_ENTER:
+  case R_RC:
+  case R_RI:
+  case R_WRC:
+  case R_WRI:
+    printf("%s %d", regOpCodeName(instruction->op), instruction->a);
+    break;
+  case R_MOV:
+  case R_LDC:
+  case R_LEA:
+  case R_LDI:
+  case R_STI:
+  case R_NEG:
+  case R_FJ:
+    printf("%s %d,%d", regOpCodeName(instruction->op), instruction->a, instruction->b);
+    break;
+  default:
+    printf("%s %d,%d,%d", regOpCodeName(instruction->op), instruction->a, instruction->b, instruction->c);
+    break;
+  }
+}
+
+void printRegCode(RegCode *code) {
+  int i, label = 0;
+
+  for (i = 0; i < code->codeSize; i++) {
+    while ((label < code->labelCount) && (code->labels[label].address == i))
+      printf("%s:\n", code->labels[label++].name);
+    printf("%6d:  ", i);
+    printRegInstruction(&(code->code[i]));
+    printf("\n");
+  }
+}
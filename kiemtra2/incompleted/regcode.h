@@ -0,0 +1,108 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __REGCODE_H__
+#define __REGCODE_H__
+
+#include "instructions.h"
+
+/* Register machine over the same memory and frames as the stack machine.
+ * Its operands are slots: offsets from b, the base of the current frame.
+ * The slots of a frame are its variables, then the slots the stack code
+ * would push its operands to.
+ *
+ * The code is translated from stack code when it is loaded. The
+ * translation follows the stack of each basic block, holding back the
+ * loads of variables, constants and addresses until an instruction uses
+ * them, so that  S := S + A(.I.)  becomes an indexed load and an ADD
+ * that writes S. */
+
+enum RegOpCode {
+  R_MOV,    // s[a] := s[b]
+  R_LDC,    // s[a] := b
+  R_LEA,    // s[a] := the address of slot b
+  R_LEAX,   // s[a] := the address of slot b + s[c]
+  R_LEAN,   // s[a] := base(b) + c
+  R_LDN,    // s[a] := s[base(b) + c]
+  R_STN,    // s[base(a) + b] := s[c]
+  R_LDI,    // s[a] := s[s[b]]
+  R_STI,    // s[s[a]] := s[b]
+  R_LDX,    // s[a] := the word at slot b + s[c]
+  R_STX,    // the word at slot a + s[b] := s[c]
+  R_CP,     // the c words at s[b] to s[a]
+  R_SUM,    // s[a] := the s[c] words at s[b] added up
+
+  R_ADD,    // s[a] := s[b] + s[c]
+  R_SUB,
+  R_MUL,
+  R_DIV,
+  R_ADDI,   // s[a] := s[b] + c
+  R_SUBI,
+  R_MULI,
+  R_DIVI,
+  R_NEG,    // s[a] := - s[b]
+
+  R_EQ,     // s[a] := (s[b] = s[c])
+  R_NE,
+  R_GT,
+  R_LT,
+  R_GE,
+  R_LE,
+
+  R_BEQ,    // if s[a] = s[b] then jump to c
+  R_BNE,
+  R_BGT,
+  R_BLT,
+  R_BGE,
+  R_BLE,
+  R_BEQI,   // if s[a] = b then jump to c
+  R_BNEI,
+  R_BGTI,
+  R_BLTI,
+  R_BGEI,
+  R_BLEI,
+
+  R_J,      // jump to a
+  R_FJ,     // if s[a] = 0 then jump to b
+  R_ENTER,  // a frame of a slots starts here
+  R_CALL,   // call c with static link base(a), the new frame at slot b
+  R_RET,
+  R_RC,     // s[a] := the character read
+  R_RI,     // s[a] := the integer read
+  R_WRC,    // write s[a] as a character
+  R_WRI,    // write s[a]
+  R_WLN,
+  R_HL,
+  R_OP_COUNT
+};
+
+struct RegInstruction_ {
+  enum RegOpCode op;
+  WORD a;
+  WORD b;
+  WORD c;
+};
+
+typedef struct RegInstruction_ RegInstruction;
+
+struct RegCode_ {
+  RegInstruction *code;
+  int codeSize;
+  int maxSize;
+  CodeAddress *origins;  // the stack instruction each one was translated from
+  CodeLabel *labels;     // in address order, as in the stack code
+  int labelCount;
+};
+
+typedef struct RegCode_ RegCode;
+
+RegCode* translateCode(CodeBlock *codeBlock);
+void freeRegCode(RegCode *regCode);
+char* regOpCodeName(enum RegOpCode op);
+void printRegInstruction(RegInstruction *instruction);
+void printRegCode(RegCode *regCode);
+
+#endif
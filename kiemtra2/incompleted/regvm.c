@@ -0,0 +1,288 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "regvm.h"
+#include "dispatch.h"
+#include "reduce.h"
+
+// Only the stack machine is profiled
+#define PROFILE() ((void) 0)
+
+struct DecodedRegInstruction_ {
+#ifdef THREADED_DISPATCH
+  void *handler;
+#else
+  int op;
+#endif
+  WORD a;
+  WORD b;
+  WORD c;
+  struct DecodedRegInstruction_ *target;   // of jumps, branches and CALL
+};
+
+typedef struct DecodedRegInstruction_ DecodedRegInstruction;
+
+#define FAIL(code) do { status = (code); goto stop; } while (0)
+#define CHECK_ADDRESS(a) if ((unsigned) (a) >= (unsigned) stackSize) FAIL(VM_BAD_ADDRESS)
+
+// The slots of the current frame
+#define R(slot) fp[slot]
+
+#define BRANCH(condition) if (condition) { pc = pc->target; DISPATCH(); } NEXT()
+
+int runRegCode(RegCode *regCode, int stackSize) {
+#ifdef THREADED_DISPATCH
+  static void *handlers[R_OP_COUNT] = {
+    [R_MOV] = &&do_R_MOV, [R_LDC] = &&do_R_LDC, [R_LEA] = &&do_R_LEA, [R_LEAX] = &&do_R_LEAX,
+    [R_LEAN] = &&do_R_LEAN, [R_LDN] = &&do_R_LDN, [R_STN] = &&do_R_STN, [R_LDI] = &&do_R_LDI,
+    [R_STI] = &&do_R_STI, [R_LDX] = &&do_R_LDX, [R_STX] = &&do_R_STX, [R_CP] = &&do_R_CP,
+    [R_SUM] = &&do_R_SUM, [R_ADD] = &&do_R_ADD, [R_SUB] = &&do_R_SUB, [R_MUL] = &&do_R_MUL,
+    [R_DIV] = &&do_R_DIV, [R_ADDI] = &&do_R_ADDI, [R_SUBI] = &&do_R_SUBI, [R_MULI] = &&do_R_MULI,
+    [R_DIVI] = &&do_R_DIVI, [R_NEG] = &&do_R_NEG, [R_EQ] = &&do_R_EQ, [R_NE] = &&do_R_NE,
+    [R_GT] = &&do_R_GT, [R_LT] = &&do_R_LT, [R_GE] = &&do_R_GE, [R_LE] = &&do_R_LE,
+    [R_BEQ] = &&do_R_BEQ, [R_BNE] = &&do_R_BNE, [R_BGT] = &&do_R_BGT, [R_BLT] = &&do_R_BLT,
+    [R_BGE] = &&do_R_BGE, [R_BLE] = &&do_R_BLE, [R_BEQI] = &&do_R_BEQI, [R_BNEI] = &&do_R_BNEI,
+    [R_BGTI] = &&do_R_BGTI, [R_BLTI] = &&do_R_BLTI, [R_BGEI] = &&do_R_BGEI, [R_BLEI] = &&do_R_BLEI,
+    [R_J] = &&do_R_J, [R_FJ] = &&do_R_FJ, [R_ENTER] = &&do_R_ENTER, [R_CALL] = &&do_R_CALL,
+    [R_RET] = &&do_R_RET, [R_RC] = &&do_R_RC, [R_RI] = &&do_R_RI, [R_WRC] = &&do_R_WRC,
+    [R_WRI] = &&do_R_WRI, [R_WLN] = &&do_R_WLN, [R_HL] = &&do_R_HL
+  };
+#endif
+  DecodedRegInstruction *code, *pc;
+  RegInstruction *instruction;
+  WORD *memory, *s, *fp;
+  WORD x, y, a;
+  char ch;
+  int codeSize = regCode->codeSize;
+  int limit = stackSize - STACK_MARGIN;
+  int b = 0;
+  int i, status;
+
+  code = (DecodedRegInstruction*) malloc(codeSize * sizeof(DecodedRegInstruction));
+  for (i = 0; i < codeSize; i++) {
+    instruction = &(regCode->code[i]);
+    SET_OP(&code[i], instruction->op);
+    code[i].a = instruction->a;
+    code[i].b = instruction->b;
+    code[i].c = instruction->c;
+    code[i].target = NULL;
+    if (instruction->op == R_J)
+      a = instruction->a;
+    else if (instruction->op == R_FJ)
+      a = instruction->b;
+    else if ((instruction->op == R_CALL) || ((instruction->op >= R_BEQ) && (instruction->op <= R_BLEI)))
+      a = instruction->c;
+    else continue;
+    if ((a < 0) || (a >= codeSize)) {
+      free(code);
+      vmErrorAddress = regCode->origins[i];
+      return VM_BAD_JUMP;
+    }
+    code[i].target = code + a;
+  }
+
+  // Slot -1 of the program's frame is s[-1]
+  memory = (WORD*) calloc(stackSize + 1, sizeof(WORD));
+  s = memory + 1;
+  fp = s;
+  pc = code;
+
+  BEGIN_DISPATCH()
+
+  CASE(R_MOV)
+    R(pc->a) = R(pc->b);
+    NEXT();
+  CASE(R_LDC)
+    R(pc->a) = pc->b;
+    NEXT();
+  CASE(R_LEA)
+    R(pc->a) = b + pc->b;
+    NEXT();
+  CASE(R_LEAX)
+    R(pc->a) = b + pc->b + R(pc->c);
+    NEXT();
+  CASE(R_LEAN)
+    R(pc->a) = base(s, b, pc->b) + pc->c;
+    NEXT();
+  CASE(R_LDN)
+    R(pc->a) = s[base(s, b, pc->b) + pc->c];
+    NEXT();
+  CASE(R_STN)
+    s[base(s, b, pc->a) + pc->b] = R(pc->c);
+    NEXT();
+  CASE(R_LDI)
+    a = R(pc->b);
+    CHECK_ADDRESS(a);
+    R(pc->a) = s[a];
+    NEXT();
+  CASE(R_STI)
+    a = R(pc->a);
+    CHECK_ADDRESS(a);
+    s[a] = R(pc->b);
+    NEXT();
+  CASE(R_LDX)
+    a = b + pc->b + R(pc->c);
+    CHECK_ADDRESS(a);
+    R(pc->a) = s[a];
+    NEXT();
+  CASE(R_STX)
+    a = b + pc->a + R(pc->b);
+    CHECK_ADDRESS(a);
+    s[a] = R(pc->c);
+    NEXT();
+  CASE(R_CP)
+    a = R(pc->a);
+    x = R(pc->b);
+    if (((unsigned) a > (unsigned) (stackSize - pc->c)) || ((unsigned) x > (unsigned) (stackSize - pc->c)))
+      FAIL(VM_BAD_ADDRESS);
+    memmove(s + a, s + x, pc->c * sizeof(WORD));
+    NEXT();
+  CASE(R_SUM)
+    a = R(pc->b);
+    x = R(pc->c);
+    if ((x < 0) || ((unsigned) a > (unsigned) stackSize) || (x > stackSize - a))
+      FAIL(VM_BAD_ADDRESS);
+    R(pc->a) = sumWords(s + a, x);
+    NEXT();
+  CASE(R_ADD)
+    R(pc->a) = (WORD) ((unsigned) R(pc->b) + (unsigned) R(pc->c));
+    NEXT();
+  CASE(R_SUB)
+    R(pc->a) = (WORD) ((unsigned) R(pc->b) - (unsigned) R(pc->c));
+    NEXT();
+  CASE(R_MUL)
+    R(pc->a) = (WORD) ((unsigned) R(pc->b) * (unsigned) R(pc->c));
+    NEXT();
+  CASE(R_DIV)
+    y = R(pc->c);
+    if (y == 0)
+      FAIL(VM_DIVISION_BY_ZERO);
+    // The most negative integer divided by -1 wraps around
+    if (y == -1)
+      R(pc->a) = (WORD) (0u - (unsigned) R(pc->b));
+    else R(pc->a) = R(pc->b) / y;
+    NEXT();
+  CASE(R_ADDI)
+    R(pc->a) = (WORD) ((unsigned) R(pc->b) + (unsigned) pc->c);
+    NEXT();
+  CASE(R_SUBI)
+    R(pc->a) = (WORD) ((unsigned) R(pc->b) - (unsigned) pc->c);
+    NEXT();
+  CASE(R_MULI)
+    R(pc->a) = (WORD) ((unsigned) R(pc->b) * (unsigned) pc->c);
+    NEXT();
+  CASE(R_DIVI)
+    if (pc->c == 0)
+      FAIL(VM_DIVISION_BY_ZERO);
+    if (pc->c == -1)
+      R(pc->a) = (WORD) (0u - (unsigned) R(pc->b));
+    else R(pc->a) = R(pc->b) / pc->c;
+    NEXT();
+  CASE(R_NEG)
+    R(pc->a) = (WORD) (0u - (unsigned) R(pc->b));
+    NEXT();
+  CASE(R_EQ)
+    R(pc->a) = (R(pc->b) == R(pc->c));
+    NEXT();
+  CASE(R_NE)
+    R(pc->a) = (R(pc->b) != R(pc->c));
+    NEXT();
+  CASE(R_GT)
+    R(pc->a) = (R(pc->b) > R(pc->c));
+    NEXT();
+  CASE(R_LT)
+    R(pc->a) = (R(pc->b) < R(pc->c));
+    NEXT();
+  CASE(R_GE)
+    R(pc->a) = (R(pc->b) >= R(pc->c));
+    NEXT();
+  CASE(R_LE)
+    R(pc->a) = (R(pc->b) <= R(pc->c));
+    NEXT();
+  CASE(R_BEQ)
+    BRANCH(R(pc->a) == R(pc->b));
+  CASE(R_BNE)
+    BRANCH(R(pc->a) != R(pc->b));
+  CASE(R_BGT)
+    BRANCH(R(pc->a) > R(pc->b));
+  CASE(R_BLT)
+    BRANCH(R(pc->a) < R(pc->b));
+  CASE(R_BGE)
+    BRANCH(R(pc->a) >= R(pc->b));
+  CASE(R_BLE)
+    BRANCH(R(pc->a) <= R(pc->b));
+  CASE(R_BEQI)
+    BRANCH(R(pc->a) == pc->b);
+  CASE(R_BNEI)
+    BRANCH(R(pc->a) != pc->b);
+  CASE(R_BGTI)
+    BRANCH(R(pc->a) > pc->b);
+  CASE(R_BLTI)
+    BRANCH(R(pc->a) < pc->b);
+  CASE(R_BGEI)
+    BRANCH(R(pc->a) >= pc->b);
+  CASE(R_BLEI)
+    BRANCH(R(pc->a) <= pc->b);
+  CASE(R_J)
+    pc = pc->target;
+    DISPATCH();
+  CASE(R_FJ)
+    BRANCH(R(pc->a) == 0);
+  CASE(R_ENTER)
+    if (b + pc->a - 1 >= limit)
+      FAIL(VM_STACK_OVERFLOW);
+    NEXT();
+  CASE(R_CALL)
+    x = pc->b;
+    R(x + 1) = b;
+    R(x + 2) = pc + 1 - code;
+    R(x + 3) = base(s, b, pc->a);
+    b += x;
+    fp = s + b;
+    pc = pc->target;
+    DISPATCH();
+  CASE(R_RET)
+    if ((unsigned) R(2) >= (unsigned) codeSize)
+      FAIL(VM_BAD_JUMP);
+    pc = code + R(2);
+    b = R(1);
+    fp = s + b;
+    DISPATCH();
+  CASE(R_RC)
+    if (scanf(" %c", &ch) != 1)
+      FAIL(VM_BAD_INPUT);
+    R(pc->a) = (unsigned char) ch;
+    NEXT();
+  CASE(R_RI)
+    if (scanf("%d", &x) != 1)
+      FAIL(VM_BAD_INPUT);
+    R(pc->a) = x;
+    NEXT();
+  CASE(R_WRC)
+    putchar(R(pc->a));
+    NEXT();
+  CASE(R_WRI)
+    printf("%d", R(pc->a));
+    NEXT();
+  CASE(R_WLN)
+    putchar('\n');
+    NEXT();
+  CASE(R_HL)
+    FAIL(VM_SUCCESS);
+
+  END_DISPATCH()
+
+ stop:
+  fflush(stdout);
+  vmErrorAddress = regCode->origins[pc - code];
+  free(memory);
+  free(code);
+  return status;
+}
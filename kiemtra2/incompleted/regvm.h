@@ -0,0 +1,21 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __REGVM_H__
+#define __REGVM_H__
+
+#include "regcode.h"
+#include "vm.h"
+
+/* Interpreter for the register machine of regcode.h. It runs on the
+ * memory layout of the stack machine and reports the same errors, at
+ * the address of the stack instruction the failing one came from. A
+ * frame that does not fit overflows at its ENTER, where the stack
+ * machine finds it already at the INT before the CALL. */
+
+int runRegCode(RegCode *regCode, int stackSize);
+
+#endif
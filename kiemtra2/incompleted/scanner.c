@@ -17,9 +17,12 @@
 extern int lineNo;
 extern int colNo;
 extern int currentChar;
+extern int inputOffset;
 
 extern CharCode charCodes[];
 
+int tokenOffset;
+
 /***************************************************************/
 
 void skipBlank()
@@ -141,6 +144,7 @@ Token *getToken(void)
   Token *token;
   int ln, cn;
 
+  tokenOffset = inputOffset;
   if (currentChar == EOF)
     return makeToken(TK_EOF, lineNo, colNo);
 
@@ -154,21 +158,49 @@ Token *getToken(void)
   case CHAR_DIGIT:
     return readNumber();
   case CHAR_PLUS:
-    token = makeToken(SB_PLUS, lineNo, colNo);
+    ln = lineNo;
+    cn = colNo;
     readChar();
-    return token;
+    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ))
+    {
+      readChar();
+      return makeToken(SB_ASSIGN_PLUS, ln, cn);
+    }
+    else
+      return makeToken(SB_PLUS, ln, cn);
   case CHAR_MINUS:
-    token = makeToken(SB_MINUS, lineNo, colNo);
+    ln = lineNo;
+    cn = colNo;
     readChar();
-    return token;
+    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ))
+    {
+      readChar();
+      return makeToken(SB_ASSIGN_SUBTRACT, ln, cn);
+    }
+    else
+      return makeToken(SB_MINUS, ln, cn);
   case CHAR_TIMES:
-    token = makeToken(SB_TIMES, lineNo, colNo);
+    ln = lineNo;
+    cn = colNo;
     readChar();
-    return token;
+    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ))
+    {
+      readChar();
+      return makeToken(SB_ASSIGN_TIMES, ln, cn);
+    }
+    else
+      return makeToken(SB_TIMES, ln, cn);
   case CHAR_SLASH:
-    token = makeToken(SB_SLASH, lineNo, colNo);
+    ln = lineNo;
+    cn = colNo;
     readChar();
-    return token;
+    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ))
+    {
+      readChar();
+      return makeToken(SB_ASSIGN_DIVIDE, ln, cn);
+    }
+    else
+      return makeToken(SB_SLASH, ln, cn);
   case CHAR_LT:
     ln = lineNo;
     cn = colNo;
@@ -279,9 +311,10 @@ Token *getValidToken(void)
   Token *token = getToken();
   while (token->tokenType == TK_NONE)
   {
-    free(token);
+    freeToken(token);
     token = getToken();
   }
+  token->offset = tokenOffset;
   return token;
 }
 
@@ -373,6 +406,12 @@ void printToken(Token *token)
   case KW_SUM:
     printf("KW_SUM\n");
     break;
+  case KW_USES:
+    printf("KW_USES\n");
+    break;
+  case KW_MODULE:
+    printf("KW_MODULE\n");
+    break;
 
   case SB_SEMICOLON:
     printf("SB_SEMICOLON\n");
@@ -431,5 +470,17 @@ void printToken(Token *token)
   case SB_RSEL:
     printf("SB_RSEL\n");
     break;
+  case SB_ASSIGN_PLUS:
+    printf("SB_ASSIGN_PLUS\n");
+    break;
+  case SB_ASSIGN_SUBTRACT:
+    printf("SB_ASSIGN_SUBTRACT\n");
+    break;
+  case SB_ASSIGN_TIMES:
+    printf("SB_ASSIGN_TIMES\n");
+    break;
+  case SB_ASSIGN_DIVIDE:
+    printf("SB_ASSIGN_DIVIDE\n");
+    break;
   }
 }
@@ -6,33 +6,54 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include "semantics.h"
 #include "error.h"
+#include "xref.h"
 
 extern SymTab *symtab;
 extern Token *currentToken;
 
+// Declaring scope of the object found by the last lookupObject
+Scope *lookupScope = NULL;
+
+/* An incremental reparse binds only the objects of the subroutine it
+ * recompiles and of the scopes it enters. The scopes around it, from
+ * symtab->unboundScope outward, are searched by name instead, between
+ * those bindings and the ones of imports and predefined subroutines. */
 Object *lookupObject(char *name)
 {
-  Scope *scope = symtab->currentScope;
+  Binding *binding = findBinding(name);
+  Scope *scope = symtab->unboundScope;
   Object *obj;
 
-  while (scope != NULL)
-  {
-    obj = findObject(scope->objList, name);
-    if (obj != NULL)
-      return obj;
-    scope = scope->outer;
-  }
-  obj = findObject(symtab->globalObjectList, name);
-  if (obj != NULL)
-    return obj;
-  return NULL;
+  if ((scope != NULL) &&
+      ((binding == NULL) || (binding->scope == NULL) || (binding->scope->level <= scope->level)))
+    for (; scope != NULL; scope = scope->outer)
+    {
+      obj = findObjectInScope(scope, name);
+      if (obj != NULL)
+      {
+        lookupScope = scope;
+        return obj;
+      }
+    }
+
+  if (binding == NULL)
+    return NULL;
+  lookupScope = binding->scope;
+  return binding->object;
+}
+
+void recordUse(Object *obj, int access)
+{
+  recordXref(obj, lookupScope, access, currentToken);
 }
 
 void checkFreshIdent(char *name)
 {
-  if (findObject(symtab->currentScope->objList, name) != NULL)
+  Binding *binding = findBinding(name);
+  if ((binding != NULL) && (binding->scope == symtab->currentScope))
     error(ERR_DUPLICATE_IDENT, currentToken->lineNo, currentToken->colNo);
 }
 
@@ -43,6 +64,7 @@ Object *checkDeclaredIdent(char *name)
   {
     error(ERR_UNDECLARED_IDENT, currentToken->lineNo, currentToken->colNo);
   }
+  recordUse(obj, (obj->kind == OBJ_FUNCTION) ? XREF_CALL : XREF_READ);
   return obj;
 }
 
@@ -54,6 +76,7 @@ Object *checkDeclaredConstant(char *name)
   if (obj->kind != OBJ_CONSTANT)
     error(ERR_INVALID_CONSTANT, currentToken->lineNo, currentToken->colNo);
 
+  recordUse(obj, XREF_READ);
   return obj;
 }
 
@@ -65,10 +88,12 @@ Object *checkDeclaredType(char *name)
   if (obj->kind != OBJ_TYPE)
     error(ERR_INVALID_TYPE, currentToken->lineNo, currentToken->colNo);
 
+  recordUse(obj, XREF_READ);
   return obj;
 }
 
-Object *checkDeclaredVariable(char *name)
+// access is how the variable is used here: the FOR control variable is written
+Object *checkDeclaredVariable(char *name, int access)
 {
   Object *obj = lookupObject(name);
   if (obj == NULL)
@@ -76,6 +101,7 @@ Object *checkDeclaredVariable(char *name)
   if (obj->kind != OBJ_VARIABLE)
     error(ERR_INVALID_VARIABLE, currentToken->lineNo, currentToken->colNo);
 
+  recordUse(obj, access);
   return obj;
 }
 
@@ -87,6 +113,7 @@ Object *checkDeclaredFunction(char *name)
   if (obj->kind != OBJ_FUNCTION)
     error(ERR_INVALID_FUNCTION, currentToken->lineNo, currentToken->colNo);
 
+  recordUse(obj, XREF_CALL);
   return obj;
 }
 
@@ -98,6 +125,7 @@ Object *checkDeclaredProcedure(char *name)
   if (obj->kind != OBJ_PROCEDURE)
     error(ERR_INVALID_PROCEDURE, currentToken->lineNo, currentToken->colNo);
 
+  recordUse(obj, XREF_CALL);
   return obj;
 }
 
@@ -120,6 +148,7 @@ Object *checkDeclaredLValueIdent(char *name)
     error(ERR_INVALID_IDENT, currentToken->lineNo, currentToken->colNo);
   }
 
+  recordUse(obj, XREF_WRITE);
   return obj;
 }
 
@@ -177,10 +206,26 @@ void checkArrayType(Type *type)
     error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
 }
 
+void checkIntArrayType(Type *type)
+{
+  // An array whose elements, through every dimension, are integers
+  while ((type != NULL) && (type->typeClass == TP_ARRAY))
+    type = type->elementType;
+  checkIntType(type);
+}
+
+void checkCompoundAssignType(Type *varType, Type *expType)
+{
+  // +=, -=, *= and /= are only defined on integers
+  if ((varType == NULL) || (varType->typeClass != TP_INT))
+    error(ERR_OPERATOR_ASSIGN_WITH_CHAR_OR_STRING, currentToken->lineNo, currentToken->colNo);
+  checkIntType(expType);
+}
+
 void checkTypeEquality(Type *type1, Type *type2)
 {
-  // TODO
-  if (compareType(type1, type2) == 0)
+  // Types are interned: equal types are the same node
+  if (type1 != type2)
   {
     error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
   }
@@ -193,4 +238,11 @@ void checkTypeEquality(Type *type1, Type *type2)
   }
 }
 
+// A variable of the type must fit in the frame of the current block
+void checkFrameSpace(Type *type)
+{
+  if (sizeOfType(type) >= INT_MAX - symtab->currentScope->frameSize)
+    error(ERR_FRAME_TOO_LARGE, currentToken->lineNo, currentToken->colNo);
+}
+
 // gcc debug.c symtab.c charcode.c error.c parser.c reader.c scanner.c semantics.c token.c  main.c -o main
\ No newline at end of file
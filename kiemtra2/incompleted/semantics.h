@@ -9,11 +9,13 @@
 
 #include "symtab.h"
 
+Object *lookupObject(char *name);
+void recordUse(Object *obj, int access);
 void checkFreshIdent(char *name);
 Object *checkDeclaredIdent(char *name);
 Object *checkDeclaredConstant(char *name);
 Object *checkDeclaredType(char *name);
-Object *checkDeclaredVariable(char *name);
+Object *checkDeclaredVariable(char *name, int access);
 Object *checkDeclaredFunction(char *name);
 Object *checkDeclaredProcedure(char *name);
 Object *checkDeclaredLValueIdent(char *name);
@@ -21,9 +23,12 @@ Object *checkDeclaredLValueIdent(char *name);
 void checkIntType(Type *type);
 void checkCharType(Type *type);
 void checkArrayType(Type *type);
+void checkIntArrayType(Type *type);
 void checkBasicType(Type *type);
 void checkTypeEquality(Type *type1, Type *type2);
+void checkCompoundAssignType(Type *varType, Type *expType);
 void checkForStType(Type *type);
 void checkExpressionType(Type *type);
+void checkFrameSpace(Type *type);
 
 #endif
@@ -0,0 +1,1126 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ssa.h"
+#include "symtab.h"
+
+#define INIT_VALUES 64
+#define UNREACHED -2        // the depth of an address no path reaches
+
+char *irOpNames[IR_OP_COUNT] = {
+  "const", "undef", "entry", "phi", "la", "lv", "li", "sum",
+  "ad", "sb", "ml", "dv", "neg", "eq", "ne", "gt", "lt", "ge", "le",
+  "rc", "ri", "call", "st", "cp", "wrc", "wri", "wln",
+  "j", "fj", "hl", "ep", "ef"
+};
+
+char *irTypeNames[] = { "none", "int", "char", "addr" };
+
+char* irOpName(enum IrOp op) {
+  return irOpNames[op];
+}
+
+char* irTypeName(enum IrType type) {
+  return irTypeNames[type];
+}
+
+/******************* Instructions ******************************/
+
+IrInstr* irResolve(IrInstr *value) {
+  while (value->forward != NULL)
+    value = value->forward;
+  return value;
+}
+
+int irIsTerminator(enum IrOp op) {
+  return (op == IR_J) || (op == IR_FJ) || (op == IR_HL) || (op == IR_EP) || (op == IR_EF);
+}
+
+// Whether the instruction has no effect but its value: it writes nothing, reads no memory and cannot fail
+int irIsPure(IrInstr *instr) {
+  IrInstr *divisor;
+
+  switch (instr->op) {
+  case IR_CONST:
+  case IR_UNDEF:
+  case IR_ENTRY:
+  case IR_PHI:
+  case IR_LA:
+  case IR_AD:
+  case IR_SB:
+  case IR_ML:
+  case IR_NEG:
+  case IR_EQ:
+  case IR_NE:
+  case IR_GT:
+  case IR_LT:
+  case IR_GE:
+  case IR_LE:
+    return 1;
+  case IR_DV:
+    divisor = irResolve(instr->args[1]);
+    return (divisor->op == IR_CONST) && (divisor->q != 0);
+  default:
+    return 0;
+  }
+}
+
+IrInstr* irNewInstr(IrFunction *fn, enum IrOp op, enum IrType type, WORD p, WORD q, int argCount) {
+  IrInstr *instr = (IrInstr*) malloc(sizeof(IrInstr));
+
+  instr->op = op;
+  instr->type = type;
+  instr->p = p;
+  instr->q = q;
+  instr->argCount = argCount;
+  instr->args = (argCount > 0) ? (IrInstr**) calloc(argCount, sizeof(IrInstr*)) : NULL;
+  instr->block = NULL;
+  instr->prev = NULL;
+  instr->next = NULL;
+  instr->forward = NULL;
+  if (fn->valueCount == fn->valueMax) {
+    fn->valueMax = (fn->valueMax == 0) ? INIT_VALUES : fn->valueMax * 2;
+    fn->values = (IrInstr**) realloc(fn->values, fn->valueMax * sizeof(IrInstr*));
+  }
+  instr->id = fn->valueCount;
+  fn->values[fn->valueCount++] = instr;
+  return instr;
+}
+
+// Links instr into block after prev, at the head for NULL
+void irLink(IrBlock *block, IrInstr *prev, IrInstr *instr) {
+  instr->block = block;
+  instr->prev = prev;
+  instr->next = (prev != NULL) ? prev->next : block->first;
+  if (instr->next != NULL)
+    instr->next->prev = instr;
+  else block->last = instr;
+  if (prev != NULL)
+    prev->next = instr;
+  else block->first = instr;
+}
+
+void irInsertBefore(IrInstr *position, IrInstr *instr) {
+  irLink(position->block, position->prev, instr);
+}
+
+void irInsertAfterPhis(IrBlock *block, IrInstr *instr) {
+  IrInstr *prev = NULL;
+  IrInstr *i;
+
+  for (i = block->first; (i != NULL) && (i->op == IR_PHI); i = i->next)
+    prev = i;
+  irLink(block, prev, instr);
+}
+
+void irAppend(IrBlock *block, IrInstr *instr) {
+  irLink(block, block->last, instr);
+}
+
+// Takes instr out of its block; it is freed with its function
+void irRemove(IrInstr *instr) {
+  IrBlock *block = instr->block;
+
+  if (instr->prev != NULL)
+    instr->prev->next = instr->next;
+  else block->first = instr->next;
+  if (instr->next != NULL)
+    instr->next->prev = instr->prev;
+  else block->last = instr->prev;
+  instr->block = NULL;
+  instr->prev = NULL;
+  instr->next = NULL;
+}
+
+// value takes the place of instr, which is removed
+void irReplace(IrInstr *instr, IrInstr *value) {
+  instr->forward = value;
+  irRemove(instr);
+}
+
+void irResolveArgs(IrFunction *fn) {
+  IrInstr *instr;
+  int b, k;
+
+  for (b = 0; b < fn->blockCount; b++)
+    for (instr = fn->blocks[b]->first; instr != NULL; instr = instr->next)
+      for (k = 0; k < instr->argCount; k++)
+        instr->args[k] = irResolve(instr->args[k]);
+}
+
+/******************* Blocks ******************************/
+
+IrBlock* irNewBlock(IrFunction *fn, CodeAddress start) {
+  IrBlock *block = (IrBlock*) calloc(1, sizeof(IrBlock));
+
+  block->id = fn->blockIds++;
+  block->start = start;
+  return block;
+}
+
+void irAddEdge(IrBlock *from, IrBlock *to) {
+  from->succs[from->succCount++] = to;
+  if (to->predCount == to->predMax) {
+    to->predMax = (to->predMax == 0) ? 2 : to->predMax * 2;
+    to->preds = (IrBlock**) realloc(to->preds, to->predMax * sizeof(IrBlock*));
+  }
+  to->preds[to->predCount++] = from;
+}
+
+int irPredIndex(IrBlock *block, IrBlock *pred) {
+  int k;
+
+  for (k = 0; k < block->predCount; k++)
+    if (block->preds[k] == pred)
+      return k;
+  return -1;
+}
+
+// Drops predecessor k of block, and the arguments its phis take from it
+void irRemovePred(IrBlock *block, int k) {
+  IrInstr *phi;
+
+  for (phi = block->first; (phi != NULL) && (phi->op == IR_PHI); phi = phi->next)
+    if (phi->argCount == block->predCount) {
+      memmove(phi->args + k, phi->args + k + 1, (phi->argCount - k - 1) * sizeof(IrInstr*));
+      phi->argCount--;
+    }
+  memmove(block->preds + k, block->preds + k + 1, (block->predCount - k - 1) * sizeof(IrBlock*));
+  block->predCount--;
+}
+
+// Drops the edge to successor succ of block; the terminator is the caller's to mend
+void irRemoveEdge(IrBlock *block, int succ) {
+  IrBlock *to = block->succs[succ];
+
+  irRemovePred(to, irPredIndex(to, block));
+  if (succ == 0)
+    block->succs[0] = block->succs[1];
+  block->succCount--;
+}
+
+// Removes a block no path reaches any more, with its edges and instructions
+void irRemoveBlock(IrFunction *fn, IrBlock *block) {
+  IrBlock *pred;
+  int b, s;
+
+  while (block->succCount > 0)
+    irRemoveEdge(block, 0);
+  while (block->predCount > 0) {
+    pred = block->preds[0];
+    for (s = 0; pred->succs[s] != block; s++)
+      ;
+    irRemoveEdge(pred, s);
+  }
+  while (block->first != NULL)
+    irRemove(block->first);
+  for (b = 0; fn->blocks[b] != block; b++)
+    ;
+  memmove(fn->blocks + b, fn->blocks + b + 1, (fn->blockCount - b - 1) * sizeof(IrBlock*));
+  fn->blockCount--;
+  free(block->preds);
+  free(block);
+}
+
+// A phi whose arguments are itself and one other value is that value
+IrInstr* irTryRemoveTrivialPhi(IrFunction *fn, IrInstr *phi) {
+  IrInstr *same = NULL;
+  IrInstr *arg;
+  int k;
+
+  for (k = 0; k < phi->argCount; k++) {
+    arg = irResolve(phi->args[k]);
+    if ((arg == same) || (arg == phi))
+      continue;
+    if (same != NULL)
+      return phi;
+    same = arg;
+  }
+  if (same == NULL)
+    same = fn->undef;
+  irReplace(phi, same);
+  return same;
+}
+
+// Removes the trivial phis until there are none, and returns how many
+int irSimplifyPhis(IrFunction *fn) {
+  IrInstr *phi, *next;
+  int b, count = 0, changed = 1;
+
+  while (changed) {
+    changed = 0;
+    for (b = 0; b < fn->blockCount; b++)
+      for (phi = fn->blocks[b]->first; (phi != NULL) && (phi->op == IR_PHI); phi = next) {
+        next = phi->next;
+        if (irTryRemoveTrivialPhi(fn, phi) != phi) {
+          count++;
+          changed = 1;
+        }
+      }
+  }
+  irResolveArgs(fn);
+  return count;
+}
+
+// The blocks reached from the entry, in reverse postorder; returns how many
+int irReversePostorder(IrFunction *fn, IrBlock **order) {
+  IrBlock **stack = (IrBlock**) malloc((fn->blockCount + 1) * sizeof(IrBlock*));
+  int *next = (int*) calloc(fn->blockIds, sizeof(int));
+  char *seen = (char*) calloc(fn->blockIds, sizeof(char));
+  IrBlock *block, *succ;
+  int top = 0, count = 0, k;
+
+  stack[top++] = fn->blocks[0];
+  seen[fn->blocks[0]->id] = 1;
+  while (top > 0) {
+    block = stack[top - 1];
+    if (next[block->id] < block->succCount) {
+      succ = block->succs[next[block->id]++];
+      if (!seen[succ->id]) {
+        seen[succ->id] = 1;
+        stack[top++] = succ;
+      }
+    } else {
+      order[count++] = block;
+      top--;
+    }
+  }
+  for (k = 0; k < count / 2; k++) {
+    block = order[k];
+    order[k] = order[count - 1 - k];
+    order[count - 1 - k] = block;
+  }
+  free(stack);
+  free(next);
+  free(seen);
+  return count;
+}
+
+IrUses* irComputeUses(IrFunction *fn) {
+  IrUses *uses = (IrUses*) malloc(sizeof(IrUses));
+  int *fill = (int*) calloc(fn->valueCount + 1, sizeof(int));
+  IrInstr *instr;
+  int b, k, id;
+
+  uses->starts = (int*) calloc(fn->valueCount + 1, sizeof(int));
+  for (b = 0; b < fn->blockCount; b++)
+    for (instr = fn->blocks[b]->first; instr != NULL; instr = instr->next)
+      for (k = 0; k < instr->argCount; k++)
+        uses->starts[irResolve(instr->args[k])->id + 1]++;
+  for (id = 0; id < fn->valueCount; id++)
+    uses->starts[id + 1] += uses->starts[id];
+  uses->users = (IrInstr**) malloc((uses->starts[fn->valueCount] + 1) * sizeof(IrInstr*));
+  for (b = 0; b < fn->blockCount; b++)
+    for (instr = fn->blocks[b]->first; instr != NULL; instr = instr->next)
+      for (k = 0; k < instr->argCount; k++) {
+        id = irResolve(instr->args[k])->id;
+        uses->users[uses->starts[id] + fill[id]++] = instr;
+      }
+  free(fill);
+  return uses;
+}
+
+void irFreeUses(IrUses *uses) {
+  free(uses->starts);
+  free(uses->users);
+  free(uses);
+}
+
+/******************* Types ******************************/
+
+enum IrType irJoinTypes(enum IrType a, enum IrType b) {
+  if ((a == IRT_NONE) || (a == b))
+    return b;
+  if (b == IRT_NONE)
+    return a;
+  if ((a == IRT_ADDR) || (b == IRT_ADDR))
+    return IRT_ADDR;
+  return IRT_INT;
+}
+
+// The type of a value from those of its arguments, for the instructions whose type depends on them
+enum IrType irInferType(IrInstr *instr) {
+  enum IrType type = IRT_NONE;
+  int k;
+
+  switch (instr->op) {
+  case IR_PHI:
+    for (k = 0; k < instr->argCount; k++)
+      if (irResolve(instr->args[k]) != instr)
+        type = irJoinTypes(type, irResolve(instr->args[k])->type);
+    return type;
+  case IR_AD:
+    if ((irResolve(instr->args[0])->type == IRT_ADDR) || (irResolve(instr->args[1])->type == IRT_ADDR))
+      return IRT_ADDR;
+    return IRT_INT;
+  case IR_SB:
+    if ((irResolve(instr->args[0])->type == IRT_ADDR) && (irResolve(instr->args[1])->type != IRT_ADDR))
+      return IRT_ADDR;
+    return IRT_INT;
+  default:
+    return instr->type;
+  }
+}
+
+void irInferTypes(IrFunction *fn) {
+  IrInstr *instr;
+  enum IrType type;
+  int b, changed = 1;
+
+  while (changed) {
+    changed = 0;
+    for (b = 0; b < fn->blockCount; b++)
+      for (instr = fn->blocks[b]->first; instr != NULL; instr = instr->next) {
+        type = irInferType(instr);
+        if (type != instr->type) {
+          instr->type = type;
+          changed = 1;
+        }
+      }
+  }
+  // A phi only of phis
+  for (b = 0; b < fn->blockCount; b++)
+    for (instr = fn->blocks[b]->first; (instr != NULL) && (instr->op == IR_PHI); instr = instr->next)
+      if (instr->type == IRT_NONE)
+        instr->type = IRT_INT;
+}
+
+/******************* Renaming ******************************/
+
+/* Values are given to variables as in Braun et al., "Simple and
+ * Efficient Construction of Static Single Assignment Form": a block
+ * looks a variable up in itself, then in its predecessors, with a phi
+ * where they are several. A block is sealed once all its predecessors
+ * are filled; until then its phis wait for their arguments. */
+
+IrFunction *irRenamed;
+int irVarCount;
+int *irVarWords;            // the word each variable is, for its phis
+
+void irBeginRenaming(IrFunction *fn, int varCount, int *varWords) {
+  IrBlock *block;
+  int b;
+
+  irRenamed = fn;
+  irVarCount = varCount;
+  irVarWords = varWords;
+  for (b = 0; b < fn->blockCount; b++) {
+    block = fn->blocks[b];
+    block->defs = (IrInstr**) calloc((varCount > 0) ? varCount : 1, sizeof(IrInstr*));
+    block->incompleteCount = 0;
+    block->filled = 0;
+    block->sealed = (block->predCount == 0);
+  }
+}
+
+IrInstr* irNewPhi(IrBlock *block, int var) {
+  IrInstr *phi = irNewInstr(irRenamed, IR_PHI, IRT_NONE, var, irVarWords[var], 0);
+
+  irInsertAfterPhis(block, phi);
+  return phi;
+}
+
+IrInstr* irAddPhiOperands(int var, IrInstr *phi, IrBlock *block) {
+  int k;
+
+  phi->argCount = block->predCount;
+  phi->args = (IrInstr**) calloc(block->predCount, sizeof(IrInstr*));
+  for (k = 0; k < block->predCount; k++)
+    phi->args[k] = irReadVariable(var, block->preds[k]);
+  return irTryRemoveTrivialPhi(irRenamed, phi);
+}
+
+void irWriteVariable(int var, IrBlock *block, IrInstr *value) {
+  block->defs[var] = value;
+}
+
+IrInstr* irReadVariable(int var, IrBlock *block) {
+  IrInstr *value;
+
+  if (block->defs[var] != NULL)
+    return irResolve(block->defs[var]);
+  if (!block->sealed) {
+    value = irNewPhi(block, var);
+    if (block->incompleteCount == block->incompleteMax) {
+      block->incompleteMax = (block->incompleteMax == 0) ? 4 : block->incompleteMax * 2;
+      block->incomplete = (IrInstr**) realloc(block->incomplete, block->incompleteMax * sizeof(IrInstr*));
+    }
+    block->incomplete[block->incompleteCount++] = value;
+  } else if (block->predCount == 0)
+    value = irRenamed->undef;
+  else if (block->predCount == 1)
+    value = irReadVariable(var, block->preds[0]);
+  else {
+    // Written first, for the loops that lead back here
+    value = irNewPhi(block, var);
+    block->defs[var] = value;
+    value = irAddPhiOperands(var, value, block);
+  }
+  block->defs[var] = value;
+  return value;
+}
+
+void irSealBlock(IrBlock *block) {
+  IrInstr *phi;
+  int k;
+
+  block->sealed = 1;
+  for (k = 0; k < block->incompleteCount; k++) {
+    phi = block->incomplete[k];
+    irAddPhiOperands(phi->p, phi, block);
+  }
+  block->incompleteCount = 0;
+}
+
+// Every instruction of block has been renamed
+void irFillBlock(IrBlock *block) {
+  IrBlock *succ;
+  int s, k;
+
+  block->filled = 1;
+  for (s = 0; s < block->succCount; s++) {
+    succ = block->succs[s];
+    if (succ->sealed)
+      continue;
+    for (k = 0; k < succ->predCount; k++)
+      if (!succ->preds[k]->filled)
+        break;
+    if (k == succ->predCount)
+      irSealBlock(succ);
+  }
+}
+
+void irEndRenaming(void) {
+  IrFunction *fn = irRenamed;
+  IrBlock *block;
+  IrInstr *phi;
+  int b;
+
+  for (b = 0; b < fn->blockCount; b++)
+    if (!fn->blocks[b]->sealed)
+      irSealBlock(fn->blocks[b]);
+  for (b = 0; b < fn->blockCount; b++) {
+    block = fn->blocks[b];
+    free(block->defs);
+    free(block->incomplete);
+    block->defs = NULL;
+    block->incomplete = NULL;
+    block->incompleteMax = 0;
+  }
+  irSimplifyPhis(fn);
+  for (b = 0; b < fn->blockCount; b++)
+    for (phi = fn->blocks[b]->first; (phi != NULL) && (phi->op == IR_PHI); phi = phi->next)
+      phi->p = 0;
+  irInferTypes(fn);
+  irRenamed = NULL;
+}
+
+/******************* Construction ******************************/
+
+/* A function is made from the code between its label and the next. Its
+ * operand stack is renamed while its blocks are translated: the depth k
+ * of an address is t - b when it runs, and the word k of the frame is a
+ * variable once it is above the frame. */
+
+CodeBlock *irCode;
+IrFrame *irFrames;
+IrFunction *irFn;
+IrBlock *irBlock;           // the block being translated
+int irDepth;
+int irFailed;
+
+int irOp(CodeAddress i) {
+  return irCode->code[i].op;
+}
+
+int irLabelAt(CodeAddress address) {
+  int label;
+
+  for (label = 0; label < irCode->labelCount; label++)
+    if (irCode->labels[label].address == address)
+      return label;
+  return -1;
+}
+
+// The depth after instruction i, run at depth k
+int irDepthAfter(CodeAddress i, int k) {
+  Instruction *instruction = &(irCode->code[i]);
+
+  switch (instruction->op) {
+  case OP_LA:
+  case OP_LV:
+  case OP_LC:
+  case OP_CV:
+  case OP_RC:
+  case OP_RI:
+    return k + 1;
+  case OP_INT:
+    return k + instruction->q;
+  case OP_DCT:
+    return k - instruction->q;
+  case OP_FJ:
+    return k - 1;
+  case OP_ST:
+  case OP_CP:
+    return k - 2;
+  case OP_CALL:
+    return k + (irFrames[irLabelAt(instruction->q)].result != IRT_NONE);
+  case OP_NEG:
+  case OP_LI:
+  case OP_WLN:
+  case OP_J:
+  case OP_HL:
+  case OP_EP:
+  case OP_EF:
+    return k;
+  default:
+    return k - 1;
+  }
+}
+
+IrInstr* irEmit(enum IrOp op, enum IrType type, WORD p, WORD q, int argCount) {
+  IrInstr *instr = irNewInstr(irFn, op, type, p, q, argCount);
+
+  irAppend(irBlock, instr);
+  return instr;
+}
+
+void irPush(IrInstr *value) {
+  irDepth++;
+  irWriteVariable(irDepth - irFn->frameSize, irBlock, value);
+}
+
+IrInstr* irPop(void) {
+  return irReadVariable(irDepth-- - irFn->frameSize, irBlock);
+}
+
+IrInstr* irTop(void) {
+  return irReadVariable(irDepth - irFn->frameSize, irBlock);
+}
+
+// An operation on the two words on top
+void irBinary(enum IrOp op, enum IrType type) {
+  IrInstr *instr = irNewInstr(irFn, op, type, 0, 0, 2);
+
+  instr->args[1] = irPop();
+  instr->args[0] = irPop();
+  irAppend(irBlock, instr);
+  irPush(instr);
+}
+
+// Translates the stack code of irBlock, from start to end
+void irTranslateBlock(CodeAddress start, CodeAddress end) {
+  Instruction *instruction;
+  IrInstr *instr, *value;
+  enum IrType type;
+  CodeAddress i;
+  int label, k;
+
+  for (i = start; i < end; i++) {
+    instruction = &(irCode->code[i]);
+    switch (instruction->op) {
+    case OP_LA:
+      irPush(irEmit(IR_LA, IRT_ADDR, instruction->p, instruction->q, 0));
+      break;
+    case OP_LV:
+      type = IRT_INT;
+      if ((instruction->p == 0) && (instruction->q >= 0) && (instruction->q < irFn->frameSize) &&
+          (irFn->frame->slots[instruction->q] != IRT_NONE))
+        type = irFn->frame->slots[instruction->q];
+      irPush(irEmit(IR_LV, type, instruction->p, instruction->q, 0));
+      break;
+    case OP_LC:
+      irPush(irEmit(IR_CONST, IRT_INT, 0, instruction->q, 0));
+      break;
+    case OP_LI:
+      instr = irNewInstr(irFn, IR_LI, IRT_INT, 0, 0, 1);
+      instr->args[0] = irPop();
+      irAppend(irBlock, instr);
+      irPush(instr);
+      break;
+    case OP_INT:
+      if (irDepth < 0)
+        irDepth = instruction->q - 1;
+      else for (k = 0; k < instruction->q; k++)
+        irPush(irFn->undef);
+      break;
+    case OP_DCT:
+      if ((i + 1 < end) && (irOp(i + 1) == OP_CALL)) {
+        // The words dropped are the start of the frame of the call
+        label = irLabelAt(irCode->code[i + 1].q);
+        instr = irNewInstr(irFn, IR_CALL, irFrames[label].result, irCode->code[i + 1].p, label, instruction->q);
+        for (k = instruction->q - 1; k >= 0; k--)
+          instr->args[k] = irPop();
+        irAppend(irBlock, instr);
+        if (instr->type != IRT_NONE)
+          irPush(instr);
+        i++;
+      } else for (k = 0; k < instruction->q; k++)
+        irPop();
+      break;
+    case OP_J:
+      irEmit(IR_J, IRT_NONE, 0, 0, 0);
+      break;
+    case OP_FJ:
+      value = irPop();
+      if (instruction->q == i + 1)
+        irEmit(IR_J, IRT_NONE, 0, 0, 0);
+      else irEmit(IR_FJ, IRT_NONE, 0, 0, 1)->args[0] = value;
+      break;
+    case OP_HL:
+      irEmit(IR_HL, IRT_NONE, 0, 0, 0);
+      break;
+    case OP_EP:
+      irEmit(IR_EP, IRT_NONE, 0, 0, 0);
+      break;
+    case OP_EF:
+      irEmit(IR_EF, IRT_NONE, 0, 0, 0);
+      break;
+    case OP_ST:
+    case OP_CP:
+      instr = irNewInstr(irFn, (instruction->op == OP_ST) ? IR_ST : IR_CP, IRT_NONE, 0,
+                         (instruction->op == OP_CP) ? instruction->q : 0, 2);
+      instr->args[1] = irPop();
+      instr->args[0] = irPop();
+      irAppend(irBlock, instr);
+      break;
+    case OP_CALL:
+      irFailed = 1;         // without the DCT that makes its frame
+      return;
+    case OP_RC:
+      irPush(irEmit(IR_RC, IRT_CHAR, 0, 0, 0));
+      break;
+    case OP_RI:
+      irPush(irEmit(IR_RI, IRT_INT, 0, 0, 0));
+      break;
+    case OP_WRC:
+    case OP_WRI:
+      instr = irNewInstr(irFn, (instruction->op == OP_WRC) ? IR_WRC : IR_WRI, IRT_NONE, 0, 0, 1);
+      instr->args[0] = irPop();
+      irAppend(irBlock, instr);
+      break;
+    case OP_WLN:
+      irEmit(IR_WLN, IRT_NONE, 0, 0, 0);
+      break;
+    case OP_AD:
+      irBinary(IR_AD, IRT_NONE);
+      break;
+    case OP_SB:
+      irBinary(IR_SB, IRT_NONE);
+      break;
+    case OP_ML:
+      irBinary(IR_ML, IRT_INT);
+      break;
+    case OP_DV:
+      irBinary(IR_DV, IRT_INT);
+      break;
+    case OP_NEG:
+      instr = irNewInstr(irFn, IR_NEG, IRT_INT, 0, 0, 1);
+      instr->args[0] = irPop();
+      irAppend(irBlock, instr);
+      irPush(instr);
+      break;
+    case OP_CV:
+      irPush(irTop());
+      break;
+    case OP_EQ:
+    case OP_NE:
+    case OP_GT:
+    case OP_LT:
+    case OP_GE:
+    case OP_LE:
+      irBinary(IR_EQ + (instruction->op - OP_EQ), IRT_INT);
+      break;
+    case OP_SUM:
+      irBinary(IR_SUM, IRT_INT);
+      break;
+    default:
+      irFailed = 1;
+      return;
+    }
+  }
+  if ((irBlock->last == NULL) || !irIsTerminator(irBlock->last->op))
+    irEmit(IR_J, IRT_NONE, 0, 0, 0);
+}
+
+// Checks the code of a function and finds where its blocks start and how deep the stack is there
+int irScanFunction(CodeAddress start, CodeAddress end, char *leaders, int *depths, int *maxDepth) {
+  Instruction *instruction;
+  CodeAddress *work;
+  CodeAddress i, next;
+  int workCount = 0, frameSize = 0, k, op;
+
+  for (i = start; i < end; i++) {
+    instruction = &(irCode->code[i]);
+    op = instruction->op;
+    if (isSuperOp(op) || (op < 0) || (op >= PLAIN_OP_COUNT))
+      return 0;
+    if (((op == OP_LA) || (op == OP_LV) || (op == OP_CALL)) && (instruction->p < 0))
+      return 0;
+    if ((op == OP_J) || (op == OP_FJ)) {
+      if ((instruction->q <= start) || (instruction->q >= end))
+        return 0;
+      leaders[instruction->q - start] = 1;
+    }
+    if ((op == OP_CALL) && (irLabelAt(instruction->q) < 0))
+      return 0;
+    if (((op == OP_J) || (op == OP_FJ) || (op == OP_HL) || (op == OP_EP) || (op == OP_EF)) && (i + 1 < end))
+      leaders[i + 1 - start] = 1;
+  }
+  if ((irCode->code[start].op != OP_INT) || (irCode->code[start].q < RESERVED_WORDS))
+    return 0;
+  frameSize = irCode->code[start].q;
+
+  work = (CodeAddress*) malloc((end - start) * sizeof(CodeAddress));
+  for (i = start; i < end; i++)
+    depths[i - start] = UNREACHED;
+  depths[0] = -1;
+  work[workCount++] = start;
+  *maxDepth = frameSize - 1;
+  while (workCount > 0) {
+    i = work[--workCount];
+    k = depths[i - start];
+    for (;;) {
+      instruction = &(irCode->code[i]);
+      k = irDepthAfter(i, k);
+      if ((k < frameSize - 1) || ((instruction->op == OP_INT) && (i != start) && (instruction->q < 0))) {
+        free(work);
+        return 0;
+      }
+      if (k > *maxDepth)
+        *maxDepth = k;
+      if ((instruction->op == OP_HL) || (instruction->op == OP_EP) || (instruction->op == OP_EF))
+        break;
+      if ((instruction->op == OP_J) || (instruction->op == OP_FJ)) {
+        next = instruction->q;
+        if (depths[next - start] == UNREACHED) {
+          depths[next - start] = k;
+          work[workCount++] = next;
+        } else if (depths[next - start] != k) {
+          free(work);
+          return 0;
+        }
+        if (instruction->op == OP_J)
+          break;
+      }
+      if (i + 1 >= end) {
+        free(work);
+        return 0;
+      }
+      if (leaders[i + 1 - start]) {
+        next = i + 1;
+        if (depths[next - start] == UNREACHED) {
+          depths[next - start] = k;
+          work[workCount++] = next;
+        } else if (depths[next - start] != k) {
+          free(work);
+          return 0;
+        }
+        break;
+      }
+      i++;
+    }
+  }
+  free(work);
+  return frameSize;
+}
+
+// The function of the code at label, NULL if it is not as kplc generates it
+IrFunction* irBuildFunction(int label) {
+  CodeAddress start = irCode->labels[label].address;
+  CodeAddress end = (label + 1 < irCode->labelCount) ? irCode->labels[label + 1].address : irCode->codeSize;
+  IrFunction *fn;
+  IrBlock **blockAt;
+  IrBlock *block;
+  Instruction *last;
+  char *leaders;
+  int *depths, *varWords;
+  CodeAddress i, blockEnd;
+  int maxDepth, frameSize, varCount, k;
+
+  if ((start >= end) || (end > irCode->codeSize))
+    return NULL;
+  leaders = (char*) calloc(end - start, sizeof(char));
+  depths = (int*) malloc((end - start) * sizeof(int));
+  leaders[0] = 1;
+  frameSize = irScanFunction(start, end, leaders, depths, &maxDepth);
+  if ((frameSize == 0) || (frameSize != irFrames[label].size)) {
+    free(leaders);
+    free(depths);
+    return NULL;
+  }
+
+  fn = (IrFunction*) calloc(1, sizeof(IrFunction));
+  fn->label = label;
+  fn->frame = &irFrames[label];
+  fn->frameSize = frameSize;
+  fn->promoted = (char*) calloc(frameSize, sizeof(char));
+  fn->blocks = (IrBlock**) malloc((end - start) * sizeof(IrBlock*));
+  blockAt = (IrBlock**) calloc(end - start, sizeof(IrBlock*));
+  for (i = start; i < end; i++)
+    if (leaders[i - start] && (depths[i - start] != UNREACHED)) {
+      block = irNewBlock(fn, i);
+      fn->blocks[fn->blockCount++] = block;
+      blockAt[i - start] = block;
+    }
+
+  // The edges, an FJ to the next address being a J
+  for (k = 0; k < fn->blockCount; k++) {
+    block = fn->blocks[k];
+    for (i = block->start; (i + 1 < end) && !leaders[i + 1 - start]; i++)
+      ;
+    last = &(irCode->code[i]);
+    if (last->op == OP_J)
+      irAddEdge(block, blockAt[last->q - start]);
+    else if ((last->op != OP_HL) && (last->op != OP_EP) && (last->op != OP_EF)) {
+      irAddEdge(block, blockAt[i + 1 - start]);
+      if ((last->op == OP_FJ) && (last->q != i + 1))
+        irAddEdge(block, blockAt[last->q - start]);
+    }
+  }
+
+  // The entry block has nothing before it
+  fn->undef = irNewInstr(fn, IR_UNDEF, IRT_INT, 0, 0, 0);
+  irAppend(fn->blocks[0], fn->undef);
+  if (fn->blocks[0]->predCount > 0)
+    irFailed = 1;
+
+  varCount = maxDepth - frameSize + 1;
+  varWords = (int*) malloc(((varCount > 0) ? varCount : 1) * sizeof(int));
+  for (k = 0; k < varCount; k++)
+    varWords[k] = frameSize + k;
+  irFn = fn;
+  irBeginRenaming(fn, varCount, varWords);
+  for (k = 0; (k < fn->blockCount) && !irFailed; k++) {
+    irBlock = fn->blocks[k];
+    irDepth = depths[irBlock->start - start];
+    blockEnd = (k + 1 < fn->blockCount) ? fn->blocks[k + 1]->start : end;
+    for (i = irBlock->start + 1; i < blockEnd; i++)
+      if (leaders[i - start])
+        break;
+    irTranslateBlock(irBlock->start, i);
+    irFillBlock(irBlock);
+  }
+  irEndRenaming();
+
+  free(varWords);
+  free(blockAt);
+  free(leaders);
+  free(depths);
+  return fn;
+}
+
+void irFreeFunction(IrFunction *fn) {
+  int k;
+
+  for (k = 0; k < fn->valueCount; k++) {
+    free(fn->values[k]->args);
+    free(fn->values[k]);
+  }
+  for (k = 0; k < fn->blockCount; k++) {
+    free(fn->blocks[k]->preds);
+    free(fn->blocks[k]);
+  }
+  free(fn->values);
+  free(fn->blocks);
+  free(fn->promoted);
+  free(fn);
+}
+
+/* The program's code starts with the jump to its body, which comes last,
+ * and every other label starts a subroutine. */
+IrProgram* buildIr(CodeBlock *code, IrFrame *frames, int frameCount) {
+  IrProgram *program;
+  int label;
+
+  if ((code->labelCount == 0) || (frameCount != code->labelCount) || (code->labels[0].address != 1) ||
+      (code->code[0].op != OP_J) || (code->code[0].q != code->labels[code->labelCount - 1].address))
+    return NULL;
+  irCode = code;
+  irFrames = frames;
+  irFailed = 0;
+  program = (IrProgram*) malloc(sizeof(IrProgram));
+  program->code = code;
+  program->frames = frames;
+  program->functionCount = 0;
+  program->functions = (IrFunction**) malloc(code->labelCount * sizeof(IrFunction*));
+  for (label = 0; label < code->labelCount; label++) {
+    program->functions[label] = irBuildFunction(label);
+    if (program->functions[label] == NULL)
+      irFailed = 1;
+    else program->functionCount++;
+    if (irFailed)
+      break;
+  }
+  if (irFailed) {
+    freeIr(program);
+    return NULL;
+  }
+  return program;
+}
+
+void freeIr(IrProgram *program) {
+  int label;
+
+  for (label = 0; label < program->functionCount; label++)
+    irFreeFunction(program->functions[label]);
+  free(program->functions);
+  free(program);
+}
+
+/******************* Checks ******************************/
+
+// The number of arguments an instruction takes, -1 where it varies
+int irArgCount(enum IrOp op) {
+  switch (op) {
+  case IR_LI:
+  case IR_NEG:
+  case IR_WRC:
+  case IR_WRI:
+  case IR_FJ:
+    return 1;
+  case IR_SUM:
+  case IR_AD:
+  case IR_SB:
+  case IR_ML:
+  case IR_DV:
+  case IR_EQ:
+  case IR_NE:
+  case IR_GT:
+  case IR_LT:
+  case IR_GE:
+  case IR_LE:
+  case IR_ST:
+  case IR_CP:
+    return 2;
+  case IR_PHI:
+  case IR_CALL:
+    return -1;
+  default:
+    return 0;
+  }
+}
+
+int irVerifyBlock(IrFunction *fn, IrBlock *block) {
+  IrInstr *instr, *arg;
+  int k, succs;
+
+  if ((block->last == NULL) || !irIsTerminator(block->last->op))
+    return 0;
+  succs = (block->last->op == IR_J) ? 1 : (block->last->op == IR_FJ) ? 2 : 0;
+  if (block->succCount != succs)
+    return 0;
+  for (k = 0; k < block->succCount; k++)
+    if (irPredIndex(block->succs[k], block) < 0)
+      return 0;
+  if ((block->succCount == 2) && (block->succs[0] == block->succs[1]))
+    return 0;
+  for (k = 0; k < block->predCount; k++)
+    if ((block->preds[k]->succs[0] != block) && ((block->preds[k]->succCount < 2) || (block->preds[k]->succs[1] != block)))
+      return 0;
+  for (instr = block->first; instr != NULL; instr = instr->next) {
+    if ((instr->block != block) || ((instr->next == NULL) != (instr == block->last)))
+      return 0;
+    if ((instr->op == IR_PHI) && (((instr->prev != NULL) && (instr->prev->op != IR_PHI)) || (instr->argCount != block->predCount)))
+      return 0;
+    if (irIsTerminator(instr->op) && (instr != block->last))
+      return 0;
+    if ((irArgCount(instr->op) >= 0) && (instr->argCount != irArgCount(instr->op)))
+      return 0;
+    if ((instr->op == IR_CALL) && ((instr->argCount < RESERVED_WORDS) || (instr->q < 0)))
+      return 0;
+    for (k = 0; k < instr->argCount; k++) {
+      arg = instr->args[k];
+      if ((arg == NULL) || (arg->forward != NULL) || (arg->block == NULL) || (arg->type == IRT_NONE))
+        return 0;
+      if ((instr->op == IR_CALL) && (k < RESERVED_WORDS) && (arg != fn->undef))
+        return 0;
+    }
+  }
+  return 1;
+}
+
+// Whether the program is well formed, as the passes and the lowering take it
+int verifyIr(IrProgram *program) {
+  IrFunction *fn;
+  int label, b;
+
+  for (label = 0; label < program->functionCount; label++) {
+    fn = program->functions[label];
+    if ((fn->blockCount == 0) || (fn->blocks[0]->predCount > 0) || (fn->undef->block != fn->blocks[0]))
+      return 0;
+    for (b = 0; b < fn->blockCount; b++)
+      if (!irVerifyBlock(fn, fn->blocks[b]))
+        return 0;
+  }
+  return 1;
+}
+
+/******************* Printing ******************************/
+
+void irPrintInstr(IrProgram *program, IrInstr *instr) {
+  int k;
+
+  printf("  ");
+  if (instr->type != IRT_NONE)
+    printf("v%d:%s = ", instr->id, irTypeName(instr->type));
+  printf("%s", irOpName(instr->op));
+  switch (instr->op) {
+  case IR_CONST:
+  case IR_ENTRY:
+  case IR_PHI:
+  case IR_CP:
+    printf(" %d", instr->q);
+    break;
+  case IR_LA:
+  case IR_LV:
+    printf(" %d,%d", instr->p, instr->q);
+    break;
+  case IR_CALL:
+    printf(" %d,%s", instr->p, program->code->labels[instr->q].name);
+    break;
+  default:
+    break;
+  }
+  for (k = 0; k < instr->argCount; k++) {
+    if ((instr->op == IR_CALL) && (k < RESERVED_WORDS))
+      continue;
+    printf(" v%d", irResolve(instr->args[k])->id);
+    if (instr->op == IR_PHI)
+      printf("(b%d)", instr->block->preds[k]->id);
+  }
+  if (instr->op == IR_J)
+    printf(" b%d", instr->block->succs[0]->id);
+  else if (instr->op == IR_FJ)
+    printf(" ? b%d : b%d", instr->block->succs[0]->id, instr->block->succs[1]->id);
+  printf("\n");
+}
+
+void printIr(IrProgram *program) {
+  IrFunction *fn;
+  IrBlock *block;
+  IrInstr *instr;
+  int label, b, k;
+
+  for (label = 0; label < program->functionCount; label++) {
+    fn = program->functions[label];
+    printf("%s: frame %d\n", program->code->labels[fn->label].name, fn->frameSize);
+    for (b = 0; b < fn->blockCount; b++) {
+      block = fn->blocks[b];
+      printf("b%d:", block->id);
+      for (k = 0; k < block->predCount; k++)
+        printf("%s b%d", (k == 0) ? " from" : ",", block->preds[k]->id);
+      printf("\n");
+      for (instr = block->first; instr != NULL; instr = instr->next)
+        if (instr->op != IR_UNDEF)
+          irPrintInstr(program, instr);
+    }
+  }
+}
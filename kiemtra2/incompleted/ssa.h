@@ -0,0 +1,192 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __SSA_H__
+#define __SSA_H__
+
+#include "instructions.h"
+
+/* SSA form of the stack code, between the checked program and the
+ * backends. kplc generates stack code while it parses; once the program
+ * is checked the code is taken into this form, the passes of passes.h
+ * optimize it and lower.h turns it back into stack code, which the code
+ * file, kplc -S and kplc --emit-c are all made from.
+ *
+ * Every subroutine, and the body of the program, is a function of basic
+ * blocks, the entry block first. An instruction defines at most one
+ * value, an INT, a CHAR or an address. The operand stack is gone: what
+ * the stack code pushed is the value that computed it, and where paths
+ * bringing different values meet, a phi at the head of the block picks
+ * one by the predecessor it came from. The words of a frame stay in
+ * memory, reached through LA, LV, LI and ST, until the promote pass
+ * turns its scalar variables and parameters, where their address is not
+ * taken, into values too.
+ *
+ * What the stack code does not say, the checked program describes with
+ * an IrFrame per code label: which words of the frame hold a scalar
+ * variable or parameter, how deep the block is nested and whether it is
+ * a function. An array element is taken to be reached only through its
+ * array: an index out of range, which the machine does not check, may
+ * give other results once the code is optimized. */
+
+enum IrType {
+  IRT_NONE,       // no value
+  IRT_INT,
+  IRT_CHAR,
+  IRT_ADDR
+};
+
+enum IrOp {
+  IR_CONST,   // q
+  IR_UNDEF,   // a word nothing has set, as those INT reserves for a call
+  IR_ENTRY,   // word q of the frame when the block is entered
+  IR_PHI,     // args[k] when entered from preds[k]
+  IR_LA,      // base(p) + q
+  IR_LV,      // s[base(p) + q]
+  IR_LI,      // s[args[0]]
+  IR_SUM,     // the args[1] words from s[args[0]] added up
+  IR_AD,      // args[0] + args[1], and so on
+  IR_SB,
+  IR_ML,
+  IR_DV,
+  IR_NEG,
+  IR_EQ,
+  IR_NE,
+  IR_GT,
+  IR_LT,
+  IR_GE,
+  IR_LE,
+  IR_RC,
+  IR_RI,
+  IR_CALL,    // calls label q with static link base(p); args are the words of the new frame
+  IR_ST,      // s[args[0]] := args[1]
+  IR_CP,      // the q words at s[args[1]] to s[args[0]]
+  IR_WRC,
+  IR_WRI,
+  IR_WLN,
+  IR_J,       // to succs[0]
+  IR_FJ,      // to succs[1] if args[0] = 0, else to succs[0]
+  IR_HL,
+  IR_EP,
+  IR_EF,
+  IR_OP_COUNT
+};
+
+struct IrBlock_;
+
+// An instruction, and the value it defines
+struct IrInstr_ {
+  enum IrOp op;
+  enum IrType type;
+  WORD p;
+  WORD q;                       // a phi's: the word whose values it picks from
+  int argCount;
+  struct IrInstr_ **args;
+  struct IrBlock_ *block;       // NULL once removed
+  struct IrInstr_ *prev;
+  struct IrInstr_ *next;
+  struct IrInstr_ *forward;     // the value that replaced it
+  int id;
+};
+
+typedef struct IrInstr_ IrInstr;
+
+struct IrBlock_ {
+  int id;
+  CodeAddress start;            // of its stack code
+  IrInstr *first;               // the phis, then the rest, the last a jump, HL, EP or EF
+  IrInstr *last;
+  struct IrBlock_ **preds;
+  int predCount;
+  int predMax;
+  struct IrBlock_ *succs[2];    // an FJ falls through to succs[0] and jumps to succs[1]
+  int succCount;
+  // Renaming
+  IrInstr **defs;
+  IrInstr **incomplete;         // phis waiting for the predecessors
+  int incompleteCount;
+  int incompleteMax;
+  int sealed;
+  int filled;
+};
+
+typedef struct IrBlock_ IrBlock;
+
+// What the checked program tells about the frame of the block at a code label
+struct IrFrame_ {
+  int size;                     // words
+  int level;                    // the level of its scope
+  enum IrType result;           // a function's, IRT_NONE for the others
+  enum IrType *slots;           // per word, the scalar variable or parameter there, IRT_NONE for the others
+};
+
+typedef struct IrFrame_ IrFrame;
+
+struct IrFunction_ {
+  int label;                    // in the code block
+  IrFrame *frame;
+  int frameSize;
+  char *promoted;               // per word of the frame, whether its variable is in values
+  IrBlock **blocks;             // in the order of the code, the entry first
+  int blockCount;
+  int blockIds;                 // given so far, the bound of the ids
+  IrInstr **values;             // by id, the removed ones included
+  int valueCount;
+  int valueMax;
+  IrInstr *undef;
+};
+
+typedef struct IrFunction_ IrFunction;
+
+struct IrProgram_ {
+  CodeBlock *code;
+  IrFrame *frames;              // by code label
+  IrFunction **functions;       // by code label
+  int functionCount;
+};
+
+typedef struct IrProgram_ IrProgram;
+
+// The users of value id are users[starts[id]] to users[starts[id + 1] - 1], an instruction once per operand
+struct IrUses_ {
+  int *starts;
+  IrInstr **users;
+};
+
+typedef struct IrUses_ IrUses;
+
+IrProgram* buildIr(CodeBlock *code, IrFrame *frames, int frameCount);
+void freeIr(IrProgram *program);
+int verifyIr(IrProgram *program);
+void printIr(IrProgram *program);
+char* irOpName(enum IrOp op);
+char* irTypeName(enum IrType type);
+
+IrInstr* irResolve(IrInstr *value);
+int irIsPure(IrInstr *instr);
+int irIsTerminator(enum IrOp op);
+IrInstr* irNewInstr(IrFunction *fn, enum IrOp op, enum IrType type, WORD p, WORD q, int argCount);
+void irInsertBefore(IrInstr *position, IrInstr *instr);
+void irInsertAfterPhis(IrBlock *block, IrInstr *instr);
+void irAppend(IrBlock *block, IrInstr *instr);
+void irRemove(IrInstr *instr);
+void irReplace(IrInstr *instr, IrInstr *value);
+int irPredIndex(IrBlock *block, IrBlock *pred);
+void irRemoveEdge(IrBlock *block, int succ);
+void irRemoveBlock(IrFunction *fn, IrBlock *block);
+int irSimplifyPhis(IrFunction *fn);
+void irResolveArgs(IrFunction *fn);
+int irReversePostorder(IrFunction *fn, IrBlock **order);
+IrUses* irComputeUses(IrFunction *fn);
+void irFreeUses(IrUses *uses);
+
+void irBeginRenaming(IrFunction *fn, int varCount, int *varWords);
+IrInstr* irReadVariable(int var, IrBlock *block);
+void irWriteVariable(int var, IrBlock *block, IrInstr *value);
+void irFillBlock(IrBlock *block);
+void irEndRenaming(void);
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ * Generated by kplsuper from bench/arraysum.prof bench/factorial.prof bench/fib.prof bench/hanoi.prof bench/sieve.prof bench/sort.prof.
+ * SUPEROP(name, length, op1, op2, op3, op4), tried in this order.
+ */
+
+#define SUPEROP_SET 0x69781FF2
+
+#ifdef SUPEROP
+SUPEROP(LA_LV_AD_LI, 4, LA, LV, AD, LI)   // 46940505 of 480016728 dispatches
+SUPEROP(LV_LC_EQ_FJ, 4, LV, LC, EQ, FJ)   // 37940679 of 480016728 dispatches
+SUPEROP(LA_LV_AD_LC, 4, LA, LV, AD, LC)   // 32112720 of 480016728 dispatches
+SUPEROP(LV_AD_LC_ST, 4, LV, AD, LC, ST)   // 32112720 of 480016728 dispatches
+SUPEROP(LV_LC_LE_FJ, 4, LV, LC, LE, FJ)   // 23976000 of 480016728 dispatches
+SUPEROP(LC_ST_LA_CV, 4, LC, ST, LA, CV)   // 23112819 of 480016728 dispatches
+SUPEROP(LA_LV_AD, 3, LA, LV, AD, NONE)   // 52712166 of 480016728 dispatches
+SUPEROP(LC_LE_FJ, 3, LC, LE, FJ, NONE)   // 28014198 of 480016728 dispatches
+SUPEROP(AD_ST_J, 3, AD, ST, J, NONE)   // 27438584 of 480016728 dispatches
+SUPEROP(LA_LV_LC, 3, LA, LV, LC, NONE)   // 25303776 of 480016728 dispatches
+SUPEROP(CV_LI_LC, 3, CV, LI, LC, NONE)   // 24635806 of 480016728 dispatches
+SUPEROP(LV_LC, 2, LV, LC, NONE, NONE)   // 38686010 of 480016728 dispatches
+#endif
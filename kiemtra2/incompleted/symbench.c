@@ -0,0 +1,148 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "symtab.h"
+
+extern SymTab* symtab;
+
+/* Declare N variables in one scope, then look every one of them up, once
+ * through the scope index and, on a sample, by scanning objList the way
+ * lookups used to. Then nest D procedures and resolve a name of the
+ * outermost scope from the innermost, through the binding stacks and by
+ * walking the scope chain. */
+
+#define LINEAR_SAMPLE 1000
+#define NEST_LOOKUPS 100000
+
+double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+void makeName(char *name, int i) {
+  sprintf(name, "V%d", i);
+}
+
+void bench(int n) {
+  char name[MAX_IDENT_LEN];
+  Object *obj;
+  double start, declTime, indexTime, linearTime;
+  int i, step, found = 0;
+
+  initSymTab();
+  symtab->program = createProgramObject("BENCH");
+  enterBlock(symtab->program->progAttrs.scope);
+
+  start = now();
+  for (i = 0; i < n; i++) {
+    makeName(name, i);
+    obj = createVariableObject(name);
+    obj->varAttrs.type = makeIntType();
+    declareObject(obj);
+  }
+  declTime = now() - start;
+
+  start = now();
+  for (i = 0; i < n; i++) {
+    makeName(name, i);
+    if (findObjectInScope(symtab->currentScope, name) != NULL)
+      found++;
+  }
+  indexTime = now() - start;
+
+  step = (n > LINEAR_SAMPLE) ? n / LINEAR_SAMPLE : 1;
+  start = now();
+  for (i = 0; i < n; i += step) {
+    makeName(name, i);
+    if (findObject(symtab->currentScope->objList, name) != NULL)
+      found++;
+  }
+  linearTime = (now() - start) / ((n + step - 1) / step);
+
+  printf("%8d symbols: declare %8.1f ns, indexed lookup %8.1f ns, linear lookup %10.1f ns (%d found)\n",
+         n, declTime * 1e9 / n, indexTime * 1e9 / n, linearTime * 1e9, found);
+
+  exitBlock();
+  cleanSymTab();
+}
+
+// A walk from the current scope outwards, probing each scope index
+Object* walkScopes(char *name) {
+  Scope *scope;
+  Object *obj;
+
+  for (scope = symtab->currentScope; scope != NULL; scope = scope->outer) {
+    obj = findObjectInScope(scope, name);
+    if (obj != NULL)
+      return obj;
+  }
+  return NULL;
+}
+
+void benchNesting(int depth) {
+  char name[MAX_IDENT_LEN];
+  Object *obj;
+  double start, bindingTime, walkTime;
+  int i, found = 0;
+
+  initSymTab();
+  symtab->program = createProgramObject("BENCH");
+  enterBlock(symtab->program->progAttrs.scope);
+
+  for (i = 0; i < depth; i++) {
+    makeName(name, i);
+    obj = createVariableObject(name);
+    obj->varAttrs.type = makeIntType();
+    declareObject(obj);
+
+    sprintf(name, "P%d", i);
+    obj = createProcedureObject(name);
+    declareObject(obj);
+    enterBlock(obj->procAttrs.scope);
+  }
+
+  makeName(name, 0);
+  start = now();
+  for (i = 0; i < NEST_LOOKUPS; i++)
+    if (findBinding(name) != NULL)
+      found++;
+  bindingTime = now() - start;
+
+  start = now();
+  for (i = 0; i < NEST_LOOKUPS; i++)
+    if (walkScopes(name) != NULL)
+      found++;
+  walkTime = now() - start;
+
+  printf("%8d levels:  binding lookup %8.1f ns, scope walk %10.1f ns (%d found)\n",
+         depth, bindingTime * 1e9 / NEST_LOOKUPS, walkTime * 1e9 / NEST_LOOKUPS, found);
+
+  for (i = 0; i <= depth; i++)
+    exitBlock();
+  cleanSymTab();
+}
+
+int main(int argc, char *argv[]) {
+  int i;
+
+  if (argc > 1) {
+    for (i = 1; i < argc; i++)
+      bench(atoi(argv[i]));
+  } else {
+    bench(1000);
+    bench(100000);
+    bench(1000000);
+    benchNesting(10);
+    benchNesting(100);
+    benchNesting(1000);
+  }
+  return 0;
+}
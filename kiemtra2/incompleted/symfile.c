@@ -0,0 +1,376 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "reader.h"
+#include "symfile.h"
+
+extern SymTab* symtab;
+
+/******************* Writer ******************************/
+
+struct IndexEntry_ {
+  void *key;
+  int index;
+};
+
+typedef struct IndexEntry_ IndexEntry;
+
+static IndexEntry *indexTable;
+static int indexCapacity;
+static int indexCount;
+
+static SymFileType *types;
+static int typeCount, typeMax;
+static SymFileObject *objects;
+static int objectCount, objectMax;
+static SymFileNode *nodes;
+static int nodeCount, nodeMax;
+static int interfaceOnly;     // subroutines keep their parameters only
+
+static unsigned hashPointer(void *key) {
+  unsigned long k = (unsigned long) key;
+  return (unsigned) ((k >> 4) ^ (k >> 16));
+}
+
+static int findIndex(void *key) {
+  unsigned i = hashPointer(key) & (indexCapacity - 1);
+  while (indexTable[i].key != NULL) {
+    if (indexTable[i].key == key)
+      return indexTable[i].index;
+    i = (i + 1) & (indexCapacity - 1);
+  }
+  return SYMFILE_NONE;
+}
+
+static void recordIndex(void *key, int index);
+
+static void growIndex(void) {
+  IndexEntry *old = indexTable;
+  int oldCapacity = indexCapacity;
+  int i;
+
+  indexCapacity = (oldCapacity == 0) ? 256 : oldCapacity * 2;
+  indexTable = (IndexEntry*) calloc(indexCapacity, sizeof(IndexEntry));
+  indexCount = 0;
+  for (i = 0; i < oldCapacity; i++)
+    if (old[i].key != NULL)
+      recordIndex(old[i].key, old[i].index);
+  free(old);
+}
+
+static void recordIndex(void *key, int index) {
+  unsigned i;
+
+  if (2 * (indexCount + 1) > indexCapacity)
+    growIndex();
+  i = hashPointer(key) & (indexCapacity - 1);
+  while (indexTable[i].key != NULL)
+    i = (i + 1) & (indexCapacity - 1);
+  indexTable[i].key = key;
+  indexTable[i].index = index;
+  indexCount++;
+}
+
+static void* grow(void *array, int *max, int elementSize) {
+  *max = (*max == 0) ? 64 : (*max) * 2;
+  return realloc(array, (*max) * elementSize);
+}
+
+static int writeType(Type *type) {
+  int index, elementType;
+
+  if (type == NULL)
+    return SYMFILE_NONE;
+  index = findIndex(type);
+  if (index != SYMFILE_NONE)
+    return index;
+
+  if (typeCount == typeMax)
+    types = (SymFileType*) grow(types, &typeMax, sizeof(SymFileType));
+  index = typeCount++;
+  recordIndex(type, index);
+
+  elementType = (type->typeClass == TP_ARRAY) ? writeType(type->elementType) : SYMFILE_NONE;
+  types[index].typeClass = type->typeClass;
+  types[index].arraySize = (type->typeClass == TP_ARRAY) ? type->arraySize : 0;
+  types[index].elementType = elementType;
+  return index;
+}
+
+static int writeObject(Object *obj);
+
+static int writeObjectList(ObjectNode *objList) {
+  int first = SYMFILE_NONE, last = SYMFILE_NONE;
+  int index, object;
+
+  while (objList != NULL) {
+    object = writeObject(objList->object);
+    if (nodeCount == nodeMax)
+      nodes = (SymFileNode*) grow(nodes, &nodeMax, sizeof(SymFileNode));
+    index = nodeCount++;
+    nodes[index].object = object;
+    nodes[index].next = SYMFILE_NONE;
+    if (last == SYMFILE_NONE)
+      first = index;
+    else nodes[last].next = index;
+    last = index;
+    objList = objList->next;
+  }
+  return first;
+}
+
+static int writeObject(Object *obj) {
+  SymFileObject o;
+  int index;
+
+  index = findIndex(obj);
+  if (index != SYMFILE_NONE)
+    return index;
+
+  if (objectCount == objectMax)
+    objects = (SymFileObject*) grow(objects, &objectMax, sizeof(SymFileObject));
+  index = objectCount++;
+  recordIndex(obj, index);
+
+  memset(&o, 0, sizeof(o));
+  strncpy(o.name, obj->name, MAX_IDENT_LEN);
+  o.kind = obj->kind;
+  o.type = o.scope = o.paramList = o.owner = SYMFILE_NONE;
+
+  switch (obj->kind) {
+  case OBJ_CONSTANT:
+    o.valueType = obj->constAttrs.value.type;
+    if (o.valueType == TP_INT)
+      o.value = obj->constAttrs.value.intValue;
+    else o.value = obj->constAttrs.value.charValue;
+    break;
+  case OBJ_TYPE:
+    o.type = writeType(obj->typeAttrs.actualType);
+    break;
+  case OBJ_VARIABLE:
+    o.type = writeType(obj->varAttrs.type);
+    break;
+  case OBJ_PARAMETER:
+    o.type = writeType(obj->paramAttrs.type);
+    o.value = obj->paramAttrs.kind;
+    o.owner = writeObject(obj->paramAttrs.function);
+    break;
+  case OBJ_FUNCTION:
+    o.type = writeType(obj->funcAttrs.returnType);
+    o.scope = writeObjectList(interfaceOnly ? obj->funcAttrs.paramList : obj->funcAttrs.scope->objList);
+    o.paramList = writeObjectList(obj->funcAttrs.paramList);
+    break;
+  case OBJ_PROCEDURE:
+    o.scope = writeObjectList(interfaceOnly ? obj->procAttrs.paramList : obj->procAttrs.scope->objList);
+    o.paramList = writeObjectList(obj->procAttrs.paramList);
+    break;
+  case OBJ_PROGRAM:
+  case OBJ_MODULE:
+    o.scope = writeObjectList(obj->progAttrs.scope->objList);
+    break;
+  }
+
+  objects[index] = o;
+  return index;
+}
+
+static void resetWriter(void) {
+  free(indexTable);
+  free(types);
+  free(objects);
+  free(nodes);
+  indexTable = NULL;
+  types = NULL;
+  objects = NULL;
+  nodes = NULL;
+  indexCapacity = indexCount = 0;
+  typeCount = typeMax = 0;
+  objectCount = objectMax = 0;
+  nodeCount = nodeMax = 0;
+}
+
+static int writeSymFile(char *fileName) {
+  SymFileHeader header;
+  FILE *f;
+  int ok;
+
+  growIndex();
+  header.magic = SYMFILE_MAGIC;
+  header.version = SYMFILE_VERSION;
+  header.program = writeObject(symtab->program);
+  header.globalList = interfaceOnly ? SYMFILE_NONE : writeObjectList(symtab->globalObjectList);
+
+  header.typeCount = typeCount;
+  header.objectCount = objectCount;
+  header.nodeCount = nodeCount;
+  header.typeOffset = sizeof(SymFileHeader);
+  header.objectOffset = header.typeOffset + typeCount * sizeof(SymFileType);
+  header.nodeOffset = header.objectOffset + objectCount * sizeof(SymFileObject);
+
+  f = fopen(fileName, "wb");
+  if (f == NULL) {
+    resetWriter();
+    return IO_ERROR;
+  }
+  ok = (fwrite(&header, sizeof(header), 1, f) == 1)
+    && (fwrite(types, sizeof(SymFileType), typeCount, f) == (size_t) typeCount)
+    && (fwrite(objects, sizeof(SymFileObject), objectCount, f) == (size_t) objectCount)
+    && (fwrite(nodes, sizeof(SymFileNode), nodeCount, f) == (size_t) nodeCount);
+  ok = (fclose(f) == 0) && ok;
+
+  resetWriter();
+  return ok ? IO_SUCCESS : IO_ERROR;
+}
+
+int saveSymFile(char *fileName) {
+  interfaceOnly = 0;
+  return writeSymFile(fileName);
+}
+
+int saveInterfaceFile(char *fileName) {
+  interfaceOnly = 1;
+  return writeSymFile(fileName);
+}
+
+/******************* Loader ******************************/
+
+// An array of count elements at offset, within the image
+static int checkSection(long size, int offset, int count, int elementSize) {
+  return (offset >= (int) sizeof(SymFileHeader)) && (offset % sizeof(int) == 0) &&
+    (count >= 0) && (offset + (long) count * elementSize <= size);
+}
+
+static int checkIndex(int index, int count) {
+  return (index == SYMFILE_NONE) || ((index >= 0) && (index < count));
+}
+
+// The nodes of a list, each in one list only, whose objects the writer wrote after owner
+static int checkList(SymFile *symFile, int node, int owner, char *listed) {
+  for (; node != SYMFILE_NONE; node = symFile->nodes[node].next) {
+    if (listed[node] || (symFile->nodes[node].object <= owner))
+      return 0;
+    listed[node] = 1;
+  }
+  return 1;
+}
+
+/* Every offset, count and index of the image, once, so that its users
+ * may follow them unchecked. The writer gives an array type's element
+ * type, the next node of a list and the objects listed in a scope higher
+ * indices than their own; requiring that keeps the structure acyclic. */
+static int checkSymFile(SymFile *symFile, long size) {
+  SymFileHeader *header = symFile->header;
+  SymFileType *t;
+  SymFileObject *o;
+  char *listed;
+  int i, ok = 1;
+
+  if (!checkSection(size, header->typeOffset, header->typeCount, sizeof(SymFileType)) ||
+      !checkSection(size, header->objectOffset, header->objectCount, sizeof(SymFileObject)) ||
+      !checkSection(size, header->nodeOffset, header->nodeCount, sizeof(SymFileNode)) ||
+      (header->program < 0) || (header->program >= header->objectCount) ||
+      !checkIndex(header->globalList, header->nodeCount))
+    return 0;
+
+  for (i = 0; ok && (i < header->typeCount); i++) {
+    t = &(symFile->types[i]);
+    if (t->typeClass == TP_ARRAY)
+      ok = (t->arraySize > 0) && (t->elementType > i) && (t->elementType < header->typeCount);
+    else ok = (t->typeClass == TP_INT) || (t->typeClass == TP_CHAR);
+  }
+
+  for (i = 0; ok && (i < header->nodeCount); i++)
+    ok = (symFile->nodes[i].object >= 0) && (symFile->nodes[i].object < header->objectCount) &&
+      ((symFile->nodes[i].next == SYMFILE_NONE) ||
+       ((symFile->nodes[i].next > i) && (symFile->nodes[i].next < header->nodeCount)));
+
+  for (i = 0; ok && (i < header->objectCount); i++) {
+    o = &(symFile->objects[i]);
+    ok = (memchr(o->name, '\0', sizeof(o->name)) != NULL) &&
+      checkIndex(o->type, header->typeCount) && checkIndex(o->scope, header->nodeCount) &&
+      checkIndex(o->paramList, header->nodeCount) && checkIndex(o->owner, header->objectCount);
+    switch (o->kind) {
+    case OBJ_CONSTANT:
+      ok = ok && ((o->valueType == TP_INT) || (o->valueType == TP_CHAR));
+      break;
+    case OBJ_PARAMETER:
+      ok = ok && ((o->value == PARAM_VALUE) || (o->value == PARAM_REFERENCE));
+      // fall through
+    case OBJ_TYPE:
+    case OBJ_VARIABLE:
+    case OBJ_FUNCTION:
+      ok = ok && (o->type != SYMFILE_NONE);
+      break;
+    case OBJ_PROCEDURE:
+    case OBJ_PROGRAM:
+    case OBJ_MODULE:
+      break;
+    default:
+      ok = 0;
+      break;
+    }
+  }
+
+  listed = (char*) calloc(header->nodeCount + 1, 1);
+  ok = ok && checkList(symFile, header->globalList, SYMFILE_NONE, listed);
+  for (i = 0; ok && (i < header->objectCount); i++)
+    ok = checkList(symFile, symFile->objects[i].scope, i, listed) &&
+      checkList(symFile, symFile->objects[i].paramList, i, listed);
+  free(listed);
+  return ok;
+}
+
+SymFile* loadSymFile(char *fileName) {
+  SymFile *symFile;
+  SymFileHeader *header;
+  struct stat st;
+  void *image;
+  int fd;
+
+  fd = open(fileName, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if ((fstat(fd, &st) < 0) || (st.st_size < (long) sizeof(SymFileHeader))) {
+    close(fd);
+    return NULL;
+  }
+  image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED)
+    return NULL;
+
+  header = (SymFileHeader*) image;
+  if ((header->magic != SYMFILE_MAGIC) || (header->version != SYMFILE_VERSION)) {
+    munmap(image, st.st_size);
+    return NULL;
+  }
+
+  symFile = (SymFile*) malloc(sizeof(SymFile));
+  symFile->image = image;
+  symFile->size = st.st_size;
+  symFile->header = header;
+  symFile->types = (SymFileType*) ((char*) image + header->typeOffset);
+  symFile->objects = (SymFileObject*) ((char*) image + header->objectOffset);
+  symFile->nodes = (SymFileNode*) ((char*) image + header->nodeOffset);
+  if (!checkSymFile(symFile, st.st_size)) {
+    closeSymFile(symFile);
+    return NULL;
+  }
+  return symFile;
+}
+
+void closeSymFile(SymFile *symFile) {
+  munmap(symFile->image, symFile->size);
+  free(symFile);
+}
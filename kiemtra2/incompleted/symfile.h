@@ -0,0 +1,87 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __SYMFILE_H__
+#define __SYMFILE_H__
+
+#include "symtab.h"
+
+/* Binary image of a checked program's symbol table.
+ *
+ * The file is a header followed by three flat arrays (types, objects and
+ * list nodes). Every reference is an index into one of those arrays, -1
+ * standing for NULL, so the image can be mapped anywhere and used in place.
+ *
+ * A module interface (.kpi) is the same image for a MODULE, reduced to
+ * what importers need: subroutine scopes hold only the parameters and
+ * the predefined subroutines are left out.
+ *
+ * loadSymFile checks every offset, count and index of the image once and
+ * returns NULL for a file that is not a whole image, so that the image
+ * can then be followed without checks.
+ */
+
+#define SYMFILE_MAGIC 0x534C504B   /* "KPLS" */
+#define SYMFILE_VERSION 1
+#define SYMFILE_NONE (-1)
+
+struct SymFileHeader_ {
+  int magic;
+  int version;
+  int typeCount;
+  int typeOffset;
+  int objectCount;
+  int objectOffset;
+  int nodeCount;
+  int nodeOffset;
+  int program;        // object index of the program
+  int globalList;     // node index of the predefined subroutines
+};
+
+struct SymFileType_ {
+  int typeClass;
+  int arraySize;
+  int elementType;
+};
+
+struct SymFileObject_ {
+  char name[MAX_IDENT_LEN + 1];
+  int kind;
+  int type;           // variable, parameter, type or return type
+  int valueType;      // constants only
+  int value;          // constant value, or parameter kind
+  int scope;          // node index of the first object in the scope
+  int paramList;      // node index of the first parameter
+  int owner;          // function or procedure owning a parameter
+};
+
+struct SymFileNode_ {
+  int object;
+  int next;
+};
+
+typedef struct SymFileHeader_ SymFileHeader;
+typedef struct SymFileType_ SymFileType;
+typedef struct SymFileObject_ SymFileObject;
+typedef struct SymFileNode_ SymFileNode;
+
+struct SymFile_ {
+  void *image;
+  long size;
+  SymFileHeader *header;
+  SymFileType *types;
+  SymFileObject *objects;
+  SymFileNode *nodes;
+};
+
+typedef struct SymFile_ SymFile;
+
+int saveSymFile(char *fileName);
+int saveInterfaceFile(char *fileName);
+SymFile* loadSymFile(char *fileName);
+void closeSymFile(SymFile *symFile);
+
+#endif
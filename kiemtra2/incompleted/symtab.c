@@ -7,13 +7,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include "symtab.h"
 #include "error.h"
+#include "memstats.h"
 
 void freeObject(Object* obj);
 void freeScope(Scope* scope);
 void freeObjectList(ObjectNode *objList);
 void freeReferenceList(ObjectNode *objList);
+void insertEntry(Scope* scope, Object* obj, int seq);
+void allocateObject(Scope* scope, Object* obj);
+unsigned hashName(char *name);
+void pushBinding(Object* obj, Scope* scope);
+void popBinding(Object* obj, Scope* scope);
 
 SymTab* symtab;
 Type* intType;
@@ -21,77 +28,108 @@ Type* charType;
 
 /******************* Type utilities ******************************/
 
+/* Types are interned: there is one INT, one CHAR and one node per
+ * distinct (arraySize, elementType) array, so that equal types are the
+ * same pointer. They live as long as the symbol table. */
+
 Type* makeIntType(void) {
-  Type* type = (Type*) malloc(sizeof(Type));
-  type->typeClass = TP_INT;
-  return type;
+  return intType;
 }
 
 Type* makeCharType(void) {
-  Type* type = (Type*) malloc(sizeof(Type));
-  type->typeClass = TP_CHAR;
-  return type;
+  return charType;
 }
 
-Type* makeArrayType(int arraySize, Type* elementType) {
-  Type* type = (Type*) malloc(sizeof(Type));
-  type->typeClass = TP_ARRAY;
-  type->arraySize = arraySize;
-  type->elementType = elementType;
-  return type;
+unsigned hashArrayType(int arraySize, Type* elementType) {
+  return ((unsigned) arraySize * 2654435761u) ^ (unsigned) ((size_t) elementType >> 4);
 }
 
-Type* duplicateType(Type* type) {
-  Type* resultType = (Type*) malloc(sizeof(Type));
-  resultType->typeClass = type->typeClass;
-  if (type->typeClass == TP_ARRAY) {
-    resultType->arraySize = type->arraySize;
-    resultType->elementType = duplicateType(type->elementType);
+Type** findArrayType(int arraySize, Type* elementType) {
+  unsigned i = hashArrayType(arraySize, elementType) & (symtab->arrayTypeSize - 1);
+  Type* type;
+
+  while ((type = symtab->arrayTypes[i]) != NULL) {
+    if ((type->arraySize == arraySize) && (type->elementType == elementType))
+      break;
+    i = (i + 1) & (symtab->arrayTypeSize - 1);
   }
-  return resultType;
+  return &(symtab->arrayTypes[i]);
 }
 
-int compareType(Type* type1, Type* type2) {
-  if (type1->typeClass == type2->typeClass) {
-    if (type1->typeClass == TP_ARRAY) {
-      if (type1->arraySize == type2->arraySize)
-	return compareType(type1->elementType, type2->elementType);
-      else return 0;
-    } else return 1;
-  } else return 0;
+void growArrayTypes(void) {
+  Type **old = symtab->arrayTypes;
+  int oldSize = symtab->arrayTypeSize;
+  int i;
+
+  symtab->arrayTypeSize = oldSize * 2;
+  symtab->arrayTypes = (Type**) memCalloc(MEM_TYPE, symtab->arrayTypeSize, sizeof(Type*));
+  for (i = 0; i < oldSize; i++)
+    if (old[i] != NULL)
+      *findArrayType(old[i]->arraySize, old[i]->elementType) = old[i];
+  memFree(MEM_TYPE, old, oldSize * sizeof(Type*));
 }
 
-void freeType(Type* type) {
-  switch (type->typeClass) {
-  case TP_INT:
-  case TP_CHAR:
-    free(type);
-    break;
-  case TP_ARRAY:
-    freeType(type->elementType);
-    freeType(type);
-    break;
+Type* makeArrayType(int arraySize, Type* elementType) {
+  Type** slot = findArrayType(arraySize, elementType);
+
+  if (*slot == NULL) {
+    if (2 * (symtab->arrayTypeCount + 1) > symtab->arrayTypeSize) {
+      growArrayTypes();
+      slot = findArrayType(arraySize, elementType);
+    }
+    *slot = (Type*) memAlloc(MEM_TYPE, sizeof(Type));
+    (*slot)->typeClass = TP_ARRAY;
+    (*slot)->arraySize = arraySize;
+    (*slot)->elementType = elementType;
+    if ((arraySize > 0) && (elementType->size > INT_MAX / arraySize))
+      (*slot)->size = INT_MAX;
+    else (*slot)->size = arraySize * elementType->size;
+    symtab->arrayTypeCount++;
   }
+  return *slot;
+}
+
+Type* createBasicType(enum TypeClass typeClass) {
+  Type* type = (Type*) memAlloc(MEM_TYPE, sizeof(Type));
+  type->typeClass = typeClass;
+  type->arraySize = 0;
+  type->elementType = NULL;
+  type->size = 1;
+  return type;
+}
+
+int sizeOfType(Type* type) {
+  return type->size;
+}
+
+void freeTypes(void) {
+  int i;
+
+  for (i = 0; i < symtab->arrayTypeSize; i++)
+    memFree(MEM_TYPE, symtab->arrayTypes[i], sizeof(Type));
+  memFree(MEM_TYPE, symtab->arrayTypes, symtab->arrayTypeSize * sizeof(Type*));
+  memFree(MEM_TYPE, intType, sizeof(Type));
+  memFree(MEM_TYPE, charType, sizeof(Type));
 }
 
 /******************* Constant utility ******************************/
 
 ConstantValue* makeIntConstant(int i) {
-  ConstantValue* value = (ConstantValue*) malloc(sizeof(ConstantValue));
+  ConstantValue* value = (ConstantValue*) memAlloc(MEM_CONSTANT, sizeof(ConstantValue));
   value->type = TP_INT;
   value->intValue = i;
   return value;
 }
 
 ConstantValue* makeCharConstant(char ch) {
-  ConstantValue* value = (ConstantValue*) malloc(sizeof(ConstantValue));
+  ConstantValue* value = (ConstantValue*) memAlloc(MEM_CONSTANT, sizeof(ConstantValue));
   value->type = TP_CHAR;
   value->charValue = ch;
   return value;
 }
 
 ConstantValue* duplicateConstantValue(ConstantValue* v) {
-  ConstantValue* value = (ConstantValue*) malloc(sizeof(ConstantValue));
+  ConstantValue* value = (ConstantValue*) memAlloc(MEM_CONSTANT, sizeof(ConstantValue));
   value->type = v->type;
   if (v->type == TP_INT) 
     value->intValue = v->intValue;
@@ -103,118 +141,122 @@ ConstantValue* duplicateConstantValue(ConstantValue* v) {
 /******************* Object utilities ******************************/
 
 Scope* createScope(Object* owner, Scope* outer) {
-  Scope* scope = (Scope*) malloc(sizeof(Scope));
+  Scope* scope = (Scope*) memAlloc(MEM_SCOPE, sizeof(Scope));
   scope->objList = NULL;
+  scope->lastNode = NULL;
+  scope->index = NULL;
+  scope->indexSize = 0;
+  scope->objCount = 0;
+  scope->visibleCount = INT_MAX;
   scope->owner = owner;
   scope->outer = outer;
+  scope->frameSize = RESERVED_WORDS;
+  scope->level = (outer == NULL) ? 0 : outer->level + 1;
   return scope;
 }
 
 Object* createProgramObject(char *programName) {
-  Object* program = (Object*) malloc(sizeof(Object));
+  Object* program = (Object*) memAlloc(MEM_OBJECT, sizeof(Object));
   strcpy(program->name, programName);
   program->kind = OBJ_PROGRAM;
-  program->progAttrs = (ProgramAttributes*) malloc(sizeof(ProgramAttributes));
-  program->progAttrs->scope = createScope(program,NULL);
+  program->progAttrs.scope = createScope(program,NULL);
+  program->progAttrs.codeAddress = -1;
   symtab->program = program;
 
   return program;
 }
 
+// A module's scope holds the objects it exports
+Object* createModuleObject(char *moduleName) {
+  Object* module = (Object*) memAlloc(MEM_OBJECT, sizeof(Object));
+  strcpy(module->name, moduleName);
+  module->kind = OBJ_MODULE;
+  module->progAttrs.scope = createScope(module,NULL);
+  module->progAttrs.codeAddress = -1;
+  return module;
+}
+
 Object* createConstantObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
+  Object* obj = (Object*) memAlloc(MEM_OBJECT, sizeof(Object));
   strcpy(obj->name, name);
   obj->kind = OBJ_CONSTANT;
-  obj->constAttrs = (ConstantAttributes*) malloc(sizeof(ConstantAttributes));
   return obj;
 }
 
 Object* createTypeObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
+  Object* obj = (Object*) memAlloc(MEM_OBJECT, sizeof(Object));
   strcpy(obj->name, name);
   obj->kind = OBJ_TYPE;
-  obj->typeAttrs = (TypeAttributes*) malloc(sizeof(TypeAttributes));
   return obj;
 }
 
 Object* createVariableObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
+  Object* obj = (Object*) memAlloc(MEM_OBJECT, sizeof(Object));
   strcpy(obj->name, name);
   obj->kind = OBJ_VARIABLE;
-  obj->varAttrs = (VariableAttributes*) malloc(sizeof(VariableAttributes));
-  obj->varAttrs->scope = symtab->currentScope;
+  obj->varAttrs.scope = symtab->currentScope;
+  obj->varAttrs.localOffset = 0;
+  obj->varAttrs.level = 0;
   return obj;
 }
 
 Object* createFunctionObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
+  Object* obj = (Object*) memAlloc(MEM_OBJECT, sizeof(Object));
   strcpy(obj->name, name);
   obj->kind = OBJ_FUNCTION;
-  obj->funcAttrs = (FunctionAttributes*) malloc(sizeof(FunctionAttributes));
-  obj->funcAttrs->paramList = NULL;
-  obj->funcAttrs->scope = createScope(obj, symtab->currentScope);
+  obj->funcAttrs.paramList = NULL;
+  obj->funcAttrs.lastParam = NULL;
+  obj->funcAttrs.scope = createScope(obj, symtab->currentScope);
+  obj->funcAttrs.codeAddress = -1;
   return obj;
 }
 
 Object* createProcedureObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
+  Object* obj = (Object*) memAlloc(MEM_OBJECT, sizeof(Object));
   strcpy(obj->name, name);
   obj->kind = OBJ_PROCEDURE;
-  obj->procAttrs = (ProcedureAttributes*) malloc(sizeof(ProcedureAttributes));
-  obj->procAttrs->paramList = NULL;
-  obj->procAttrs->scope = createScope(obj, symtab->currentScope);
+  obj->procAttrs.paramList = NULL;
+  obj->procAttrs.lastParam = NULL;
+  obj->procAttrs.scope = createScope(obj, symtab->currentScope);
+  obj->procAttrs.codeAddress = -1;
   return obj;
 }
 
 Object* createParameterObject(char *name, enum ParamKind kind, Object* owner) {
-  Object* obj = (Object*) malloc(sizeof(Object));
+  Object* obj = (Object*) memAlloc(MEM_OBJECT, sizeof(Object));
   strcpy(obj->name, name);
   obj->kind = OBJ_PARAMETER;
-  obj->paramAttrs = (ParameterAttributes*) malloc(sizeof(ParameterAttributes));
-  obj->paramAttrs->kind = kind;
-  obj->paramAttrs->function = owner;
+  obj->paramAttrs.kind = kind;
+  obj->paramAttrs.function = owner;
+  obj->paramAttrs.localOffset = 0;
+  obj->paramAttrs.level = 0;
   return obj;
 }
 
 void freeObject(Object* obj) {
   switch (obj->kind) {
-  case OBJ_CONSTANT:
-    free(obj->constAttrs->value);
-    free(obj->constAttrs);
-    break;
-  case OBJ_TYPE:
-    free(obj->typeAttrs->actualType);
-    free(obj->typeAttrs);
-    break;
-  case OBJ_VARIABLE:
-    free(obj->varAttrs->type);
-    free(obj->varAttrs);
-    break;
   case OBJ_FUNCTION:
-    freeReferenceList(obj->funcAttrs->paramList);
-    freeType(obj->funcAttrs->returnType);
-    freeScope(obj->funcAttrs->scope);
-    free(obj->funcAttrs);
+    freeReferenceList(obj->funcAttrs.paramList);
+    freeScope(obj->funcAttrs.scope);
     break;
   case OBJ_PROCEDURE:
-    freeReferenceList(obj->procAttrs->paramList);
-    freeScope(obj->procAttrs->scope);
-    free(obj->procAttrs);
+    freeReferenceList(obj->procAttrs.paramList);
+    freeScope(obj->procAttrs.scope);
     break;
   case OBJ_PROGRAM:
-    freeScope(obj->progAttrs->scope);
-    free(obj->progAttrs);
+  case OBJ_MODULE:
+    freeScope(obj->progAttrs.scope);
+    break;
+  default:
     break;
-  case OBJ_PARAMETER:
-    freeType(obj->paramAttrs->type);
-    free(obj->paramAttrs);
   }
-  free(obj);
+  memFree(MEM_OBJECT, obj, sizeof(Object));
 }
 
 void freeScope(Scope* scope) {
   freeObjectList(scope->objList);
-  free(scope);
+  memFree(MEM_SCOPE, scope->index, scope->indexSize * sizeof(ScopeEntry));
+  memFree(MEM_SCOPE, scope, sizeof(Scope));
 }
 
 void freeObjectList(ObjectNode *objList) {
@@ -224,7 +266,31 @@ void freeObjectList(ObjectNode *objList) {
     ObjectNode* node = list;
     list = list->next;
     freeObject(node->object);
-    free(node);
+    memFree(MEM_OBJNODE, node, sizeof(ObjectNode));
+  }
+}
+
+// Free the objects of a scope that follow node last (all of them when last is NULL)
+void freeObjectsAfter(Scope* scope, ObjectNode* last) {
+  ObjectNode *node;
+
+  if (last == NULL) {
+    freeObjectList(scope->objList);
+    scope->objList = NULL;
+  } else {
+    freeObjectList(last->next);
+    last->next = NULL;
+  }
+
+  // Rebuild the index and the frame over the objects that remain
+  scope->lastNode = last;
+  scope->objCount = 0;
+  scope->frameSize = RESERVED_WORDS;
+  if (scope->indexSize > 0)
+    memset(scope->index, 0, scope->indexSize * sizeof(ScopeEntry));
+  for (node = scope->objList; node != NULL; node = node->next) {
+    insertEntry(scope, node->object, scope->objCount++);
+    allocateObject(scope, node->object);
   }
 }
 
@@ -234,12 +300,12 @@ void freeReferenceList(ObjectNode *objList) {
   while (list != NULL) {
     ObjectNode* node = list;
     list = list->next;
-    free(node);
+    memFree(MEM_OBJNODE, node, sizeof(ObjectNode));
   }
 }
 
 void addObject(ObjectNode **objList, Object* obj) {
-  ObjectNode* node = (ObjectNode*) malloc(sizeof(ObjectNode));
+  ObjectNode* node = (ObjectNode*) memAlloc(MEM_OBJNODE, sizeof(ObjectNode));
   node->object = obj;
   node->next = NULL;
   if ((*objList) == NULL) 
@@ -261,74 +327,312 @@ Object* findObject(ObjectNode *objList, char *name) {
   return NULL;
 }
 
+/******************* Scope index ******************************/
+
+unsigned hashName(char *name) {
+  unsigned h = 2166136261u;
+  while (*name != '\0')
+    h = (h ^ (unsigned char) *name++) * 16777619u;
+  return h;
+}
+
+ScopeEntry* findEntry(Scope* scope, char *name) {
+  unsigned i;
+
+  if (scope->indexSize == 0)
+    return NULL;
+  i = hashName(name) & (scope->indexSize - 1);
+  while (scope->index[i].object != NULL) {
+    if (strcmp(scope->index[i].object->name, name) == 0)
+      return &(scope->index[i]);
+    i = (i + 1) & (scope->indexSize - 1);
+  }
+  return NULL;
+}
+
+void insertEntry(Scope* scope, Object* obj, int seq) {
+  unsigned i = hashName(obj->name) & (scope->indexSize - 1);
+  while (scope->index[i].object != NULL)
+    i = (i + 1) & (scope->indexSize - 1);
+  scope->index[i].object = obj;
+  scope->index[i].seq = seq;
+}
+
+void growIndex(Scope* scope) {
+  ScopeEntry *old = scope->index;
+  int oldSize = scope->indexSize;
+  int i;
+
+  scope->indexSize = (oldSize == 0) ? 8 : oldSize * 2;
+  scope->index = (ScopeEntry*) memCalloc(MEM_SCOPE, scope->indexSize, sizeof(ScopeEntry));
+  for (i = 0; i < oldSize; i++)
+    if (old[i].object != NULL)
+      insertEntry(scope, old[i].object, old[i].seq);
+  memFree(MEM_SCOPE, old, oldSize * sizeof(ScopeEntry));
+}
+
+// Give a variable or parameter the next free words of the scope's frame
+// Frame sizes saturate at INT_MAX as type sizes do; the parser rejects a
+// variable that would reach it (checkFrameSpace)
+void allocateObject(Scope* scope, Object* obj) {
+  int size;
+
+  switch (obj->kind) {
+  case OBJ_VARIABLE:
+    obj->varAttrs.localOffset = scope->frameSize;
+    obj->varAttrs.level = scope->level;
+    size = sizeOfType(obj->varAttrs.type);
+    break;
+  case OBJ_PARAMETER:
+    obj->paramAttrs.localOffset = scope->frameSize;
+    obj->paramAttrs.level = scope->level;
+    size = 1;
+    break;
+  default:
+    return;
+  }
+  if (size > INT_MAX - scope->frameSize)
+    scope->frameSize = INT_MAX;
+  else scope->frameSize += size;
+}
+
+// Words past the objects of the scope, for a temporary of its body
+int allocateTemporary(Scope* scope, int size) {
+  int offset = scope->frameSize;
+
+  if (size > INT_MAX - scope->frameSize)
+    scope->frameSize = INT_MAX;
+  else scope->frameSize += size;
+  return offset;
+}
+
+// Append to objList in O(1) and index the object by name
+void addObjectToScope(Scope* scope, Object* obj) {
+  ObjectNode* node = (ObjectNode*) memAlloc(MEM_OBJNODE, sizeof(ObjectNode));
+  node->object = obj;
+  node->next = NULL;
+  if (scope->lastNode == NULL)
+    scope->objList = node;
+  else scope->lastNode->next = node;
+  scope->lastNode = node;
+  allocateObject(scope, obj);
+
+  if (2 * (scope->objCount + 1) > scope->indexSize)
+    growIndex(scope);
+  insertEntry(scope, obj, scope->objCount);
+  scope->objCount++;
+}
+
+// Append a parameter to the list of a function or procedure, in constant time
+void addParameter(Object* owner, Object* param) {
+  ObjectNode **paramList, **lastParam;
+  ObjectNode* node;
+
+  switch (owner->kind) {
+  case OBJ_FUNCTION:
+    paramList = &(owner->funcAttrs.paramList);
+    lastParam = &(owner->funcAttrs.lastParam);
+    break;
+  case OBJ_PROCEDURE:
+    paramList = &(owner->procAttrs.paramList);
+    lastParam = &(owner->procAttrs.lastParam);
+    break;
+  default:
+    return;
+  }
+
+  node = (ObjectNode*) memAlloc(MEM_OBJNODE, sizeof(ObjectNode));
+  node->object = param;
+  node->next = NULL;
+  if (*lastParam == NULL)
+    *paramList = node;
+  else (*lastParam)->next = node;
+  *lastParam = node;
+}
+
+Object* findObjectInScope(Scope* scope, char *name) {
+  ScopeEntry *entry = findEntry(scope, name);
+  if ((entry == NULL) || (entry->seq >= scope->visibleCount))
+    return NULL;
+  return entry->object;
+}
+
+// Hide the objects declared in scope after obj, as if they did not exist yet
+void hideObjectsAfter(Scope* scope, Object* obj) {
+  scope->visibleCount = findEntry(scope, obj->name)->seq + 1;
+}
+
+void showAllObjects(Scope* scope) {
+  scope->visibleCount = INT_MAX;
+}
+
+/******************* Binding stacks ******************************/
+
+BindingStack* findBindingStack(char *name) {
+  unsigned i = hashName(name) & (symtab->bindingSize - 1);
+  while (symtab->bindings[i].name[0] != '\0') {
+    if (strcmp(symtab->bindings[i].name, name) == 0)
+      return &(symtab->bindings[i]);
+    i = (i + 1) & (symtab->bindingSize - 1);
+  }
+  return &(symtab->bindings[i]);
+}
+
+void growBindings(void) {
+  BindingStack *old = symtab->bindings;
+  int oldSize = symtab->bindingSize;
+  int i;
+
+  symtab->bindingSize = oldSize * 2;
+  symtab->bindings = (BindingStack*) memCalloc(MEM_BINDING, symtab->bindingSize, sizeof(BindingStack));
+  for (i = 0; i < oldSize; i++)
+    if (old[i].name[0] != '\0')
+      *findBindingStack(old[i].name) = old[i];
+  memFree(MEM_BINDING, old, oldSize * sizeof(BindingStack));
+}
+
+void pushBinding(Object* obj, Scope* scope) {
+  BindingStack *stack = findBindingStack(obj->name);
+  Binding *binding;
+
+  if (stack->name[0] == '\0') {
+    if (2 * (symtab->bindingCount + 1) > symtab->bindingSize) {
+      growBindings();
+      stack = findBindingStack(obj->name);
+    }
+    strcpy(stack->name, obj->name);
+    symtab->bindingCount++;
+  }
+
+  binding = (Binding*) memAlloc(MEM_BINDING, sizeof(Binding));
+  binding->object = obj;
+  binding->scope = scope;
+  binding->below = stack->top;
+  stack->top = binding;
+}
+
+void popBinding(Object* obj, Scope* scope) {
+  BindingStack *stack = findBindingStack(obj->name);
+  Binding *binding = stack->top;
+
+  // Objects hidden when the scope was entered have no binding to pop
+  if ((binding != NULL) && (binding->object == obj) && (binding->scope == scope)) {
+    stack->top = binding->below;
+    memFree(MEM_BINDING, binding, sizeof(Binding));
+  }
+}
+
+// The innermost live binding of name, or NULL
+Binding* findBinding(char *name) {
+  return findBindingStack(name)->top;
+}
+
+void freeBindings(void) {
+  Binding *binding;
+  int i;
+
+  for (i = 0; i < symtab->bindingSize; i++)
+    while (symtab->bindings[i].top != NULL) {
+      binding = symtab->bindings[i].top;
+      symtab->bindings[i].top = binding->below;
+      memFree(MEM_BINDING, binding, sizeof(Binding));
+    }
+  memFree(MEM_BINDING, symtab->bindings, symtab->bindingSize * sizeof(BindingStack));
+}
+
 /******************* others ******************************/
 
 void initSymTab(void) {
   Object* obj;
   Object* param;
+  ObjectNode* node;
 
-  symtab = (SymTab*) malloc(sizeof(SymTab));
+  symtab = (SymTab*) memAlloc(MEM_OTHER, sizeof(SymTab));
+  symtab->program = NULL;
+  symtab->currentScope = NULL;
+  symtab->unboundScope = NULL;
   symtab->globalObjectList = NULL;
+  symtab->importList = NULL;
+  symtab->bindingSize = 64;
+  symtab->bindingCount = 0;
+  symtab->bindings = (BindingStack*) memCalloc(MEM_BINDING, symtab->bindingSize, sizeof(BindingStack));
+  symtab->arrayTypeSize = 64;
+  symtab->arrayTypeCount = 0;
+  symtab->arrayTypes = (Type**) memCalloc(MEM_TYPE, symtab->arrayTypeSize, sizeof(Type*));
+  intType = createBasicType(TP_INT);
+  charType = createBasicType(TP_CHAR);
   
   obj = createFunctionObject("READC");
-  obj->funcAttrs->returnType = makeCharType();
+  obj->funcAttrs.returnType = makeCharType();
   addObject(&(symtab->globalObjectList), obj);
 
   obj = createFunctionObject("READI");
-  obj->funcAttrs->returnType = makeIntType();
+  obj->funcAttrs.returnType = makeIntType();
   addObject(&(symtab->globalObjectList), obj);
 
   obj = createProcedureObject("WRITEI");
   param = createParameterObject("i", PARAM_VALUE, obj);
-  param->paramAttrs->type = makeIntType();
-  addObject(&(obj->procAttrs->paramList),param);
+  param->paramAttrs.type = makeIntType();
+  addParameter(obj, param);
+  addObjectToScope(obj->procAttrs.scope, param);
   addObject(&(symtab->globalObjectList), obj);
 
   obj = createProcedureObject("WRITEC");
   param = createParameterObject("ch", PARAM_VALUE, obj);
-  param->paramAttrs->type = makeCharType();
-  addObject(&(obj->procAttrs->paramList),param);
+  param->paramAttrs.type = makeCharType();
+  addParameter(obj, param);
+  addObjectToScope(obj->procAttrs.scope, param);
   addObject(&(symtab->globalObjectList), obj);
 
   obj = createProcedureObject("WRITELN");
   addObject(&(symtab->globalObjectList), obj);
 
-  intType = makeIntType();
-  charType = makeCharType();
+  for (node = symtab->globalObjectList; node != NULL; node = node->next)
+    pushBinding(node->object, NULL);
 }
 
 void cleanSymTab(void) {
-  freeObject(symtab->program);
+  freeBindings();
+  if (symtab->program != NULL)      // NULL when a parse stopped before the heading
+    freeObject(symtab->program);
   freeObjectList(symtab->globalObjectList);
-  free(symtab);
-  freeType(intType);
-  freeType(charType);
+  freeObjectList(symtab->importList);
+  freeTypes();
+  memFree(MEM_OTHER, symtab, sizeof(SymTab));
 }
 
 void enterBlock(Scope* scope) {
+  ObjectNode* node;
+  int seq = 0;
+
+  // A scope compiled before (on an incremental reparse) brings back its visible objects
+  for (node = scope->objList; (node != NULL) && (seq < scope->visibleCount); node = node->next, seq++)
+    pushBinding(node->object, scope);
   symtab->currentScope = scope;
 }
 
 void exitBlock(void) {
+  ObjectNode* node;
+
+  for (node = symtab->currentScope->objList; node != NULL; node = node->next)
+    popBinding(node->object, symtab->currentScope);
   symtab->currentScope = symtab->currentScope->outer;
 }
 
 void declareObject(Object* obj) {
-  if (obj->kind == OBJ_PARAMETER) {
-    Object* owner = symtab->currentScope->owner;
-    switch (owner->kind) {
-    case OBJ_FUNCTION:
-      addObject(&(owner->funcAttrs->paramList), obj);
-      break;
-    case OBJ_PROCEDURE:
-      addObject(&(owner->procAttrs->paramList), obj);
-      break;
-    default:
-      break;
-    }
-  }
- 
-  addObject(&(symtab->currentScope->objList), obj);
+  if (obj->kind == OBJ_PARAMETER)
+    addParameter(symtab->currentScope->owner, obj);
+
+  addObjectToScope(symtab->currentScope, obj);
+  pushBinding(obj, symtab->currentScope);
+}
+
+// Make the objects of an imported scope visible beneath the current declarations
+void importScope(Scope* scope) {
+  ObjectNode* node;
+
+  for (node = scope->objList; node != NULL; node = node->next)
+    pushBinding(node->object, scope);
 }
 
 
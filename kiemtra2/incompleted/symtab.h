@@ -22,7 +22,8 @@ enum ObjectKind {
   OBJ_FUNCTION,
   OBJ_PROCEDURE,
   OBJ_PARAMETER,
-  OBJ_PROGRAM
+  OBJ_PROGRAM,
+  OBJ_MODULE
 };
 
 enum ParamKind {
@@ -30,10 +31,19 @@ enum ParamKind {
   PARAM_REFERENCE
 };
 
+/* Storage is counted in words. An INT or a CHAR takes one word, an
+ * array its size times the size of its elements. A frame starts with
+ * RESERVED_WORDS words for the return value, the dynamic link, the return
+ * address and the static link, followed by the parameters, one word each,
+ * then the local variables in declaration order. */
+
+#define RESERVED_WORDS 4
+
 struct Type_ {
   enum TypeClass typeClass;
   int arraySize;
   struct Type_ *elementType;
+  int size;                 // in words
 };
 
 typedef struct Type_ Type;
@@ -55,12 +65,14 @@ struct ObjectNode_;
 struct Object_;
 
 struct ConstantAttributes_ {
-  ConstantValue* value;
+  ConstantValue value;
 };
 
 struct VariableAttributes_ {
   Type *type;
   struct Scope_ *scope;
+  int localOffset;          // in words from the start of the frame
+  int level;                // static nesting level of the scope
 };
 
 struct TypeAttributes_ {
@@ -69,23 +81,30 @@ struct TypeAttributes_ {
 
 struct ProcedureAttributes_ {
   struct ObjectNode_ *paramList;
+  struct ObjectNode_ *lastParam;  // where addParameter appends
   struct Scope_* scope;
+  int codeAddress;          // start of the body's code, -1 until generated
 };
 
 struct FunctionAttributes_ {
   struct ObjectNode_ *paramList;
+  struct ObjectNode_ *lastParam;
   Type* returnType;
   struct Scope_ *scope;
+  int codeAddress;
 };
 
-struct ProgramAttributes_ {
+struct ProgramAttributes_ {    // programs and modules
   struct Scope_ *scope;
+  int codeAddress;
 };
 
 struct ParameterAttributes_ {
   enum ParamKind kind;
   Type* type;
   struct Object_ *function;
+  int localOffset;
+  int level;
 };
 
 typedef struct ConstantAttributes_ ConstantAttributes;
@@ -96,17 +115,18 @@ typedef struct ProcedureAttributes_ ProcedureAttributes;
 typedef struct ProgramAttributes_ ProgramAttributes;
 typedef struct ParameterAttributes_ ParameterAttributes;
 
+// The attributes live in the object itself, selected by kind
 struct Object_ {
   char name[MAX_IDENT_LEN];
   enum ObjectKind kind;
   union {
-    ConstantAttributes* constAttrs;
-    VariableAttributes* varAttrs;
-    TypeAttributes* typeAttrs;
-    FunctionAttributes* funcAttrs;
-    ProcedureAttributes* procAttrs;
-    ProgramAttributes* progAttrs;
-    ParameterAttributes* paramAttrs;
+    ConstantAttributes constAttrs;
+    VariableAttributes varAttrs;
+    TypeAttributes typeAttrs;
+    FunctionAttributes funcAttrs;
+    ProcedureAttributes procAttrs;
+    ProgramAttributes progAttrs;
+    ParameterAttributes paramAttrs;
   };
 };
 
@@ -119,18 +139,58 @@ struct ObjectNode_ {
 
 typedef struct ObjectNode_ ObjectNode;
 
+struct ScopeEntry_ {
+  Object *object;
+  int seq;              // position of the object in objList
+};
+
+typedef struct ScopeEntry_ ScopeEntry;
+
 struct Scope_ {
   ObjectNode *objList;
+  ObjectNode *lastNode;     // tail of objList
+  ScopeEntry *index;        // objList hashed by name, open addressing
+  int indexSize;            // a power of two, 0 until the first object
+  int objCount;
+  int visibleCount;         // objects at or after this position are hidden
   Object *owner;
   struct Scope_ *outer;
+  int frameSize;            // words used so far, the final frame size once the block is compiled
+  int level;                // 0 for a program or module, one more per enclosing subroutine
 };
 
 typedef struct Scope_ Scope;
 
+/* Live bindings of one name, innermost first. A binding is pushed when
+ * its object is declared or its scope is entered, and popped when the
+ * scope is exited. */
+struct Binding_ {
+  Object *object;
+  Scope *scope;             // NULL for the predefined subroutines
+  struct Binding_ *below;
+};
+
+typedef struct Binding_ Binding;
+
+struct BindingStack_ {
+  char name[MAX_IDENT_LEN];
+  Binding *top;
+};
+
+typedef struct BindingStack_ BindingStack;
+
 struct SymTab_ {
   Object* program;
   Scope* currentScope;
+  Scope* unboundScope;      // see lookupObject
   ObjectNode *globalObjectList;
+  ObjectNode *importList;   // modules named in USES
+  BindingStack *bindings;   // hashed by name, open addressing
+  int bindingSize;          // a power of two
+  int bindingCount;
+  Type **arrayTypes;        // interned array types, open addressing
+  int arrayTypeSize;        // a power of two
+  int arrayTypeCount;
 };
 
 typedef struct SymTab_ SymTab;
@@ -138,9 +198,7 @@ typedef struct SymTab_ SymTab;
 Type* makeIntType(void);
 Type* makeCharType(void);
 Type* makeArrayType(int arraySize, Type* elementType);
-Type* duplicateType(Type* type);
-int compareType(Type* type1, Type* type2);
-void freeType(Type* type);
+int sizeOfType(Type* type);
 
 ConstantValue* makeIntConstant(int i);
 ConstantValue* makeCharConstant(char ch);
@@ -149,6 +207,7 @@ ConstantValue* duplicateConstantValue(ConstantValue* v);
 Scope* createScope(Object* owner, Scope* outer);
 
 Object* createProgramObject(char *programName);
+Object* createModuleObject(char *moduleName);
 Object* createConstantObject(char *name);
 Object* createTypeObject(char *name);
 Object* createVariableObject(char *name);
@@ -157,11 +216,23 @@ Object* createProcedureObject(char *name);
 Object* createParameterObject(char *name, enum ParamKind kind, Object* owner);
 
 Object* findObject(ObjectNode *objList, char *name);
+Object* findObjectInScope(Scope* scope, char *name);
+void hideObjectsAfter(Scope* scope, Object* obj);
+void showAllObjects(Scope* scope);
+void addObject(ObjectNode **objList, Object* obj);
+void addObjectToScope(Scope* scope, Object* obj);
+void addParameter(Object* owner, Object* param);
+int allocateTemporary(Scope* scope, int size);
+void freeObjectsAfter(Scope* scope, ObjectNode* last);
+void freeObject(Object* obj);
+
+Binding* findBinding(char *name);
 
 void initSymTab(void);
 void cleanSymTab(void);
 void enterBlock(Scope* scope);
 void exitBlock(void);
 void declareObject(Object* obj);
+void importScope(Scope* scope);
 
 #endif
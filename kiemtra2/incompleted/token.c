@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include "token.h"
+#include "memstats.h"
 
 struct
 {
@@ -34,6 +35,8 @@ struct
     {"FOR", KW_FOR},
     {"TO", KW_TO},
     {"SUM", KW_SUM},
+    {"USES", KW_USES},
+    {"MODULE", KW_MODULE},
 };
 
 int keywordEq(char *kw, char *string)
@@ -59,13 +62,18 @@ TokenType checkKeyword(char *string)
 
 Token *makeToken(TokenType tokenType, int lineNo, int colNo)
 {
-  Token *token = (Token *)malloc(sizeof(Token));
+  Token *token = (Token *)memAlloc(MEM_TOKEN, sizeof(Token));
   token->tokenType = tokenType;
   token->lineNo = lineNo;
   token->colNo = colNo;
   return token;
 }
 
+void freeToken(Token *token)
+{
+  memFree(MEM_TOKEN, token, sizeof(Token));
+}
+
 char *tokenToString(TokenType tokenType)
 {
   switch (tokenType)
@@ -123,6 +131,10 @@ char *tokenToString(TokenType tokenType)
     return "keyword TO";
   case KW_SUM:
     return "keyword SUM";
+  case KW_USES:
+    return "keyword USES";
+  case KW_MODULE:
+    return "keyword MODULE";
 
   case SB_SEMICOLON:
     return "\';\'";
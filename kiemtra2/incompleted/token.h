@@ -39,6 +39,8 @@ typedef enum
   KW_FOR,
   KW_TO,
   KW_SUM,
+  KW_USES,
+  KW_MODULE,
 
   SB_SEMICOLON,
   SB_COLON,
@@ -69,12 +71,14 @@ typedef struct
 {
   char string[MAX_IDENT_LEN + 1];
   int lineNo, colNo;
+  int offset;
   TokenType tokenType;
   int value;
 } Token;
 
 TokenType checkKeyword(char *string);
 Token *makeToken(TokenType tokenType, int lineNo, int colNo);
+void freeToken(Token *token);
 char *tokenToString(TokenType tokenType);
 
 #endif
@@ -0,0 +1,600 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "reader.h"
+#include "vm.h"
+#include "jit.h"
+#include "dispatch.h"
+#include "reduce.h"
+
+// Decoded only: LA and LV in the current frame, which need no static links
+#define VM_LA_LOCAL OP_COUNT
+#define VM_LV_LOCAL (OP_COUNT + 1)
+// and when tiered, the counted subroutine entries and loop back-edges, and the compiled entries
+#define VM_ENTRY (OP_COUNT + 2)
+#define VM_J_BACK (OP_COUNT + 3)
+#define VM_FJ_BACK (OP_COUNT + 4)
+#define VM_NATIVE (OP_COUNT + 5)
+#define VM_OP_COUNT (OP_COUNT + 6)
+
+#define HOT_COUNT 1000      // calls and loop iterations of a unit before it is compiled
+
+struct DecodedInstruction_ {
+#ifdef THREADED_DISPATCH
+  void *handler;
+#else
+  int op;
+#endif
+  WORD p;
+  WORD q;
+  struct DecodedInstruction_ *target;   // of J, FJ and CALL
+};
+
+typedef struct DecodedInstruction_ DecodedInstruction;
+
+CodeAddress vmErrorAddress = 0;
+#if defined(COUNT_DISPATCH) || defined(PROFILE_DISPATCH)
+long vmDispatchCount = 0;
+#else
+long vmDispatchCount = -1;
+#endif
+
+char *vmErrorMessages[] = {
+  "Success",
+  "Stack overflow",
+  "Address out of memory",
+  "Division by zero",
+  "Invalid input",
+  "Jump out of the code"
+};
+
+char* vmErrorMessage(int status) {
+  return vmErrorMessages[status];
+}
+
+char* vmDispatchName(void) {
+#ifdef THREADED_DISPATCH
+  return "threaded";
+#else
+  return "switch";
+#endif
+}
+
+// Follow p static links from the frame at b
+WORD base(WORD *s, WORD b, int p) {
+  for (; p > 0; p--)
+    b = s[b + 3];
+  return b;
+}
+
+/******************* Profiles ******************************/
+
+#ifdef PROFILE_DISPATCH
+
+static long opCounts[PLAIN_OP_COUNT];
+static long pairCounts[PLAIN_OP_COUNT][PLAIN_OP_COUNT];
+static long *addressCounts = NULL;   // how often the instruction at each address ran
+static int profileSize = 0;
+static int lastOp;
+
+#define PROFILE() profileOp(pc - code, pc->op)
+
+void startProfile(int codeSize) {
+  free(addressCounts);
+  addressCounts = (long*) calloc(codeSize + 1, sizeof(long));
+  profileSize = codeSize;
+  memset(opCounts, 0, sizeof(opCounts));
+  memset(pairCounts, 0, sizeof(pairCounts));
+  lastOp = -1;
+}
+
+void profileOp(int address, int op) {
+  if (op == VM_LA_LOCAL)
+    op = OP_LA;
+  else if (op == VM_LV_LOCAL)
+    op = OP_LV;
+  addressCounts[address]++;
+  opCounts[op]++;
+  if (lastOp >= 0)
+    pairCounts[lastOp][op]++;
+  lastOp = op;
+}
+
+#endif
+
+int vmProfiling(void) {
+#ifdef PROFILE_DISPATCH
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+struct Sequence_ {
+  enum OpCode ops[MAX_SUPEROP_LENGTH];
+  int length;
+  long count;
+};
+
+typedef struct Sequence_ Sequence;
+
+/* The opcodes and pairs of opcodes the last run dispatched, then every
+ * sequence a superinstruction could run, with how often it started: the
+ * instructions before the last cannot jump, so each run of the first
+ * runs them all. */
+int saveProfile(CodeBlock *codeBlock, char *fileName) {
+#ifdef PROFILE_DISPATCH
+  Sequence *sequences = NULL;
+  int sequenceCount = 0, sequenceMax = 0;
+  Sequence sequence;
+  FILE *f;
+  int address, length, i, j, ok;
+
+  if ((addressCounts == NULL) || (profileSize != codeBlock->codeSize))
+    return IO_ERROR;
+  f = fopen(fileName, "w");
+  if (f == NULL)
+    return IO_ERROR;
+
+  for (i = 0; i < PLAIN_OP_COUNT; i++)
+    if (opCounts[i] > 0)
+      fprintf(f, "op %s %ld\n", opCodeName(i), opCounts[i]);
+  for (i = 0; i < PLAIN_OP_COUNT; i++)
+    for (j = 0; j < PLAIN_OP_COUNT; j++)
+      if (pairCounts[i][j] > 0)
+        fprintf(f, "pair %s %s %ld\n", opCodeName(i), opCodeName(j), pairCounts[i][j]);
+
+  for (address = 0; address < codeBlock->codeSize; address++) {
+    if (addressCounts[address] == 0)
+      continue;
+    for (length = 2; (length <= MAX_SUPEROP_LENGTH) && (address + length <= codeBlock->codeSize); length++) {
+      if (!canFuse(plainOp(codeBlock->code[address + length - 2].op), 0))
+        break;
+      if (!canFuse(plainOp(codeBlock->code[address + length - 1].op), 1))
+        continue;
+      sequence.length = length;
+      for (i = 0; i < length; i++)
+        sequence.ops[i] = plainOp(codeBlock->code[address + i].op);
+      for (i = 0; i < sequenceCount; i++)
+        if ((sequences[i].length == length) &&
+            (memcmp(sequences[i].ops, sequence.ops, length * sizeof(enum OpCode)) == 0))
+          break;
+      if (i == sequenceCount) {
+        if (sequenceCount == sequenceMax) {
+          sequenceMax = (sequenceMax == 0) ? 64 : sequenceMax * 2;
+          sequences = (Sequence*) realloc(sequences, sequenceMax * sizeof(Sequence));
+        }
+        sequence.count = 0;
+        sequences[sequenceCount++] = sequence;
+      }
+      sequences[i].count += addressCounts[address];
+    }
+  }
+  for (i = 0; i < sequenceCount; i++) {
+    fprintf(f, "seq");
+    for (j = 0; j < sequences[i].length; j++)
+      fprintf(f, " %s", opCodeName(sequences[i].ops[j]));
+    fprintf(f, " %ld\n", sequences[i].count);
+  }
+  free(sequences);
+
+  ok = !ferror(f);
+  ok = (fclose(f) == 0) && ok;
+  return ok ? IO_SUCCESS : IO_ERROR;
+#else
+  return IO_ERROR;
+#endif
+}
+
+/******************* Interpreter ******************************/
+
+#define FAIL(code) do { status = (code); goto stop; } while (0)
+#define FAIL_AT(i, code) do { pc = (i); FAIL(code); } while (0)
+#define CHECK_ADDRESS(i, a) if ((unsigned) (a) >= (unsigned) stackSize) FAIL_AT(i, VM_BAD_ADDRESS)
+
+// s[0 .. t-1] are in memory, s[t] is top
+#define PUSH(v) do { WORD v_ = (v); s[t++] = top; top = v_; } while (0)
+#define POP() (top = s[--t])
+
+/* The operations of the instructions, for instruction i. A handler runs
+ * one, a superinstruction runs those of its sequence; J and FJ dispatch
+ * themselves when they jump. */
+
+#define DO_LA(i) { PUSH(((i)->p == 0 ? b : base(s, b, (i)->p)) + (i)->q); }
+#define DO_LV(i) { PUSH(s[((i)->p == 0 ? b : base(s, b, (i)->p)) + (i)->q]); }
+#define DO_LC(i) { PUSH((i)->q); }
+#define DO_LI(i) { CHECK_ADDRESS(i, top); top = s[top]; }
+#define DO_INT(i) { if (t + (i)->q >= limit) FAIL_AT(i, VM_STACK_OVERFLOW); s[t] = top; t += (i)->q; top = s[t]; }
+#define DO_DCT(i) { s[t] = top; t -= (i)->q; top = s[t]; }
+#define DO_J(i) { pc = (i)->target; DISPATCH(); }
+#define DO_FJ(i) { x = top; POP(); if (x == 0) { pc = (i)->target; DISPATCH(); } }
+#define DO_ST(i) { a = s[t - 1]; CHECK_ADDRESS(i, a); s[a] = top; t -= 2; top = s[t]; }
+#define DO_CP(i) {                                                      \
+    a = s[t - 1];                                                       \
+    if (((unsigned) a > (unsigned) (stackSize - (i)->q)) ||             \
+        ((unsigned) top > (unsigned) (stackSize - (i)->q)))             \
+      FAIL_AT(i, VM_BAD_ADDRESS);                                       \
+    memmove(s + a, s + top, (i)->q * sizeof(WORD));                     \
+    t -= 2;                                                             \
+    top = s[t];                                                         \
+  }
+#define DO_RC(i) { if (scanf(" %c", &ch) != 1) FAIL_AT(i, VM_BAD_INPUT); PUSH((unsigned char) ch); }
+#define DO_RI(i) { if (scanf("%d", &x) != 1) FAIL_AT(i, VM_BAD_INPUT); PUSH(x); }
+#define DO_WRC(i) { putchar(top); POP(); }
+#define DO_WRI(i) { printf("%d", top); POP(); }
+#define DO_WLN(i) { putchar('\n'); }
+#define DO_AD(i) { top = (WORD) ((unsigned) s[t - 1] + (unsigned) top); t--; }
+#define DO_SB(i) { top = (WORD) ((unsigned) s[t - 1] - (unsigned) top); t--; }
+#define DO_ML(i) { top = (WORD) ((unsigned) s[t - 1] * (unsigned) top); t--; }
+// The most negative integer divided by -1 wraps around
+#define DO_DV(i) {                                                      \
+    if (top == 0)                                                       \
+      FAIL_AT(i, VM_DIVISION_BY_ZERO);                                  \
+    if (top == -1)                                                      \
+      top = (WORD) (0u - (unsigned) s[t - 1]);                          \
+    else top = s[t - 1] / top;                                          \
+    t--;                                                                \
+  }
+#define DO_NEG(i) { top = (WORD) (0u - (unsigned) top); }
+#define DO_CV(i) { s[t++] = top; }
+#define DO_EQ(i) { top = (s[t - 1] == top); t--; }
+#define DO_NE(i) { top = (s[t - 1] != top); t--; }
+#define DO_GT(i) { top = (s[t - 1] > top); t--; }
+#define DO_LT(i) { top = (s[t - 1] < top); t--; }
+#define DO_GE(i) { top = (s[t - 1] >= top); t--; }
+#define DO_LE(i) { top = (s[t - 1] <= top); t--; }
+#define DO_SUM(i) {                                                     \
+    a = s[t - 1];                                                       \
+    if ((top < 0) || ((unsigned) a > (unsigned) stackSize) || (top > stackSize - a)) \
+      FAIL_AT(i, VM_BAD_ADDRESS);                                       \
+    top = sumWords(s + a, top);                                         \
+    t--;                                                                \
+  }
+#define DO_NONE(i)
+
+/* Tiered, each unit counts its calls and loop iterations: a subroutine
+ * that gets hot is compiled, with what it calls, and its entries run the
+ * native code from then on; a loop of the program that gets hot goes on
+ * in the native code of the program. */
+
+// Compiles unit e, then calls natively the subroutines it compiled
+#define TIER_UP(e) do {                                                 \
+    if (jitCompile(jit, (e)))                                           \
+      for (k = 0; k < entryCount; k++)                                  \
+        if (jitCompiled(jit, entries[k]))                               \
+          SET_OP(&code[entries[k]], VM_NATIVE);                         \
+  } while (0)
+
+/* The native code gets the machine through copies, so that b, t and
+ * top, whose addresses are never taken, stay in registers */
+#define ENTER_NATIVE(enter, address) do {                               \
+    nb = b; nt = t; ntop = top;                                         \
+    status = enter(jit, (address), s, &nb, &nt, &ntop);                 \
+    b = nb; t = nt; top = ntop;                                         \
+  } while (0)
+
+// pc is at the head of a loop that went round once more
+#define BACK_EDGE() do {                                                \
+    e = owners[pc - code];                                              \
+    if (++counts[e] == HOT_COUNT) {                                     \
+      if (subroutine[e])                                                \
+        TIER_UP(e);                                                     \
+      else if ((b == 0) && jitCompile(jit, 0) && jitCompiled(jit, pc - code)) { \
+        ENTER_NATIVE(jitEnter, pc - code);                              \
+        FAIL_AT(code + vmErrorAddress, status);                         \
+      }                                                                 \
+    }                                                                   \
+  } while (0)
+
+// Whether the instruction at i is a J or FJ back to it or before
+int isBackEdge(CodeBlock *codeBlock, CodeAddress i) {
+  Instruction *instruction = &(codeBlock->code[i]);
+  enum OpCode op = plainOp(instruction->op);
+
+  return ((op == OP_J) || (op == OP_FJ)) && (instruction->q <= i);
+}
+
+int interpret(CodeBlock *codeBlock, int stackSize, JitCode *jit) {
+#ifdef THREADED_DISPATCH
+  static void *handlers[VM_OP_COUNT] = {
+    [OP_LA] = &&do_OP_LA, [OP_LV] = &&do_OP_LV, [OP_LC] = &&do_OP_LC, [OP_LI] = &&do_OP_LI,
+    [OP_INT] = &&do_OP_INT, [OP_DCT] = &&do_OP_DCT, [OP_J] = &&do_OP_J, [OP_FJ] = &&do_OP_FJ,
+    [OP_HL] = &&do_OP_HL, [OP_ST] = &&do_OP_ST, [OP_CP] = &&do_OP_CP, [OP_CALL] = &&do_OP_CALL,
+    [OP_EP] = &&do_OP_EP, [OP_EF] = &&do_OP_EF, [OP_RC] = &&do_OP_RC, [OP_RI] = &&do_OP_RI,
+    [OP_WRC] = &&do_OP_WRC, [OP_WRI] = &&do_OP_WRI, [OP_WLN] = &&do_OP_WLN,
+    [OP_AD] = &&do_OP_AD, [OP_SB] = &&do_OP_SB, [OP_ML] = &&do_OP_ML, [OP_DV] = &&do_OP_DV,
+    [OP_NEG] = &&do_OP_NEG, [OP_CV] = &&do_OP_CV, [OP_EQ] = &&do_OP_EQ, [OP_NE] = &&do_OP_NE,
+    [OP_GT] = &&do_OP_GT, [OP_LT] = &&do_OP_LT, [OP_GE] = &&do_OP_GE, [OP_LE] = &&do_OP_LE,
+    [OP_SUM] = &&do_OP_SUM, [VM_LA_LOCAL] = &&do_VM_LA_LOCAL, [VM_LV_LOCAL] = &&do_VM_LV_LOCAL,
+    [VM_ENTRY] = &&do_VM_ENTRY, [VM_J_BACK] = &&do_VM_J_BACK, [VM_FJ_BACK] = &&do_VM_FJ_BACK,
+    [VM_NATIVE] = &&do_VM_NATIVE,
+#define SUPEROP(name, length, op1, op2, op3, op4) [OP_##name] = &&do_OP_##name,
+#include "superops.h"
+#undef SUPEROP
+  };
+#endif
+  DecodedInstruction *code, *pc;
+  Instruction *instruction;
+  WORD *memory, *s;
+  WORD top = 0, x, a;
+  char ch;
+  int codeSize = codeBlock->codeSize;
+  int limit = stackSize - STACK_MARGIN;
+  int t = -1, b = 0;
+  int i, k, op, status;
+  long *counts = NULL;          // of each unit, at its entry
+  CodeAddress *owners = NULL;   // the entry of the unit of each address
+  CodeAddress *entries = NULL;  // of the subroutines
+  char *subroutine = NULL;
+  int entryCount = 0;
+  CodeAddress e;
+  int nb, nt;
+  WORD ntop;
+
+  // One more instruction halts a machine that runs off the end
+  code = (DecodedInstruction*) malloc((codeSize + 1) * sizeof(DecodedInstruction));
+  for (i = 0; i <= codeSize; i++) {
+    if (i == codeSize) {
+      SET_OP(&code[i], OP_HL);
+      break;
+    }
+    instruction = &(codeBlock->code[i]);
+    op = instruction->op;
+#ifdef PROFILE_DISPATCH
+    // Every instruction is profiled on its own
+    op = plainOp(op);
+#endif
+    // Tiered, the back-edge of a loop is dispatched on its own, to count it
+    if ((jit != NULL) && isSuperOp(op) && isBackEdge(codeBlock, i + getSuperOp(op)->length - 1))
+      op = plainOp(op);
+    if ((op == OP_LA) && (instruction->p == 0))
+      op = VM_LA_LOCAL;
+    else if ((op == OP_LV) && (instruction->p == 0))
+      op = VM_LV_LOCAL;
+    SET_OP(&code[i], op);
+    code[i].p = instruction->p;
+    code[i].q = instruction->q;
+    code[i].target = NULL;
+    if ((op == OP_J) || (op == OP_FJ) || (op == OP_CALL)) {
+      if ((instruction->q < 0) || (instruction->q > codeSize)) {
+        free(code);
+        vmErrorAddress = i;
+        return VM_BAD_JUMP;
+      }
+      code[i].target = code + instruction->q;
+      if ((jit != NULL) && isBackEdge(codeBlock, i))
+        SET_OP(&code[i], op == OP_J ? VM_J_BACK : VM_FJ_BACK);
+    }
+  }
+
+  // The units start where the labels are, and the subroutines where CALL goes
+  if (jit != NULL) {
+    counts = (long*) calloc(codeSize + 1, sizeof(long));
+    owners = (CodeAddress*) malloc((codeSize + 1) * sizeof(CodeAddress));
+    entries = (CodeAddress*) malloc((codeSize + 1) * sizeof(CodeAddress));
+    subroutine = (char*) calloc(codeSize + 1, sizeof(char));
+    for (i = 0, k = 0; i <= codeSize; i++) {
+      while ((k < codeBlock->labelCount) && (codeBlock->labels[k].address <= i))
+        k++;
+      owners[i] = (k > 0) ? codeBlock->labels[k - 1].address : 0;
+    }
+    for (i = 0; i < codeSize; i++) {
+      e = codeBlock->code[i].q;
+      if ((codeBlock->code[i].op != OP_CALL) || (e >= codeSize) || subroutine[e] ||
+          (plainOp(codeBlock->code[e].op) != OP_INT))
+        continue;
+      subroutine[e] = 1;
+      entries[entryCount++] = e;
+      SET_OP(&code[e], VM_ENTRY);
+    }
+  }
+
+#ifdef PROFILE_DISPATCH
+  startProfile(codeSize);
+#endif
+
+  // s[-1] takes the top spilled by the first push
+  memory = (WORD*) calloc(stackSize + 1, sizeof(WORD));
+  s = memory + 1;
+  pc = code;
+
+  BEGIN_DISPATCH()
+
+  CASE(OP_LA)
+    DO_LA(pc);
+    NEXT();
+  CASE(VM_LA_LOCAL)
+    PUSH(b + pc->q);
+    NEXT();
+  CASE(OP_LV)
+    DO_LV(pc);
+    NEXT();
+  CASE(VM_LV_LOCAL)
+    PUSH(s[b + pc->q]);
+    NEXT();
+  CASE(OP_LC)
+    DO_LC(pc);
+    NEXT();
+  CASE(OP_LI)
+    DO_LI(pc);
+    NEXT();
+  CASE(OP_INT)
+    DO_INT(pc);
+    NEXT();
+  CASE(OP_DCT)
+    DO_DCT(pc);
+    NEXT();
+  CASE(OP_J)
+    DO_J(pc);
+  CASE(OP_FJ)
+    DO_FJ(pc);
+    NEXT();
+  CASE(OP_HL)
+    FAIL(VM_SUCCESS);
+  CASE(OP_ST)
+    DO_ST(pc);
+    NEXT();
+  CASE(OP_CP)
+    DO_CP(pc);
+    NEXT();
+  CASE(OP_CALL)
+    s[t + 2] = b;
+    s[t + 3] = pc + 1 - code;
+    s[t + 4] = base(s, b, pc->p);
+    b = t + 1;
+    pc = pc->target;
+    DISPATCH();
+  CASE(OP_EP)
+    a = b;
+    if ((unsigned) s[a + 2] > (unsigned) codeSize)
+      FAIL(VM_BAD_JUMP);
+    pc = code + s[a + 2];
+    b = s[a + 1];
+    t = a - 1;
+    top = s[t];
+    DISPATCH();
+  CASE(OP_EF)
+    a = b;
+    if ((unsigned) s[a + 2] > (unsigned) codeSize)
+      FAIL(VM_BAD_JUMP);
+    pc = code + s[a + 2];
+    b = s[a + 1];
+    t = a;
+    top = s[t];
+    DISPATCH();
+  CASE(OP_RC)
+    DO_RC(pc);
+    NEXT();
+  CASE(OP_RI)
+    DO_RI(pc);
+    NEXT();
+  CASE(OP_WRC)
+    DO_WRC(pc);
+    NEXT();
+  CASE(OP_WRI)
+    DO_WRI(pc);
+    NEXT();
+  CASE(OP_WLN)
+    DO_WLN(pc);
+    NEXT();
+  CASE(OP_AD)
+    DO_AD(pc);
+    NEXT();
+  CASE(OP_SB)
+    DO_SB(pc);
+    NEXT();
+  CASE(OP_ML)
+    DO_ML(pc);
+    NEXT();
+  CASE(OP_DV)
+    DO_DV(pc);
+    NEXT();
+  CASE(OP_NEG)
+    DO_NEG(pc);
+    NEXT();
+  CASE(OP_CV)
+    DO_CV(pc);
+    NEXT();
+  CASE(OP_EQ)
+    DO_EQ(pc);
+    NEXT();
+  CASE(OP_NE)
+    DO_NE(pc);
+    NEXT();
+  CASE(OP_GT)
+    DO_GT(pc);
+    NEXT();
+  CASE(OP_LT)
+    DO_LT(pc);
+    NEXT();
+  CASE(OP_GE)
+    DO_GE(pc);
+    NEXT();
+  CASE(OP_LE)
+    DO_LE(pc);
+    NEXT();
+  CASE(OP_SUM)
+    DO_SUM(pc);
+    NEXT();
+
+  CASE(VM_ENTRY)
+    if (++counts[pc - code] == HOT_COUNT) {
+      TIER_UP(pc - code);
+      if (jitCompiled(jit, pc - code))
+        DISPATCH();
+    }
+    DO_INT(pc);
+    NEXT();
+  CASE(VM_J_BACK)
+    pc = pc->target;
+    BACK_EDGE();
+    DISPATCH();
+  CASE(VM_FJ_BACK)
+    x = top;
+    POP();
+    if (x == 0) {
+      pc = pc->target;
+      BACK_EDGE();
+      DISPATCH();
+    }
+    NEXT();
+  CASE(VM_NATIVE)
+    // Until the subroutine returns, to the address in its frame
+    a = b;
+    ENTER_NATIVE(jitCall, pc - code);
+    if (status != JIT_RETURNED)
+      FAIL_AT(code + vmErrorAddress, status);
+    if ((unsigned) s[a + 2] > (unsigned) codeSize)
+      FAIL(VM_BAD_JUMP);
+    pc = code + s[a + 2];
+    DISPATCH();
+
+#define SUPEROP(name, length, op1, op2, op3, op4)                      \
+  CASE(OP_##name)                                                       \
+    DO_##op1(pc);                                                       \
+    DO_##op2(pc + 1);                                                   \
+    DO_##op3(pc + 2);                                                   \
+    DO_##op4(pc + 3);                                                   \
+    pc += length;                                                       \
+    DISPATCH();
+#include "superops.h"
+#undef SUPEROP
+
+  END_DISPATCH()
+
+ stop:
+  fflush(stdout);
+  vmErrorAddress = pc - code;
+  free(memory);
+  free(code);
+  free(counts);
+  free(owners);
+  free(entries);
+  free(subroutine);
+  return status;
+}
+
+int runCode(CodeBlock *codeBlock, int stackSize) {
+  return interpret(codeBlock, stackSize, NULL);
+}
+
+// What is counted or profiled is every instruction of the program
+int runTiered(CodeBlock *codeBlock, int stackSize) {
+  JitCode *jit = NULL;
+  int status;
+
+#if !defined(COUNT_DISPATCH) && !defined(PROFILE_DISPATCH)
+  jit = newJit(codeBlock, stackSize);
+#endif
+  status = interpret(codeBlock, stackSize, jit);
+  if (jit != NULL)
+    freeJit(jit);
+  return status;
+}
@@ -0,0 +1,52 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __VM_H__
+#define __VM_H__
+
+#include "instructions.h"
+
+/* Interpreter for the stack machine of instructions.h.
+ *
+ * The code is decoded once before it runs: jump targets become pointers
+ * and LA/LV in the current frame get their own handlers. Built with GCC
+ * or Clang the handlers are threaded through computed gotos; defining
+ * SWITCH_DISPATCH, or any other compiler, gives the portable loop over
+ * a switch. The top of the stack is kept in a local variable.
+ *
+ * Built with PROFILE_DISPATCH it runs superinstructions as the plain
+ * instructions they replaced and counts what it dispatches, for
+ * saveProfile to write out and kplsuper to choose superinstructions
+ * from.
+ *
+ * runTiered interprets the code until part of it gets hot, then runs
+ * that part as native code from jit.h: a subroutine called or looping
+ * often is compiled for its next calls, and a loop of the program that
+ * runs long goes on in native code where it is. Where there is no JIT,
+ * and when counting or profiling, it only interprets. */
+
+#define DEFAULT_STACK_SIZE 1048576  // words
+#define STACK_MARGIN 1024           // words left for the operands of a frame
+
+#define VM_SUCCESS 0
+#define VM_STACK_OVERFLOW 1
+#define VM_BAD_ADDRESS 2
+#define VM_DIVISION_BY_ZERO 3
+#define VM_BAD_INPUT 4
+#define VM_BAD_JUMP 5
+
+extern CodeAddress vmErrorAddress;  // the instruction that failed
+extern long vmDispatchCount;        // -1 unless built with COUNT_DISPATCH or PROFILE_DISPATCH
+
+WORD base(WORD *s, WORD b, int p);
+int runCode(CodeBlock *codeBlock, int stackSize);
+int runTiered(CodeBlock *codeBlock, int stackSize);
+char* vmErrorMessage(int status);
+char* vmDispatchName(void);
+int vmProfiling(void);
+int saveProfile(CodeBlock *codeBlock, char *fileName);
+
+#endif
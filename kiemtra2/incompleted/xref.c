@@ -0,0 +1,222 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "xref.h"
+
+#define INIT_XREF_INDEX 64
+#define INIT_XREF_REFS 4
+
+int xrefEnabled = 0;
+
+XrefList *xrefLists = NULL;     // indexed by object id
+int xrefCount = 0;
+int xrefMax = 0;
+
+int *xrefIndex = NULL;          // open addressing on the object pointer, -1 when empty
+int xrefIndexSize = 0;
+
+XrefSpan *xrefSpans = NULL;     // every reference, by source offset once sorted
+int xrefSpanCount = 0;
+int xrefSpanMax = 0;
+int xrefSpansSorted = 1;
+
+char *accessNames[] = { "read", "write", "call" };
+
+/******************* Index ******************************/
+
+unsigned hashObject(Object *obj) {
+  uintptr_t p = (uintptr_t) obj;
+  p ^= p >> 17;
+  p *= 0x9E3779B1u;
+  return (unsigned) (p ^ (p >> 15));
+}
+
+int* findXrefSlot(Object *obj) {
+  unsigned i = hashObject(obj) & (xrefIndexSize - 1);
+
+  while ((xrefIndex[i] >= 0) && (xrefLists[xrefIndex[i]].object != obj))
+    i = (i + 1) & (xrefIndexSize - 1);
+  return &(xrefIndex[i]);
+}
+
+void growXrefIndex(void) {
+  int i;
+
+  free(xrefIndex);
+  xrefIndexSize = (xrefIndexSize == 0) ? INIT_XREF_INDEX : xrefIndexSize * 2;
+  xrefIndex = (int*) malloc(xrefIndexSize * sizeof(int));
+  for (i = 0; i < xrefIndexSize; i++)
+    xrefIndex[i] = -1;
+  for (i = 0; i < xrefCount; i++)
+    *findXrefSlot(xrefLists[i].object) = i;
+}
+
+XrefList* newXrefList(Object *obj, Scope *scope) {
+  XrefList *list;
+
+  if (xrefCount == xrefMax) {
+    xrefMax = (xrefMax == 0) ? INIT_XREF_INDEX : xrefMax * 2;
+    xrefLists = (XrefList*) realloc(xrefLists, xrefMax * sizeof(XrefList));
+  }
+  if (2 * (xrefCount + 1) > xrefIndexSize)
+    growXrefIndex();
+
+  list = &(xrefLists[xrefCount]);
+  list->object = obj;
+  list->scope = scope;
+  list->id = xrefCount;
+  list->refs = NULL;
+  list->count = 0;
+  list->max = 0;
+  *findXrefSlot(obj) = xrefCount++;
+  return list;
+}
+
+/******************* Spans ******************************/
+
+int compareSpans(const void *a, const void *b) {
+  return ((XrefSpan*) a)->offset - ((XrefSpan*) b)->offset;
+}
+
+void addXrefSpan(Object *obj, int offset) {
+  XrefSpan *span;
+
+  if (xrefSpanCount == xrefSpanMax) {
+    xrefSpanMax = (xrefSpanMax == 0) ? INIT_XREF_INDEX : xrefSpanMax * 2;
+    xrefSpans = (XrefSpan*) realloc(xrefSpans, xrefSpanMax * sizeof(XrefSpan));
+  }
+  if ((xrefSpanCount > 0) && (offset < xrefSpans[xrefSpanCount - 1].offset))
+    xrefSpansSorted = 0;
+  span = &(xrefSpans[xrefSpanCount++]);
+  span->offset = offset;
+  span->end = offset + (int) strlen(obj->name);
+  span->object = obj;
+}
+
+/******************* Recording ******************************/
+
+void recordXref(Object *obj, Scope *scope, int access, Token *token) {
+  XrefList *list;
+  XrefEntry *ref;
+
+  if (!xrefEnabled)
+    return;
+
+  list = findXrefs(obj);
+  if (list == NULL)
+    list = newXrefList(obj, scope);
+
+  if (list->count == list->max) {
+    list->max = (list->max == 0) ? INIT_XREF_REFS : list->max * 2;
+    list->refs = (XrefEntry*) realloc(list->refs, list->max * sizeof(XrefEntry));
+  }
+  ref = &(list->refs[list->count++]);
+  ref->offset = token->offset;
+  ref->lineNo = token->lineNo;
+  ref->colNo = token->colNo;
+  ref->access = access;
+  addXrefSpan(obj, token->offset);
+}
+
+/******************* Queries ******************************/
+
+XrefList* findXrefs(Object *obj) {
+  int *slot;
+
+  if (xrefCount == 0)
+    return NULL;
+  slot = findXrefSlot(obj);
+  return (*slot < 0) ? NULL : &(xrefLists[*slot]);
+}
+
+// The number of references to obj whose access kind is in accessMask
+int countXrefs(Object *obj, int accessMask) {
+  XrefList *list = findXrefs(obj);
+  int i, n = 0;
+
+  if (list == NULL)
+    return 0;
+  for (i = 0; i < list->count; i++)
+    if (accessMask & XREF_MASK(list->refs[i].access))
+      n++;
+  return n;
+}
+
+int xrefListCount(void) {
+  return xrefCount;
+}
+
+XrefList* xrefListAt(int id) {
+  return ((id < 0) || (id >= xrefCount)) ? NULL : &(xrefLists[id]);
+}
+
+// The object whose name is used at the given source offset, if any
+Object* xrefObjectAt(int offset) {
+  int low = 0, high = xrefSpanCount;
+  int middle;
+
+  if (!xrefSpansSorted) {
+    qsort(xrefSpans, xrefSpanCount, sizeof(XrefSpan), compareSpans);
+    xrefSpansSorted = 1;
+  }
+
+  // The last span starting at or before offset
+  while (low < high) {
+    middle = (low + high) / 2;
+    if (xrefSpans[middle].offset <= offset)
+      low = middle + 1;
+    else high = middle;
+  }
+  if ((low > 0) && (offset < xrefSpans[low - 1].end))
+    return xrefSpans[low - 1].object;
+  return NULL;
+}
+
+/******************* Dump ******************************/
+
+void printScopePath(Scope *scope) {
+  if (scope == NULL)
+    return;
+  printScopePath(scope->outer);
+  if (scope->owner != NULL)
+    printf("%s.", scope->owner->name);
+}
+
+// One line per reference: qualified name, line:column, @offset, access kind
+void printXrefs(void) {
+  XrefList *list;
+  int i, j;
+
+  for (i = 0; i < xrefCount; i++) {
+    list = &(xrefLists[i]);
+    for (j = 0; j < list->count; j++) {
+      printScopePath(list->scope);
+      printf("%s %d:%d @%d %s\n", list->object->name, list->refs[j].lineNo, list->refs[j].colNo,
+             list->refs[j].offset, accessNames[list->refs[j].access]);
+    }
+  }
+}
+
+void freeXrefs(void) {
+  int i;
+
+  for (i = 0; i < xrefCount; i++)
+    free(xrefLists[i].refs);
+  free(xrefLists);
+  free(xrefIndex);
+  free(xrefSpans);
+  xrefLists = NULL;
+  xrefIndex = NULL;
+  xrefSpans = NULL;
+  xrefCount = xrefMax = xrefIndexSize = 0;
+  xrefSpanCount = xrefSpanMax = 0;
+  xrefSpansSorted = 1;
+}
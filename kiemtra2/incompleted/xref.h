@@ -0,0 +1,70 @@
+/*
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __XREF_H__
+#define __XREF_H__
+
+#include "token.h"
+#include "symtab.h"
+
+/* Cross-reference index. While xrefEnabled is set, every use of a name
+ * that semantic checking resolves is recorded against the object it
+ * denotes, as its source position and access kind. The references of an
+ * object are kept together, in source order, so finding them is one hash
+ * probe. Objects are numbered in the order of their first reference.
+ * All the references are also kept by source offset, for xrefObjectAt
+ * to find the one at an offset by binary search.
+ *
+ * The index holds pointers to objects: free it before the symbol table.
+ * Incremental reparsing does not maintain it. */
+
+#define XREF_READ 0
+#define XREF_WRITE 1
+#define XREF_CALL 2
+
+#define XREF_MASK(access) (1 << (access))
+#define XREF_ANY (XREF_MASK(XREF_READ) | XREF_MASK(XREF_WRITE) | XREF_MASK(XREF_CALL))
+
+struct XrefEntry_ {
+  int offset;
+  int lineNo;
+  int colNo;
+  int access;
+};
+
+struct XrefList_ {
+  Object *object;
+  Scope *scope;         // declaring scope, NULL for predefined objects
+  int id;
+  struct XrefEntry_ *refs;
+  int count;
+  int max;
+};
+
+struct XrefSpan_ {
+  int offset;
+  int end;              // just past the name
+  Object *object;
+};
+
+typedef struct XrefEntry_ XrefEntry;
+typedef struct XrefList_ XrefList;
+typedef struct XrefSpan_ XrefSpan;
+
+extern int xrefEnabled;
+
+void recordXref(Object *obj, Scope *scope, int access, Token *token);
+
+XrefList* findXrefs(Object *obj);
+int countXrefs(Object *obj, int accessMask);
+int xrefListCount(void);
+XrefList* xrefListAt(int id);
+Object* xrefObjectAt(int offset);
+
+void printXrefs(void);
+void freeXrefs(void);
+
+#endif
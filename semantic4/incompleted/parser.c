@@ -505,9 +505,11 @@ Type *compileLValue(void)
   return varType;
 }
 
-void compileAssign(void)
+TokenType compileAssign(void)
 {
-  switch (lookAhead->tokenType)
+  TokenType assignOp = lookAhead->tokenType;
+
+  switch (assignOp)
   {
   case SB_ASSIGN:
     eat(SB_ASSIGN);
@@ -525,8 +527,10 @@ void compileAssign(void)
     eat(SB_ASSIGN_DIVIDE);
     break;
   default:
+    missingToken(SB_ASSIGN, lookAhead->lineNo, lookAhead->colNo);
     break;
   }
+  return assignOp;
 }
 
 void compileAssignSt(void)
@@ -534,12 +538,17 @@ void compileAssignSt(void)
   //*** TODO: parse the assignment and check type consistency
   Type *varType;
   Type *expType;
+  TokenType assignOp;
 
+  // The lvalue, indexes included, is compiled once whatever the operator
   varType = compileLValue();
 
-  compileAssign();
+  assignOp = compileAssign();
   expType = compileExpression();
-  checkTypeEquality(varType, expType);
+  if (assignOp == SB_ASSIGN)
+    checkTypeEquality(varType, expType);
+  else
+    checkCompoundAssignType(varType, expType);
 }
 
 void compileCallSt(void)
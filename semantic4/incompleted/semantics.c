@@ -177,6 +177,14 @@ void checkArrayType(Type *type)
     error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
 }
 
+void checkCompoundAssignType(Type *varType, Type *expType)
+{
+  // +=, -=, *= and /= are only defined on integers
+  if ((varType == NULL) || (varType->typeClass != TP_INT))
+    error(ERR_OPERATOR_ASSIGN_WITH_CHAR_OR_STRING, currentToken->lineNo, currentToken->colNo);
+  checkIntType(expType);
+}
+
 void checkTypeEquality(Type *type1, Type *type2)
 {
   // TODO
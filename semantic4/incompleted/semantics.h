@@ -23,6 +23,7 @@ void checkCharType(Type *type);
 void checkArrayType(Type *type);
 void checkBasicType(Type *type);
 void checkTypeEquality(Type *type1, Type *type2);
+void checkCompoundAssignType(Type *varType, Type *expType);
 void checkForStType(Type *type);
 void checkExpressionType(Type *type);
 